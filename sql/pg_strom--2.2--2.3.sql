@@ -20,6 +20,11 @@ CREATE OR REPLACE FUNCTION pgstrom.arrow_fdw_truncate(regclass)
   AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_truncate'
   LANGUAGE C STRICT;
 
+CREATE OR REPLACE FUNCTION pgstrom.arrow_fdw_compaction(regclass)
+  RETURNS int
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_compaction'
+  LANGUAGE C STRICT;
+
 CREATE OR REPLACE FUNCTION
 pgstrom.arrow_fdw_export_cupy(regclass, text[] = null, int = null)
   RETURNS text
@@ -44,6 +49,20 @@ pgstrom.arrow_fdw_put_gpu_buffer(text)
   AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_put_gpu_buffer'
   LANGUAGE C STRICT;
 
+CREATE TYPE pgstrom.__arrow_fdw_metadata_stats AS (
+  shmem_hits      int8,
+  shmem_misses    int8,
+  disk_hits       int8,
+  disk_misses     int8,
+  disk_writes     int8,
+  shmem_consumed  int8
+);
+CREATE OR REPLACE FUNCTION
+pgstrom.arrow_fdw_metadata_stats()
+  RETURNS pgstrom.__arrow_fdw_metadata_stats
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_metadata_stats'
+  LANGUAGE C VOLATILE;
+
 --
 -- Drop Gstore_Fdw support functions (deprecated)
 --
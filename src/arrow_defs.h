@@ -15,6 +15,7 @@ typedef enum
 	ArrowMetadataVersion__V2 = 1,		/* not supported */
 	ArrowMetadataVersion__V3 = 2,		/* not supported */
 	ArrowMetadataVersion__V4 = 3,
+	ArrowMetadataVersion__V5 = 4,
 } ArrowMetadataVersion;
 
 /*
@@ -114,6 +115,23 @@ typedef enum
 	ArrowUnionMode__Dense		= 1,
 } ArrowUnionMode;
 
+/*
+ * CompressionType : byte
+ */
+typedef enum
+{
+	ArrowCompressionType__LZ4_FRAME	= 0,
+	ArrowCompressionType__ZSTD		= 1,
+} ArrowCompressionType;
+
+/*
+ * BodyCompressionMethod : byte
+ */
+typedef enum
+{
+	ArrowBodyCompressionMethod__BUFFER = 0,
+} ArrowBodyCompressionMethod;
+
 /*
  * ArrowTypeOptions - our own definition
  */
@@ -135,6 +153,10 @@ typedef union		ArrowTypeOptions
 	struct {
 		ArrowIntervalUnit	unit;
 	} interval;
+	struct {
+		unsigned short		index_width;	/* 0, if not dictionary-encoded */
+		unsigned short		is_signed;
+	} dictionary;
 } ArrowTypeOptions;
 
 #ifndef __CUDACC__
@@ -176,6 +198,7 @@ typedef enum
 	ArrowNodeTag__FieldNode,
 	ArrowNodeTag__Buffer,
 	ArrowNodeTag__Schema,
+	ArrowNodeTag__BodyCompression,
 	ArrowNodeTag__RecordBatch,
 	ArrowNodeTag__DictionaryBatch,
 	ArrowNodeTag__Message,
@@ -426,6 +449,16 @@ typedef struct		ArrowSchema
 	int				_num_custom_metadata;
 } ArrowSchema;
 
+/*
+ * BodyCompression
+ */
+typedef struct		ArrowBodyCompression
+{
+	ArrowNode		node;
+	ArrowCompressionType codec;
+	ArrowBodyCompressionMethod method;
+} ArrowBodyCompression;
+
 /*
  * RecordBatch
  */
@@ -439,6 +472,8 @@ typedef struct		ArrowRecordBatch
 	/* vector of Buffer */
 	ArrowBuffer	    *buffers;
 	int				_num_buffers;
+	/* optional compression of the body */
+	ArrowBodyCompression *compression;	/* NULL, if not compressed */
 } ArrowRecordBatch;
 
 /*
@@ -509,6 +544,9 @@ typedef struct
 	ArrowFooter		footer;
 	ArrowMessage   *dictionaries;	/* array of ArrowDictionaryBatch */
 	ArrowMessage   *recordBatches;	/* array of ArrowRecordBatch */
+	/* only if IPC streaming format; footer is built from the messages */
+	bool			is_stream;
+	size_t			stream_tail;	/* offset of the next message to read */
 } ArrowFileInfo;
 
 #endif		/* !__CUDACC__ */
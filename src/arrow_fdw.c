@@ -18,6 +18,7 @@
 #include "pg_strom.h"
 #include "arrow_defs.h"
 #include "arrow_ipc.h"
+#include "parquet_defs.h"
 #include "cuda_numeric.cu"
 
 /*
@@ -36,10 +37,43 @@ typedef struct RecordBatchFieldState
 	size_t		values_length;
 	off_t		extra_offset;
 	size_t		extra_length;
+	/*
+	 * compressed buffers (BodyCompression); *_length above is the length
+	 * once decompressed, and *_zlength is the length on the file.
+	 */
+	bool		compressed;
+	ArrowCompressionType codec;
+	size_t		nullmap_zlength;
+	size_t		values_zlength;
+	size_t		extra_zlength;
+	/*
+	 * column chunk of Parquet file; all the buffers are built by CPU from
+	 * the chunk at values_offset, with values_zlength on the file.
+	 */
+	ParquetColumnDesc parquet;
+	/*
+	 * layout of the values buffer to pick up a row window; width of the
+	 * values per row, or ARROW_VALUES__* below. @extra_shift is the position
+	 * in the original extra buffer where the row window begins.
+	 */
+	int			values_unitsz;
+	size_t		extra_shift;
+	/* min/max statistics (only top-level fields) */
+	bool		stat_known;		/* statistics are already examined */
+	bool		stat_valid;		/* stat_min/stat_max are valid */
+	SQLstat__datum stat_min;
+	SQLstat__datum stat_max;
+	/* virtual column by the partition key (only local copy) */
+	bool		part_key;
+	Datum		part_value;
 	int			num_children;
 	struct RecordBatchFieldState *children;
 } RecordBatchFieldState;
 
+#define ARROW_VALUES__NONE		0	/* no values buffer (Struct) */
+#define ARROW_VALUES__BITMAP	(-1)	/* bitmap (Bool) */
+#define ARROW_VALUES__OFFSET	(-2)	/* offset array (Utf8, Binary, List) */
+
 typedef struct RecordBatchState
 {
 	File		fdesc;
@@ -48,6 +82,12 @@ typedef struct RecordBatchState
 	off_t		rb_offset;	/* offset from the head */
 	size_t		rb_length;	/* length of the entire RecordBatch */
 	int64		rb_nitems;	/* number of items */
+	/* row window, if a large RecordBatch is split for parallel scan */
+	bool		rb_window;	/* true, if a row window of the RecordBatch */
+	bool		rb_rebase;	/* offset arrays must be rebased on load */
+	int64		rb_row_start; /* first row of the window */
+	/* qualifiers on the partition keys with Params, if any */
+	ExprState  *part_qual;
 	/* per column information */
 	int			ncols;
 	RecordBatchFieldState columns[FLEXIBLE_ARRAY_MEMBER];
@@ -81,6 +121,48 @@ typedef struct
 	RecordBatchFieldState fstate[FLEXIBLE_ARRAY_MEMBER];
 } arrowMetadataCache;
 
+/*
+ * metadata cache (on the disk)
+ *
+ * Parsed RecordBatchState is also written out to a file under the data
+ * directory, to avoid re-reading and re-parsing the footer of arrow files
+ * after restart or eviction from the shared memory. A file consists of
+ * the arrowMetadataFileHead, then arrowMetadataFileItem and its fstate[]
+ * for each RecordBatch. @children of fstate[] is saved as an index to
+ * the fstate[] array of the same RecordBatch.
+ * The file is named by the device and inode number of the arrow file, so
+ * it is removed when the arrow file is replaced or removed by arrow_fdw,
+ * and the files whose arrow file is gone by others are pruned at startup.
+ */
+#define ARROW_METADATA_CACHE_DIR		"pg_strom_arrow_cache"
+#define ARROW_METADATA_CACHE_MAGIC		0x434d5241		/* 'ARMC' */
+#define ARROW_METADATA_CACHE_VERSION	4
+
+typedef struct
+{
+	uint32		magic;
+	uint32		version;
+	uint32		fstate_sz;	/* sizeof(RecordBatchFieldState) */
+	int32		nrbatches;
+	/* validator of the arrow file */
+	uint64		st_dev;
+	uint64		st_ino;
+	int64		st_size;
+	int64		st_mtime_sec;
+	int64		st_mtime_nsec;
+	char		pathname[MAXPGPATH];	/* to prune the orphan files */
+} arrowMetadataFileHead;
+
+typedef struct
+{
+	int32		rb_index;
+	int32		ncols;
+	int32		nfields;	/* length of fstate[] array */
+	int64		rb_offset;
+	int64		rb_length;
+	int64		rb_nitems;
+} arrowMetadataFileItem;
+
 #define ARROW_METADATA_HASH_NSLOTS		2048
 #define ARROW_GPUBUF_HASH_NSLOTS		512
 typedef struct
@@ -88,10 +170,16 @@ typedef struct
 	slock_t		lru_lock;
 	dlist_head	lru_list;
 	pg_atomic_uint64 consumed;
+	/* statistics of the metadata cache */
+	pg_atomic_uint64 stat_shmem_hits;
+	pg_atomic_uint64 stat_shmem_misses;
+	pg_atomic_uint64 stat_disk_hits;
+	pg_atomic_uint64 stat_disk_misses;
+	pg_atomic_uint64 stat_disk_writes;
 
 	LWLock		lock_slots[ARROW_METADATA_HASH_NSLOTS];
 	dlist_head	hash_slots[ARROW_METADATA_HASH_NSLOTS];
-	dlist_head	mvcc_slots[ARROW_METADATA_HASH_NSLOTS];
+	dlist_head	mvcc_slots[ARROW_METADATA_HASH_NSLOTS];	/* arrowWriteMVCCFile */
 
 	/* for ArrowGpuBuffer links */
 	LWLock		gpubuf_locks[ARROW_GPUBUF_HASH_NSLOTS];
@@ -100,10 +188,27 @@ typedef struct
 
 /*
  * MVCC state for the pending writes
+ *
+ * arrowWriteMVCCFile is a per-file entry linked to mvcc_slots[] of the
+ * same index as lock_slots[] and hash_slots[]. It exists only while any
+ * in-progress transaction has written RecordBatches to the file, and
+ * arrowWriteMVCCLog of the individual RecordBatch is hashed by its index
+ * on rb_slots[]. So, readers of the file usually need neither a walk on
+ * the entries of other files nor another lock than lock_slots[].
  */
+#define ARROW_MVCC_RB_NSLOTS		64
+typedef struct
+{
+	dlist_node	chain;
+	MetadataCacheKey key;
+	uint32		nitems;		/* number of arrowWriteMVCCLog */
+	dlist_head	rb_slots[ARROW_MVCC_RB_NSLOTS];
+} arrowWriteMVCCFile;
+
 typedef struct
 {
 	dlist_node	chain;
+	arrowWriteMVCCFile *mvcc_file;
 	MetadataCacheKey key;
 	TransactionId xid;
 	CommandId	cid;
@@ -111,7 +216,7 @@ typedef struct
 } arrowWriteMVCCLog;
 
 /*
- * REDO Log for INSERT/TRUNCATE
+ * REDO Log for INSERT/TRUNCATE/compaction
  */
 typedef struct
 {
@@ -121,7 +226,8 @@ typedef struct
 	CommandId	cid;
 	char	   *pathname;
 	bool		is_truncate;
-	/* for TRUNCATE */
+	bool		is_compaction;
+	/* for TRUNCATE and compaction */
 	uint32		suffix;
 	/* for INSERT */
 	loff_t		footer_offset;
@@ -129,8 +235,15 @@ typedef struct
 	char		footer_backup[FLEXIBLE_ARRAY_MEMBER];
 } arrowWriteRedoLog;
 
+/* suffix of the shard files, if 'writable' with 'dir' option */
+#define ARROW_SHARD_DEFAULT_SUFFIX		"arrow"
+
 /*
  * arrowWriteState
+ *
+ * Rows to be inserted are buffered on the batch_slots[] (or given by the
+ * batch-insert callback), then appended to the SQLfield buffers column by
+ * column.
  */
 typedef struct
 {
@@ -139,25 +252,302 @@ typedef struct
 	MetadataCacheKey key;
 	uint32		hash;
 	bool		redo_log_written;
+	bool		is_compaction;	/* writes a new file without MVCC log */
+	/* bulk insert */
+	MemoryContext batch_memcxt;	/* temporary memory per batch */
+	int			batch_nrooms;	/* length of batch_slots[] */
+	int			batch_nslots;	/* number of the buffered rows */
+	TupleTableSlot **batch_slots;
 	SQLtable	sql_table;
 } arrowWriteState;
 
+/*
+ * arrowStatsHint - qualifiers to skip RecordBatches using min/max statistics
+ * and null-count of the fields.
+ */
+#define ARROW_STATS_HINT__OPERATOR		1	/* Var OP Expr */
+#define ARROW_STATS_HINT__IS_NULL		2	/* Var IS NULL */
+#define ARROW_STATS_HINT__IS_NOT_NULL	3	/* Var IS NOT NULL */
+
+typedef struct
+{
+	int			kind;		/* one of ARROW_STATS_HINT__* */
+	int			attidx;		/* index of the column (0-origin) */
+	bool		is_strict;	/* operator never matches NULL */
+	Oid			collid;		/* input collation of the operator */
+	FmgrInfo	min_fn;		/* (min OP arg) must be true, if any */
+	FmgrInfo	max_fn;		/* (max OP arg) must be true, if any */
+	ExprState  *arg;		/* argument of the operator */
+	Datum		arg_value;
+	bool		arg_isnull;
+} arrowStatsHint;
+
+/*
+ * arrowSortKey - a sort key declared by the 'sorted_by' option
+ */
+typedef struct
+{
+	AttrNumber	attnum;		/* attribute number of the column */
+	Oid			atttypid;
+	int32		atttypmod;
+	Oid			attcollid;
+	Oid			sortop;		/* '<' operator, or '>' if descending */
+	bool		descending;
+} arrowSortKey;
+
+/*
+ * ArrowFdwRelInfo - planner information of arrow_fdw foreign table,
+ * saved at baserel->fdw_private
+ */
+typedef struct
+{
+	cl_int		optimal_gpu;	/* optimal GPU, or -1 */
+	cl_int		nvme_distance;	/* distance of the GPU and NVME-SSD, or -1 */
+	double		ntuples_scan;	/* rows in RecordBatches not to be skipped */
+	int			nrbatches_scan;	/* RecordBatches not to be skipped */
+	double		npages_raw;		/* referenced compressed buffers, in pages
+								 * once decompressed */
+	List	   *sort_keys;		/* list of arrowSortKey, if 'sorted_by' */
+	int			sort_nruns;		/* number of sorted runs to be merged */
+} ArrowFdwRelInfo;
+
+/*
+ * arrowVecQual - qualifiers to be evaluated on the column buffers directly,
+ * prior to the tuple materialization.
+ *
+ * It works as a pre-filter of the scan; rows that may satisfy the qualifiers
+ * are still materialized and checked by ExecQual, so it must never drop rows
+ * that ExecQual accepts.
+ */
+#define ARROW_VEC_QUAL__COMPARE			1	/* Var OP Expr */
+#define ARROW_VEC_QUAL__ANY				2	/* Var OP ANY(Array) */
+#define ARROW_VEC_QUAL__IS_NULL			3	/* Var IS NULL */
+#define ARROW_VEC_QUAL__IS_NOT_NULL		4	/* Var IS NOT NULL */
+#define ARROW_VEC_QUAL__BOOL			5	/* Var, or NOT Var of bool */
+#define ARROW_VEC_QUAL__AND				6
+#define ARROW_VEC_QUAL__OR				7
+#define ARROW_VEC_QUAL__DICT			8	/* Var OP Expr on dictionary */
+
+typedef struct
+{
+	int			kind;		/* one of ARROW_VEC_QUAL__* */
+	int			attidx;		/* index of the column (0-origin) */
+	int			strategy;	/* BT*StrategyNumber or ROWCOMPARE_NE */
+	bool		bool_value;	/* expected value, if ARROW_VEC_QUAL__BOOL */
+	Oid			arg_type;	/* type of the argument (or its element) */
+	ExprState  *arg;		/* argument of the operator */
+	int			nvalues;	/* number of non-null argument values */
+	SQLstat__datum *values;	/* argument values in the column domain */
+	List	   *subquals;	/* sub-qualifiers, if AND/OR */
+	/* ARROW_VEC_QUAL__DICT */
+	bool		is_any;		/* Var OP ANY(Array) form */
+	Oid			collid;		/* input collation of the operator */
+	FmgrInfo	fn_dict;	/* operator applied on the dictionary entries */
+	Datum	   *dict_args;	/* non-null argument values */
+	File		dict_fdesc;	/* source of the dictionary evaluated below */
+	cl_long		dict_base;
+	uint32		dict_nitems;	/* number of dictionary entries evaluated */
+	uint32		dict_nrooms;	/* length of dict_res[] */
+	cl_char	   *dict_res;	/* results on the dictionary entries */
+} arrowVecQual;
+
+/*
+ * arrowDictBuffer - dictionary of a dictionary-encoded column
+ *
+ * The nullmap and index values of a dictionary-encoded column are loaded
+ * onto the KDS as usual, and its extra buffer points this structure, built
+ * from the DictionaryBatches (the base one and the delta ones) and placed
+ * at the tail of the KDS. All the offsets are relative to the head of this
+ * structure.
+ */
+typedef struct
+{
+	File		fdesc;			/* source file of the dictionary */
+	cl_uint		nitems;			/* number of the dictionary entries */
+	cl_long		base_offset;	/* offset of the base DictionaryBatch */
+	cl_uint		length;			/* length of this structure */
+	cl_uint		nullmap_offset;	/* offset of the nullmap, or 0 */
+	cl_uint		extra_offset;	/* offset of the extra buffer */
+	cl_uint		extra_length;	/* length of the extra buffer */
+	cl_uint		values[FLEXIBLE_ARRAY_MEMBER];	/* offset array */
+} arrowDictBuffer;
+
+/*
+ * ArrowFdwMmapState - read-only mapping of an arrow file for CPU scan
+ *
+ * The reserved virtual address space consists of a slab of PDS headers
+ * (one slot per RecordBatch in the file), followed by the file image that
+ * is mapped read-only. Because offsets in kern_colmeta are unsigned and
+ * relative to the KDS head, PDS headers must be located prior to the file
+ * image. The mapping is released when the last PDS on it and the scan
+ * which created it are released.
+ */
+struct ArrowFdwMmapState
+{
+	File		fdesc;
+	int			refcnt;		/* 1 by the scan + number of PDS in use */
+	char	   *mmap_head;	/* NULL, if file is not mapped */
+	size_t		mmap_sz;	/* length of the entire mapping */
+	size_t		slab_sz;	/* length of the PDS header slab */
+	size_t		slot_sz;	/* length of a PDS header slot */
+	int			nslots;		/* number of PDS header slots */
+};
+
 /*
  * ArrowFdwState
  */
+/*
+ * arrowDeformState
+ *
+ * CPU fetches rows from KDS_FORMAT_ARROW by vector of ARROW_DEFORM_NROWS
+ * rows. An extractor specialized to the data type is bound to each of the
+ * referenced columns once per RecordBatch, then it fills up values/isnull
+ * of the vector column-by-column.
+ */
+#define ARROW_DEFORM_NROWS		256
+
+typedef void (*arrowDeformFn)(kern_data_store *kds,
+							  kern_colmeta *cmeta,
+							  const uint32 *rows, int nrows,
+							  Datum *values, bool *isnull);
+typedef struct
+{
+	int			attidx;			/* index of the column */
+	kern_colmeta *cmeta;
+	arrowDeformFn deform_fn;
+} arrowDeformColumn;
+
+typedef struct arrowDeformState
+{
+	kern_data_store *kds;		/* KDS currently bound */
+	cl_long		next_index;		/* next row index to be deformed */
+	int			nrows;			/* number of rows in the vector */
+	int			pos;			/* current position on the vector */
+	uint32		rows[ARROW_DEFORM_NROWS];
+	Datum	   *values;			/* [ncols_max * ARROW_DEFORM_NROWS] */
+	bool	   *isnull;			/* [ncols_max * ARROW_DEFORM_NROWS] */
+	MemoryContext memcxt;		/* varlena datum of the vector */
+	int			ncols;			/* number of the bound columns */
+	int			ncols_max;		/* number of the referenced columns */
+	arrowDeformColumn columns[FLEXIBLE_ARRAY_MEMBER];
+} arrowDeformState;
+
 struct ArrowFdwState
 {
 	List	   *fdescList;
 	Bitmapset  *referenced;
-	pg_atomic_uint32   *rbatch_index;
-	pg_atomic_uint32	__rbatch_index_local;	/* if single process exec */
+	ArrowFdwSharedState *sstate;
+	ArrowFdwSharedState	__sstate_local;	/* if single process exec */
+	/* RecordBatch skip by min/max statistics */
+	List	   *stats_hint;			/* list of arrowStatsHint */
+	Bitmapset  *stats_attidx;		/* columns that need min/max stats */
+	ExprContext *econtext;			/* to evaluate arguments of stats_hint */
+	bool		stats_hint_ready;	/* arguments are already evaluated */
+	/* partitioned directory */
+	int			nfiles_pruned;		/* files pruned by the partition keys */
+	bool		has_part_qual;		/* any RecordBatches have part_qual */
+	/* vectorized evaluation of qualifiers */
+	List	   *vec_quals;			/* list of arrowVecQual */
+	bool		vec_quals_ready;	/* arguments are already evaluated */
+	MemoryContext vec_memcxt;		/* working memory of evaluation */
+	pgstrom_data_store *sel_pds;	/* PDS of the selection vector below */
+	uint32	   *sel_rows;			/* selection vector; index of rows */
+	uint32		sel_nitems;			/* number of the selected rows */
+	uint32		sel_nrooms;			/* length of sel_rows[] */
+	uint32		sel_pos;			/* current position on sel_rows[] */
+	List	   *mmap_list;			/* list of ArrowFdwMmapState */
+	List	   *dict_list;			/* list of arrowDictBuffer */
+	/* asynchronous read-ahead */
+	int			ra_depth;			/* number of RecordBatches to read-ahead */
+	int			ra_head;			/* head of the ra_queue ring buffer */
+	int			ra_nitems;			/* number of claimed RecordBatches */
+	uint32	   *ra_queue;			/* index of claimed RecordBatches */
 	pgstrom_data_store *curr_pds;	/* current focused buffer */
-	cl_ulong	curr_index;			/* current index to row on KDS */
+	cl_long		curr_index;			/* current index to row on KDS */
+	struct arrowDeformState *deform; /* column-at-a-time deform */
+	struct arrowSortedMerge *merge;	/* k-way merge, if ordered scan */
+	struct arrowMetaAgg *metaagg;	/* aggregation by the metadata */
 	/* state of RecordBatches */
 	uint32		num_rbatches;
 	RecordBatchState *rbatches[FLEXIBLE_ARRAY_MEMBER];
 };
 
+/*
+ * arrowSortedMerge - state of the ordered scan
+ *
+ * RecordBatches of the files declared as sorted are grouped into sorted runs;
+ * RecordBatches in a run have no overlap on the leading sort key according to
+ * their min/max statistics, so they are read one by one. Then, the current
+ * rows of the runs are merged by the binary heap, like MergeAppend.
+ */
+typedef struct
+{
+	int		   *rb_indexes;		/* RecordBatches of the run, in order */
+	int			rb_count;
+	int			rb_pos;
+	RecordBatchState *rb_state;	/* RecordBatch currently loaded */
+	pgstrom_data_store *pds;
+	cl_long		row_index;		/* next row index on the pds */
+	bool		has_row;		/* values[curr] holds the current row */
+	int			curr;			/* either 0 or 1 */
+	Datum	   *values[2];		/* current and previous rows */
+	bool	   *isnull[2];
+	MemoryContext memcxt[2];
+} arrowSortedRun;
+
+typedef struct arrowSortedMerge
+{
+	List	   *sort_keys;		/* list of arrowSortKey */
+	int			nkeys;
+	SortSupport	ssup;			/* [nkeys] */
+	int			natts;
+	MemoryContext memcxt;		/* memory of the sorted runs */
+	bool		initialized;	/* runs are already built */
+	int			last_run;		/* run of the row returned last, or -1 */
+	binaryheap *heap;
+	int			nruns;
+	arrowSortedRun *runs;
+} arrowSortedMerge;
+
+/*
+ * arrowMetaAgg - state of the aggregation by the metadata
+ *
+ * count(*), count(col), min(col) and max(col) without GROUP BY are answered
+ * by the number of rows, null-count and min/max statistics of RecordBatches.
+ * RecordBatches are scanned only if the metadata cannot prove that all the
+ * rows satisfy the qualifiers, or min/max statistics are not available.
+ */
+#define ARROW_META_AGG__COUNT_STAR		1	/* count(*) */
+#define ARROW_META_AGG__COUNT			2	/* count(Var) */
+#define ARROW_META_AGG__MIN				3	/* min(Var) */
+#define ARROW_META_AGG__MAX				4	/* max(Var) */
+
+typedef struct
+{
+	int			kind;		/* one of ARROW_META_AGG__* */
+	int			attidx;		/* index of the column (0-origin) */
+	Oid			collid;		/* input collation of the aggregate */
+	FmgrInfo	cmp_fn;		/* aggsortop of min/max */
+	int64		count;		/* result of count */
+	Datum		value;		/* result of min/max */
+	bool		isnull;
+} arrowMetaAggItem;
+
+typedef struct arrowMetaAgg
+{
+	List	   *hints;			/* arrowStatsHint to prove the qualifiers */
+	bool		hints_ready;	/* arguments are already evaluated */
+	bool		quals_proven;	/* hints cover all the qualifiers */
+	ExprState  *quals;			/* qualifiers evaluated on the scan */
+	TupleTableSlot *base_slot;	/* slot of the foreign table */
+	MemoryContext memcxt;		/* per-row working memory */
+	bool		done;			/* result is already returned */
+	uint32		nbatches_meta;	/* RecordBatches by the metadata */
+	uint32		nbatches_scan;	/* RecordBatches scanned */
+	int			naggs;
+	arrowMetaAggItem aggs[FLEXIBLE_ARRAY_MEMBER];
+} arrowMetaAgg;
+
 /*
  * ArrowGpuBuffer (shared structure)
  */
@@ -194,11 +584,24 @@ static FdwRoutine		pgstrom_arrow_fdw_routine;
 static shmem_startup_hook_type shmem_startup_next = NULL;
 static arrowMetadataState *arrow_metadata_state = NULL;
 static dlist_head		arrow_write_redo_list;
+static List			   *arrow_write_mvcc_list = NIL;	/* arrowWriteMVCCLog */
 static bool				arrow_fdw_enabled;				/* GUC */
 static int				arrow_metadata_cache_size_kb;	/* GUC */
 static size_t			arrow_metadata_cache_size;
+static bool				arrow_metadata_cache_persistent;	/* GUC */
 static char			   *arrow_debug_row_numbers_hint;	/* GUC */
 static int				arrow_record_batch_size_kb;		/* GUC */
+static bool				arrow_fdw_enable_mmap;			/* GUC */
+static int				arrow_fdw_readahead_depth;		/* GUC */
+static int				arrow_fdw_split_unit_size_kb;	/* GUC */
+static int				arrow_fdw_sorted_merge_limit;	/* GUC */
+static bool				arrow_fdw_enable_metadata_agg;	/* GUC */
+static int				arrow_fdw_insert_batch_size;	/* GUC */
+static char			   *arrow_fdw_compaction_database;	/* GUC */
+static int				arrow_fdw_compaction_naptime;	/* GUC */
+static int				arrow_fdw_compaction_min_batches; /* GUC */
+static volatile sig_atomic_t arrow_compaction_got_sigterm = false;
+static volatile sig_atomic_t arrow_compaction_got_sighup = false;
 static dlist_head		arrow_gpu_buffer_tracker_list;
 
 /* ---------- static functions ---------- */
@@ -212,10 +615,53 @@ static List	   *__arrowFdwExtractFilesList(List *options_list,
 										   int *p_parallel_nworkers,
 										   bool *p_writable);
 static List	   *arrowFdwExtractFilesList(List *options_list);
-static RecordBatchState *makeRecordBatchState(ArrowSchema *schema,
-											  ArrowBlock *block,
-											  ArrowRecordBatch *rbatch);
+static List	   *__arrowFdwParseSortedBy(const char *sorted_by,
+										TupleDesc tupdesc);
+static List	   *arrowFdwSortKeys(List *options_list, TupleDesc tupdesc);
+static int		arrowFdwAssignSortedRuns(RecordBatchState **rbatches,
+										 int nitems, int *run_id,
+										 List *sort_keys);
+static const char *arrowFdwPartitionDir(List *options_list);
+static char	   *arrowFdwWritableFile(List *options_list, bool *p_sharded);
+static Const  **arrowFdwPartitionConsts(TupleDesc tupdesc,
+										const char *dir_path,
+										const char *fname);
+static List	   *arrowFdwRemapPartitionColumns(List *rb_cached,
+											  TupleDesc tupdesc,
+											  Const **part_consts);
+static List	   *arrowFdwPartitionQuals(List *quals, TupleDesc tupdesc,
+									   Const **part_consts,
+									   bool *p_refuted);
+static RecordBatchState *makeRecordBatchState(ArrowFileInfo *af_info,
+											  int rb_index, File fdesc);
 static List	   *arrowLookupOrBuildMetadataCache(File fdesc);
+static bool		__arrowStatsTypeIsSupported(Oid type_oid);
+static List	   *__buildArrowStatsHint(TupleDesc tupdesc, List *quals,
+									  PlanState *ps);
+static bool		__arrowStatsHintCheckRecordBatch(List *stats_hint,
+												 RecordBatchState *rb_state);
+static inline DateADT __arrow_date_to_pg(cl_long ival, ArrowDateUnit unit);
+static inline TimeADT __arrow_time_to_pg(cl_long ival, ArrowTimeUnit unit);
+static inline Timestamp __arrow_timestamp_to_pg(cl_long ival,
+												ArrowTimeUnit unit);
+static void		arrowUpdateMetadataCacheFieldStat(RecordBatchState *rb_state,
+												  int attidx);
+static arrowDeformState *arrowFdwCreateDeformState(Bitmapset *referenced);
+static arrowSortedMerge *arrowFdwCreateSortedMerge(List *sort_keys,
+												   TupleDesc tupdesc);
+static arrowMetaAgg *arrowFdwCreateMetaAgg(ArrowFdwState *af_state,
+										   List *fdw_scan_tlist,
+										   Index scanrelid,
+										   TupleDesc tupdesc,
+										   PlanState *ps);
+static void		__arrowFdwReadChunk(File fdesc, off_t f_pos,
+									size_t length, void *dest);
+static inline cl_long __arrowDictIndexRef(kern_colmeta *cmeta,
+										  const char *values, size_t index);
+static inline bool __arrowDictBufferRef(arrowDictBuffer *dict, cl_long dindex,
+										char **p_addr, cl_uint *p_len);
+static Datum	pg_bool_arrow_ref(kern_data_store *kds,
+								  kern_colmeta *cmeta, size_t index);
 static void		pg_datum_arrow_ref(kern_data_store *kds,
 								   kern_colmeta *cmeta,
 								   size_t index,
@@ -227,15 +673,28 @@ static arrowWriteState *createArrowWriteState(Relation frel, File file,
 static void createArrowWriteRedoLog(File filp, bool is_newfile);
 static void writeOutArrowRecordBatch(arrowWriteState *aw_state,
 									 bool with_footer);
+static void arrowWriteFlushBatch(arrowWriteState *aw_state,
+								 TupleDesc tupdesc);
+static void arrowWriteAppendSlots(arrowWriteState *aw_state,
+								  TupleDesc tupdesc,
+								  TupleTableSlot **slots, int nslots);
+static void arrowWriteInsertSlot(arrowWriteState *aw_state,
+								 TupleDesc tupdesc,
+								 TupleTableSlot *slot);
+static arrowWriteRedoLog *__arrowFdwLookupRedoLog(const char *pathname,
+												  bool compaction_only);
 
 Datum	pgstrom_arrow_fdw_handler(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_validator(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_precheck_schema(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS);
+Datum	pgstrom_arrow_fdw_compaction(PG_FUNCTION_ARGS);
+void	arrowFdwCompactionMain(Datum arg);
 Datum	pgstrom_arrow_fdw_export_cupy(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_export_cupy_pinned(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_unpin_gpu_buffer(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_put_gpu_buffer(PG_FUNCTION_ARGS);
+Datum	pgstrom_arrow_fdw_metadata_stats(PG_FUNCTION_ARGS);
 
 /*
  * timespec_comp - compare timespec values
@@ -298,8 +757,21 @@ RecordBatchFieldCount(RecordBatchState *rbstate)
 	return count;
 }
 
+/*
+ * RecordBatchFieldIsDictionary
+ */
+static inline bool
+RecordBatchFieldIsDictionary(RecordBatchFieldState *fstate)
+{
+	return ((fstate->atttypid == TEXTOID ||
+			 fstate->atttypid == BYTEAOID) &&
+			fstate->attopts.dictionary.index_width > 0);
+}
+
 /*
  * RecordBatchFieldLength
+ *
+ * NOTE: dictionaries are not counted, because they are loaded once per scan
  */
 static size_t
 RecordBatchFieldLength(RecordBatchFieldState *fstate)
@@ -307,18 +779,51 @@ RecordBatchFieldLength(RecordBatchFieldState *fstate)
 	size_t	len = 0;
 	int		j;
 
-	if (fstate->nullmap_offset > 0)
-		len += fstate->nullmap_length;
-	if (fstate->values_offset > 0)
-		len += fstate->values_length;
-	if (fstate->extra_offset > 0)
-		len += fstate->extra_length;
+	if (fstate->compressed)
+	{
+		len += (fstate->nullmap_zlength +
+				fstate->values_zlength +
+				fstate->extra_zlength);
+	}
+	else
+	{
+		if (fstate->nullmap_offset > 0)
+			len += fstate->nullmap_length;
+		if (fstate->values_offset > 0)
+			len += fstate->values_length;
+		if (fstate->extra_offset > 0)
+			len += fstate->extra_length;
+	}
 	len = BLCKALIGN(len);
+	if (RecordBatchFieldIsDictionary(fstate))
+		return len;
 	for (j=0; j < fstate->num_children; j++)
 		len += RecordBatchFieldLength(&fstate->children[j]);
 	return len;
 }
 
+/*
+ * RecordBatchFieldRawLength
+ *
+ * length of the compressed buffers once decompressed; 0 if not compressed
+ */
+static size_t
+RecordBatchFieldRawLength(RecordBatchFieldState *fstate)
+{
+	size_t	len = 0;
+	int		j;
+
+	if (fstate->compressed)
+		len += BLCKALIGN(fstate->nullmap_length +
+						 fstate->values_length +
+						 fstate->extra_length);
+	if (RecordBatchFieldIsDictionary(fstate))
+		return len;
+	for (j=0; j < fstate->num_children; j++)
+		len += RecordBatchFieldRawLength(&fstate->children[j]);
+	return len;
+}
+
 /*
  * apply_debug_row_numbers_hint
  *
@@ -378,8 +883,62 @@ apply_debug_row_numbers_hint(PlannerInfo *root,
 	pfree(config);
 }
 
+/*
+ * arrowPlanStatsHint
+ *
+ * It builds arrowStatsHint at the planning time, to estimate RecordBatches
+ * to be skipped by min/max statistics. Only qualifiers with constant
+ * arguments are considered, because Params are not valid yet.
+ */
+static List *
+arrowPlanStatsHint(RelOptInfo *baserel, TupleDesc tupdesc,
+				   ExprContext *econtext)
+{
+	List	   *quals = NIL;
+	List	   *stats_hint;
+	ListCell   *lc;
+
+	foreach (lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = lfirst(lc);
+		Expr	   *expr = rinfo->clause;
+
+		if (IsA(expr, OpExpr))
+		{
+			OpExpr	   *op = (OpExpr *) expr;
+
+			if (list_length(op->args) != 2 ||
+				(!IsA(linitial(op->args), Const) &&
+				 !IsA(lsecond(op->args), Const)))
+				continue;
+		}
+		else if (!IsA(expr, NullTest))
+			continue;
+		quals = lappend(quals, expr);
+	}
+	if (quals == NIL)
+		return NIL;
+
+	stats_hint = __buildArrowStatsHint(tupdesc, quals, NULL);
+	foreach (lc, stats_hint)
+	{
+		arrowStatsHint *hint = lfirst(lc);
+
+		if (hint->arg)
+			hint->arg_value = ExecEvalExpr(hint->arg, econtext,
+										   &hint->arg_isnull);
+	}
+	list_free(quals);
+
+	return stats_hint;
+}
+
 /*
  * ArrowGetForeignRelSize
+ *
+ * It also estimates the amount of i/o by the referenced columns of the
+ * RecordBatches which are not skipped by min/max statistics, on the
+ * storage (compressed) and once decompressed.
  */
 static void
 ArrowGetForeignRelSize(PlannerInfo *root,
@@ -387,15 +946,31 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 					   Oid foreigntableid)
 {
 	ForeignTable   *ft = GetForeignTable(foreigntableid);
+	ArrowFdwRelInfo *af_rinfo;
+	Relation		frel;
+	TupleDesc		tupdesc;
+	ExprContext	   *econtext;
 	List		   *filesList;
+	List		   *stats_hint;
+	const char	   *part_dir;
+	List		   *part_quals = NIL;
+	List		   *rest_clauses = NIL;
+	Bitmapset	   *part_attrs = NULL;
+	List		   *sort_keys;
+	List		   *sort_rbatches = NIL;
+	int				sort_nruns = 0;
 	Size			filesSizeTotal = 0;
 	Bitmapset	   *referenced = NULL;
-	BlockNumber		npages = 0;
+	double			nbytes_scan = 0.0;
+	double			nbytes_raw = 0.0;
 	double			ntuples = 0.0;
+	double			ntuples_scan = 0.0;
+	int				nrbatches_scan = 0;
 	ListCell	   *lc;
 	int				parallel_nworkers;
 	bool			writable;
 	int				optimal_gpu = INT_MAX;
+	int				nvme_distance = -1;
 	int				j, k;
 
 	/* columns to be fetched */
@@ -407,17 +982,45 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 	}
 	referenced = pgstrom_pullup_outer_refs(root, baserel, referenced);
 
+	/* qualifiers to skip RecordBatches by min/max statistics */
+	frel = table_open(foreigntableid, NoLock);
+	tupdesc = RelationGetDescr(frel);
+	econtext = CreateStandaloneExprContext();
+	stats_hint = arrowPlanStatsHint(baserel, tupdesc, econtext);
+
 	filesList = __arrowFdwExtractFilesList(ft->options,
 										   &parallel_nworkers,
 										   &writable);
+	sort_keys = arrowFdwSortKeys(ft->options, tupdesc);
+	/* qualifiers to prune files by the partition keys */
+	part_dir = arrowFdwPartitionDir(ft->options);
+	if (part_dir)
+		part_quals = extract_actual_clauses(baserel->baserestrictinfo, false);
 	foreach (lc, filesList)
 	{
 		char	   *fname = strVal(lfirst(lc));
 		File		fdesc;
 		List	   *rb_cached;
 		ListCell   *cell;
-		size_t		len = 0;
+		Const	  **part_consts = NULL;
+		int			distance;
+
+		if (part_dir)
+		{
+			bool	refuted;
 
+			part_consts = arrowFdwPartitionConsts(tupdesc, part_dir, fname);
+			(void) arrowFdwPartitionQuals(part_quals, tupdesc,
+										  part_consts, &refuted);
+			if (refuted)
+				continue;
+			for (j=0; part_consts && j < tupdesc->natts; j++)
+			{
+				if (part_consts[j])
+					part_attrs = bms_add_member(part_attrs, j + 1 -
+												FirstLowInvalidHeapAttributeNumber);
+			}
+		}
 		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
 		if (fdesc < 0)
 		{
@@ -426,24 +1029,34 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 			elog(ERROR, "failed to open file '%s' on behalf of '%s'",
 				 fname, get_rel_name(foreigntableid));
 		}
-		k = GetOptimalGpuForFile(fdesc);
+		k = GetOptimalGpuForFile(fdesc, &distance);
 		if (optimal_gpu == INT_MAX)
 			optimal_gpu = k;
 		else if (optimal_gpu != k)
 			optimal_gpu = -1;
+		nvme_distance = Max(nvme_distance, distance);
 
 		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
+		rb_cached = arrowFdwRemapPartitionColumns(rb_cached, tupdesc,
+												  part_consts);
 		foreach (cell, rb_cached)
 		{
 			RecordBatchState   *rb_state = lfirst(cell);
 
 			if (cell == list_head(rb_cached))
 				filesSizeTotal += BLCKALIGN(rb_state->stat_buf.st_size);
+			ntuples += rb_state->rb_nitems;
+			if (stats_hint != NIL &&
+				__arrowStatsHintCheckRecordBatch(stats_hint, rb_state))
+				continue;
 
 			if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, referenced))
 			{
 				for (j=0; j < rb_state->ncols; j++)
-					len += RecordBatchFieldLength(&rb_state->columns[j]);
+				{
+					nbytes_scan += RecordBatchFieldLength(&rb_state->columns[j]);
+					nbytes_raw += RecordBatchFieldRawLength(&rb_state->columns[j]);
+				}
 			}
 			else
 			{
@@ -454,28 +1067,78 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 					j = k + FirstLowInvalidHeapAttributeNumber;
 					if (j < 0 || j >= rb_state->ncols)
 						continue;
-					len += RecordBatchFieldLength(&rb_state->columns[j]);
+					nbytes_scan += RecordBatchFieldLength(&rb_state->columns[j]);
+					nbytes_raw += RecordBatchFieldRawLength(&rb_state->columns[j]);
 				}
 			}
-			ntuples += rb_state->rb_nitems;
+			ntuples_scan += rb_state->rb_nitems;
+			nrbatches_scan++;
+			if (sort_keys != NIL)
+				sort_rbatches = lappend(sort_rbatches, rb_state);
 		}
-		npages = len / BLCKSZ;
 		FileClose(fdesc);
 	}
 	bms_free(referenced);
+	FreeExprContext(econtext, true);
+	table_close(frel, NoLock);
+
+	/* number of sorted runs to be merged, if files are declared as sorted */
+	if (sort_rbatches != NIL)
+	{
+		int		nitems = list_length(sort_rbatches);
+		int	   *run_id = palloc0(sizeof(int) * nitems);
+		RecordBatchState **rbatches;
+
+		rbatches = palloc(sizeof(RecordBatchState *) * nitems);
+		j = 0;
+		foreach (lc, sort_rbatches)
+			rbatches[j++] = lfirst(lc);
+		sort_nruns = arrowFdwAssignSortedRuns(rbatches, nitems,
+											  run_id, sort_keys);
+		pfree(rbatches);
+		pfree(run_id);
+		list_free(sort_rbatches);
+	}
+
+	/*
+	 * baserel->tuples counts only the files not pruned, so qualifiers that
+	 * reference only the partition keys are already applied.
+	 */
+	foreach (lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo   *rinfo = lfirst(lc);
+		Bitmapset	   *attrs = NULL;
+
+		if (part_attrs)
+		{
+			pull_varattnos((Node *)rinfo->clause, baserel->relid, &attrs);
+			if (attrs && bms_is_subset(attrs, part_attrs))
+				continue;
+		}
+		rest_clauses = lappend(rest_clauses, rinfo);
+	}
 
 	if (optimal_gpu < 0 || optimal_gpu >= numDevAttrs)
 		optimal_gpu = -1;
 	else if (filesSizeTotal < nvme_strom_threshold())
 		optimal_gpu = -1;
 
+	af_rinfo = palloc0(sizeof(ArrowFdwRelInfo));
+	af_rinfo->optimal_gpu = optimal_gpu;
+	af_rinfo->nvme_distance = (optimal_gpu < 0 ? -1 : nvme_distance);
+	af_rinfo->ntuples_scan = ntuples_scan;
+	af_rinfo->nrbatches_scan = nrbatches_scan;
+	af_rinfo->npages_raw = nbytes_raw / (double) BLCKSZ;
+	af_rinfo->sort_keys = sort_keys;
+	af_rinfo->sort_nruns = sort_nruns;
+
 	baserel->rel_parallel_workers = parallel_nworkers;
-	baserel->fdw_private = makeInteger(optimal_gpu);
-	baserel->pages = npages;
+	baserel->fdw_private = af_rinfo;
+	baserel->pages = (BlockNumber)(nbytes_scan / (double) BLCKSZ);
 	baserel->tuples = ntuples;
 	baserel->rows = ntuples *
 		clauselist_selectivity(root,
-							   baserel->baserestrictinfo,
+							   rest_clauses,
 							   0,
 							   JOIN_INNER,
 							   NULL);
@@ -484,12 +1147,12 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 }
 
 /*
- * GetOptimalGpuForArrowFdw
+ * GetArrowFdwRelInfo
  *
- * optimal GPU index is saved at baserel->fdw_private
+ * planner information is saved at baserel->fdw_private
  */
-cl_int
-GetOptimalGpuForArrowFdw(PlannerInfo *root, RelOptInfo *baserel)
+static ArrowFdwRelInfo *
+GetArrowFdwRelInfo(PlannerInfo *root, RelOptInfo *baserel)
 {
 	if (!baserel->fdw_private)
 	{
@@ -497,7 +1160,45 @@ GetOptimalGpuForArrowFdw(PlannerInfo *root, RelOptInfo *baserel)
 
 		ArrowGetForeignRelSize(root, baserel, rte->relid);
 	}
-	return intVal(baserel->fdw_private);
+	return (ArrowFdwRelInfo *) baserel->fdw_private;
+}
+
+/*
+ * GetOptimalGpuForArrowFdw
+ */
+cl_int
+GetOptimalGpuForArrowFdw(PlannerInfo *root, RelOptInfo *baserel)
+{
+	return GetArrowFdwRelInfo(root, baserel)->optimal_gpu;
+}
+
+/*
+ * GetNvmeDistanceForArrowFdw
+ */
+cl_int
+GetNvmeDistanceForArrowFdw(PlannerInfo *root, RelOptInfo *baserel)
+{
+	return GetArrowFdwRelInfo(root, baserel)->nvme_distance;
+}
+
+/*
+ * GetDecompressCostForArrowFdw
+ *
+ * CPU cost to decompress the referenced columns; we assume decompression
+ * of a page takes half of the sequential read.
+ */
+Cost
+GetDecompressCostForArrowFdw(PlannerInfo *root, RelOptInfo *baserel)
+{
+	ArrowFdwRelInfo *af_rinfo = GetArrowFdwRelInfo(root, baserel);
+	double		spc_seq_page_cost;
+
+	if (af_rinfo->npages_raw <= 0.0)
+		return 0.0;
+	get_tablespace_page_costs(baserel->reltablespace,
+							  NULL,
+							  &spc_seq_page_cost);
+	return 0.5 * spc_seq_page_cost * af_rinfo->npages_raw;
 }
 
 static void
@@ -507,11 +1208,13 @@ cost_arrow_fdw_seqscan(Path *path,
 					   ParamPathInfo *param_info,
 					   int num_workers)
 {
+	ArrowFdwRelInfo *af_rinfo = GetArrowFdwRelInfo(root, baserel);
 	Cost		startup_cost = 0.0;
 	Cost		disk_run_cost = 0.0;
 	Cost		cpu_run_cost = 0.0;
 	QualCost	qcost;
 	double		nrows;
+	double		parallel_divisor = 1.0;
 	double		spc_seq_page_cost;
 
 	if (param_info)
@@ -523,18 +1226,31 @@ cost_arrow_fdw_seqscan(Path *path,
 	if (!arrow_fdw_enabled)
 		startup_cost += disable_cost;
 
+	/* see get_parallel_divisor() */
+	if (num_workers > 0)
+	{
+		double		leader_contribution;
+
+		parallel_divisor = (double) num_workers;
+		leader_contribution = 1.0 - (0.3 * (double)num_workers);
+		parallel_divisor += Max(leader_contribution, 0.0);
+	}
+
 	/*
 	 * Storage costs
 	 *
-	 * XXX - smaller number of columns to read shall have less disk cost
-	 * because of columnar format. Right now, we don't discount cost for
-	 * the pages not to be read.
+	 * baserel->pages is the length of the referenced columns (compressed,
+	 * if any) in the RecordBatches not to be skipped by min/max statistics,
+	 * because of columnar format.
 	 */
 	get_tablespace_page_costs(baserel->reltablespace,
 							  NULL,
 							  &spc_seq_page_cost);
-	disk_run_cost = spc_seq_page_cost * baserel->pages;
-
+	disk_run_cost = pgstrom_relscan_disk_cost(root, baserel,
+											  spc_seq_page_cost *
+											  baserel->pages,
+											  parallel_divisor,
+											  false);
 	/* CPU costs */
 	if (param_info)
 	{
@@ -545,7 +1261,7 @@ cost_arrow_fdw_seqscan(Path *path,
 	else
 		qcost = baserel->baserestrictcost;
 	startup_cost += qcost.startup;
-	cpu_run_cost = (cpu_tuple_cost + qcost.per_tuple) * baserel->tuples;
+	cpu_run_cost = (cpu_tuple_cost + qcost.per_tuple) * af_rinfo->ntuples_scan;
 
 	/* tlist evaluation costs */
 	startup_cost += path->pathtarget->cost.startup;
@@ -554,13 +1270,6 @@ cost_arrow_fdw_seqscan(Path *path,
 	/* adjust cost for CPU parallelism */
 	if (num_workers > 0)
 	{
-		double		leader_contribution;
-		double		parallel_divisor = (double) num_workers;
-
-		/* see get_parallel_divisor() */
-		leader_contribution = 1.0 - (0.3 * (double)num_workers);
-		parallel_divisor += Max(leader_contribution, 0.0);
-
 		/* The CPU cost is divided among all the workers. */
 		cpu_run_cost /= parallel_divisor;
 
@@ -573,6 +1282,68 @@ cost_arrow_fdw_seqscan(Path *path,
 	path->parallel_workers = num_workers;
 }
 
+/*
+ * arrowFdwBuildPathKeys - pathkeys of the ordered scan, if useful
+ */
+static List *
+arrowFdwBuildPathKeys(PlannerInfo *root,
+					  RelOptInfo *baserel,
+					  List *sort_keys)
+{
+	List	   *pathkeys = NIL;
+	ListCell   *lc;
+
+	foreach (lc, sort_keys)
+	{
+		arrowSortKey *skey = lfirst(lc);
+		PathKey	   *pathkey;
+		Var		   *var;
+		List	   *temp;
+
+		var = makeVar(baserel->relid,
+					  skey->attnum,
+					  skey->atttypid,
+					  skey->atttypmod,
+					  skey->attcollid,
+					  0);
+		temp = build_expression_pathkey(root, (Expr *)var,
+										NULL,	/* no nullable relids */
+										skey->sortop,
+										baserel->relids,
+										true);
+		if (temp == NIL)
+			break;
+		pathkey = linitial(temp);
+		/* columns fixed to a constant are not meaningful for ordering */
+		if (EC_MUST_BE_REDUNDANT(pathkey->pk_eclass) ||
+			list_member_ptr(pathkeys, pathkey))
+			continue;
+		pathkeys = lappend(pathkeys, pathkey);
+	}
+	return truncate_useless_pathkeys(root, baserel, pathkeys);
+}
+
+/*
+ * cost_arrow_fdw_sorted_merge
+ *
+ * Additional cost of the ordered scan; k-way merge of the sorted runs by
+ * the binary heap (see cost_merge_append), and verification of the order.
+ */
+static void
+cost_arrow_fdw_sorted_merge(Path *path, RelOptInfo *baserel)
+{
+	ArrowFdwRelInfo *af_rinfo = baserel->fdw_private;
+	int			nkeys = list_length(af_rinfo->sort_keys);
+	double		nruns = Max(af_rinfo->sort_nruns, 1);
+	double		logN = log(nruns) / log(2.0);
+	Cost		comparison_cost = 2.0 * cpu_operator_cost;
+
+	path->startup_cost += comparison_cost * nruns * logN;
+	path->total_cost += comparison_cost * nruns * logN;
+	path->total_cost += (comparison_cost * logN +
+						 cpu_operator_cost * nkeys) * af_rinfo->ntuples_scan;
+}
+
 /*
  * ArrowGetForeignPaths
  */
@@ -581,6 +1352,7 @@ ArrowGetForeignPaths(PlannerInfo *root,
 					 RelOptInfo *baserel,
 					 Oid foreigntableid)
 {
+	ArrowFdwRelInfo *af_rinfo = GetArrowFdwRelInfo(root, baserel);
 	ForeignPath	   *fpath;
 	ParamPathInfo  *param_info;
 	Relids			required_outer = baserel->lateral_relids;
@@ -599,6 +1371,35 @@ ArrowGetForeignPaths(PlannerInfo *root,
 	cost_arrow_fdw_seqscan(&fpath->path, root, baserel, param_info, 0);
 	add_path(baserel, (Path *)fpath);
 
+	/*
+	 * Ordered scan by the k-way merge of RecordBatches, if the files are
+	 * declared as sorted by the 'sorted_by' option, and the number of the
+	 * sorted runs to be loaded at once is reasonable.
+	 */
+	if (af_rinfo->sort_keys != NIL &&
+		af_rinfo->sort_nruns > 0 &&
+		af_rinfo->sort_nruns <= arrow_fdw_sorted_merge_limit)
+	{
+		List   *pathkeys = arrowFdwBuildPathKeys(root, baserel,
+												 af_rinfo->sort_keys);
+		if (pathkeys != NIL)
+		{
+			fpath = create_foreignscan_path(root, baserel,
+											NULL,	/* default pathtarget */
+											-1,		/* dummy */
+											-1.0,	/* dummy */
+											-1.0,	/* dummy */
+											pathkeys,
+											required_outer,
+											NULL,	/* no extra plan */
+											NIL);	/* no particular private */
+			cost_arrow_fdw_seqscan(&fpath->path, root, baserel,
+								   param_info, 0);
+			cost_arrow_fdw_sorted_merge(&fpath->path, baserel);
+			add_path(baserel, (Path *)fpath);
+		}
+	}
+
 	if (baserel->consider_parallel)
 	{
 		int		num_workers =
@@ -627,29 +1428,241 @@ ArrowGetForeignPaths(PlannerInfo *root,
 }
 
 /*
- * ArrowGetForeignPlan
+ * arrowMetaAggKind - kind of the aggregate function that can be answered
+ * by the metadata of RecordBatches, or 0 if not supported.
  */
-static ForeignScan *
-ArrowGetForeignPlan(PlannerInfo *root,
-					RelOptInfo *baserel,
-					Oid foreigntableid,
-					ForeignPath *best_path,
-					List *tlist,
-					List *scan_clauses,
-					Plan *outer_plan)
+static int
+arrowMetaAggKind(Aggref *aggref, Oid *p_sortop)
 {
-	Bitmapset  *referenced = NULL;
-	List	   *ref_list = NIL;
-	ListCell   *lc;
-	int			i, j, k;
-
-	Assert(IS_SIMPLE_REL(baserel));
-	/* pick up referenced attributes */
-	foreach (lc, baserel->baserestrictinfo)
-	{
-		RestrictInfo   *rinfo = lfirst(lc);
+	HeapTuple	tuple;
+	Oid			aggsortop;
+	Oid			opfamily;
+	Oid			opcintype;
+	int16		strategy;
+	const char *func_name;
+	TargetEntry *tle;
+	Var		   *var;
+
+	if (aggref->aggkind != AGGKIND_NORMAL ||
+		aggref->agglevelsup > 0 ||
+		aggref->aggdirectargs != NIL ||
+		aggref->aggorder != NIL ||
+		aggref->aggdistinct != NIL ||
+		aggref->aggfilter != NULL ||
+		get_func_namespace(aggref->aggfnoid) != PG_CATALOG_NAMESPACE)
+		return 0;
+	func_name = get_func_name(aggref->aggfnoid);
+	if (aggref->aggstar)
+		return (strcmp(func_name, "count") == 0
+				? ARROW_META_AGG__COUNT_STAR : 0);
+	if (list_length(aggref->args) != 1)
+		return 0;
+	tle = linitial(aggref->args);
+	var = (Var *) tle->expr;
+	if (!IsA(var, Var) ||
+		var->varlevelsup > 0 ||
+		var->varattno <= 0)
+		return 0;
+	if (strcmp(func_name, "count") == 0)
+		return ARROW_META_AGG__COUNT;
+
+	/* min/max by the statistics */
+	if (!__arrowStatsTypeIsSupported(var->vartype))
+		return 0;
+	tuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggref->aggfnoid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for pg_aggregate %u",
+			 aggref->aggfnoid);
+	aggsortop = ((Form_pg_aggregate) GETSTRUCT(tuple))->aggsortop;
+	ReleaseSysCache(tuple);
+	if (!OidIsValid(aggsortop) ||
+		!get_ordering_op_properties(aggsortop,
+									&opfamily,
+									&opcintype,
+									&strategy) ||
+		opcintype != var->vartype)
+		return 0;
+	*p_sortop = aggsortop;
+	if (strategy == BTLessStrategyNumber)
+		return ARROW_META_AGG__MIN;
+	if (strategy == BTGreaterStrategyNumber)
+		return ARROW_META_AGG__MAX;
+	return 0;
+}
 
-		pull_varattnos((Node *)rinfo->clause, baserel->relid, &referenced);
+/*
+ * ArrowGetForeignUpperPaths
+ *
+ * It adds a path to answer the aggregate functions without GROUP BY by
+ * the metadata of RecordBatches, if all of them are count(*), count(col),
+ * min(col) or max(col).
+ */
+static void
+ArrowGetForeignUpperPaths(PlannerInfo *root,
+						  UpperRelationKind stage,
+						  RelOptInfo *input_rel,
+						  RelOptInfo *output_rel
+#if PG_VERSION_NUM >= 110000
+						  ,void *extra
+#endif
+	)
+{
+	Query		   *parse = root->parse;
+	PathTarget	   *target = root->upper_targets[UPPERREL_GROUP_AGG];
+	ArrowFdwRelInfo *af_rinfo;
+	ForeignPath	   *fpath;
+	List		   *aggrefs = NIL;
+	List		   *quals;
+	List		   *ref_list = NIL;
+	List		   *temp;
+	Bitmapset	   *referenced = NULL;
+	Cost			startup_cost;
+	Cost			total_cost;
+	ListCell	   *lc;
+	int				k;
+
+	if (stage != UPPERREL_GROUP_AGG ||
+		!arrow_fdw_enabled ||
+		!arrow_fdw_enable_metadata_agg)
+		return;
+	if (input_rel->reloptkind != RELOPT_BASEREL ||
+		!baseRelIsArrowFdw(input_rel) ||
+		!parse->hasAggs ||
+		parse->groupClause != NIL ||
+		parse->groupingSets != NIL ||
+		parse->hasTargetSRFs ||
+		root->hasHavingQual)
+		return;
+
+	/* all the aggregate functions must be answered by the metadata */
+	temp = pull_var_clause((Node *)target->exprs,
+						   PVC_INCLUDE_AGGREGATES |
+						   PVC_RECURSE_WINDOWFUNCS |
+						   PVC_RECURSE_PLACEHOLDERS);
+	foreach (lc, temp)
+	{
+		Node   *node = lfirst(lc);
+		Oid		sortop;
+
+		if (!IsA(node, Aggref) ||
+			arrowMetaAggKind((Aggref *)node, &sortop) == 0)
+			return;
+		aggrefs = list_append_unique(aggrefs, node);
+		pull_varattnos(node, input_rel->relid, &referenced);
+	}
+	list_free(temp);
+	if (aggrefs == NIL)
+		return;
+
+	quals = extract_actual_clauses(input_rel->baserestrictinfo, false);
+	if (contain_subplans((Node *)quals))
+		return;
+	pull_varattnos((Node *)quals, input_rel->relid, &referenced);
+	for (k = bms_next_member(referenced, -1);
+		 k >= 0;
+		 k = bms_next_member(referenced, k))
+	{
+		ref_list = lappend_int(ref_list, k + FirstLowInvalidHeapAttributeNumber);
+	}
+
+	/*
+	 * Cost estimation; if no qualifiers, only metadata of RecordBatches are
+	 * referenced. Elsewhere, RecordBatches partially matched to qualifiers
+	 * must be scanned, so we assume the worst case.
+	 */
+	af_rinfo = GetArrowFdwRelInfo(root, input_rel);
+	if (quals == NIL)
+		startup_cost = (cpu_operator_cost * list_length(aggrefs) *
+						(double) af_rinfo->nrbatches_scan);
+	else
+		startup_cost = (input_rel->cheapest_total_path->total_cost +
+						cpu_operator_cost * list_length(aggrefs) *
+						input_rel->rows);
+	startup_cost += target->cost.startup;
+	total_cost = startup_cost + target->cost.per_tuple + cpu_tuple_cost;
+
+#if PG_VERSION_NUM < 110000
+	fpath = create_foreignscan_path(root, output_rel,
+									target,
+									1.0,
+									startup_cost,
+									total_cost,
+									NIL,	/* no pathkeys */
+									NULL,	/* no required_outer */
+									NULL,	/* no extra plan */
+									list_make3(ref_list, aggrefs, quals));
+#else
+	fpath = create_foreign_upper_path(root, output_rel,
+									  target,
+									  1.0,
+									  startup_cost,
+									  total_cost,
+									  NIL,	/* no pathkeys */
+									  NULL,	/* no extra plan */
+									  list_make3(ref_list, aggrefs, quals));
+#endif
+	add_path(output_rel, (Path *)fpath);
+}
+
+/*
+ * ArrowGetForeignPlan
+ */
+static ForeignScan *
+ArrowGetForeignPlan(PlannerInfo *root,
+					RelOptInfo *baserel,
+					Oid foreigntableid,
+					ForeignPath *best_path,
+					List *tlist,
+					List *scan_clauses,
+					Plan *outer_plan)
+{
+	Bitmapset  *referenced = NULL;
+	List	   *ref_list = NIL;
+	ListCell   *lc;
+	bool		ordered;
+	int			i, j, k;
+
+	/* aggregation by the metadata */
+	if (baserel->reloptkind == RELOPT_UPPER_REL)
+	{
+		List	   *aggrefs = lsecond(best_path->fdw_private);
+		List	   *quals = lthird(best_path->fdw_private);
+		List	   *fdw_scan_tlist = NIL;
+		AttrNumber	resno = 1;
+
+		ref_list = linitial(best_path->fdw_private);
+		foreach (lc, aggrefs)
+		{
+			fdw_scan_tlist = lappend(fdw_scan_tlist,
+									 makeTargetEntry(lfirst(lc),
+													 resno++,
+													 NULL,
+													 false));
+		}
+		/* qualifiers are kept as a junk entry, to be fixed up by setrefs */
+		if (quals != NIL)
+			fdw_scan_tlist = lappend(fdw_scan_tlist,
+									 makeTargetEntry(make_ands_explicit(quals),
+													 resno++,
+													 NULL,
+													 true));
+		return make_foreignscan(tlist,
+								NIL,	/* no scan qualifiers */
+								0,		/* no scanrelid */
+								NIL,	/* no expressions to evaluate */
+								list_make2(ref_list, /* referenced attnums */
+										   makeInteger(false)),
+								fdw_scan_tlist,
+								NIL,	/* no remote quals */
+								outer_plan);
+	}
+	Assert(IS_SIMPLE_REL(baserel));
+	/* pick up referenced attributes */
+	foreach (lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo   *rinfo = lfirst(lc);
+
+		pull_varattnos((Node *)rinfo->clause, baserel->relid, &referenced);
 	}
 	for (i=baserel->min_attr, j=0; i <= baserel->max_attr; i++, j++)
 	{
@@ -667,12 +1680,15 @@ ArrowGetForeignPlan(PlannerInfo *root,
 		ref_list = lappend_int(ref_list, j);
 	}
 	bms_free(referenced);
+	/* ordered scan, if pathkeys are required */
+	ordered = (best_path->path.pathkeys != NIL);
 
 	return make_foreignscan(tlist,
 							extract_actual_clauses(scan_clauses, false),
 							baserel->relid,
 							NIL,	/* no expressions to evaluate */
-							ref_list, /* list of referenced attnums */
+							list_make2(ref_list, /* referenced attnums */
+									   makeInteger(ordered)),
 							NIL,	/* no custom tlist */
 							NIL,	/* no remote quals */
 							outer_plan);
@@ -684,6 +1700,11 @@ typedef struct
 	ArrowBuffer    *buffer_tail;
 	ArrowFieldNode *fnode_curr;
 	ArrowFieldNode *fnode_tail;
+	ArrowFileInfo  *af_info;	/* to lookup DictionaryBatches */
+	off_t			rb_offset;	/* offset of the RecordBatch message */
+	off_t			body_offset;/* offset of the message body */
+	ArrowBodyCompression *compression;	/* NULL, if not compressed */
+	File			fdesc;		/* to fetch length of compressed buffers */
 } setupRecordBatchContext;
 
 static void
@@ -740,6 +1761,191 @@ assignArrowTypeOptions(ArrowTypeOptions *attopts, const ArrowType *atype)
 	}
 }
 
+/*
+ * setupRecordBatchBuffer
+ *
+ * Buffers of the compressed RecordBatch begin with 64bit length of the
+ * decompressed image (-1, if it is stored as is), so we fetch it here
+ * to determine the buffer size to be expanded on the KDS.
+ */
+static void
+setupRecordBatchBuffer(setupRecordBatchContext *con,
+					   ArrowBuffer *buffer,
+					   off_t *p_offset,
+					   size_t *p_length,
+					   size_t *p_zlength)
+{
+	int64		rawlen;
+
+	*p_offset = buffer->offset;
+	if (!con->compression)
+	{
+		*p_length = buffer->length;
+		return;
+	}
+	if (buffer->length == 0)
+	{
+		*p_length = 0;
+		*p_zlength = 0;
+		return;
+	}
+	if (buffer->length < sizeof(int64))
+		elog(ERROR, "compressed buffer is shorter than its length prefix");
+	__arrowFdwReadChunk(con->fdesc, con->body_offset + buffer->offset,
+						sizeof(int64), &rawlen);
+	if (rawlen == -1)
+		rawlen = buffer->length - sizeof(int64);
+	else if (rawlen < 0)
+		elog(ERROR, "compressed buffer has corrupted length prefix");
+	*p_length  = MAXALIGN(rawlen);
+	*p_zlength = (rawlen > 0 ? buffer->length : 0);
+}
+
+static void
+setupRecordBatchField(setupRecordBatchContext *con,
+					  RecordBatchFieldState *fstate,
+					  ArrowField  *field,
+					  int depth);
+
+/*
+ * setupRecordBatchDictionary
+ *
+ * A dictionary-encoded field has nullmap and index values in the RecordBatch.
+ * The dictionary itself is described by the child fields; each of them is
+ * a chunk of the dictionary in a DictionaryBatch (the base one, then the delta
+ * ones), and its buffer offsets are absolute positions in the file.
+ */
+static void
+setupRecordBatchDictionary(setupRecordBatchContext *con,
+						   RecordBatchFieldState *fstate,
+						   ArrowField *field,
+						   int depth)
+{
+	ArrowDictionaryEncoding *dict = field->dictionary;
+	ArrowFooter	   *footer = &con->af_info->footer;
+	ArrowField		vfield;
+	ArrowBuffer	   *buffer_curr;
+	int			   *chunks;
+	int				i, nchunks = 0;
+
+	if (field->type.node.tag != ArrowNodeTag__Utf8 &&
+		field->type.node.tag != ArrowNodeTag__Binary)
+		elog(ERROR, "dictionary of Arrow.%s is not supported",
+			 arrowTypeName(field));
+	if (depth > 0)
+		elog(ERROR, "dictionary-encoded sub-field is not supported");
+	if (dict->indexType.bitWidth != 8 &&
+		dict->indexType.bitWidth != 16 &&
+		dict->indexType.bitWidth != 32 &&
+		dict->indexType.bitWidth != 64)
+		elog(ERROR, "Not a supported dictionary index width: %d",
+			 dict->indexType.bitWidth);
+
+	/* nullmap and index values */
+	if (con->buffer_curr + 2 > con->buffer_tail)
+		elog(ERROR, "RecordBatch has less buffers than expected");
+	buffer_curr = con->buffer_curr++;
+	if (fstate->null_count > 0)
+	{
+		setupRecordBatchBuffer(con, buffer_curr,
+							   &fstate->nullmap_offset,
+							   &fstate->nullmap_length,
+							   &fstate->nullmap_zlength);
+		if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+			elog(ERROR, "nullmap length is smaller than expected");
+		if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
+			(fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+			elog(ERROR, "nullmap is not aligned well");
+	}
+	buffer_curr = con->buffer_curr++;
+	setupRecordBatchBuffer(con, buffer_curr,
+						   &fstate->values_offset,
+						   &fstate->values_length,
+						   &fstate->values_zlength);
+	if (fstate->values_length < (dict->indexType.bitWidth /
+								 BITS_PER_BYTE) * fstate->nitems)
+		elog(ERROR, "index array is smaller than expected");
+	fstate->values_unitsz = dict->indexType.bitWidth / BITS_PER_BYTE;
+	if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
+		(fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+		elog(ERROR, "index array is not aligned well");
+
+	/*
+	 * DictionaryBatches visible to this RecordBatch; the latest base one
+	 * prior to the RecordBatch, and the delta ones following the base.
+	 * If no DictionaryBatches are written prior to the RecordBatch, we
+	 * apply all of them.
+	 */
+	chunks = alloca(sizeof(int) * (footer->_num_dictionaries + 1));
+	for (i=0; i < footer->_num_dictionaries; i++)
+	{
+		ArrowBlock *block = &footer->dictionaries[i];
+		ArrowDictionaryBatch *dbatch
+			= &con->af_info->dictionaries[i].body.dictionaryBatch;
+
+		if (dbatch->id != dict->id || block->offset > con->rb_offset)
+			continue;
+		if (!dbatch->isDelta)
+			nchunks = 0;
+		chunks[nchunks++] = i;
+	}
+	if (nchunks == 0)
+	{
+		for (i=0; i < footer->_num_dictionaries; i++)
+		{
+			ArrowDictionaryBatch *dbatch
+				= &con->af_info->dictionaries[i].body.dictionaryBatch;
+
+			if (dbatch->id != dict->id)
+				continue;
+			if (!dbatch->isDelta)
+				nchunks = 0;
+			chunks[nchunks++] = i;
+		}
+	}
+	if (nchunks == 0)
+		elog(ERROR, "DictionaryBatch (id=%ld) was not found",
+			 (long)dict->id);
+
+	memcpy(&vfield, field, sizeof(ArrowField));
+	vfield.dictionary = NULL;
+	fstate->children = palloc0(sizeof(RecordBatchFieldState) * nchunks);
+	for (i=0; i < nchunks; i++)
+	{
+		RecordBatchFieldState *chunk = &fstate->children[i];
+		ArrowBlock	   *block = &footer->dictionaries[chunks[i]];
+		ArrowRecordBatch *rbatch
+			= &con->af_info->dictionaries[chunks[i]].body.dictionaryBatch.data;
+		setupRecordBatchContext dcon;
+		off_t			body_offset = block->offset + block->metaDataLength;
+
+		memset(&dcon, 0, sizeof(setupRecordBatchContext));
+		dcon.buffer_curr = rbatch->buffers;
+		dcon.buffer_tail = rbatch->buffers + rbatch->_num_buffers;
+		dcon.fnode_curr  = rbatch->nodes;
+		dcon.fnode_tail  = rbatch->nodes + rbatch->_num_nodes;
+		dcon.af_info     = con->af_info;
+		dcon.rb_offset   = block->offset;
+		dcon.body_offset = body_offset;
+		dcon.compression = rbatch->compression;
+		dcon.fdesc       = con->fdesc;
+		setupRecordBatchField(&dcon, chunk, &vfield, depth+1);
+		if (dcon.buffer_curr != dcon.buffer_tail ||
+			dcon.fnode_curr  != dcon.fnode_tail)
+			elog(ERROR, "arrow_fdw: DictionaryBatch may have corruption.");
+		if (chunk->nullmap_length > 0)
+			chunk->nullmap_offset += body_offset;
+		chunk->values_offset += body_offset;
+		chunk->extra_offset  += body_offset;
+	}
+	fstate->num_children = nchunks;
+
+	assignArrowTypeOptions(&fstate->attopts, &field->type);
+	fstate->attopts.dictionary.index_width = (dict->indexType.bitWidth /
+											  BITS_PER_BYTE);
+	fstate->attopts.dictionary.is_signed = dict->indexType.is_signed;
+}
+
 static void
 setupRecordBatchField(setupRecordBatchContext *con,
 					  RecordBatchFieldState *fstate,
@@ -755,6 +1961,17 @@ setupRecordBatchField(setupRecordBatchContext *con,
 	fstate->atttypid   = arrowTypeToPGTypeOid(field, &fstate->atttypmod);
 	fstate->nitems     = fnode->length;
 	fstate->null_count = fnode->null_count;
+	if (con->compression)
+	{
+		fstate->compressed = true;
+		fstate->codec = con->compression->codec;
+	}
+
+	if (field->dictionary)
+	{
+		setupRecordBatchDictionary(con, fstate, field, depth);
+		return;
+	}
 
 	switch (field->type.node.tag)
 	{
@@ -773,8 +1990,10 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			buffer_curr = con->buffer_curr++;
 			if (fstate->null_count > 0)
 			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
+				setupRecordBatchBuffer(con, buffer_curr,
+									   &fstate->nullmap_offset,
+									   &fstate->nullmap_length,
+									   &fstate->nullmap_zlength);
 				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
@@ -782,10 +2001,16 @@ setupRecordBatchField(setupRecordBatchContext *con,
 					elog(ERROR, "nullmap is not aligned well");
 			}
 			buffer_curr = con->buffer_curr++;
-			fstate->values_offset = buffer_curr->offset;
-			fstate->values_length = buffer_curr->length;
+			setupRecordBatchBuffer(con, buffer_curr,
+								   &fstate->values_offset,
+								   &fstate->values_length,
+								   &fstate->values_zlength);
 			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
 				elog(ERROR, "values array is smaller than expected");
+			if (field->type.node.tag == ArrowNodeTag__Bool)
+				fstate->values_unitsz = ARROW_VALUES__BITMAP;
+			else
+				fstate->values_unitsz = arrowFieldLength(field, 1);
 			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
 				(fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0)
 				elog(ERROR, "values array is not aligned well");
@@ -802,8 +2027,10 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			buffer_curr = con->buffer_curr++;
 			if (fstate->null_count > 0)
 			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
+				setupRecordBatchBuffer(con, buffer_curr,
+									   &fstate->nullmap_offset,
+									   &fstate->nullmap_length,
+									   &fstate->nullmap_zlength);
 				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
@@ -812,10 +2039,13 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			}
 			/* offset values */
 			buffer_curr = con->buffer_curr++;
-			fstate->values_offset = buffer_curr->offset;
-			fstate->values_length = buffer_curr->length;
+			setupRecordBatchBuffer(con, buffer_curr,
+								   &fstate->values_offset,
+								   &fstate->values_length,
+								   &fstate->values_zlength);
 			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
 				elog(ERROR, "offset array is smaller than expected");
+			fstate->values_unitsz = ARROW_VALUES__OFFSET;
 			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
 				(fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0)
 				elog(ERROR, "offset array is not aligned well");
@@ -836,8 +2066,10 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			buffer_curr = con->buffer_curr++;
 			if (fstate->null_count > 0)
 			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
+				setupRecordBatchBuffer(con, buffer_curr,
+									   &fstate->nullmap_offset,
+									   &fstate->nullmap_length,
+									   &fstate->nullmap_zlength);
 				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
@@ -846,17 +2078,22 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			}
 
 			buffer_curr = con->buffer_curr++;
-			fstate->values_offset = buffer_curr->offset;
-			fstate->values_length = buffer_curr->length;
+			setupRecordBatchBuffer(con, buffer_curr,
+								   &fstate->values_offset,
+								   &fstate->values_length,
+								   &fstate->values_zlength);
 			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
 				elog(ERROR, "offset array is smaller than expected");
+			fstate->values_unitsz = ARROW_VALUES__OFFSET;
 			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
 				(fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0)
 				elog(ERROR, "offset array is not aligned well");
 
 			buffer_curr = con->buffer_curr++;
-			fstate->extra_offset = buffer_curr->offset;
-			fstate->extra_length = buffer_curr->length;
+			setupRecordBatchBuffer(con, buffer_curr,
+								   &fstate->extra_offset,
+								   &fstate->extra_length,
+								   &fstate->extra_zlength);
 			if ((fstate->extra_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
 				(fstate->extra_length & (MAXIMUM_ALIGNOF - 1)) != 0)
 				elog(ERROR, "extra buffer is not aligned well");
@@ -871,8 +2108,10 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			buffer_curr = con->buffer_curr++;
 			if (fstate->null_count > 0)
 			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
+				setupRecordBatchBuffer(con, buffer_curr,
+									   &fstate->nullmap_offset,
+									   &fstate->nullmap_length,
+									   &fstate->nullmap_zlength);
 				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
@@ -904,10 +2143,11 @@ setupRecordBatchField(setupRecordBatchContext *con,
 }
 
 static RecordBatchState *
-makeRecordBatchState(ArrowSchema *schema,
-					 ArrowBlock *block,
-					 ArrowRecordBatch *rbatch)
+makeRecordBatchState(ArrowFileInfo *af_info, int rb_index, File fdesc)
 {
+	ArrowSchema	   *schema = &af_info->footer.schema;
+	ArrowBlock	   *block = &af_info->footer.recordBatches[rb_index];
+	ArrowRecordBatch *rbatch = &af_info->recordBatches[rb_index].body.recordBatch;
 	setupRecordBatchContext con;
 	RecordBatchState *result;
 	int			j, ncols = schema->_num_fields;
@@ -923,6 +2163,11 @@ makeRecordBatchState(ArrowSchema *schema,
 	con.buffer_tail = rbatch->buffers + rbatch->_num_buffers;
 	con.fnode_curr  = rbatch->nodes;
 	con.fnode_tail  = rbatch->nodes + rbatch->_num_nodes;
+	con.af_info     = af_info;
+	con.rb_offset   = block->offset;
+	con.body_offset = result->rb_offset;
+	con.compression = rbatch->compression;
+	con.fdesc       = fdesc;
 
 	for (j=0; j < ncols; j++)
 	{
@@ -939,441 +2184,4241 @@ makeRecordBatchState(ArrowSchema *schema,
 }
 
 /*
- * ExecInitArrowFdw
+ * makeRecordBatchStateParquet
+ *
+ * It builds RecordBatchState of a row group in the Parquet file. All the
+ * buffers are decoded from the column chunk by CPU on the load, so we need
+ * the null_count and the length of variable-length values beforehand.
+ * If the metadata does not tell them, the column chunk is decoded once here;
+ * so, the caller must not hold the lock on the metadata cache.
  */
-ArrowFdwState *
-ExecInitArrowFdw(Relation relation, Bitmapset *outer_refs)
+static RecordBatchState *
+makeRecordBatchStateParquet(ArrowSchema *schema, ParquetFileInfo *pq_info,
+							int rg_index, File fdesc)
 {
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
-	List		   *filesList = NIL;
-	List		   *fdescList = NIL;
-	Bitmapset	   *referenced = NULL;
-	bool			whole_row_ref = false;
-	ArrowFdwState  *af_state;
-	List		   *rb_state_list = NIL;
-	ListCell	   *lc;
-	bool			writable;
-	int				i, num_rbatches;
+	RecordBatchState *result;
+	ParquetColumnChunk *chunks;
+	int64		nitems = pq_info->row_group_nrows[rg_index];
+	off_t		head = LONG_MAX;
+	off_t		tail = 0;
+	int			j, ncols = schema->_num_fields;
 
-	Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE &&
-		   memcmp(GetFdwRoutineForRelation(relation, false),
-				  &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) == 0);
-	/* expand 'referenced' if it has whole-row reference */
-	if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, outer_refs))
-		whole_row_ref = true;
-	for (i=0; i < tupdesc->natts; i++)
+	chunks = &pq_info->chunks[rg_index * pq_info->num_columns];
+	for (j=0; j < ncols; j++)
 	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
-		int		k = attr->attnum - FirstLowInvalidHeapAttributeNumber;
-
-		if (attr->attisdropped)
-			continue;
-		if (whole_row_ref || bms_is_member(k, outer_refs))
-			referenced = bms_add_member(referenced, k);
+		head = Min(head, chunks[j].chunk_offset);
+		tail = Max(tail, chunks[j].chunk_offset + chunks[j].chunk_length);
 	}
+	result = palloc0(offsetof(RecordBatchState, columns[ncols]));
+	result->ncols = ncols;
+	result->rb_offset = (ncols > 0 ? head : 0);
+	result->rb_length = (ncols > 0 ? tail - head : 0);
+	result->rb_nitems = nitems;
 
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	foreach (lc, filesList)
+	for (j=0; j < ncols; j++)
 	{
-		char	   *fname = strVal(lfirst(lc));
-		File		fdesc;
-		List	   *rb_cached = NIL;
-		ListCell   *cell;
-
-		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
-		if (fdesc < 0)
+		RecordBatchFieldState *fstate = &result->columns[j];
+		ArrowField	   *field = &schema->fields[j];
+		ParquetColumnChunk *chunk = &chunks[j];
+		int64			null_count = chunk->null_count;
+		int64			extra_sz = 0;
+
+		fstate->atttypid = arrowTypeToPGTypeOid(field, &fstate->atttypmod);
+		assignArrowTypeOptions(&fstate->attopts, &field->type);
+		fstate->nitems = nitems;
+		if (chunk->desc.unitsz == PARQUET_UNITSZ__VARLENA)
 		{
-			if (writable && errno == ENOENT)
-				continue;
-			elog(ERROR, "failed to open '%s' on behalf of '%s'",
-				 fname, RelationGetRelationName(relation));
+			if (chunk->desc.physical_type == ParquetType__FIXED_LEN_BYTE_ARRAY)
+				extra_sz = (null_count < 0 ? -1 : chunk->desc.type_length *
+							(nitems - null_count));
+			else
+				extra_sz = chunk->unencoded_bytes;
 		}
-		fdescList = lappend_int(fdescList, fdesc);
-
-		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
-		/* check schema compatibility */
-		foreach (cell, rb_cached)
+		if (null_count < 0 || extra_sz < 0)
 		{
-			RecordBatchState   *rb_state = lfirst(cell);
-
-			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
-				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
-					 fname, RelationGetRelationName(relation));
+			ParquetDecodedChunk	pq;
+
+			parquetDecodeColumnChunk(fdesc, &chunk->desc,
+									 chunk->chunk_offset,
+									 chunk->chunk_length,
+									 nitems, &pq);
+			null_count = pq.null_count;
+			extra_sz = pq.extra_length;
+			if (pq.nullmap)
+				pfree(pq.nullmap);
+			if (pq.extra)
+				pfree(pq.extra);
+			pfree(pq.values);
+		}
+		fstate->null_count = null_count;
+		if (null_count > 0)
+			fstate->nullmap_length = MAXALIGN(BITMAPLEN(nitems));
+		fstate->values_length = MAXALIGN(arrowFieldLength(field, nitems));
+		if (chunk->desc.unitsz == PARQUET_UNITSZ__BITMAP)
+			fstate->values_unitsz = ARROW_VALUES__BITMAP;
+		else if (chunk->desc.unitsz == PARQUET_UNITSZ__VARLENA)
+		{
+			fstate->values_unitsz = ARROW_VALUES__OFFSET;
+			fstate->extra_length = MAXALIGN(extra_sz);
+		}
+		else
+			fstate->values_unitsz = chunk->desc.unitsz;
+		/* the column chunk on the file */
+		fstate->nullmap_offset = chunk->chunk_offset - result->rb_offset;
+		fstate->values_offset  = chunk->chunk_offset - result->rb_offset;
+		fstate->extra_offset   = chunk->chunk_offset - result->rb_offset;
+		fstate->compressed     = true;
+		fstate->values_zlength = chunk->chunk_length;
+		memcpy(&fstate->parquet, &chunk->desc, sizeof(ParquetColumnDesc));
+		/* min/max statistics of the column chunk, if any */
+		if (chunk->stat_valid)
+		{
+			fstate->stat_known = true;
+			fstate->stat_valid = true;
+			fstate->stat_min = chunk->stat_min;
+			fstate->stat_max = chunk->stat_max;
+		}
+		else if (null_count == nitems)
+		{
+			fstate->stat_known = true;
+			fstate->stat_valid = false;
 		}
-		rb_state_list = list_concat(rb_state_list, rb_cached);
 	}
-	num_rbatches = list_length(rb_state_list);
-	af_state = palloc0(offsetof(ArrowFdwState, rbatches[num_rbatches]));
-	af_state->fdescList = fdescList;
-	af_state->referenced = referenced;
-	af_state->rbatch_index = &af_state->__rbatch_index_local;
-	i = 0;
-	foreach (lc, rb_state_list)
-		af_state->rbatches[i++] = (RecordBatchState *)lfirst(lc);
-	af_state->num_rbatches = num_rbatches;
-
-	return af_state;
+	return result;
 }
 
 /*
- * ArrowBeginForeignScan
+ * Routines to split a large RecordBatch into row windows
+ *
+ * A row window [row_start, row_start + nitems) is described by a copy of
+ * RecordBatchState whose buffer offsets/lengths point the portion of the
+ * column buffers, so the usual load routines read only the byte ranges
+ * needed. row_start is aligned to ARROW_WINDOW_ALIGN_NROWS; then, nullmap
+ * and bitmap of the window also begin at MAXALIGN'ed position.
+ * Offset array of the variable-length values still points the position in
+ * the original extra buffer, so the extra buffer is loaded from
+ * @extra_shift, then the offset array is rebased on the load.
  */
-static void
-ArrowBeginForeignScan(ForeignScanState *node, int eflags)
+#define ARROW_WINDOW_ALIGN_NROWS	(BITS_PER_BYTE * MAXIMUM_ALIGNOF)
+
+static bool
+setupRecordBatchFieldWindow(RecordBatchState *rb_state,
+							RecordBatchFieldState *fstate,
+							int64 row_start, int64 nitems,
+							bool *p_rebase)
 {
-	Relation		relation = node->ss.ss_currentRelation;
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ForeignScan	   *fscan = (ForeignScan *) node->ss.ps.plan;
-	ListCell	   *lc;
-	Bitmapset	   *referenced = NULL;
+	int		j;
 
-	foreach (lc, fscan->fdw_private)
+	Assert(row_start % ARROW_WINDOW_ALIGN_NROWS == 0);
+	if (fstate->part_key)
 	{
-		int		j = lfirst_int(lc);
+		/* virtual column has no buffers */
+		fstate->nitems = nitems;
+		if (fstate->null_count > 0)
+			fstate->null_count = nitems;
+		return true;
+	}
+	if (fstate->compressed || fstate->nitems != rb_state->rb_nitems)
+		return false;
+	if (fstate->null_count > 0)
+	{
+		fstate->nullmap_offset += row_start / BITS_PER_BYTE;
+		fstate->nullmap_length = MAXALIGN(BITMAPLEN(nitems));
+	}
+	switch (fstate->values_unitsz)
+	{
+		case ARROW_VALUES__NONE:
+			break;
+		case ARROW_VALUES__BITMAP:
+			fstate->values_offset += row_start / BITS_PER_BYTE;
+			fstate->values_length = MAXALIGN(BITMAPLEN(nitems));
+			break;
+		case ARROW_VALUES__OFFSET:
+			{
+				cl_uint		head, tail;
+				size_t		shift;
 
-		if (j >= 0 && j <= tupdesc->natts)
-			referenced = bms_add_member(referenced, j -
-										FirstLowInvalidHeapAttributeNumber);
+				/* elements of the List are not aligned to the window */
+				if (fstate->num_children > 0)
+					return false;
+				__arrowFdwReadChunk(rb_state->fdesc,
+									rb_state->rb_offset +
+									fstate->values_offset +
+									sizeof(cl_uint) * row_start,
+									sizeof(cl_uint), &head);
+				__arrowFdwReadChunk(rb_state->fdesc,
+									rb_state->rb_offset +
+									fstate->values_offset +
+									sizeof(cl_uint) * (row_start + nitems),
+									sizeof(cl_uint), &tail);
+				if (head > tail || tail > fstate->extra_length)
+					elog(ERROR, "corrupted arrow file? offset points out of extra buffer");
+				fstate->values_offset += sizeof(cl_uint) * row_start;
+				fstate->values_length = MAXALIGN(sizeof(cl_uint) * (nitems + 1));
+				shift = TYPEALIGN_DOWN(MAXIMUM_ALIGNOF, head);
+				fstate->extra_offset += shift;
+				fstate->extra_length = MAXALIGN(tail - shift);
+				fstate->extra_shift = shift;
+				if (shift > 0)
+					*p_rebase = true;
+			}
+			break;
+		default:
+			Assert(fstate->values_unitsz > 0);
+			fstate->values_offset += fstate->values_unitsz * row_start;
+			fstate->values_length = MAXALIGN(fstate->values_unitsz * nitems);
+			break;
 	}
-	node->fdw_state = ExecInitArrowFdw(relation, referenced);
-}
+	fstate->nitems = nitems;
 
-typedef struct
-{
-	off_t		rb_offset;
-	off_t		f_offset;
-	off_t		m_offset;
-	cl_int		io_index;
-	cl_int      depth;
-	strom_io_chunk ioc[FLEXIBLE_ARRAY_MEMBER];
-} arrowFdwSetupIOContext;
+	/* sub-fields of Struct have same row window */
+	if (fstate->values_unitsz == ARROW_VALUES__NONE &&
+		fstate->num_children > 0)
+	{
+		RecordBatchFieldState *children
+			= palloc(sizeof(RecordBatchFieldState) * fstate->num_children);
+
+		memcpy(children, fstate->children,
+			   sizeof(RecordBatchFieldState) * fstate->num_children);
+		for (j=0; j < fstate->num_children; j++)
+		{
+			if (!setupRecordBatchFieldWindow(rb_state, &children[j],
+											 row_start, nitems, p_rebase))
+				return false;
+		}
+		fstate->children = children;
+	}
+	return true;
+}
 
 /*
- * arrowFdwSetupIOvectorField
+ * arrowFdwSplitRecordBatches
+ *
+ * It splits RecordBatches larger than arrow_fdw.split_unit_size (by the
+ * length of the referenced columns) into row windows; each of them is
+ * claimed by the workers of parallel scan as if it were a RecordBatch.
  */
-static inline void
-__setupIOvectorField(arrowFdwSetupIOContext *con,
-					 off_t chunk_offset,
-					 size_t chunk_length,
-					 cl_uint *p_cmeta_offset,
+static List *
+arrowFdwSplitRecordBatches(List *rb_state_list, Bitmapset *referenced)
+{
+	size_t		unit_sz = (size_t)arrow_fdw_split_unit_size_kb << 10;
+	List	   *results = NIL;
+	ListCell   *lc;
+
+	foreach (lc, rb_state_list)
+	{
+		RecordBatchState *rb_state = lfirst(lc);
+		List	   *windows = NIL;
+		size_t		length = 0;
+		int64		unit_nitems;
+		int64		row_start;
+		int			j, k;
+
+		for (k = bms_next_member(referenced, -1);
+			 k >= 0;
+			 k = bms_next_member(referenced, k))
+		{
+			j = k + FirstLowInvalidHeapAttributeNumber - 1;
+			if (j < 0 || j >= rb_state->ncols)
+				continue;
+			length += RecordBatchFieldLength(&rb_state->columns[j]);
+		}
+		if (length <= unit_sz)
+			goto not_split;
+		unit_nitems = (int64)((double)rb_state->rb_nitems *
+							  ((double)unit_sz / (double)length));
+		unit_nitems = TYPEALIGN(ARROW_WINDOW_ALIGN_NROWS,
+								Max(unit_nitems, 1));
+		if (unit_nitems >= rb_state->rb_nitems)
+			goto not_split;
+
+		for (row_start = 0;
+			 row_start < rb_state->rb_nitems;
+			 row_start += unit_nitems)
+		{
+			RecordBatchState *window;
+			size_t		sz = offsetof(RecordBatchState,
+									  columns[rb_state->ncols]);
+
+			window = palloc(sz);
+			memcpy(window, rb_state, sz);
+			window->rb_window = true;
+			window->rb_row_start = row_start;
+			window->rb_nitems = Min(unit_nitems,
+									rb_state->rb_nitems - row_start);
+			for (k = bms_next_member(referenced, -1);
+				 k >= 0;
+				 k = bms_next_member(referenced, k))
+			{
+				j = k + FirstLowInvalidHeapAttributeNumber - 1;
+				if (j < 0 || j >= rb_state->ncols)
+					continue;
+				if (!setupRecordBatchFieldWindow(rb_state,
+												 &window->columns[j],
+												 row_start,
+												 window->rb_nitems,
+												 &window->rb_rebase))
+				{
+					list_free_deep(windows);
+					goto not_split;
+				}
+			}
+			windows = lappend(windows, window);
+		}
+		results = list_concat(results, windows);
+		continue;
+
+	not_split:
+		results = lappend(results, rb_state);
+	}
+	return results;
+}
+
+/*
+ * Routines to skip RecordBatches by min/max statistics
+ */
+static bool
+__arrowStatsTypeIsSupported(Oid type_oid)
+{
+	switch (type_oid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case DATEOID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+/*
+ * __arrowStatsHintVarIndex - returns column index if @expr is a simple Var
+ * reference to the scanned relation; elsewhere -1.
+ */
+static int
+__arrowStatsHintVarIndex(TupleDesc tupdesc, Node *expr, bool need_stats)
+{
+	Var		   *var = (Var *) expr;
+	Form_pg_attribute attr;
+
+	if (!IsA(expr, Var) ||
+		IS_SPECIAL_VARNO(var->varno) ||
+		var->varlevelsup > 0 ||
+		var->varattno <= 0 ||
+		var->varattno > tupdesc->natts)
+		return -1;
+	attr = tupleDescAttr(tupdesc, var->varattno - 1);
+	if (attr->attisdropped || attr->atttypid != var->vartype)
+		return -1;
+	if (need_stats && !__arrowStatsTypeIsSupported(attr->atttypid))
+		return -1;
+	return var->varattno - 1;
+}
+
+static arrowStatsHint *
+__buildArrowStatsHintOpExpr(TupleDesc tupdesc, OpExpr *op, PlanState *ps)
+{
+	arrowStatsHint *hint;
+	Oid			opcode = op->opno;
+	Node	   *var_expr;
+	Node	   *arg_expr;
+	Oid			var_type;
+	Oid			arg_type;
+	Oid			min_opcode = InvalidOid;
+	Oid			max_opcode = InvalidOid;
+	List	   *interpretations;
+	ListCell   *lc;
+	int			attidx;
+
+	if (list_length(op->args) != 2)
+		return NULL;
+	var_expr = linitial(op->args);
+	arg_expr = lsecond(op->args);
+	attidx = __arrowStatsHintVarIndex(tupdesc, var_expr, true);
+	if (attidx < 0)
+	{
+		/* try 'ARG op VAR' form */
+		attidx = __arrowStatsHintVarIndex(tupdesc, arg_expr, true);
+		if (attidx < 0)
+			return NULL;
+		opcode = get_commutator(opcode);
+		if (!OidIsValid(opcode))
+			return NULL;
+		var_expr = lsecond(op->args);
+		arg_expr = linitial(op->args);
+	}
+	if (contain_var_clause(arg_expr) ||
+		contain_volatile_functions(arg_expr))
+		return NULL;
+	var_type = exprType(var_expr);
+	arg_type = exprType(arg_expr);
+
+	interpretations = get_op_btree_interpretation(opcode);
+	foreach (lc, interpretations)
+	{
+		OpBtreeInterpretation *bti = lfirst(lc);
+
+		if (bti->oplefttype != var_type ||
+			bti->oprighttype != arg_type)
+			continue;
+		switch (bti->strategy)
+		{
+			case BTLessStrategyNumber:
+			case BTLessEqualStrategyNumber:
+				min_opcode = opcode;
+				break;
+			case BTGreaterStrategyNumber:
+			case BTGreaterEqualStrategyNumber:
+				max_opcode = opcode;
+				break;
+			case BTEqualStrategyNumber:
+				min_opcode = get_opfamily_member(bti->opfamily_id,
+												 var_type, arg_type,
+												 BTLessEqualStrategyNumber);
+				max_opcode = get_opfamily_member(bti->opfamily_id,
+												 var_type, arg_type,
+												 BTGreaterEqualStrategyNumber);
+				if (!OidIsValid(min_opcode) || !OidIsValid(max_opcode))
+				{
+					min_opcode = max_opcode = InvalidOid;
+					continue;
+				}
+				break;
+			default:
+				continue;
+		}
+		break;
+	}
+	if (!OidIsValid(min_opcode) && !OidIsValid(max_opcode))
+		return NULL;
+
+	hint = palloc0(sizeof(arrowStatsHint));
+	hint->kind = ARROW_STATS_HINT__OPERATOR;
+	hint->attidx = attidx;
+	hint->is_strict = op_strict(opcode);
+	hint->collid = op->inputcollid;
+	if (OidIsValid(min_opcode))
+		fmgr_info(get_opcode(min_opcode), &hint->min_fn);
+	if (OidIsValid(max_opcode))
+		fmgr_info(get_opcode(max_opcode), &hint->max_fn);
+	hint->arg = ExecInitExpr((Expr *)arg_expr, ps);
+
+	return hint;
+}
+
+static List *
+__buildArrowStatsHint(TupleDesc tupdesc, List *quals, PlanState *ps)
+{
+	List	   *results = NIL;
+	ListCell   *lc;
+
+	foreach (lc, quals)
+	{
+		Node	   *expr = lfirst(lc);
+		arrowStatsHint *hint = NULL;
+
+		if (IsA(expr, BoolExpr) &&
+			((BoolExpr *)expr)->boolop == AND_EXPR)
+		{
+			results = list_concat(results,
+								  __buildArrowStatsHint(tupdesc,
+														((BoolExpr *)expr)->args,
+														ps));
+		}
+		else if (IsA(expr, OpExpr))
+		{
+			hint = __buildArrowStatsHintOpExpr(tupdesc, (OpExpr *)expr, ps);
+		}
+		else if (IsA(expr, NullTest))
+		{
+			NullTest   *nt = (NullTest *) expr;
+			int			attidx;
+
+			attidx = __arrowStatsHintVarIndex(tupdesc,
+											  (Node *)nt->arg, false);
+			if (attidx >= 0 && !nt->argisrow)
+			{
+				hint = palloc0(sizeof(arrowStatsHint));
+				hint->kind = (nt->nulltesttype == IS_NULL
+							  ? ARROW_STATS_HINT__IS_NULL
+							  : ARROW_STATS_HINT__IS_NOT_NULL);
+				hint->attidx = attidx;
+			}
+		}
+		if (hint)
+			results = lappend(results, hint);
+	}
+	return results;
+}
+
+/*
+ * __arrowStatDatumToPG - transforms min/max statistics to PG's datum
+ */
+static bool
+__arrowStatDatumToPG(RecordBatchFieldState *fstate,
+					 SQLstat__datum *stat, Datum *p_datum)
+{
+	switch (fstate->atttypid)
+	{
+		case INT2OID:
+			*p_datum = Int16GetDatum((int16) stat->i64);
+			break;
+		case INT4OID:
+			*p_datum = Int32GetDatum((int32) stat->i64);
+			break;
+		case INT8OID:
+			*p_datum = Int64GetDatum(stat->i64);
+			break;
+		case FLOAT4OID:
+			*p_datum = Float4GetDatum((float4) stat->f64);
+			break;
+		case FLOAT8OID:
+			*p_datum = Float8GetDatum(stat->f64);
+			break;
+		case DATEOID:
+			/* unsigned division is not monotonic for negative values */
+			if (fstate->attopts.date.unit == ArrowDateUnit__MilliSecond &&
+				stat->i64 < 0)
+				return false;
+			*p_datum = DateADTGetDatum(__arrow_date_to_pg(stat->i64,
+											fstate->attopts.date.unit));
+			break;
+		case TIMEOID:
+			if (fstate->attopts.time.unit == ArrowTimeUnit__NanoSecond &&
+				stat->i64 < 0)
+				return false;
+			*p_datum = TimeADTGetDatum(__arrow_time_to_pg(stat->i64,
+											fstate->attopts.time.unit));
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			if (fstate->attopts.timestamp.unit == ArrowTimeUnit__NanoSecond &&
+				stat->i64 < 0)
+				return false;
+			*p_datum = TimestampGetDatum(__arrow_timestamp_to_pg(stat->i64,
+											fstate->attopts.timestamp.unit));
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+/*
+ * arrowStatsHintCheckRecordBatch
+ *
+ * It returns true, if the RecordBatch never contains any rows that satisfy
+ * the stats_hint, thus we can skip it.
+ */
+static bool
+__arrowStatsHintCheckRecordBatch(List *stats_hint,
+								 RecordBatchState *rb_state)
+{
+	ListCell   *lc;
+
+	foreach (lc, stats_hint)
+	{
+		arrowStatsHint *hint = lfirst(lc);
+		RecordBatchFieldState *fstate;
+		Datum		datum;
+
+		if (hint->attidx >= rb_state->ncols)
+			continue;
+		fstate = &rb_state->columns[hint->attidx];
+		switch (hint->kind)
+		{
+			case ARROW_STATS_HINT__IS_NULL:
+				if (fstate->null_count == 0)
+					return true;
+				break;
+			case ARROW_STATS_HINT__IS_NOT_NULL:
+				if (fstate->null_count >= fstate->nitems)
+					return true;
+				break;
+			case ARROW_STATS_HINT__OPERATOR:
+				if (hint->is_strict &&
+					fstate->null_count >= fstate->nitems)
+					return true;
+				if (!fstate->stat_valid || hint->arg_isnull)
+					break;
+				if (OidIsValid(hint->min_fn.fn_oid) &&
+					__arrowStatDatumToPG(fstate, &fstate->stat_min, &datum) &&
+					!DatumGetBool(FunctionCall2Coll(&hint->min_fn,
+													hint->collid,
+													datum,
+													hint->arg_value)))
+					return true;
+				if (OidIsValid(hint->max_fn.fn_oid) &&
+					__arrowStatDatumToPG(fstate, &fstate->stat_max, &datum) &&
+					!DatumGetBool(FunctionCall2Coll(&hint->max_fn,
+													hint->collid,
+													datum,
+													hint->arg_value)))
+					return true;
+				break;
+			default:
+				elog(ERROR, "Bug? unknown ArrowStatsHint kind: %d",
+					 hint->kind);
+		}
+	}
+	return false;
+}
+
+static bool
+arrowStatsHintCheckRecordBatch(ArrowFdwState *af_state,
+							   RecordBatchState *rb_state)
+{
+	ListCell   *lc;
+
+	if (af_state->stats_hint == NIL)
+		return false;
+
+	/* evaluate the arguments of the hints once per scan */
+	if (!af_state->stats_hint_ready)
+	{
+		ExprContext	   *econtext = af_state->econtext;
+		MemoryContext	oldcxt;
+
+		oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
+		foreach (lc, af_state->stats_hint)
+		{
+			arrowStatsHint *hint = lfirst(lc);
+
+			if (hint->arg)
+				hint->arg_value = ExecEvalExpr(hint->arg, econtext,
+											   &hint->arg_isnull);
+		}
+		MemoryContextSwitchTo(oldcxt);
+		af_state->stats_hint_ready = true;
+	}
+
+	return __arrowStatsHintCheckRecordBatch(af_state->stats_hint, rb_state);
+}
+
+/*
+ * Routines for vectorized evaluation of qualifiers
+ */
+static int
+__arrowVecQualTypeGroup(Oid type_oid)
+{
+	switch (type_oid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			return 1;
+		case FLOAT4OID:
+		case FLOAT8OID:
+			return 2;
+		case DATEOID:
+			return 3;
+		case TIMEOID:
+			return 4;
+		case TIMESTAMPOID:
+			return 5;
+		case TIMESTAMPTZOID:
+			return 6;
+		default:
+			break;
+	}
+	return 0;	/* not supported */
+}
+#define __arrowVecQualIsFloat(type_oid)		\
+	(__arrowVecQualTypeGroup(type_oid) == 2)
+
+static int
+__arrowVecQualVarIndex(TupleDesc tupdesc, Bitmapset *referenced, Node *expr)
+{
+	int		attidx = __arrowStatsHintVarIndex(tupdesc, expr, false);
+
+	/* only columns already loaded are available */
+	if (attidx < 0 ||
+		!bms_is_member(attidx + 1 - FirstLowInvalidHeapAttributeNumber,
+					   referenced))
+		return -1;
+	return attidx;
+}
+
+/*
+ * __buildArrowVecQualDictionary
+ *
+ * Operators on text/bytea columns are applied on the dictionary entries
+ * once, then rows are filtered by the index values, if the column is
+ * dictionary-encoded. Any strict and non-volatile boolean operators are
+ * available, like equality, IN-list or LIKE.
+ */
+static arrowVecQual *
+__buildArrowVecQualDictionary(int attidx, Oid opcode, Oid var_type,
+							  Oid arg_type, Node *arg_expr,
+							  bool is_any, Oid collid, PlanState *ps)
+{
+	arrowVecQual *vq;
+	Oid			opfuncid = get_opcode(opcode);
+	Oid			ltype;
+	Oid			rtype;
+
+	if (!OidIsValid(opfuncid) ||
+		!op_strict(opcode) ||
+		get_func_rettype(opfuncid) != BOOLOID ||
+		func_volatile(opfuncid) == PROVOLATILE_VOLATILE)
+		return NULL;
+	op_input_types(opcode, &ltype, &rtype);
+	if (ltype != var_type)
+		return NULL;
+
+	vq = palloc0(sizeof(arrowVecQual));
+	vq->kind = ARROW_VEC_QUAL__DICT;
+	vq->attidx = attidx;
+	vq->arg_type = arg_type;
+	vq->arg = ExecInitExpr((Expr *)arg_expr, ps);
+	vq->is_any = is_any;
+	vq->collid = collid;
+	fmgr_info(opfuncid, &vq->fn_dict);
+
+	return vq;
+}
+
+static arrowVecQual *
+__buildArrowVecQualOperator(TupleDesc tupdesc, Bitmapset *referenced,
+							Oid opcode, Node *var_expr, Node *arg_expr,
+							bool is_any, Oid collid, PlanState *ps)
+{
+	arrowVecQual *vq;
+	TypeCacheEntry *tcache;
+	List	   *interpretations;
+	ListCell   *lc;
+	Oid			var_type;
+	Oid			arg_type;
+	int			strategy = 0;
+	int			attidx;
+
+	attidx = __arrowVecQualVarIndex(tupdesc, referenced, var_expr);
+	if (attidx < 0)
+		return NULL;
+	if (contain_var_clause(arg_expr) ||
+		contain_volatile_functions(arg_expr))
+		return NULL;
+	var_type = exprType(var_expr);
+	arg_type = exprType(arg_expr);
+	if (is_any)
+	{
+		arg_type = get_element_type(arg_type);
+		if (!OidIsValid(arg_type))
+			return NULL;
+	}
+	if (var_type == TEXTOID || var_type == BYTEAOID)
+		return __buildArrowVecQualDictionary(attidx, opcode, var_type,
+											 arg_type, arg_expr,
+											 is_any, collid, ps);
+	if (__arrowVecQualTypeGroup(var_type) == 0 ||
+		__arrowVecQualTypeGroup(var_type) != __arrowVecQualTypeGroup(arg_type))
+		return NULL;
+	if (!op_strict(opcode))
+		return NULL;
+
+	/*
+	 * Only operators in the default btree operator family of the column
+	 * type are supported; their semantics are the natural order of values.
+	 */
+	tcache = lookup_type_cache(var_type, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(tcache->btree_opf))
+		return NULL;
+	interpretations = get_op_btree_interpretation(opcode);
+	foreach (lc, interpretations)
+	{
+		OpBtreeInterpretation *bti = lfirst(lc);
+
+		if (bti->opfamily_id == tcache->btree_opf &&
+			bti->oplefttype == var_type &&
+			bti->oprighttype == arg_type)
+		{
+			strategy = bti->strategy;
+			break;
+		}
+	}
+	if (strategy == 0)
+		return NULL;
+
+	vq = palloc0(sizeof(arrowVecQual));
+	vq->kind = (is_any ? ARROW_VEC_QUAL__ANY : ARROW_VEC_QUAL__COMPARE);
+	vq->attidx = attidx;
+	vq->strategy = strategy;
+	vq->arg_type = arg_type;
+	vq->arg = ExecInitExpr((Expr *)arg_expr, ps);
+
+	return vq;
+}
+
+static arrowVecQual *
+__buildArrowVecQual(TupleDesc tupdesc, Bitmapset *referenced,
+					Node *expr, PlanState *ps)
+{
+	arrowVecQual *vq = NULL;
+
+	if (IsA(expr, BoolExpr))
+	{
+		BoolExpr   *b = (BoolExpr *) expr;
+		List	   *subquals = NIL;
+		ListCell   *lc;
+		int			attidx;
+
+		switch (b->boolop)
+		{
+			case AND_EXPR:
+			case OR_EXPR:
+				foreach (lc, b->args)
+				{
+					arrowVecQual *sub = __buildArrowVecQual(tupdesc,
+															referenced,
+															lfirst(lc), ps);
+					/*
+					 * unsupported sub-qualifiers are ignored in AND,
+					 * but it makes the entire OR unavailable.
+					 */
+					if (sub)
+						subquals = lappend(subquals, sub);
+					else if (b->boolop == OR_EXPR)
+						return NULL;
+				}
+				if (subquals == NIL)
+					return NULL;
+				if (list_length(subquals) == 1)
+					return linitial(subquals);
+				vq = palloc0(sizeof(arrowVecQual));
+				vq->kind = (b->boolop == AND_EXPR
+							? ARROW_VEC_QUAL__AND
+							: ARROW_VEC_QUAL__OR);
+				vq->attidx = -1;
+				vq->subquals = subquals;
+				break;
+			case NOT_EXPR:
+				attidx = __arrowVecQualVarIndex(tupdesc, referenced,
+												linitial(b->args));
+				if (attidx >= 0 &&
+					exprType(linitial(b->args)) == BOOLOID)
+				{
+					vq = palloc0(sizeof(arrowVecQual));
+					vq->kind = ARROW_VEC_QUAL__BOOL;
+					vq->attidx = attidx;
+					vq->bool_value = false;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	else if (IsA(expr, OpExpr))
+	{
+		OpExpr	   *op = (OpExpr *) expr;
+		Oid			opcode;
+
+		if (list_length(op->args) != 2)
+			return NULL;
+		vq = __buildArrowVecQualOperator(tupdesc, referenced,
+										 op->opno,
+										 linitial(op->args),
+										 lsecond(op->args),
+										 false, op->inputcollid, ps);
+		if (!vq)
+		{
+			/* try 'ARG op VAR' form */
+			opcode = get_commutator(op->opno);
+			if (OidIsValid(opcode))
+				vq = __buildArrowVecQualOperator(tupdesc, referenced,
+												 opcode,
+												 lsecond(op->args),
+												 linitial(op->args),
+												 false, op->inputcollid, ps);
+		}
+	}
+	else if (IsA(expr, ScalarArrayOpExpr))
+	{
+		ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *) expr;
+
+		if (saop->useOr && list_length(saop->args) == 2)
+			vq = __buildArrowVecQualOperator(tupdesc, referenced,
+											 saop->opno,
+											 linitial(saop->args),
+											 lsecond(saop->args),
+											 true, saop->inputcollid, ps);
+	}
+	else if (IsA(expr, NullTest))
+	{
+		NullTest   *nt = (NullTest *) expr;
+		int			attidx;
+
+		attidx = __arrowVecQualVarIndex(tupdesc, referenced,
+										(Node *)nt->arg);
+		if (attidx >= 0 && !nt->argisrow)
+		{
+			vq = palloc0(sizeof(arrowVecQual));
+			vq->kind = (nt->nulltesttype == IS_NULL
+						? ARROW_VEC_QUAL__IS_NULL
+						: ARROW_VEC_QUAL__IS_NOT_NULL);
+			vq->attidx = attidx;
+		}
+	}
+	else if (IsA(expr, Var) && exprType(expr) == BOOLOID)
+	{
+		int			attidx;
+
+		attidx = __arrowVecQualVarIndex(tupdesc, referenced, expr);
+		if (attidx >= 0)
+		{
+			vq = palloc0(sizeof(arrowVecQual));
+			vq->kind = ARROW_VEC_QUAL__BOOL;
+			vq->attidx = attidx;
+			vq->bool_value = true;
+		}
+	}
+	return vq;
+}
+
+static List *
+__buildArrowVecQuals(TupleDesc tupdesc, Bitmapset *referenced,
+					 List *quals, PlanState *ps)
+{
+	List	   *results = NIL;
+	ListCell   *lc;
+
+	foreach (lc, quals)
+	{
+		arrowVecQual *vq = __buildArrowVecQual(tupdesc, referenced,
+											   lfirst(lc), ps);
+		if (vq)
+			results = lappend(results, vq);
+	}
+	return results;
+}
+
+/*
+ * __arrowVecQualDatumToValue - transforms PG's datum to the column domain
+ */
+static SQLstat__datum
+__arrowVecQualDatumToValue(Datum datum, Oid type_oid)
+{
+	SQLstat__datum	value;
+
+	switch (type_oid)
+	{
+		case INT2OID:
+			value.i64 = DatumGetInt16(datum);
+			break;
+		case INT4OID:
+			value.i64 = DatumGetInt32(datum);
+			break;
+		case INT8OID:
+			value.i64 = DatumGetInt64(datum);
+			break;
+		case FLOAT4OID:
+			value.f64 = DatumGetFloat4(datum);
+			break;
+		case FLOAT8OID:
+			value.f64 = DatumGetFloat8(datum);
+			break;
+		case DATEOID:
+			value.i64 = DatumGetDateADT(datum);
+			break;
+		case TIMEOID:
+			value.i64 = DatumGetTimeADT(datum);
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			value.i64 = DatumGetTimestamp(datum);
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected type for vectorized qualifier: %s",
+				 format_type_be(type_oid));
+	}
+	return value;
+}
+
+/*
+ * arrowVecQualPrepare - evaluates the arguments once per scan
+ */
+static void
+arrowVecQualPrepare(arrowVecQual *vq, ExprContext *econtext)
+{
+	ListCell   *lc;
+	Datum		datum;
+	bool		isnull;
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+
+	foreach (lc, vq->subquals)
+		arrowVecQualPrepare(lfirst(lc), econtext);
+	if (!vq->arg)
+		return;
+
+	vq->nvalues = 0;
+	vq->dict_nitems = 0;	/* results on the dictionary are invalidated */
+	datum = ExecEvalExpr(vq->arg, econtext, &isnull);
+	if (isnull)
+		return;		/* strict operator never matches */
+	get_typlenbyvalalign(vq->arg_type, &typlen, &typbyval, &typalign);
+	if (vq->kind == ARROW_VEC_QUAL__DICT && !vq->is_any)
+	{
+		vq->dict_args = palloc(sizeof(Datum));
+		vq->dict_args[vq->nvalues++] = datumCopy(datum, typbyval, typlen);
+	}
+	else if (vq->kind == ARROW_VEC_QUAL__COMPARE)
+	{
+		vq->values = palloc(sizeof(SQLstat__datum));
+		vq->values[vq->nvalues++] = __arrowVecQualDatumToValue(datum,
+															   vq->arg_type);
+	}
+	else
+	{
+		ArrayType  *array = DatumGetArrayTypeP(datum);
+		Datum	   *elem_values;
+		bool	   *elem_nulls;
+		int			i, nelems;
+
+		deconstruct_array(array, vq->arg_type,
+						  typlen, typbyval, typalign,
+						  &elem_values, &elem_nulls, &nelems);
+		if (vq->kind == ARROW_VEC_QUAL__DICT)
+			vq->dict_args = palloc(sizeof(Datum) * Max(nelems, 1));
+		else
+			vq->values = palloc(sizeof(SQLstat__datum) * Max(nelems, 1));
+		for (i=0; i < nelems; i++)
+		{
+			/* NULL element never makes the result true */
+			if (elem_nulls[i])
+				continue;
+			if (vq->kind == ARROW_VEC_QUAL__DICT)
+				vq->dict_args[vq->nvalues++] =
+					datumCopy(elem_values[i], typbyval, typlen);
+			else
+				vq->values[vq->nvalues++] =
+					__arrowVecQualDatumToValue(elem_values[i], vq->arg_type);
+		}
+	}
+}
+
+/*
+ * __arrowVecQualFetchColumn - fetch values of the column in the domain of
+ * the comparison, consistently with the datum references.
+ */
+#define __VEC_FETCH_COLUMN(TYPE,FIELD,EXPR)					\
+	do {													\
+		TYPE   *__base = (TYPE *)base;						\
+															\
+		for (i=0; i < kds->nitems; i++)						\
+		{													\
+			TYPE	v = __base[i];							\
+			vbuf[i].FIELD = (EXPR);							\
+		}													\
+	} while(0)
+
+static bool
+__arrowVecQualFetchColumn(kern_data_store *kds, int attidx,
+						  SQLstat__datum *vbuf)
+{
+	kern_colmeta   *cmeta = &kds->colmeta[attidx];
+	char		   *base;
+	size_t			i;
+
+	if (cmeta->values_offset == 0)
+		return false;
+	base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	switch (cmeta->atttypid)
+	{
+		case INT2OID:
+			__VEC_FETCH_COLUMN(cl_short, i64, v);
+			break;
+		case INT4OID:
+			__VEC_FETCH_COLUMN(cl_int, i64, v);
+			break;
+		case INT8OID:
+			__VEC_FETCH_COLUMN(cl_long, i64, v);
+			break;
+		case FLOAT4OID:
+			__VEC_FETCH_COLUMN(cl_float, f64, v);
+			break;
+		case FLOAT8OID:
+			__VEC_FETCH_COLUMN(cl_double, f64, v);
+			break;
+		case DATEOID:
+			if (cmeta->attopts.date.unit == ArrowDateUnit__Day)
+				__VEC_FETCH_COLUMN(cl_int, i64,
+					__arrow_date_to_pg(v, ArrowDateUnit__Day));
+			else
+				__VEC_FETCH_COLUMN(cl_long, i64,
+					__arrow_date_to_pg(v, cmeta->attopts.date.unit));
+			break;
+		case TIMEOID:
+			if (cmeta->attopts.time.unit == ArrowTimeUnit__Second ||
+				cmeta->attopts.time.unit == ArrowTimeUnit__MilliSecond)
+				__VEC_FETCH_COLUMN(cl_int, i64,
+					__arrow_time_to_pg(v, cmeta->attopts.time.unit));
+			else
+				__VEC_FETCH_COLUMN(cl_long, i64,
+					__arrow_time_to_pg(v, cmeta->attopts.time.unit));
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			__VEC_FETCH_COLUMN(cl_long, i64,
+				__arrow_timestamp_to_pg(v, cmeta->attopts.timestamp.unit));
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+#undef __VEC_FETCH_COLUMN
+
+/*
+ * __arrowVecFloatCmp - comparison of float values, compatible to
+ * float8_cmp_internal; NaN is equal to NaN, and larger than others.
+ */
+static inline int
+__arrowVecFloatCmp(double a, double b)
+{
+	if (isnan(a))
+		return (isnan(b) ? 0 : 1);
+	if (isnan(b))
+		return -1;
+	return (a > b ? 1 : (a < b ? -1 : 0));
+}
+
+#define __VEC_COMPARE_LOOP(EXPR)				\
+	do {										\
+		for (i=0; i < nitems; i++)				\
+			out[i] = (EXPR);					\
+	} while(0)
+
+static void
+__arrowVecQualCompare(SQLstat__datum *vbuf, size_t nitems,
+					  bool is_float, int strategy,
+					  SQLstat__datum cval, cl_char *out)
+{
+	size_t		i;
+
+	if (!is_float)
+	{
+		cl_long		c = cval.i64;
+
+		switch (strategy)
+		{
+			case BTLessStrategyNumber:
+				__VEC_COMPARE_LOOP(vbuf[i].i64 <  c);
+				break;
+			case BTLessEqualStrategyNumber:
+				__VEC_COMPARE_LOOP(vbuf[i].i64 <= c);
+				break;
+			case BTEqualStrategyNumber:
+				__VEC_COMPARE_LOOP(vbuf[i].i64 == c);
+				break;
+			case BTGreaterEqualStrategyNumber:
+				__VEC_COMPARE_LOOP(vbuf[i].i64 >= c);
+				break;
+			case BTGreaterStrategyNumber:
+				__VEC_COMPARE_LOOP(vbuf[i].i64 >  c);
+				break;
+			case ROWCOMPARE_NE:
+				__VEC_COMPARE_LOOP(vbuf[i].i64 != c);
+				break;
+			default:
+				elog(ERROR, "Bug? unexpected strategy: %d", strategy);
+		}
+	}
+	else
+	{
+		double		c = cval.f64;
+
+		switch (strategy)
+		{
+			case BTLessStrategyNumber:
+				__VEC_COMPARE_LOOP(__arrowVecFloatCmp(vbuf[i].f64, c) <  0);
+				break;
+			case BTLessEqualStrategyNumber:
+				__VEC_COMPARE_LOOP(__arrowVecFloatCmp(vbuf[i].f64, c) <= 0);
+				break;
+			case BTEqualStrategyNumber:
+				__VEC_COMPARE_LOOP(__arrowVecFloatCmp(vbuf[i].f64, c) == 0);
+				break;
+			case BTGreaterEqualStrategyNumber:
+				__VEC_COMPARE_LOOP(__arrowVecFloatCmp(vbuf[i].f64, c) >= 0);
+				break;
+			case BTGreaterStrategyNumber:
+				__VEC_COMPARE_LOOP(__arrowVecFloatCmp(vbuf[i].f64, c) >  0);
+				break;
+			case ROWCOMPARE_NE:
+				__VEC_COMPARE_LOOP(__arrowVecFloatCmp(vbuf[i].f64, c) != 0);
+				break;
+			default:
+				elog(ERROR, "Bug? unexpected strategy: %d", strategy);
+		}
+	}
+}
+#undef __VEC_COMPARE_LOOP
+
+/*
+ * __arrowVecQualEvalDictionary - applies the operator on the dictionary
+ * entries not evaluated yet, then filters rows by the index values.
+ * It returns false if the column is not dictionary-encoded.
+ */
+static bool
+__arrowVecQualEvalDictionary(arrowVecQual *vq, kern_data_store *kds,
+							 kern_colmeta *cmeta, uint8 *nullmap,
+							 cl_char *res)
+{
+	arrowDictBuffer *dict;
+	char	   *values;
+	char	   *addr;
+	cl_uint		len;
+	size_t		i, nitems = kds->nitems;
+	uint32		k;
+	int			m;
+
+	if (cmeta->attopts.dictionary.index_width == 0 ||
+		cmeta->values_offset == 0 ||
+		cmeta->extra_offset == 0)
+		return false;
+	values = (char *)kds + __kds_unpack(cmeta->values_offset);
+	dict = (arrowDictBuffer *)((char *)kds + __kds_unpack(cmeta->extra_offset));
+
+	/*
+	 * Results on the dictionary entries are kept across RecordBatches;
+	 * delta dictionaries only append entries to the base one.
+	 */
+	if (vq->dict_fdesc != dict->fdesc ||
+		vq->dict_base != dict->base_offset ||
+		vq->dict_nitems > dict->nitems)
+	{
+		vq->dict_fdesc = dict->fdesc;
+		vq->dict_base = dict->base_offset;
+		vq->dict_nitems = 0;
+	}
+	if (vq->dict_nrooms < dict->nitems)
+	{
+		cl_char	   *dict_res
+			= MemoryContextAllocHuge(GetMemoryChunkContext(vq),
+									 dict->nitems);
+		if (vq->dict_res)
+		{
+			memcpy(dict_res, vq->dict_res, vq->dict_nitems);
+			pfree(vq->dict_res);
+		}
+		vq->dict_res = dict_res;
+		vq->dict_nrooms = dict->nitems;
+	}
+	for (k = vq->dict_nitems; k < dict->nitems; k++)
+	{
+		bool		rv = false;
+
+		if (__arrowDictBufferRef(dict, k, &addr, &len))
+		{
+			struct varlena *vl = palloc(VARHDRSZ + len);
+
+			SET_VARSIZE(vl, VARHDRSZ + len);
+			memcpy(VARDATA(vl), addr, len);
+			for (m=0; !rv && m < vq->nvalues; m++)
+			{
+				Datum	datum = FunctionCall2Coll(&vq->fn_dict,
+												  vq->collid,
+												  PointerGetDatum(vl),
+												  vq->dict_args[m]);
+				rv = DatumGetBool(datum);
+			}
+			pfree(vl);
+		}
+		vq->dict_res[k] = rv;
+	}
+	vq->dict_nitems = dict->nitems;
+
+	for (i=0; i < nitems; i++)
+	{
+		cl_long		dindex;
+
+		/* index values of NULL rows are undefined */
+		if (!res[i] || (nullmap && att_isnull(i, nullmap)))
+			continue;
+		dindex = __arrowDictIndexRef(cmeta, values, i);
+		if (dindex < 0 || dindex >= dict->nitems)
+			elog(ERROR, "corrupted arrow file? dictionary index out of range");
+		res[i] &= vq->dict_res[dindex];
+	}
+	return true;
+}
+
+/*
+ * __arrowVecQualEval - res[i] &= (qualifier may be true on the i-th row)
+ */
+static void
+__arrowVecQualEval(arrowVecQual *vq, kern_data_store *kds, cl_char *res)
+{
+	size_t		nitems = kds->nitems;
+	kern_colmeta *cmeta = NULL;
+	uint8	   *nullmap = NULL;
+	cl_char	   *acc;
+	cl_char	   *out;
+	ListCell   *lc;
+	size_t		i;
+	int			k;
+
+	if (vq->attidx >= 0)
+	{
+		cmeta = &kds->colmeta[vq->attidx];
+		if (cmeta->nullmap_offset != 0)
+			nullmap = (uint8 *)kds + __kds_unpack(cmeta->nullmap_offset);
+	}
+
+	switch (vq->kind)
+	{
+		case ARROW_VEC_QUAL__AND:
+			foreach (lc, vq->subquals)
+				__arrowVecQualEval(lfirst(lc), kds, res);
+			return;
+
+		case ARROW_VEC_QUAL__OR:
+			acc = palloc0(nitems);
+			out = palloc(nitems);
+			foreach (lc, vq->subquals)
+			{
+				memset(out, 1, nitems);
+				__arrowVecQualEval(lfirst(lc), kds, out);
+				for (i=0; i < nitems; i++)
+					acc[i] |= out[i];
+			}
+			for (i=0; i < nitems; i++)
+				res[i] &= acc[i];
+			pfree(out);
+			pfree(acc);
+			return;
+
+		case ARROW_VEC_QUAL__IS_NULL:
+			if (!nullmap)
+				memset(res, 0, nitems);
+			else
+			{
+				for (i=0; i < nitems; i++)
+					res[i] &= att_isnull(i, nullmap);
+			}
+			return;
+
+		case ARROW_VEC_QUAL__IS_NOT_NULL:
+			if (nullmap)
+			{
+				for (i=0; i < nitems; i++)
+					res[i] &= !att_isnull(i, nullmap);
+			}
+			return;
+
+		case ARROW_VEC_QUAL__BOOL:
+			if (cmeta->values_offset == 0)
+				return;
+			for (i=0; i < nitems; i++)
+			{
+				bool	bval = DatumGetBool(pg_bool_arrow_ref(kds, cmeta, i));
+
+				res[i] &= (bval == vq->bool_value);
+			}
+			break;
+
+		case ARROW_VEC_QUAL__COMPARE:
+		case ARROW_VEC_QUAL__ANY:
+			if (vq->nvalues == 0)
+			{
+				/* NULL argument never makes the result true */
+				memset(res, 0, nitems);
+				return;
+			}
+			else
+			{
+				SQLstat__datum *vbuf = palloc(sizeof(SQLstat__datum) * nitems);
+				bool		is_float = __arrowVecQualIsFloat(cmeta->atttypid);
+
+				if (!__arrowVecQualFetchColumn(kds, vq->attidx, vbuf))
+				{
+					pfree(vbuf);
+					return;
+				}
+				out = palloc(nitems);
+				acc = palloc0(nitems);
+				for (k=0; k < vq->nvalues; k++)
+				{
+					__arrowVecQualCompare(vbuf, nitems, is_float,
+										  vq->strategy, vq->values[k], out);
+					for (i=0; i < nitems; i++)
+						acc[i] |= out[i];
+				}
+				for (i=0; i < nitems; i++)
+					res[i] &= acc[i];
+				pfree(acc);
+				pfree(out);
+				pfree(vbuf);
+			}
+			break;
+
+		case ARROW_VEC_QUAL__DICT:
+			if (vq->nvalues == 0)
+			{
+				/* NULL argument never makes the result true */
+				memset(res, 0, nitems);
+				return;
+			}
+			if (!__arrowVecQualEvalDictionary(vq, kds, cmeta, nullmap, res))
+				return;		/* not a dictionary-encoded column */
+			break;
+
+		default:
+			elog(ERROR, "Bug? unknown arrowVecQual kind: %d", vq->kind);
+	}
+	/* operators are strict, so NULL never makes the result true */
+	if (nullmap)
+	{
+		for (i=0; i < nitems; i++)
+			res[i] &= !att_isnull(i, nullmap);
+	}
+}
+
+/*
+ * arrowFdwSelectRows - makes selection vector of the rows that may satisfy
+ * the vectorized qualifiers.
+ */
+static void
+arrowFdwSelectRows(ArrowFdwState *af_state, pgstrom_data_store *pds)
+{
+	kern_data_store *kds = &pds->kds;
+	ExprContext *econtext = af_state->econtext;
+	MemoryContext oldcxt;
+	ListCell   *lc;
+	cl_char	   *res;
+	uint32		i, nselected = 0;
+
+	/* evaluate the arguments once per scan */
+	if (!af_state->vec_quals_ready)
+	{
+		oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
+		foreach (lc, af_state->vec_quals)
+			arrowVecQualPrepare(lfirst(lc), econtext);
+		MemoryContextSwitchTo(oldcxt);
+		af_state->vec_quals_ready = true;
+	}
+	/* expand the selection vector on demand */
+	if (af_state->sel_nrooms < kds->nitems)
+	{
+		if (af_state->sel_rows)
+			pfree(af_state->sel_rows);
+		af_state->sel_rows = MemoryContextAllocHuge(econtext->ecxt_per_query_memory,
+													sizeof(uint32) * kds->nitems);
+		af_state->sel_nrooms = kds->nitems;
+	}
+
+	oldcxt = MemoryContextSwitchTo(af_state->vec_memcxt);
+	res = palloc(kds->nitems);
+	memset(res, 1, kds->nitems);
+	foreach (lc, af_state->vec_quals)
+		__arrowVecQualEval(lfirst(lc), kds, res);
+	for (i=0; i < kds->nitems; i++)
+	{
+		af_state->sel_rows[nselected] = i;
+		nselected += res[i];
+	}
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextReset(af_state->vec_memcxt);
+
+	af_state->sel_pds = pds;
+	af_state->sel_nitems = nselected;
+	af_state->sel_pos = 0;
+}
+
+/*
+ * ArrowFdwNextSelectedRow
+ *
+ * It returns index of the next row (>= row_index) that may satisfy the scan
+ * qualifiers, or kds->nitems if no more rows. Caller must fetch rows in the
+ * ascending order, and start from row_index = 0 for each PDS.
+ */
+cl_long
+ArrowFdwNextSelectedRow(ArrowFdwState *af_state,
+						pgstrom_data_store *pds,
+						cl_long row_index)
+{
+	if (af_state->vec_quals == NIL ||
+		pds->iovec != NULL ||
+		row_index >= pds->kds.nitems)
+		return row_index;
+	if (row_index == 0 || af_state->sel_pds != pds)
+		arrowFdwSelectRows(af_state, pds);
+	while (af_state->sel_pos < af_state->sel_nitems &&
+		   af_state->sel_rows[af_state->sel_pos] < row_index)
+		af_state->sel_pos++;
+	if (af_state->sel_pos < af_state->sel_nitems)
+		return af_state->sel_rows[af_state->sel_pos];
+	return pds->kds.nitems;
+}
+
+#define __COMPUTE_FIELD_STAT(TYPE,FIELD,IS_FLOAT)				\
+	do {														\
+		TYPE   *values = (TYPE *)base;							\
+																\
+		for (i=0; i < kds->nitems; i++)							\
+		{														\
+			if (nullmap && att_isnull(i, nullmap))				\
+				continue;										\
+			if ((IS_FLOAT) && isnan((double)values[i]))			\
+			{													\
+				fstate->stat_valid = false;						\
+				return;											\
+			}													\
+			if (!fstate->stat_valid)							\
+			{													\
+				fstate->stat_min.FIELD = values[i];				\
+				fstate->stat_max.FIELD = values[i];				\
+				fstate->stat_valid = true;						\
+			}													\
+			else if (values[i] < fstate->stat_min.FIELD)		\
+				fstate->stat_min.FIELD = values[i];				\
+			else if (values[i] > fstate->stat_max.FIELD)		\
+				fstate->stat_max.FIELD = values[i];				\
+		}														\
+	} while(0)
+
+/*
+ * arrowFdwComputeFieldStat
+ *
+ * It computes min/max statistics of the column on the RecordBatch already
+ * loaded onto the host memory, if the arrow file does not have them.
+ */
+static void
+__arrowFdwComputeFieldStat(kern_data_store *kds, int attidx,
+						   RecordBatchFieldState *fstate)
+{
+	kern_colmeta   *cmeta = &kds->colmeta[attidx];
+	char		   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	uint8		   *nullmap = NULL;
+	size_t			i;
+
+	if (cmeta->nullmap_offset != 0)
+		nullmap = (uint8 *)kds + __kds_unpack(cmeta->nullmap_offset);
+	fstate->stat_known = true;
+	fstate->stat_valid = false;
+	switch (fstate->atttypid)
+	{
+		case INT2OID:
+			__COMPUTE_FIELD_STAT(cl_short, i64, false);
+			break;
+		case INT4OID:
+			__COMPUTE_FIELD_STAT(cl_int, i64, false);
+			break;
+		case INT8OID:
+			__COMPUTE_FIELD_STAT(cl_long, i64, false);
+			break;
+		case FLOAT4OID:
+			__COMPUTE_FIELD_STAT(cl_float, f64, true);
+			break;
+		case FLOAT8OID:
+			__COMPUTE_FIELD_STAT(cl_double, f64, true);
+			break;
+		case DATEOID:
+			if (fstate->attopts.date.unit == ArrowDateUnit__Day)
+				__COMPUTE_FIELD_STAT(cl_int, i64, false);
+			else
+				__COMPUTE_FIELD_STAT(cl_long, i64, false);
+			break;
+		case TIMEOID:
+			if (fstate->attopts.time.unit == ArrowTimeUnit__Second ||
+				fstate->attopts.time.unit == ArrowTimeUnit__MilliSecond)
+				__COMPUTE_FIELD_STAT(cl_int, i64, false);
+			else
+				__COMPUTE_FIELD_STAT(cl_long, i64, false);
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			__COMPUTE_FIELD_STAT(cl_long, i64, false);
+			break;
+		default:
+			break;
+	}
+}
+#undef __COMPUTE_FIELD_STAT
+
+static void
+arrowFdwComputeFieldStats(ArrowFdwState *af_state,
+						  RecordBatchState *rb_state,
+						  pgstrom_data_store *pds)
+{
+	kern_data_store *kds = &pds->kds;
+	int			attidx;
+
+	if (pds->iovec != NULL)
+		return;		/* not loaded onto the host memory */
+	if (rb_state->rb_window)
+		return;		/* only a part of the RecordBatch */
+	for (attidx = bms_next_member(af_state->stats_attidx, -1);
+		 attidx >= 0;
+		 attidx = bms_next_member(af_state->stats_attidx, attidx))
+	{
+		RecordBatchFieldState *fstate = &rb_state->columns[attidx];
+
+		if (fstate->stat_known ||
+			attidx >= kds->ncols ||
+			kds->colmeta[attidx].values_offset == 0)
+			continue;
+		__arrowFdwComputeFieldStat(kds, attidx, fstate);
+		/* save the statistics for further scans */
+		arrowUpdateMetadataCacheFieldStat(rb_state, attidx);
+	}
+}
+
+/*
+ * ExecInitArrowFdw
+ */
+ArrowFdwState *
+ExecInitArrowFdw(ScanState *ss, List *outer_quals, Bitmapset *outer_refs)
+{
+	Relation		relation = ss->ss_currentRelation;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
+	List		   *filesList = NIL;
+	List		   *fdescList = NIL;
+	Bitmapset	   *referenced = NULL;
+	bool			whole_row_ref = false;
+	ArrowFdwState  *af_state;
+	List		   *rb_state_list = NIL;
+	ListCell	   *lc;
+	const char	   *part_dir;
+	int				nfiles_pruned = 0;
+	bool			has_part_qual = false;
+	bool			writable;
+	int				i, num_rbatches;
+
+	Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE &&
+		   memcmp(GetFdwRoutineForRelation(relation, false),
+				  &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) == 0);
+	/* expand 'referenced' if it has whole-row reference */
+	if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, outer_refs))
+		whole_row_ref = true;
+	for (i=0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
+		int		k = attr->attnum - FirstLowInvalidHeapAttributeNumber;
+
+		if (attr->attisdropped)
+			continue;
+		if (whole_row_ref || bms_is_member(k, outer_refs))
+			referenced = bms_add_member(referenced, k);
+	}
+
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	part_dir = arrowFdwPartitionDir(ft->options);
+	foreach (lc, filesList)
+	{
+		char	   *fname = strVal(lfirst(lc));
+		File		fdesc;
+		List	   *rb_cached = NIL;
+		ListCell   *cell;
+		Const	  **part_consts = NULL;
+		List	   *part_quals = NIL;
+		ExprState  *part_qual = NULL;
+
+		/* prune the file by the partition keys */
+		if (part_dir)
+		{
+			bool	refuted;
+
+			part_consts = arrowFdwPartitionConsts(tupdesc, part_dir, fname);
+			part_quals = arrowFdwPartitionQuals(outer_quals, tupdesc,
+												part_consts, &refuted);
+			if (refuted)
+			{
+				nfiles_pruned++;
+				continue;
+			}
+			if (part_quals != NIL)
+			{
+				part_qual = ExecInitQual(part_quals, &ss->ps);
+				has_part_qual = true;
+			}
+		}
+		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
+		if (fdesc < 0)
+		{
+			if (writable && errno == ENOENT)
+				continue;
+			elog(ERROR, "failed to open '%s' on behalf of '%s'",
+				 fname, RelationGetRelationName(relation));
+		}
+		fdescList = lappend_int(fdescList, fdesc);
+
+		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
+		rb_cached = arrowFdwRemapPartitionColumns(rb_cached, tupdesc,
+												  part_consts);
+		/* check schema compatibility */
+		foreach (cell, rb_cached)
+		{
+			RecordBatchState   *rb_state = lfirst(cell);
+
+			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
+				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
+					 fname, RelationGetRelationName(relation));
+			rb_state->part_qual = part_qual;
+		}
+		rb_state_list = list_concat(rb_state_list, rb_cached);
+	}
+	/* split large RecordBatches into row windows on parallel scan */
+	if (ss->ps.plan->parallel_aware && arrow_fdw_split_unit_size_kb > 0)
+		rb_state_list = arrowFdwSplitRecordBatches(rb_state_list, referenced);
+	num_rbatches = list_length(rb_state_list);
+	af_state = palloc0(offsetof(ArrowFdwState, rbatches[num_rbatches]));
+	af_state->fdescList = fdescList;
+	af_state->referenced = referenced;
+	af_state->nfiles_pruned = nfiles_pruned;
+	af_state->has_part_qual = has_part_qual;
+	af_state->sstate = &af_state->__sstate_local;
+	pg_atomic_init_u32(&af_state->__sstate_local.rbatch_index, 0);
+	pg_atomic_init_u32(&af_state->__sstate_local.rbatch_nskips, 0);
+	pg_atomic_init_u64(&af_state->__sstate_local.rbatch_skip_sz, 0);
+	pg_atomic_init_u64(&af_state->__sstate_local.rbatch_stall_us, 0);
+	/* asynchronous read-ahead */
+	af_state->ra_depth = arrow_fdw_readahead_depth;
+	if (af_state->ra_depth > 0)
+		af_state->ra_queue = palloc(sizeof(uint32) * (af_state->ra_depth + 1));
+	/* RecordBatch skip by min/max statistics */
+	af_state->stats_hint = __buildArrowStatsHint(tupdesc, outer_quals,
+												 &ss->ps);
+	foreach (lc, af_state->stats_hint)
+	{
+		arrowStatsHint *hint = lfirst(lc);
+
+		if (hint->kind == ARROW_STATS_HINT__OPERATOR)
+			af_state->stats_attidx = bms_add_member(af_state->stats_attidx,
+													hint->attidx);
+	}
+	af_state->econtext = ss->ps.ps_ExprContext;
+	/* vectorized evaluation of qualifiers */
+	af_state->vec_quals = __buildArrowVecQuals(tupdesc, referenced,
+											   outer_quals, &ss->ps);
+	if (af_state->vec_quals != NIL)
+		af_state->vec_memcxt = AllocSetContextCreate(CurrentMemoryContext,
+													 "arrow_fdw vectorized quals",
+													 ALLOCSET_DEFAULT_SIZES);
+	/* column-at-a-time deform */
+	af_state->deform = arrowFdwCreateDeformState(referenced);
+	i = 0;
+	foreach (lc, rb_state_list)
+		af_state->rbatches[i++] = (RecordBatchState *)lfirst(lc);
+	af_state->num_rbatches = num_rbatches;
+
+	return af_state;
+}
+
+/*
+ * ArrowBeginForeignScan
+ */
+static void
+ArrowBeginForeignScan(ForeignScanState *node, int eflags)
+{
+	Relation		relation = node->ss.ss_currentRelation;
+	TupleDesc		tupdesc;
+	ForeignScan	   *fscan = (ForeignScan *) node->ss.ps.plan;
+	List		   *ref_list = linitial(fscan->fdw_private);
+	bool			ordered = intVal(lsecond(fscan->fdw_private));
+	List		   *quals = fscan->scan.plan.qual;
+	List		   *sort_keys = NIL;
+	ArrowFdwState  *af_state;
+	ListCell	   *lc;
+	Bitmapset	   *referenced = NULL;
+	Index			scanrelid = 0;
+
+	/*
+	 * Aggregation by the metadata has no scanrelid, so we open the foreign
+	 * table by itself. Its qualifiers are kept in the junk entry.
+	 */
+	if (fscan->scan.scanrelid == 0)
+	{
+		scanrelid = bms_singleton_member(fscan->fs_relids);
+		relation = ExecOpenScanRelation(node->ss.ps.state, scanrelid, eflags);
+		node->ss.ss_currentRelation = relation;
+		foreach (lc, fscan->fdw_scan_tlist)
+		{
+			TargetEntry *tle = lfirst(lc);
+
+			if (tle->resjunk)
+				quals = make_ands_implicit(tle->expr);
+		}
+	}
+	tupdesc = RelationGetDescr(relation);
+
+	foreach (lc, ref_list)
+	{
+		int		j = lfirst_int(lc);
+
+		if (j >= 0 && j <= tupdesc->natts)
+			referenced = bms_add_member(referenced, j -
+										FirstLowInvalidHeapAttributeNumber);
+	}
+	/* ordered scan needs all the sort keys to merge and verify the order */
+	if (ordered)
+	{
+		ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
+
+		sort_keys = arrowFdwSortKeys(ft->options, tupdesc);
+		if (sort_keys == NIL)
+			elog(ERROR, "arrow: foreign table '%s' has no 'sorted_by' option",
+				 RelationGetRelationName(relation));
+		foreach (lc, sort_keys)
+		{
+			arrowSortKey   *skey = lfirst(lc);
+
+			referenced = bms_add_member(referenced, skey->attnum -
+										FirstLowInvalidHeapAttributeNumber);
+		}
+	}
+	af_state = ExecInitArrowFdw(&node->ss, quals, referenced);
+	if (ordered)
+		af_state->merge = arrowFdwCreateSortedMerge(sort_keys, tupdesc);
+	if (scanrelid > 0)
+		af_state->metaagg = arrowFdwCreateMetaAgg(af_state,
+												  fscan->fdw_scan_tlist,
+												  scanrelid,
+												  tupdesc,
+												  &node->ss.ps);
+	node->fdw_state = af_state;
+}
+
+typedef struct
+{
+	off_t		rb_offset;
+	off_t		f_offset;
+	off_t		m_offset;
+	cl_int		io_index;
+	cl_int      depth;
+	strom_io_chunk ioc[FLEXIBLE_ARRAY_MEMBER];
+} arrowFdwSetupIOContext;
+
+/*
+ * arrowFdwSetupIOvectorField
+ */
+static inline void
+__setupIOvectorField(arrowFdwSetupIOContext *con,
+					 off_t chunk_offset,
+					 size_t chunk_length,
+					 size_t chunk_zlength,
+					 cl_uint *p_cmeta_offset,
 					 cl_uint *p_cmeta_length)
 {
-	off_t		f_pos = con->rb_offset + chunk_offset;
+	off_t		f_pos = con->rb_offset + chunk_offset;
+
+	if (chunk_zlength > 0)
+	{
+		/*
+		 * compressed buffer shall be expanded by CPU once the KDS is
+		 * allocated, so we just reserve the region; no I/O chunks.
+		 */
+		con->m_offset = MAXALIGN(con->m_offset);
+		*p_cmeta_offset = __kds_packed(con->m_offset);
+		*p_cmeta_length = __kds_packed(chunk_length);
+
+		con->m_offset += chunk_length;
+	}
+	else if (f_pos == con->f_offset &&
+		con->m_offset == MAXALIGN(con->m_offset))
+	{
+		/* good, buffer is continuous */
+		*p_cmeta_offset = __kds_packed(con->m_offset);
+		*p_cmeta_length = __kds_packed(chunk_length);
+
+		con->m_offset += chunk_length;
+		con->f_offset += chunk_length;
+	}
+	else
+	{
+		off_t		f_base = TYPEALIGN_DOWN(PAGE_SIZE, f_pos);
+		off_t		f_tail;
+		off_t		shift = f_pos - f_base;
+		strom_io_chunk *ioc;
+
+		if (con->io_index < 0)
+			con->io_index = 0;	/* no previous i/o chunks */
+		else
+		{
+			ioc = &con->ioc[con->io_index++];
+
+			f_tail = TYPEALIGN(PAGE_SIZE, con->f_offset);
+			ioc->nr_pages = f_tail / PAGE_SIZE - ioc->fchunk_id;
+			con->m_offset += (f_tail - con->f_offset); //safety margin;
+		}
+		ioc = &con->ioc[con->io_index];
+		/* adjust position if con->m_offset is not aligned well */
+		if (con->m_offset + shift != MAXALIGN(con->m_offset + shift))
+			con->m_offset = MAXALIGN(con->m_offset + shift) - shift;
+		ioc->m_offset   = con->m_offset;
+		ioc->fchunk_id  = f_base / PAGE_SIZE;
+
+		*p_cmeta_offset = __kds_packed(con->m_offset + shift);
+		*p_cmeta_length = __kds_packed(chunk_length);
+
+		con->m_offset  += shift + chunk_length;
+		con->f_offset   = f_pos + chunk_length;
+	}
+}
+
+static void
+arrowFdwSetupIOvectorField(arrowFdwSetupIOContext *con,
+						   RecordBatchFieldState *fstate,
+						   kern_data_store *kds,
+						   kern_colmeta *cmeta)
+{
+	//int		index = cmeta - kds->colmeta;
+
+	if (fstate->parquet.is_parquet)
+	{
+		/* all the buffers are decoded from the column chunk by CPU */
+		if (fstate->nullmap_length > 0)
+			__setupIOvectorField(con, 0,
+								 fstate->nullmap_length,
+								 fstate->nullmap_length,
+								 &cmeta->nullmap_offset,
+								 &cmeta->nullmap_length);
+		if (fstate->values_length > 0)
+			__setupIOvectorField(con, 0,
+								 fstate->values_length,
+								 fstate->values_length,
+								 &cmeta->values_offset,
+								 &cmeta->values_length);
+		if (fstate->extra_length > 0)
+			__setupIOvectorField(con, 0,
+								 fstate->extra_length,
+								 fstate->extra_length,
+								 &cmeta->extra_offset,
+								 &cmeta->extra_length);
+		return;
+	}
+
+	if (fstate->nullmap_length > 0)
+	{
+		Assert(fstate->null_count > 0);
+		__setupIOvectorField(con,
+							 fstate->nullmap_offset,
+							 fstate->nullmap_length,
+							 fstate->nullmap_zlength,
+							 &cmeta->nullmap_offset,
+							 &cmeta->nullmap_length);
+		//elog(INFO, "D%d att[%d] nullmap=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->nullmap_offset, fstate->nullmap_length, con->m_offset, con->f_offset);
+	}
+	if (fstate->values_length > 0)
+	{
+		__setupIOvectorField(con,
+							 fstate->values_offset,
+							 fstate->values_length,
+							 fstate->values_zlength,
+							 &cmeta->values_offset,
+							 &cmeta->values_length);
+		//elog(INFO, "D%d att[%d] values=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->values_offset, fstate->values_length, con->m_offset, con->f_offset);
+	}
+	if (fstate->extra_length > 0)
+	{
+		__setupIOvectorField(con,
+							 fstate->extra_offset,
+							 fstate->extra_length,
+							 fstate->extra_zlength,
+							 &cmeta->extra_offset,
+							 &cmeta->extra_length);
+		//elog(INFO, "D%d att[%d] extra=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->extra_offset, fstate->extra_length, con->m_offset, con->f_offset);
+	}
+
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
+		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		kern_colmeta *subattr;
+		int		j;
+
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		con->depth++;
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			RecordBatchFieldState *child = &fstate->children[j];
+
+			arrowFdwSetupIOvectorField(con, child, kds, subattr);
+		}
+		con->depth--;
+	}
+}
+
+/*
+ * arrowFdwSetupIOvector
+ */
+static strom_io_vector *
+arrowFdwSetupIOvector(kern_data_store *kds,
+					  RecordBatchState *rb_state,
+					  Bitmapset *referenced)
+{
+	arrowFdwSetupIOContext *con;
+	strom_io_vector *iovec = NULL;
+	int			j, nr_chunks = 0;
+
+	Assert(kds->nr_colmeta >= kds->ncols);
+	con = alloca(offsetof(arrowFdwSetupIOContext,
+						  ioc[3 * kds->nr_colmeta]));
+	con->rb_offset = rb_state->rb_offset;
+	con->f_offset  = ~0UL;	/* invalid offset */
+	con->m_offset  = TYPEALIGN(PAGE_SIZE, KERN_DATA_STORE_HEAD_LENGTH(kds));
+	con->io_index  = -1;
+	for (j=0; j < kds->ncols; j++)
+	{
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		kern_colmeta *cmeta = &kds->colmeta[j];
+		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (referenced && bms_is_member(attidx, referenced))
+			arrowFdwSetupIOvectorField(con, fstate, kds, cmeta);
+	}
+	if (con->io_index >= 0)
+	{
+		/* close the last I/O chunks */
+		strom_io_chunk *ioc = &con->ioc[con->io_index];
+
+		ioc->nr_pages = (TYPEALIGN(PAGE_SIZE, con->f_offset) / PAGE_SIZE -
+						 ioc->fchunk_id);
+		con->m_offset = ioc->m_offset + PAGE_SIZE * ioc->nr_pages;
+		nr_chunks = con->io_index + 1;
+	}
+	kds->length = con->m_offset;
+
+	iovec = palloc0(offsetof(strom_io_vector, ioc[nr_chunks]));
+	iovec->nr_chunks = nr_chunks;
+	if (nr_chunks > 0)
+		memcpy(iovec->ioc, con->ioc, sizeof(strom_io_chunk) * nr_chunks);
+	return iovec;
+}
+
+/*
+ * __dump_kds_and_iovec - just for debug
+ */
+static inline void
+__dump_kds_and_iovec(kern_data_store *kds, strom_io_vector *iovec)
+{
+#if 0
+	int		j;
+
+	elog(INFO, "nchunks = %d", iovec->nr_chunks);
+	for (j=0; j < iovec->nr_chunks; j++)
+	{
+		strom_io_chunk *ioc = &iovec->ioc[j];
+
+		elog(INFO, "io[%d] [ m_offset=%lu, f_read=%lu...%lu, nr_pages=%u}",
+			 j,
+			 ioc->m_offset,
+			 ioc->fchunk_id * PAGE_SIZE,
+			 (ioc->fchunk_id + ioc->nr_pages) * PAGE_SIZE,
+			 ioc->nr_pages);
+	}
+
+	elog(INFO, "kds {length=%zu nitems=%u typeid=%u typmod=%u table_oid=%u}",
+		 kds->length, kds->nitems,
+		 kds->tdtypeid, kds->tdtypmod, kds->table_oid);
+	for (j=0; j < kds->nr_colmeta; j++)
+	{
+		kern_colmeta *cmeta = &kds->colmeta[j];
+
+		elog(INFO, "%ccol[%d] nullmap=%lu,%lu values=%lu,%lu extra=%lu,%lu",
+			 j < kds->ncols ? ' ' : '*', j,
+			 __kds_unpack(cmeta->nullmap_offset),
+			 __kds_unpack(cmeta->nullmap_length),
+			 __kds_unpack(cmeta->values_offset),
+			 __kds_unpack(cmeta->values_length),
+			 __kds_unpack(cmeta->extra_offset),
+			 __kds_unpack(cmeta->extra_length));
+
+	}
+#endif
+}
+
+/*
+ * arrowFdwLookupMmapState
+ */
+static ArrowFdwMmapState *
+arrowFdwLookupMmapState(ArrowFdwState *af_state,
+						RecordBatchState *rb_state,
+						Relation relation,
+						MemoryContext mcontext)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	ArrowFdwMmapState *mmap_state;
+	MemoryContext oldcxt;
+	ListCell   *lc;
+	size_t		file_sz;
+	char	   *mmap_head;
+	int			i, nslots = 0;
+
+	foreach (lc, af_state->mmap_list)
+	{
+		mmap_state = lfirst(lc);
+		if (mmap_state->fdesc == rb_state->fdesc)
+			return (mmap_state->mmap_head ? mmap_state : NULL);
+	}
+	/* number of RecordBatches in this file */
+	for (i=0; i < af_state->num_rbatches; i++)
+	{
+		RecordBatchState *curr = af_state->rbatches[i];
+
+		if (curr->fdesc == rb_state->fdesc)
+			nslots = Max(nslots, curr->rb_index + 1);
+	}
+	Assert(nslots > 0);
+
+	oldcxt = MemoryContextSwitchTo(mcontext);
+	mmap_state = palloc0(sizeof(ArrowFdwMmapState));
+	mmap_state->fdesc = rb_state->fdesc;
+	mmap_state->refcnt = 1;
+	mmap_state->nslots = nslots;
+	mmap_state->slot_sz = STROMALIGN(offsetof(pgstrom_data_store, kds) +
+									 KDS_calculateHeadSize(tupdesc));
+	mmap_state->slab_sz = TYPEALIGN(PAGE_SIZE, mmap_state->slot_sz * nslots);
+	af_state->mmap_list = lappend(af_state->mmap_list, mmap_state);
+	MemoryContextSwitchTo(oldcxt);
+
+	/* offset from the KDS head must be representable */
+	file_sz = TYPEALIGN(PAGE_SIZE, rb_state->stat_buf.st_size);
+	if (mmap_state->slab_sz + file_sz > KDS_OFFSET_MAX_SIZE)
+		return NULL;
+	/* reserve the address space, then map the file image next to the slab */
+	mmap_head = __mmapFile(NULL, mmap_state->slab_sz + file_sz,
+						   PROT_READ | PROT_WRITE,
+						   MAP_PRIVATE | MAP_ANONYMOUS,
+						   -1, 0);
+	if (mmap_head == MAP_FAILED)
+	{
+		elog(DEBUG2, "failed on __mmapFile: %m");
+		return NULL;
+	}
+	if (mmap(mmap_head + mmap_state->slab_sz, file_sz,
+			 PROT_READ,
+			 MAP_SHARED | MAP_FIXED,
+			 FileGetRawDesc(rb_state->fdesc), 0) == MAP_FAILED)
+	{
+		elog(DEBUG2, "failed on mmap('%s'): %m",
+			 FilePathName(rb_state->fdesc));
+		if (__munmapFile(mmap_head) != 0)
+			elog(WARNING, "failed on __munmapFile: %m");
+		return NULL;
+	}
+	mmap_state->mmap_head = mmap_head;
+	mmap_state->mmap_sz = mmap_state->slab_sz + file_sz;
+
+	return mmap_state;
+}
+
+/*
+ * ReleaseArrowFdwMmapState
+ */
+void
+ReleaseArrowFdwMmapState(ArrowFdwMmapState *mmap_state)
+{
+	Assert(mmap_state->refcnt > 0);
+	if (--mmap_state->refcnt == 0 && mmap_state->mmap_head)
+	{
+		if (__munmapFile(mmap_state->mmap_head) != 0)
+			elog(WARNING, "failed on __munmapFile: %m");
+		mmap_state->mmap_head = NULL;
+	}
+}
+
+/*
+ * arrowFdwSetupMmapField
+ */
+static inline bool
+__setupMmapField(size_t base,
+				 off_t chunk_offset,
+				 size_t chunk_length,
+				 cl_uint *p_cmeta_offset,
+				 cl_uint *p_cmeta_length)
+{
+	size_t		offset = base + chunk_offset;
+
+	if (offset != MAXALIGN(offset))
+		return false;
+	*p_cmeta_offset = __kds_packed(offset);
+	*p_cmeta_length = __kds_packed(chunk_length);
+	return true;
+}
+
+static bool
+arrowFdwSetupMmapField(size_t base,
+					   RecordBatchFieldState *fstate,
+					   kern_data_store *kds,
+					   kern_colmeta *cmeta)
+{
+	if (fstate->nullmap_length > 0 &&
+		!__setupMmapField(base,
+						  fstate->nullmap_offset,
+						  fstate->nullmap_length,
+						  &cmeta->nullmap_offset,
+						  &cmeta->nullmap_length))
+		return false;
+	if (fstate->values_length > 0 &&
+		!__setupMmapField(base,
+						  fstate->values_offset,
+						  fstate->values_length,
+						  &cmeta->values_offset,
+						  &cmeta->values_length))
+		return false;
+	/* offset array of the row window points the original extra buffer */
+	if (fstate->extra_length > 0 &&
+		!__setupMmapField(base,
+						  fstate->extra_offset - fstate->extra_shift,
+						  fstate->extra_length + fstate->extra_shift,
+						  &cmeta->extra_offset,
+						  &cmeta->extra_length))
+		return false;
+
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
+		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		kern_colmeta *subattr;
+		int		j;
+
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			if (!arrowFdwSetupMmapField(base, &fstate->children[j],
+										kds, subattr))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * arrowFdwLoadRecordBatchMmap - setup PDS that refers the file image
+ * on the mapping directly, without any copy. It returns NULL if the
+ * RecordBatch cannot be referenced in this way.
+ */
+static pgstrom_data_store *
+arrowFdwLoadRecordBatchMmap(RecordBatchState *rb_state,
+							ArrowFdwMmapState *mmap_state,
+							kern_data_store *kds_head,
+							Bitmapset *referenced)
+{
+	pgstrom_data_store *pds;
+	kern_data_store *kds;
+	size_t		head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds_head);
+	size_t		base;
+	int			j;
+
+	Assert(mmap_state->mmap_head != NULL);
+	if (rb_state->rb_index >= mmap_state->nslots ||
+		offsetof(pgstrom_data_store, kds) + head_sz > mmap_state->slot_sz)
+		return NULL;
+	pds = (pgstrom_data_store *)(mmap_state->mmap_head +
+								 mmap_state->slot_sz * rb_state->rb_index);
+	if (pg_atomic_read_u32(&pds->refcnt) != 0)
+		return NULL;	/* slot is still in use */
+
+	kds = &pds->kds;
+	memcpy(kds, kds_head, head_sz);
+	base = ((mmap_state->mmap_head + mmap_state->slab_sz) - (char *)kds +
+			rb_state->rb_offset);
+	for (j=0; j < kds->ncols; j++)
+	{
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (!referenced || !bms_is_member(attidx, referenced))
+			continue;
+		if (!arrowFdwSetupMmapField(base, &rb_state->columns[j],
+									kds, &kds->colmeta[j]))
+			return NULL;	/* buffer is not aligned */
+	}
+	kds->length = (mmap_state->mmap_head + mmap_state->mmap_sz) - (char *)kds;
+
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pds->gcontext = NULL;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	pds->nblocks_uncached = 0;
+	pds->filedesc = -1;
+	pds->iovec = NULL;
+	pds->mmap_state = mmap_state;
+	mmap_state->refcnt++;
+
+	return pds;
+}
+
+/*
+ * __arrowFdwReadChunk - read a chunk of the arrow file
+ */
+static void
+__arrowFdwReadChunk(File fdesc, off_t f_pos, size_t length, void *dest)
+{
+	int			fd = FileGetRawDesc(fdesc);
+	ssize_t		sz;
+
+	while (length > 0)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		sz = pread(fd, dest, length, f_pos);
+		if (sz > 0)
+		{
+			Assert(sz <= length);
+			dest = (char *)dest + sz;
+			f_pos += sz;
+			length -= sz;
+		}
+		else if (sz == 0)
+			elog(ERROR, "unable to read arrow file '%s' any more",
+				 FilePathName(fdesc));
+		else if (errno != EINTR)
+			elog(ERROR, "failed on pread('%s'): %m", FilePathName(fdesc));
+	}
+}
+
+/*
+ * __arrowFdwDecompressChunk - read a compressed buffer of the arrow file,
+ * then expand it on the @dest. The tail of @dest (MAXALIGN padding) is
+ * filled by zero.
+ */
+#ifdef HAVE_LIBLZ4
+static size_t
+__arrowFdwDecompressLZ4(const char *src, size_t src_len,
+						char *dest, size_t dest_len)
+{
+	LZ4F_dctx  *dctx;
+	size_t		rc;
+	size_t		consumed = 0;
+	size_t		produced = 0;
+	const char *emsg = NULL;
+
+	rc = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+	if (LZ4F_isError(rc))
+		elog(ERROR, "failed on LZ4F_createDecompressionContext: %s",
+			 LZ4F_getErrorName(rc));
+	do {
+		size_t	dst_sz = dest_len - produced;
+		size_t	src_sz = src_len - consumed;
+
+		rc = LZ4F_decompress(dctx,
+							 dest + produced, &dst_sz,
+							 src + consumed, &src_sz, NULL);
+		if (LZ4F_isError(rc))
+		{
+			emsg = LZ4F_getErrorName(rc);
+			break;
+		}
+		if (dst_sz == 0 && src_sz == 0)
+		{
+			emsg = "truncated LZ4 frame";
+			break;
+		}
+		produced += dst_sz;
+		consumed += src_sz;
+	} while (rc != 0);
+	LZ4F_freeDecompressionContext(dctx);
+	if (emsg)
+		elog(ERROR, "failed on LZ4F_decompress: %s", emsg);
+	return produced;
+}
+#endif
+
+static void
+__arrowFdwDecompressChunk(File fdesc, ArrowCompressionType codec,
+						  off_t f_pos, size_t zlength,
+						  void *dest, size_t length)
+{
+	char	   *zbuf;
+	int64		rawlen;
+	size_t		sz;
+
+	Assert(zlength >= sizeof(int64));
+	zbuf = palloc(zlength);
+	__arrowFdwReadChunk(fdesc, f_pos, zlength, zbuf);
+	memcpy(&rawlen, zbuf, sizeof(int64));
+	if (rawlen == -1)
+	{
+		/* buffer is not compressed actually */
+		sz = zlength - sizeof(int64);
+		if (sz > length)
+			elog(ERROR, "uncompressed buffer is larger than expected");
+		memcpy(dest, zbuf + sizeof(int64), sz);
+	}
+	else
+	{
+		if (rawlen < 0 || rawlen > length)
+			elog(ERROR, "compressed buffer has corrupted length prefix");
+		switch (codec)
+		{
+#ifdef HAVE_LIBLZ4
+			case ArrowCompressionType__LZ4_FRAME:
+				sz = __arrowFdwDecompressLZ4(zbuf + sizeof(int64),
+											 zlength - sizeof(int64),
+											 dest, rawlen);
+				break;
+#endif
+#ifdef HAVE_LIBZSTD
+			case ArrowCompressionType__ZSTD:
+				sz = ZSTD_decompress(dest, rawlen,
+									 zbuf + sizeof(int64),
+									 zlength - sizeof(int64));
+				if (ZSTD_isError(sz))
+					elog(ERROR, "failed on ZSTD_decompress: %s",
+						 ZSTD_getErrorName(sz));
+				break;
+#endif
+			default:
+				elog(ERROR, "arrow file '%s' has buffers compressed by %s, but not supported in this build",
+					 FilePathName(fdesc),
+					 codec == ArrowCompressionType__LZ4_FRAME ? "LZ4_FRAME" :
+					 codec == ArrowCompressionType__ZSTD ? "ZSTD" : "unknown");
+				break;
+		}
+		if (sz != rawlen)
+			elog(ERROR, "decompressed buffer length mismatch (%zu of %ld)",
+				 sz, (long)rawlen);
+	}
+	if (sz < length)
+		memset((char *)dest + sz, 0, length - sz);
+	pfree(zbuf);
+}
+
+/*
+ * __arrowFdwReadBuffer - read a part of the buffer, at @offset from the head
+ * of the buffer. If compressed, entire buffer is expanded once.
+ */
+static void
+__arrowFdwReadBuffer(File fdesc, RecordBatchFieldState *fstate,
+					 off_t f_pos, size_t length, size_t zlength,
+					 size_t offset, size_t nbytes, void *dest)
+{
+	if (zlength == 0)
+		__arrowFdwReadChunk(fdesc, f_pos + offset, nbytes, dest);
+	else
+	{
+		char	   *temp = palloc(length);
+
+		if (offset + nbytes > length)
+			elog(ERROR, "corrupted arrow file? read beyond the buffer");
+		__arrowFdwDecompressChunk(fdesc, fstate->codec,
+								  f_pos, zlength, temp, length);
+		memcpy(dest, temp + offset, nbytes);
+		pfree(temp);
+	}
+}
+
+/*
+ * __arrowFdwDecodeParquetBuffer - copy a buffer decoded from the Parquet
+ * column chunk onto the region reserved by arrowFdwSetupIOvector
+ */
+static void
+__arrowFdwDecodeParquetBuffer(kern_data_store *kds,
+							  cl_uint cmeta_offset, size_t length,
+							  const char *buffer, size_t buffer_sz)
+{
+	char	   *dest = (char *)kds + __kds_unpack(cmeta_offset);
+
+	if (length == 0)
+		return;
+	if (buffer_sz > length)
+		elog(ERROR, "parquet: decoded buffer is larger than expected");
+	if (buffer_sz > 0)
+		memcpy(dest, buffer, buffer_sz);
+	if (buffer_sz < length)
+		memset(dest + buffer_sz, 0, length - buffer_sz);
+}
+
+/*
+ * arrowFdwDecompressRecordBatch - expand the compressed buffers of the
+ * referenced columns on the regions reserved by arrowFdwSetupIOvector
+ */
+static void
+arrowFdwDecompressField(RecordBatchState *rb_state,
+						RecordBatchFieldState *fstate,
+						kern_data_store *kds,
+						kern_colmeta *cmeta)
+{
+	if (fstate->parquet.is_parquet)
+	{
+		ParquetDecodedChunk	pq;
+
+		parquetDecodeColumnChunk(rb_state->fdesc, &fstate->parquet,
+								 rb_state->rb_offset + fstate->values_offset,
+								 fstate->values_zlength,
+								 fstate->nitems, &pq);
+		if (pq.null_count != fstate->null_count)
+			elog(ERROR, "parquet: column chunk has %ld null values, but %ld expected",
+				 (long)pq.null_count, (long)fstate->null_count);
+		__arrowFdwDecodeParquetBuffer(kds, cmeta->nullmap_offset,
+									  fstate->nullmap_length,
+									  (char *)pq.nullmap, pq.nullmap_length);
+		__arrowFdwDecodeParquetBuffer(kds, cmeta->values_offset,
+									  fstate->values_length,
+									  pq.values, pq.values_length);
+		__arrowFdwDecodeParquetBuffer(kds, cmeta->extra_offset,
+									  fstate->extra_length,
+									  pq.extra, pq.extra_length);
+		if (pq.nullmap)
+			pfree(pq.nullmap);
+		if (pq.extra)
+			pfree(pq.extra);
+		pfree(pq.values);
+		return;
+	}
+	if (fstate->nullmap_zlength > 0)
+		__arrowFdwDecompressChunk(rb_state->fdesc, fstate->codec,
+								  rb_state->rb_offset + fstate->nullmap_offset,
+								  fstate->nullmap_zlength,
+								  (char *)kds + __kds_unpack(cmeta->nullmap_offset),
+								  fstate->nullmap_length);
+	if (fstate->values_zlength > 0)
+		__arrowFdwDecompressChunk(rb_state->fdesc, fstate->codec,
+								  rb_state->rb_offset + fstate->values_offset,
+								  fstate->values_zlength,
+								  (char *)kds + __kds_unpack(cmeta->values_offset),
+								  fstate->values_length);
+	if (fstate->extra_zlength > 0)
+		__arrowFdwDecompressChunk(rb_state->fdesc, fstate->codec,
+								  rb_state->rb_offset + fstate->extra_offset,
+								  fstate->extra_zlength,
+								  (char *)kds + __kds_unpack(cmeta->extra_offset),
+								  fstate->extra_length);
+
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
+		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		kern_colmeta *subattr;
+		int		j;
+
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			arrowFdwDecompressField(rb_state, &fstate->children[j],
+									kds, subattr);
+		}
+	}
+}
+
+static void
+arrowFdwDecompressRecordBatch(kern_data_store *kds,
+							  RecordBatchState *rb_state,
+							  Bitmapset *referenced)
+{
+	int		j;
+
+	for (j=0; j < kds->ncols; j++)
+	{
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (referenced && bms_is_member(attidx, referenced))
+			arrowFdwDecompressField(rb_state, &rb_state->columns[j],
+									kds, &kds->colmeta[j]);
+	}
+}
+
+/*
+ * __arrowDictIndexRef / __arrowDictBufferRef
+ */
+static inline cl_long
+__arrowDictIndexRef(kern_colmeta *cmeta, const char *values, size_t index)
+{
+	switch (cmeta->attopts.dictionary.index_width)
+	{
+		case sizeof(cl_char):
+			if (cmeta->attopts.dictionary.is_signed)
+				return ((cl_char *)values)[index];
+			return ((cl_uchar *)values)[index];
+		case sizeof(cl_short):
+			if (cmeta->attopts.dictionary.is_signed)
+				return ((cl_short *)values)[index];
+			return ((cl_ushort *)values)[index];
+		case sizeof(cl_int):
+			if (cmeta->attopts.dictionary.is_signed)
+				return ((cl_int *)values)[index];
+			return ((cl_uint *)values)[index];
+		case sizeof(cl_long):
+			return ((cl_long *)values)[index];
+		default:
+			elog(ERROR, "Bug? unexpected width of dictionary index: %d",
+				 (int)cmeta->attopts.dictionary.index_width);
+	}
+	return -1;
+}
+
+static inline bool
+__arrowDictBufferRef(arrowDictBuffer *dict, cl_long dindex,
+					 char **p_addr, cl_uint *p_len)
+{
+	if (dindex < 0 || dindex >= dict->nitems)
+		elog(ERROR, "corrupted arrow file? dictionary index out of range");
+	if (dict->nullmap_offset != 0 &&
+		att_isnull(dindex, (uint8 *)dict + dict->nullmap_offset))
+		return false;
+	*p_addr = (char *)dict + dict->extra_offset + dict->values[dindex];
+	*p_len  = dict->values[dindex+1] - dict->values[dindex];
+	return true;
+}
+
+/*
+ * arrowFdwBuildDictionary - build arrowDictBuffer from the DictionaryBatches
+ */
+static arrowDictBuffer *
+arrowFdwBuildDictionary(File fdesc, RecordBatchFieldState *fstate,
+						MemoryContext mcontext)
+{
+	arrowDictBuffer *dict;
+	cl_uint	  **chunk_values;
+	size_t		nitems = 0;
+	size_t		extra_sz = 0;
+	size_t		head_sz;
+	size_t		nullmap_sz;
+	size_t		length;
+	bool		has_null = false;
+	char	   *extra;
+	size_t		i, base;
+	int			k;
+
+	Assert(RecordBatchFieldIsDictionary(fstate) && fstate->num_children > 0);
+	chunk_values = palloc(sizeof(cl_uint *) * fstate->num_children);
+	for (k=0; k < fstate->num_children; k++)
+	{
+		RecordBatchFieldState *chunk = &fstate->children[k];
+		size_t		sz = sizeof(cl_uint) * (chunk->nitems + 1);
+		cl_uint	   *values = palloc(sz);
+
+		if (chunk->values_length < sz)
+			elog(ERROR, "offset array of dictionary is smaller than expected");
+		__arrowFdwReadBuffer(fdesc, chunk,
+							 chunk->values_offset,
+							 chunk->values_length,
+							 chunk->values_zlength,
+							 0, sz, values);
+		if (values[0] > values[chunk->nitems] ||
+			values[chunk->nitems] > chunk->extra_length)
+			elog(ERROR, "corrupted arrow file? offset points out of extra buffer");
+		chunk_values[k] = values;
+		nitems += chunk->nitems;
+		extra_sz += values[chunk->nitems] - values[0];
+		if (chunk->null_count > 0)
+			has_null = true;
+	}
+	head_sz = MAXALIGN(offsetof(arrowDictBuffer, values[nitems + 1]));
+	nullmap_sz = (has_null ? MAXALIGN(BITMAPLEN(nitems)) : 0);
+	length = head_sz + nullmap_sz + MAXALIGN(extra_sz);
+	if (length >= UINT_MAX)
+		elog(ERROR, "dictionary in arrow file '%s' is too large",
+			 FilePathName(fdesc));
+
+	dict = MemoryContextAllocHuge(mcontext, length);
+	memset(dict, 0, head_sz + nullmap_sz);
+	dict->fdesc = fdesc;
+	dict->nitems = nitems;
+	dict->base_offset = fstate->children[0].values_offset;
+	dict->length = length;
+	dict->nullmap_offset = (has_null ? head_sz : 0);
+	dict->extra_offset = head_sz + nullmap_sz;
+	dict->extra_length = extra_sz;
+
+	extra = (char *)dict + dict->extra_offset;
+	for (k=0, i=0, base=0; k < fstate->num_children; k++)
+	{
+		RecordBatchFieldState *chunk = &fstate->children[k];
+		cl_uint	   *values = chunk_values[k];
+		size_t		len = values[chunk->nitems] - values[0];
+		size_t		j;
+
+		if (len > 0)
+			__arrowFdwReadBuffer(fdesc, chunk,
+								 chunk->extra_offset,
+								 chunk->extra_length,
+								 chunk->extra_zlength,
+								 values[0], len, extra + base);
+		for (j=0; j < chunk->nitems; j++)
+			dict->values[i+j] = base + values[j] - values[0];
+		if (has_null)
+		{
+			uint8	   *nullmap = (uint8 *)dict + dict->nullmap_offset;
+			uint8	   *temp = NULL;
+
+			if (chunk->null_count > 0)
+			{
+				temp = palloc(BITMAPLEN(chunk->nitems));
+				__arrowFdwReadBuffer(fdesc, chunk,
+									 chunk->nullmap_offset,
+									 chunk->nullmap_length,
+									 chunk->nullmap_zlength,
+									 0, BITMAPLEN(chunk->nitems), temp);
+			}
+			for (j=0; j < chunk->nitems; j++)
+			{
+				if (!temp || !att_isnull(j, temp))
+					nullmap[(i+j) >> 3] |= (1 << ((i+j) & 7));
+			}
+			if (temp)
+				pfree(temp);
+		}
+		i += chunk->nitems;
+		base += len;
+		pfree(values);
+	}
+	dict->values[nitems] = base;
+	pfree(chunk_values);
+
+	return dict;
+}
+
+/*
+ * arrowFdwLookupDictionary - lookup the dictionary already built in this
+ * scan, or build a new one.
+ */
+static arrowDictBuffer *
+arrowFdwLookupDictionary(File fdesc, RecordBatchFieldState *fstate,
+						 List **p_dict_list, MemoryContext mcontext)
+{
+	arrowDictBuffer *dict;
+	MemoryContext oldcxt;
+	off_t		base_offset = fstate->children[0].values_offset;
+	size_t		nitems = 0;
+	ListCell   *lc;
+	int			k;
+
+	for (k=0; k < fstate->num_children; k++)
+		nitems += fstate->children[k].nitems;
+	if (p_dict_list)
+	{
+		foreach (lc, *p_dict_list)
+		{
+			dict = lfirst(lc);
+			if (dict->fdesc == fdesc &&
+				dict->base_offset == base_offset &&
+				dict->nitems == nitems)
+				return dict;
+		}
+	}
+	dict = arrowFdwBuildDictionary(fdesc, fstate, mcontext);
+	if (p_dict_list)
+	{
+		oldcxt = MemoryContextSwitchTo(mcontext);
+		*p_dict_list = lappend(*p_dict_list, dict);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	return dict;
+}
+
+/*
+ * arrowFdwFlattenDictionary
+ *
+ * GPU device code has no idea for dictionaries, so we decode the dictionary-
+ * encoded column to the usual variable-length layout; arrowDictBuffer with
+ * one entry per row, and nulls on the rows are merged into its nullmap.
+ */
+static arrowDictBuffer *
+arrowFdwFlattenDictionary(RecordBatchState *rb_state,
+						  RecordBatchFieldState *fstate,
+						  kern_colmeta *cmeta,
+						  arrowDictBuffer *dict)
+{
+	arrowDictBuffer *flat;
+	uint8	   *nullmap = NULL;
+	char	   *values;
+	char	   *extra;
+	char	   *addr;
+	cl_uint		len;
+	size_t		nitems = rb_state->rb_nitems;
+	size_t		extra_sz = 0;
+	size_t		head_sz;
+	size_t		nullmap_sz;
+	size_t		length;
+	size_t		i, base;
+	bool		has_null;
+
+	Assert(fstate->nitems >= nitems);
+	if (fstate->null_count > 0)
+	{
+		nullmap = palloc(BITMAPLEN(nitems));
+		__arrowFdwReadBuffer(rb_state->fdesc, fstate,
+							 rb_state->rb_offset + fstate->nullmap_offset,
+							 fstate->nullmap_length,
+							 fstate->nullmap_zlength,
+							 0, BITMAPLEN(nitems), nullmap);
+	}
+	values = palloc(cmeta->attopts.dictionary.index_width * nitems);
+	__arrowFdwReadBuffer(rb_state->fdesc, fstate,
+						 rb_state->rb_offset + fstate->values_offset,
+						 fstate->values_length,
+						 fstate->values_zlength,
+						 0, cmeta->attopts.dictionary.index_width * nitems,
+						 values);
+	for (i=0; i < nitems; i++)
+	{
+		if (nullmap && att_isnull(i, nullmap))
+			continue;
+		if (__arrowDictBufferRef(dict, __arrowDictIndexRef(cmeta, values, i),
+								 &addr, &len))
+			extra_sz += len;
+	}
+	has_null = (nullmap != NULL || dict->nullmap_offset != 0);
+	head_sz = MAXALIGN(offsetof(arrowDictBuffer, values[nitems + 1]));
+	nullmap_sz = (has_null ? MAXALIGN(BITMAPLEN(nitems)) : 0);
+	length = head_sz + nullmap_sz + MAXALIGN(extra_sz);
+	if (length >= UINT_MAX)
+		elog(ERROR, "dictionary-encoded column is too large to decode");
+
+	flat = palloc0(length);
+	flat->fdesc = dict->fdesc;
+	flat->nitems = nitems;
+	flat->base_offset = dict->base_offset;
+	flat->length = length;
+	flat->nullmap_offset = (has_null ? head_sz : 0);
+	flat->extra_offset = head_sz + nullmap_sz;
+	flat->extra_length = extra_sz;
+
+	extra = (char *)flat + flat->extra_offset;
+	for (i=0, base=0; i < nitems; i++)
+	{
+		flat->values[i] = base;
+		if (nullmap && att_isnull(i, nullmap))
+			continue;
+		if (!__arrowDictBufferRef(dict, __arrowDictIndexRef(cmeta, values, i),
+								  &addr, &len))
+			continue;
+		memcpy(extra + base, addr, len);
+		base += len;
+		if (has_null)
+		{
+			uint8  *__nullmap = (uint8 *)flat + flat->nullmap_offset;
+
+			__nullmap[i >> 3] |= (1 << (i & 7));
+		}
+	}
+	flat->values[nitems] = base;
+	Assert(base == extra_sz);
+	if (nullmap)
+		pfree(nullmap);
+	pfree(values);
+
+	return flat;
+}
+
+/*
+ * arrowFdwRebaseWindow - rebase the offset arrays of the row window, because
+ * its extra buffer is loaded from @extra_shift of the original one.
+ */
+static void
+arrowFdwRebaseWindowField(RecordBatchFieldState *fstate,
+						  kern_data_store *kds,
+						  kern_colmeta *cmeta)
+{
+	if (fstate->extra_shift > 0 && cmeta->values_offset != 0)
+	{
+		cl_uint	   *offset = (cl_uint *)((char *)kds +
+										 __kds_unpack(cmeta->values_offset));
+		int64		i;
+
+		for (i=0; i <= fstate->nitems; i++)
+			offset[i] -= fstate->extra_shift;
+	}
+
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		kern_colmeta *subattr;
+		int		j;
+
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			arrowFdwRebaseWindowField(&fstate->children[j], kds, subattr);
+		}
+	}
+}
+
+static void
+arrowFdwRebaseWindow(kern_data_store *kds,
+					 RecordBatchState *rb_state,
+					 Bitmapset *referenced)
+{
+	int		j;
+
+	for (j=0; j < kds->ncols; j++)
+	{
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (referenced && bms_is_member(attidx, referenced))
+			arrowFdwRebaseWindowField(&rb_state->columns[j],
+									  kds, &kds->colmeta[j]);
+	}
+}
+
+/*
+ * arrowFdwPartitionFieldLength / arrowFdwPartitionFieldSetup
+ *
+ * Values of the partition key are not stored in the arrow file, so they are
+ * synthesized at the tail of KDS as if it were an arrow column.
+ */
+static size_t
+arrowFdwPartitionFieldLength(RecordBatchFieldState *fstate)
+{
+	size_t		len;
+
+	switch (fstate->atttypid)
+	{
+		case INT2OID:
+			return MAXALIGN(sizeof(int16) * fstate->nitems);
+		case INT4OID:
+		case FLOAT4OID:
+		case DATEOID:
+			return MAXALIGN(sizeof(int32) * fstate->nitems);
+		case INT8OID:
+		case FLOAT8OID:
+			return MAXALIGN(sizeof(int64) * fstate->nitems);
+		case TEXTOID:
+		case VARCHAROID:
+			len = VARSIZE_ANY_EXHDR(DatumGetPointer(fstate->part_value));
+			if (len * fstate->nitems >= UINT_MAX)
+				elog(ERROR, "arrow_fdw: value of the partition key is too long");
+			return (MAXALIGN(sizeof(cl_uint) * (fstate->nitems + 1)) +
+					MAXALIGN(len * fstate->nitems));
+		default:
+			elog(ERROR, "arrow_fdw: partition key has unsupported type: %s",
+				 format_type_be(fstate->atttypid));
+	}
+	return 0;
+}
+
+#define __SETUP_PARTITION_VALUES(TYPE,VALUE)		\
+	do {											\
+		TYPE   *values = (TYPE *)(base + pos);		\
+													\
+		for (i=0; i < fstate->nitems; i++)			\
+			values[i] = (VALUE);					\
+		cmeta->values_length = __kds_packed(MAXALIGN(sizeof(TYPE) *	\
+													 fstate->nitems)); \
+	} while(0)
+
+static void
+arrowFdwPartitionFieldSetup(kern_data_store *kds,
+							kern_colmeta *cmeta,
+							RecordBatchFieldState *fstate,
+							size_t pos)
+{
+	char	   *base = (char *)kds;
+	Datum		datum = fstate->part_value;
+	int64		i;
+
+	cmeta->values_offset = __kds_packed(pos);
+	switch (fstate->atttypid)
+	{
+		case INT2OID:
+			__SETUP_PARTITION_VALUES(int16, DatumGetInt16(datum));
+			break;
+		case INT4OID:
+			__SETUP_PARTITION_VALUES(int32, DatumGetInt32(datum));
+			break;
+		case INT8OID:
+			__SETUP_PARTITION_VALUES(int64, DatumGetInt64(datum));
+			break;
+		case FLOAT4OID:
+			__SETUP_PARTITION_VALUES(float4, DatumGetFloat4(datum));
+			break;
+		case FLOAT8OID:
+			__SETUP_PARTITION_VALUES(float8, DatumGetFloat8(datum));
+			break;
+		case DATEOID:
+			/* Arrow::Date (unit: day) counts days from the UNIX epoch */
+			__SETUP_PARTITION_VALUES(int32, (DatumGetDateADT(datum) +
+											 POSTGRES_EPOCH_JDATE -
+											 UNIX_EPOCH_JDATE));
+			break;
+		case TEXTOID:
+		case VARCHAROID:
+			{
+				cl_uint	   *offset = (cl_uint *)(base + pos);
+				char	   *extra;
+				char	   *str = VARDATA_ANY(DatumGetPointer(datum));
+				size_t		len = VARSIZE_ANY_EXHDR(DatumGetPointer(datum));
+				size_t		head_sz = MAXALIGN(sizeof(cl_uint) *
+											   (fstate->nitems + 1));
+
+				extra = base + pos + head_sz;
+				for (i=0; i < fstate->nitems; i++)
+				{
+					offset[i] = len * i;
+					memcpy(extra + len * i, str, len);
+				}
+				offset[fstate->nitems] = len * fstate->nitems;
+				cmeta->values_length = __kds_packed(head_sz);
+				cmeta->extra_offset = __kds_packed(pos + head_sz);
+				cmeta->extra_length = __kds_packed(MAXALIGN(len *
+															fstate->nitems));
+			}
+			break;
+		default:
+			elog(ERROR, "arrow_fdw: partition key has unsupported type: %s",
+				 format_type_be(fstate->atttypid));
+	}
+}
+#undef __SETUP_PARTITION_VALUES
+
+/*
+ * arrowFdwLoadRecordBatch
+ */
+static pgstrom_data_store *
+__arrowFdwLoadRecordBatch(RecordBatchState *rb_state,
+						  Relation relation,
+						  Bitmapset *referenced,
+						  GpuContext *gcontext,
+						  MemoryContext mcontext,
+						  int optimal_gpu,
+						  ArrowFdwMmapState *mmap_state,
+						  List **p_dict_list)
+{
+	TupleDesc			tupdesc = RelationGetDescr(relation);
+	pgstrom_data_store *pds;
+	kern_data_store	   *kds;
+	strom_io_vector	   *iovec;
+	arrowDictBuffer   **dicts = NULL;
+	Bitmapset		   *iov_referenced = referenced;
+	Bitmapset		   *part_referenced = NULL;
+	size_t				head_sz;
+	size_t				dict_pos = 0;
+	size_t				part_pos = 0;
+	bool				compressed = false;
+	int					j, fdesc;
+	CUresult			rc;
+
+	for (j=0; j < rb_state->ncols; j++)
+	{
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (fstate->compressed)
+			compressed = true;
+		/* values of the partition key are synthesized, not loaded */
+		if (fstate->part_key &&
+			referenced && bms_is_member(attidx, referenced))
+		{
+			if (iov_referenced == referenced)
+				iov_referenced = bms_copy(referenced);
+			iov_referenced = bms_del_member(iov_referenced, attidx);
+			if (fstate->null_count == 0)
+				part_referenced = bms_add_member(part_referenced, j);
+		}
+	}
+	/* setup KDS and I/O-vector */
+	head_sz = KDS_calculateHeadSize(tupdesc);
+	kds = alloca(head_sz);
+	init_kernel_data_store(kds, tupdesc, 0, KDS_FORMAT_ARROW, 0);
+	kds->nitems = rb_state->rb_nitems;
+	kds->nrooms = rb_state->rb_nitems;
+	kds->table_oid = RelationGetRelid(relation);
+	Assert(head_sz == KERN_DATA_STORE_HEAD_LENGTH(kds));
+	for (j=0; j < kds->nr_colmeta; j++)
+		kds->colmeta[j].attopts = rb_state->columns[j].attopts;
+	/* dictionaries of the referenced dictionary-encoded columns */
+	for (j=0; j < kds->ncols; j++)
+	{
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (!RecordBatchFieldIsDictionary(fstate) ||
+			!referenced || !bms_is_member(attidx, referenced))
+			continue;
+		if (!dicts)
+			dicts = palloc0(sizeof(arrowDictBuffer *) * kds->ncols);
+		dicts[j] = arrowFdwLookupDictionary(rb_state->fdesc, fstate,
+											p_dict_list, mcontext);
+		/*
+		 * GPU needs the decoded values, so the index values are not
+		 * loaded by I/O-vector.
+		 */
+		if (gcontext)
+		{
+			if (iov_referenced == referenced)
+				iov_referenced = bms_copy(referenced);
+			iov_referenced = bms_del_member(iov_referenced, attidx);
+			dicts[j] = arrowFdwFlattenDictionary(rb_state, fstate,
+												 &kds->colmeta[j],
+												 dicts[j]);
+		}
+	}
+	/*
+	 * If the arrow file is mapped, CPU can refer the file image directly
+	 * without buffer allocation and read. Compressed RecordBatch has to be
+	 * expanded on the buffer, so it is not applicable.
+	 */
+	if (!gcontext && mmap_state && !dicts && !compressed && !part_referenced)
+	{
+		pds = arrowFdwLoadRecordBatchMmap(rb_state, mmap_state,
+										  kds, referenced);
+		if (pds)
+			return pds;
+	}
+	iovec = arrowFdwSetupIOvector(kds, rb_state, iov_referenced);
+	__dump_kds_and_iovec(kds, iovec);
+	/* dictionaries are placed at the tail of KDS */
+	if (dicts)
+	{
+		dict_pos = MAXALIGN(kds->length);
+		kds->length = dict_pos;
+		for (j=0; j < kds->ncols; j++)
+		{
+			if (dicts[j])
+				kds->length += dicts[j]->length;
+		}
+	}
+	/* values of the partition keys are also placed at the tail of KDS */
+	if (part_referenced)
+	{
+		part_pos = MAXALIGN(kds->length);
+		kds->length = part_pos;
+		for (j = bms_next_member(part_referenced, -1);
+			 j >= 0;
+			 j = bms_next_member(part_referenced, j))
+			kds->length += arrowFdwPartitionFieldLength(&rb_state->columns[j]);
+	}
+
+	fdesc = FileGetRawDesc(rb_state->fdesc);
+	/*
+	 * If SSD-to-GPU Direct SQL is available on the arrow file, setup a small
+	 * PDS on host-pinned memory, with strom_io_vector.
+	 * Compressed RecordBatch is expanded by CPU, and offset arrays of the row
+	 * window are rebased by CPU, so always loaded by the filesystem.
+	 */
+	if (gcontext &&
+		gcontext->cuda_dindex == optimal_gpu &&
+		iovec->nr_chunks > 0 &&
+		!dicts &&
+		!compressed &&
+		!part_referenced &&
+		!rb_state->rb_rebase &&
+		kds->length <= gpuMemAllocIOMapMaxLength())
+	{
+		size_t	iovec_sz = offsetof(strom_io_vector, ioc[iovec->nr_chunks]);
+
+		rc = gpuMemAllocHost(gcontext, (void **)&pds,
+							 offsetof(pgstrom_data_store, kds) +
+							 head_sz + iovec_sz);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocHost: %s", errorText(rc));
+
+		pds->gcontext = gcontext;
+		pg_atomic_init_u32(&pds->refcnt, 1);
+		pds->nblocks_uncached = 0;
+		pds->filedesc = fdesc;
+		pds->iovec = (strom_io_vector *)((char *)&pds->kds + head_sz);
+		pds->mmap_state = NULL;
+		memcpy(&pds->kds, kds, head_sz);
+		memcpy(pds->iovec, iovec, iovec_sz);
+	}
+	else
+	{
+		/* Elsewhere, load RecordBatch by filesystem */
+		if (gcontext)
+		{
+			rc = gpuMemAllocManaged(gcontext,
+									(CUdeviceptr *)&pds,
+									offsetof(pgstrom_data_store,
+											 kds) + kds->length,
+									CU_MEM_ATTACH_GLOBAL);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+		}
+		else
+		{
+			pds = MemoryContextAllocHuge(mcontext,
+										 offsetof(pgstrom_data_store,
+												  kds) + kds->length);
+		}
+		__PDS_fillup_arrow(pds, gcontext, kds, fdesc, iovec);
+		if (compressed)
+			arrowFdwDecompressRecordBatch(&pds->kds, rb_state,
+										  iov_referenced);
+		if (rb_state->rb_rebase)
+			arrowFdwRebaseWindow(&pds->kds, rb_state, iov_referenced);
+	}
+	pfree(iovec);
+
+	if (dicts)
+	{
+		for (j=0; j < kds->ncols; j++)
+		{
+			arrowDictBuffer *dict = dicts[j];
+			kern_colmeta *cmeta = &pds->kds.colmeta[j];
+			size_t		curr_pos = dict_pos;
+
+			if (!dict)
+				continue;
+			memcpy((char *)&pds->kds + curr_pos, dict, dict->length);
+			dict_pos += dict->length;
+			if (!gcontext)
+			{
+				/* index values, and the dictionary on the extra buffer */
+				cmeta->extra_offset = __kds_packed(curr_pos);
+				cmeta->extra_length = __kds_packed(dict->length);
+				if (!p_dict_list)
+					pfree(dict);
+			}
+			else
+			{
+				/* decoded variable-length values */
+				if (dict->nullmap_offset != 0)
+				{
+					cmeta->nullmap_offset = __kds_packed(curr_pos +
+														 dict->nullmap_offset);
+					cmeta->nullmap_length = __kds_packed(dict->extra_offset -
+														 dict->nullmap_offset);
+				}
+				cmeta->values_offset = __kds_packed(curr_pos +
+													offsetof(arrowDictBuffer,
+															 values));
+				cmeta->values_length = __kds_packed(MAXALIGN(sizeof(cl_uint) *
+															 (dict->nitems + 1)));
+				cmeta->extra_offset = __kds_packed(curr_pos +
+												   dict->extra_offset);
+				cmeta->extra_length = __kds_packed(MAXALIGN(dict->extra_length));
+				memset(&cmeta->attopts, 0, sizeof(ArrowTypeOptions));
+				pfree(dict);
+			}
+		}
+		pfree(dicts);
+	}
+	if (part_referenced)
+	{
+		for (j = bms_next_member(part_referenced, -1);
+			 j >= 0;
+			 j = bms_next_member(part_referenced, j))
+		{
+			RecordBatchFieldState *fstate = &rb_state->columns[j];
+
+			arrowFdwPartitionFieldSetup(&pds->kds, &pds->kds.colmeta[j],
+										fstate, part_pos);
+			part_pos += arrowFdwPartitionFieldLength(fstate);
+		}
+		bms_free(part_referenced);
+	}
+	if (iov_referenced != referenced)
+		bms_free(iov_referenced);
+	return pds;
+}
+
+static size_t
+arrowFdwReferencedLength(ArrowFdwState *af_state, RecordBatchState *rb_state)
+{
+	size_t		len = 0;
+	int			j, k;
+
+	for (k = bms_next_member(af_state->referenced, -1);
+		 k >= 0;
+		 k = bms_next_member(af_state->referenced, k))
+	{
+		j = k + FirstLowInvalidHeapAttributeNumber - 1;
+		if (j < 0 || j >= rb_state->ncols)
+			continue;
+		len += RecordBatchFieldLength(&rb_state->columns[j]);
+	}
+	return len;
+}
+
+/*
+ * arrowFdwSkipRecordBatch - checks whether the RecordBatch can be skipped
+ * by the partition keys of the file or min/max statistics, and counts it.
+ */
+static bool
+arrowFdwSkipRecordBatch(ArrowFdwState *af_state, RecordBatchState *rb_state)
+{
+	ArrowFdwSharedState *sstate = af_state->sstate;
 
-	if (f_pos == con->f_offset &&
-		con->m_offset == MAXALIGN(con->m_offset))
+	if ((!rb_state->part_qual ||
+		 ExecQual(rb_state->part_qual, af_state->econtext)) &&
+		!arrowStatsHintCheckRecordBatch(af_state, rb_state))
+		return false;
+	pg_atomic_fetch_add_u32(&sstate->rbatch_nskips, 1);
+	pg_atomic_fetch_add_u64(&sstate->rbatch_skip_sz,
+							arrowFdwReferencedLength(af_state, rb_state));
+	return true;
+}
+
+/*
+ * arrowFdwClaimRecordBatch - claims the next RecordBatch to be read
+ * by the shared rbatch_index, and skips it if min/max statistics allow.
+ */
+static int
+arrowFdwClaimRecordBatch(ArrowFdwState *af_state)
+{
+	ArrowFdwSharedState *sstate = af_state->sstate;
+	uint32		rb_index;
+
+	for (;;)
 	{
-		/* good, buffer is continuous */
-		*p_cmeta_offset = __kds_packed(con->m_offset);
-		*p_cmeta_length = __kds_packed(chunk_length);
+		/* fetch next RecordBatch */
+		rb_index = pg_atomic_fetch_add_u32(&sstate->rbatch_index, 1);
+		if (rb_index >= af_state->num_rbatches)
+			return -1;		/* no more RecordBatch to read */
+		if (!arrowFdwSkipRecordBatch(af_state, af_state->rbatches[rb_index]))
+			break;
+	}
+	return rb_index;
+}
 
-		con->m_offset += chunk_length;
-		con->f_offset += chunk_length;
+/*
+ * arrowFdwPrefetchRecordBatch - kicks asynchronous read of the referenced
+ * buffers of the RecordBatch, using page-cache read-ahead of the kernel.
+ */
+static inline void
+__arrowFdwPrefetchChunk(int fdesc, off_t f_pos, size_t length)
+{
+#ifdef POSIX_FADV_WILLNEED
+	if (length > 0)
+		(void) posix_fadvise(fdesc, f_pos, length, POSIX_FADV_WILLNEED);
+#endif
+}
+
+static void
+arrowFdwPrefetchField(int fdesc, off_t rb_offset,
+					  RecordBatchFieldState *fstate)
+{
+	int		j;
+
+	if (fstate->compressed)
+	{
+		__arrowFdwPrefetchChunk(fdesc, rb_offset + fstate->nullmap_offset,
+								fstate->nullmap_zlength);
+		__arrowFdwPrefetchChunk(fdesc, rb_offset + fstate->values_offset,
+								fstate->values_zlength);
+		__arrowFdwPrefetchChunk(fdesc, rb_offset + fstate->extra_offset,
+								fstate->extra_zlength);
 	}
 	else
 	{
-		off_t		f_base = TYPEALIGN_DOWN(PAGE_SIZE, f_pos);
-		off_t		f_tail;
-		off_t		shift = f_pos - f_base;
-		strom_io_chunk *ioc;
+		__arrowFdwPrefetchChunk(fdesc, rb_offset + fstate->nullmap_offset,
+								fstate->nullmap_length);
+		__arrowFdwPrefetchChunk(fdesc, rb_offset + fstate->values_offset,
+								fstate->values_length);
+		__arrowFdwPrefetchChunk(fdesc, rb_offset + fstate->extra_offset,
+								fstate->extra_length);
+	}
+	/* dictionaries are already loaded on the first RecordBatch */
+	if (RecordBatchFieldIsDictionary(fstate))
+		return;
+	for (j=0; j < fstate->num_children; j++)
+		arrowFdwPrefetchField(fdesc, rb_offset, &fstate->children[j]);
+}
 
-		if (con->io_index < 0)
-			con->io_index = 0;	/* no previous i/o chunks */
-		else
+static void
+arrowFdwPrefetchRecordBatch(ArrowFdwState *af_state,
+							RecordBatchState *rb_state)
+{
+	int		fdesc = FileGetRawDesc(rb_state->fdesc);
+	int		j, k;
+
+	for (k = bms_next_member(af_state->referenced, -1);
+		 k >= 0;
+		 k = bms_next_member(af_state->referenced, k))
+	{
+		j = k + FirstLowInvalidHeapAttributeNumber - 1;
+		if (j < 0 || j >= rb_state->ncols)
+			continue;
+		arrowFdwPrefetchField(fdesc, rb_state->rb_offset,
+							  &rb_state->columns[j]);
+	}
+}
+
+/*
+ * arrowFdwNextRecordBatch - pick up the next RecordBatch to be loaded.
+ * If read-ahead is enabled, we keep claiming the RecordBatches ahead of
+ * the current one, and kick their asynchronous read. Because they are
+ * claimed by the shared rbatch_index, no other workers read them.
+ */
+static RecordBatchState *
+arrowFdwNextRecordBatch(ArrowFdwState *af_state, bool readahead)
+{
+	int		rb_index;
+
+	if (!readahead || af_state->ra_depth <= 0)
+	{
+		rb_index = arrowFdwClaimRecordBatch(af_state);
+		return (rb_index < 0 ? NULL : af_state->rbatches[rb_index]);
+	}
+	/* fill up the read-ahead queue */
+	while (af_state->ra_nitems <= af_state->ra_depth)
+	{
+		int		k;
+
+		rb_index = arrowFdwClaimRecordBatch(af_state);
+		if (rb_index < 0)
+			break;
+		k = (af_state->ra_head +
+			 af_state->ra_nitems++) % (af_state->ra_depth + 1);
+		af_state->ra_queue[k] = rb_index;
+		arrowFdwPrefetchRecordBatch(af_state, af_state->rbatches[rb_index]);
+	}
+	if (af_state->ra_nitems == 0)
+		return NULL;	/* no more RecordBatch to read */
+	rb_index = af_state->ra_queue[af_state->ra_head];
+	af_state->ra_head = (af_state->ra_head + 1) % (af_state->ra_depth + 1);
+	af_state->ra_nitems--;
+
+	return af_state->rbatches[rb_index];
+}
+
+static pgstrom_data_store *
+arrowFdwLoadRecordBatch(ArrowFdwState *af_state,
+						Relation relation,
+						EState *estate,
+						GpuContext *gcontext,
+						int optimal_gpu)
+{
+	ArrowFdwSharedState *sstate = af_state->sstate;
+	RecordBatchState *rb_state;
+	ArrowFdwMmapState *mmap_state = NULL;
+	pgstrom_data_store *pds;
+	instr_time	tv1, tv2;
+
+	/* read-ahead is valid only if CPU loads RecordBatches */
+	rb_state = arrowFdwNextRecordBatch(af_state, gcontext == NULL);
+	if (!rb_state)
+		return NULL;	/* no more RecordBatch to read */
+	/*
+	 * The stall is measured on every scan, not only on EXPLAIN ANALYZE,
+	 * because ps.instrument is not set up yet on the BeginXXXScan; so the
+	 * scan never behaves differently whether it is instrumented or not.
+	 */
+	INSTR_TIME_SET_CURRENT(tv1);
+	if (!gcontext && arrow_fdw_enable_mmap)
+		mmap_state = arrowFdwLookupMmapState(af_state, rb_state, relation,
+											 estate->es_query_cxt);
+	pds = __arrowFdwLoadRecordBatch(rb_state,
+									relation,
+									af_state->referenced,
+									gcontext,
+									estate->es_query_cxt,
+									optimal_gpu,
+									mmap_state,
+									&af_state->dict_list);
+	INSTR_TIME_SET_CURRENT(tv2);
+	INSTR_TIME_SUBTRACT(tv2, tv1);
+	pg_atomic_fetch_add_u64(&sstate->rbatch_stall_us,
+							INSTR_TIME_GET_MICROSEC(tv2));
+	/* compute min/max statistics lazily, if not available yet */
+	if (af_state->stats_attidx)
+		arrowFdwComputeFieldStats(af_state, rb_state, pds);
+	return pds;
+}
+
+/*
+ * ExecScanChunkArrowFdw
+ */
+pgstrom_data_store *
+ExecScanChunkArrowFdw(GpuTaskState *gts)
+{
+	pgstrom_data_store *pds;
+
+	InstrStartNode(&gts->outer_instrument);
+	pds = arrowFdwLoadRecordBatch(gts->af_state,
+								  gts->css.ss.ss_currentRelation,
+								  gts->css.ss.ps.state,
+								  gts->gcontext,
+								  gts->optimal_gpu);
+	InstrStopNode(&gts->outer_instrument,
+				  !pds ? 0.0 : (double)pds->kds.nitems);
+	return pds;
+}
+
+/*
+ * Routines for the ordered scan
+ *
+ * Foreign table with 'sorted_by' option declares each RecordBatch is sorted
+ * by the keys, so the scan returns rows in order by the k-way merge of the
+ * sorted runs, instead of the Sort node above. The declared order is not
+ * trusted blindly; every row is compared to the previous one of the same run.
+ */
+static void
+arrowFdwSetupSortSupport(SortSupport ssup, arrowSortKey *skey)
+{
+	memset(ssup, 0, sizeof(SortSupportData));
+	ssup->ssup_cxt = CurrentMemoryContext;
+	ssup->ssup_collation = skey->attcollid;
+	ssup->ssup_nulls_first = skey->descending;
+	ssup->ssup_attno = skey->attnum;
+	ssup->abbreviate = false;
+	PrepareSortSupportFromOrderingOp(skey->sortop, ssup);
+}
+
+/*
+ * arrowFdwAssignSortedRuns
+ *
+ * It assigns the RecordBatches to the sorted runs. A RecordBatch can follow
+ * the tail of a run, if min/max statistics of the leading sort key tell us
+ * they have no overlap (nor NULLs), then, rows in a run are already sorted
+ * across the RecordBatches. RecordBatches with run_id[i] < 0 are ignored.
+ * It returns the number of the sorted runs.
+ */
+static int
+arrowFdwAssignSortedRuns(RecordBatchState **rbatches, int nitems,
+						 int *run_id, List *sort_keys)
+{
+	arrowSortKey *skey = linitial(sort_keys);
+	bool		single_key = (list_length(sort_keys) == 1);
+	int			attidx = skey->attnum - 1;
+	int		   *tails;
+	int			nruns = 0;
+	SortSupportData ssup;
+	int			i, k;
+
+	arrowFdwSetupSortSupport(&ssup, skey);
+	tails = palloc(sizeof(int) * Max(nitems, 1));
+	for (i=0; i < nitems; i++)
+	{
+		RecordBatchState *rb_state = rbatches[i];
+		RecordBatchFieldState *fstate;
+		Datum		first;
+
+		if (run_id[i] < 0)
+			continue;
+		run_id[i] = nruns;
+		if (attidx < rb_state->ncols &&
+			(fstate = &rb_state->columns[attidx])->stat_valid &&
+			fstate->null_count == 0 &&
+			__arrowStatDatumToPG(fstate, (skey->descending
+										  ? &fstate->stat_max
+										  : &fstate->stat_min), &first))
 		{
-			ioc = &con->ioc[con->io_index++];
+			/* the most recent run is likely the one to be followed */
+			for (k=nruns-1; k >= 0; k--)
+			{
+				RecordBatchState *tail = rbatches[tails[k]];
+				RecordBatchFieldState *tstate = &tail->columns[attidx];
+				Datum		last;
+				int			comp;
+
+				if (!tstate->stat_valid ||
+					tstate->null_count > 0 ||
+					!__arrowStatDatumToPG(tstate, (skey->descending
+												   ? &tstate->stat_min
+												   : &tstate->stat_max), &last))
+					continue;
+				comp = ApplySortComparator(last, false, first, false, &ssup);
+				if (comp < 0 || (comp == 0 && single_key))
+				{
+					run_id[i] = k;
+					break;
+				}
+			}
+		}
+		if (run_id[i] == nruns)
+			nruns++;
+		tails[run_id[i]] = i;
+	}
+	pfree(tails);
 
-			f_tail = TYPEALIGN(PAGE_SIZE, con->f_offset);
-			ioc->nr_pages = f_tail / PAGE_SIZE - ioc->fchunk_id;
-			con->m_offset += (f_tail - con->f_offset); //safety margin;
+	return nruns;
+}
+
+static arrowSortedMerge *
+arrowFdwCreateSortedMerge(List *sort_keys, TupleDesc tupdesc)
+{
+	arrowSortedMerge *merge;
+	ListCell   *lc;
+	int			k = 0;
+
+	merge = palloc0(sizeof(arrowSortedMerge));
+	merge->sort_keys = sort_keys;
+	merge->nkeys = list_length(sort_keys);
+	merge->ssup = palloc0(sizeof(SortSupportData) * merge->nkeys);
+	foreach (lc, sort_keys)
+		arrowFdwSetupSortSupport(&merge->ssup[k++], lfirst(lc));
+	merge->natts = tupdesc->natts;
+	merge->memcxt = AllocSetContextCreate(CurrentMemoryContext,
+										  "arrow_fdw sorted merge",
+										  ALLOCSET_DEFAULT_SIZES);
+	merge->last_run = -1;
+
+	return merge;
+}
+
+static int
+arrowSortedMergeCompare(arrowSortedMerge *merge,
+						Datum *values1, bool *isnull1,
+						Datum *values2, bool *isnull2)
+{
+	ListCell   *lc;
+	int			k = 0;
+
+	foreach (lc, merge->sort_keys)
+	{
+		arrowSortKey *skey = lfirst(lc);
+		int			j = skey->attnum - 1;
+		int			comp;
+
+		comp = ApplySortComparator(values1[j], isnull1[j],
+								   values2[j], isnull2[j],
+								   &merge->ssup[k++]);
+		if (comp != 0)
+			return comp;
+	}
+	return 0;
+}
+
+static int
+arrowSortedMergeHeapComp(Datum a, Datum b, void *arg)
+{
+	arrowSortedMerge *merge = arg;
+	arrowSortedRun *run1 = &merge->runs[DatumGetInt32(a)];
+	arrowSortedRun *run2 = &merge->runs[DatumGetInt32(b)];
+	int			comp;
+
+	comp = arrowSortedMergeCompare(merge,
+								   run1->values[run1->curr],
+								   run1->isnull[run1->curr],
+								   run2->values[run2->curr],
+								   run2->isnull[run2->curr]);
+	/* binaryheap is max-heap, so smaller row must be larger */
+	return (comp < 0 ? 1 : (comp > 0 ? -1 : 0));
+}
+
+/*
+ * arrowSortedMergeBuildRuns - build the sorted runs of the RecordBatches
+ * not to be skipped; arguments of the stats hints are evaluated here.
+ */
+static void
+arrowSortedMergeBuildRuns(ArrowFdwState *af_state, arrowSortedMerge *merge)
+{
+	int			nitems = af_state->num_rbatches;
+	int		   *run_id = palloc(sizeof(int) * Max(nitems, 1));
+	MemoryContext oldcxt;
+	int			i, k;
+
+	oldcxt = MemoryContextSwitchTo(merge->memcxt);
+	for (i=0; i < nitems; i++)
+	{
+		if (arrowFdwSkipRecordBatch(af_state, af_state->rbatches[i]))
+			run_id[i] = -1;
+		else
+			run_id[i] = 0;
+	}
+	merge->nruns = arrowFdwAssignSortedRuns(af_state->rbatches, nitems,
+											run_id, merge->sort_keys);
+	merge->runs = palloc0(sizeof(arrowSortedRun) * Max(merge->nruns, 1));
+	for (i=0; i < nitems; i++)
+	{
+		if (run_id[i] >= 0)
+			merge->runs[run_id[i]].rb_count++;
+	}
+	for (k=0; k < merge->nruns; k++)
+	{
+		arrowSortedRun *run = &merge->runs[k];
+		int			n;
+
+		run->rb_indexes = palloc(sizeof(int) * run->rb_count);
+		run->rb_count = 0;
+		for (n=0; n < 2; n++)
+		{
+			run->values[n] = palloc(sizeof(Datum) * merge->natts);
+			run->isnull[n] = palloc(sizeof(bool) * merge->natts);
+			run->memcxt[n] = AllocSetContextCreate(merge->memcxt,
+												   "arrow_fdw sorted run",
+												   ALLOCSET_DEFAULT_SIZES);
 		}
-		ioc = &con->ioc[con->io_index];
-		/* adjust position if con->m_offset is not aligned well */
-		if (con->m_offset + shift != MAXALIGN(con->m_offset + shift))
-			con->m_offset = MAXALIGN(con->m_offset + shift) - shift;
-		ioc->m_offset   = con->m_offset;
-		ioc->fchunk_id  = f_base / PAGE_SIZE;
+	}
+	for (i=0; i < nitems; i++)
+	{
+		if (run_id[i] >= 0)
+		{
+			arrowSortedRun *run = &merge->runs[run_id[i]];
 
-		*p_cmeta_offset = __kds_packed(con->m_offset + shift);
-		*p_cmeta_length = __kds_packed(chunk_length);
+			run->rb_indexes[run->rb_count++] = i;
+		}
+	}
+	merge->heap = binaryheap_allocate(Max(merge->nruns, 1),
+									  arrowSortedMergeHeapComp,
+									  merge);
+	MemoryContextSwitchTo(oldcxt);
+	pfree(run_id);
+}
 
-		con->m_offset  += shift + chunk_length;
-		con->f_offset   = f_pos + chunk_length;
+/*
+ * arrowSortedRunNext - moves the run to the next row, and checks whether
+ * it is not smaller than the previous one.
+ */
+static bool
+arrowSortedRunNext(ArrowFdwState *af_state,
+				   arrowSortedMerge *merge,
+				   arrowSortedRun *run,
+				   Relation relation,
+				   EState *estate)
+{
+	pgstrom_data_store *pds_prev = NULL;
+	kern_data_store *kds;
+	MemoryContext oldcxt;
+	Datum	   *values;
+	bool	   *isnull;
+	int			next = 1 - run->curr;
+	int			j, k;
+
+	while (!run->pds || run->row_index >= run->pds->kds.nitems)
+	{
+		/* previous row may still reference the buffer */
+		if (run->pds)
+		{
+			if (!pds_prev)
+				pds_prev = run->pds;
+			else
+				PDS_release(run->pds);
+			run->pds = NULL;
+		}
+		if (run->rb_pos >= run->rb_count)
+		{
+			if (pds_prev)
+				PDS_release(pds_prev);
+			run->has_row = false;
+			return false;
+		}
+		run->rb_state = af_state->rbatches[run->rb_indexes[run->rb_pos++]];
+		run->pds = __arrowFdwLoadRecordBatch(run->rb_state,
+											 relation,
+											 af_state->referenced,
+											 NULL,
+											 estate->es_query_cxt,
+											 -1,
+											 NULL,
+											 &af_state->dict_list);
+		/* compute min/max statistics lazily, if not available yet */
+		if (af_state->stats_attidx)
+			arrowFdwComputeFieldStats(af_state, run->rb_state, run->pds);
+		run->row_index = 0;
+	}
+	kds = &run->pds->kds;
+	values = run->values[next];
+	isnull = run->isnull[next];
+	memset(isnull, true, sizeof(bool) * merge->natts);
+	MemoryContextReset(run->memcxt[next]);
+	oldcxt = MemoryContextSwitchTo(run->memcxt[next]);
+	for (k = bms_next_member(af_state->referenced, -1);
+		 k >= 0;
+		 k = bms_next_member(af_state->referenced, k))
+	{
+		j = k + FirstLowInvalidHeapAttributeNumber - 1;
+		if (j < 0 || j >= kds->ncols)
+			continue;
+		pg_datum_arrow_ref(kds, &kds->colmeta[j],
+						   run->row_index,
+						   values + j,
+						   isnull + j);
 	}
+	MemoryContextSwitchTo(oldcxt);
+
+	if (run->has_row &&
+		arrowSortedMergeCompare(merge,
+								run->values[run->curr],
+								run->isnull[run->curr],
+								values, isnull) > 0)
+		elog(ERROR, "arrow file '%s' is not sorted as 'sorted_by' option of foreign table '%s' declares",
+			 FilePathName(run->rb_state->fdesc),
+			 RelationGetRelationName(relation));
+	if (pds_prev)
+		PDS_release(pds_prev);
+	run->curr = next;
+	run->has_row = true;
+	run->row_index++;
+
+	return true;
 }
 
+/*
+ * arrowSortedMergeReset - releases the sorted runs
+ */
 static void
-arrowFdwSetupIOvectorField(arrowFdwSetupIOContext *con,
-						   RecordBatchFieldState *fstate,
-						   kern_data_store *kds,
-						   kern_colmeta *cmeta)
+arrowSortedMergeReset(arrowSortedMerge *merge)
 {
-	//int		index = cmeta - kds->colmeta;
+	int			k;
 
-	if (fstate->nullmap_length > 0)
+	for (k=0; k < merge->nruns; k++)
 	{
-		Assert(fstate->null_count > 0);
-		__setupIOvectorField(con,
-							 fstate->nullmap_offset,
-							 fstate->nullmap_length,
-							 &cmeta->nullmap_offset,
-							 &cmeta->nullmap_length);
-		//elog(INFO, "D%d att[%d] nullmap=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->nullmap_offset, fstate->nullmap_length, con->m_offset, con->f_offset);
+		if (merge->runs[k].pds)
+			PDS_release(merge->runs[k].pds);
 	}
-	if (fstate->values_length > 0)
+	MemoryContextReset(merge->memcxt);
+	merge->initialized = false;
+	merge->last_run = -1;
+	merge->heap = NULL;
+	merge->nruns = 0;
+	merge->runs = NULL;
+}
+
+/*
+ * arrowFdwIterateSortedMerge
+ */
+static TupleTableSlot *
+arrowFdwIterateSortedMerge(ForeignScanState *node)
+{
+	ArrowFdwState  *af_state = node->fdw_state;
+	arrowSortedMerge *merge = af_state->merge;
+	Relation		relation = node->ss.ss_currentRelation;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	EState		   *estate = node->ss.ps.state;
+	arrowSortedRun *run;
+	int				k;
+
+	if (!merge->initialized)
+	{
+		arrowSortedMergeBuildRuns(af_state, merge);
+		for (k=0; k < merge->nruns; k++)
+		{
+			if (arrowSortedRunNext(af_state, merge, &merge->runs[k],
+								   relation, estate))
+				binaryheap_add_unordered(merge->heap, Int32GetDatum(k));
+		}
+		binaryheap_build(merge->heap);
+		merge->initialized = true;
+	}
+	else if (merge->last_run >= 0)
+	{
+		run = &merge->runs[merge->last_run];
+		if (arrowSortedRunNext(af_state, merge, run, relation, estate))
+			binaryheap_replace_first(merge->heap,
+									 Int32GetDatum(merge->last_run));
+		else
+			(void) binaryheap_remove_first(merge->heap);
+	}
+
+	if (binaryheap_empty(merge->heap))
+	{
+		merge->last_run = -1;
+		return NULL;
+	}
+	k = DatumGetInt32(binaryheap_first(merge->heap));
+	merge->last_run = k;
+	run = &merge->runs[k];
+	ExecStoreAllNullTuple(slot);
+	memcpy(slot->tts_values, run->values[run->curr],
+		   sizeof(Datum) * merge->natts);
+	memcpy(slot->tts_isnull, run->isnull[run->curr],
+		   sizeof(bool) * merge->natts);
+	return slot;
+}
+
+/*
+ * arrowFdwCreateMetaAgg
+ */
+static int
+__arrowMetaAggQualCount(Node *qual)
+{
+	if (IsA(qual, BoolExpr) &&
+		((BoolExpr *)qual)->boolop == AND_EXPR)
 	{
-		__setupIOvectorField(con,
-							 fstate->values_offset,
-							 fstate->values_length,
-							 &cmeta->values_offset,
-							 &cmeta->values_length);
-		//elog(INFO, "D%d att[%d] values=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->values_offset, fstate->values_length, con->m_offset, con->f_offset);
+		ListCell   *lc;
+		int			count = 0;
+
+		foreach (lc, ((BoolExpr *)qual)->args)
+			count += __arrowMetaAggQualCount(lfirst(lc));
+		return count;
 	}
-	if (fstate->extra_length > 0)
+	return 1;
+}
+
+static arrowMetaAgg *
+arrowFdwCreateMetaAgg(ArrowFdwState *af_state,
+					  List *fdw_scan_tlist,
+					  Index scanrelid,
+					  TupleDesc tupdesc,
+					  PlanState *ps)
+{
+	arrowMetaAgg *magg;
+	Bitmapset  *part_attrs = NULL;
+	List	   *quals = NIL;
+	ListCell   *lc;
+	int			j, k = 0;
+
+	magg = palloc0(offsetof(arrowMetaAgg,
+							aggs[list_length(fdw_scan_tlist)]));
+	foreach (lc, fdw_scan_tlist)
 	{
-		__setupIOvectorField(con,
-							 fstate->extra_offset,
-							 fstate->extra_length,
-							 &cmeta->extra_offset,
-							 &cmeta->extra_length);
-		//elog(INFO, "D%d att[%d] extra=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->extra_offset, fstate->extra_length, con->m_offset, con->f_offset);
+		TargetEntry *tle = lfirst(lc);
+		Aggref	   *aggref = (Aggref *) tle->expr;
+		arrowMetaAggItem *item;
+		Oid			sortop = InvalidOid;
+
+		if (tle->resjunk)
+		{
+			quals = make_ands_implicit(tle->expr);
+			continue;
+		}
+		item = &magg->aggs[k++];
+		if (!IsA(aggref, Aggref) ||
+			(item->kind = arrowMetaAggKind(aggref, &sortop)) == 0)
+			elog(ERROR, "Bug? unexpected expression for metadata aggregation: %s",
+				 nodeToString(aggref));
+		if (item->kind != ARROW_META_AGG__COUNT_STAR)
+		{
+			TargetEntry *arg = linitial(aggref->args);
+
+			item->attidx = ((Var *) arg->expr)->varattno - 1;
+		}
+		if (item->kind == ARROW_META_AGG__MIN ||
+			item->kind == ARROW_META_AGG__MAX)
+		{
+			item->collid = aggref->inputcollid;
+			fmgr_info(get_opcode(sortop), &item->cmp_fn);
+			/* compute min/max statistics on the scan, if not available */
+			af_state->stats_attidx = bms_add_member(af_state->stats_attidx,
+													item->attidx);
+		}
 	}
+	magg->naggs = k;
 
-	/* nested sub-fields if composite types */
-	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
-		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	/*
+	 * Qualifiers only on the partition keys are already checked by the
+	 * file pruning or part_qual. The rest of qualifiers must be proven by
+	 * the hints; all the RecordBatch rows satisfy them if min/max statistics
+	 * and null-count say so.
+	 */
+	if (af_state->num_rbatches > 0)
 	{
-		kern_colmeta *subattr;
-		int		j;
+		RecordBatchState *rb_state = af_state->rbatches[0];
 
-		Assert(fstate->num_children == cmeta->num_subattrs);
-		con->depth++;
-		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
-			 j < cmeta->num_subattrs;
-			 j++, subattr++)
+		for (j=0; j < rb_state->ncols; j++)
 		{
-			RecordBatchFieldState *child = &fstate->children[j];
+			if (rb_state->columns[j].part_key)
+				part_attrs = bms_add_member(part_attrs, j + 1 -
+											FirstLowInvalidHeapAttributeNumber);
+		}
+	}
+	magg->quals_proven = true;
+	foreach (lc, quals)
+	{
+		Node	   *qual = lfirst(lc);
+		Bitmapset  *attrs = NULL;
+		List	   *hints;
 
-			arrowFdwSetupIOvectorField(con, child, kds, subattr);
+		pull_varattnos(qual, scanrelid, &attrs);
+		if (attrs && bms_is_subset(attrs, part_attrs))
+			continue;
+		hints = __buildArrowStatsHint(tupdesc, list_make1(qual), ps);
+		if (list_length(hints) != __arrowMetaAggQualCount(qual))
+		{
+			magg->quals_proven = false;
+			break;
 		}
-		con->depth--;
+		magg->hints = list_concat(magg->hints, hints);
 	}
+	if (quals != NIL)
+		magg->quals = ExecInitQual(quals, ps);
+	magg->base_slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	magg->memcxt = AllocSetContextCreate(CurrentMemoryContext,
+										 "arrow_fdw metadata aggregation",
+										 ALLOCSET_DEFAULT_SIZES);
+	return magg;
 }
 
 /*
- * arrowFdwSetupIOvector
+ * __arrowMetaAggFieldBounds - min/max values of the column in RecordBatch
  */
-static strom_io_vector *
-arrowFdwSetupIOvector(kern_data_store *kds,
-					  RecordBatchState *rb_state,
-					  Bitmapset *referenced)
+static bool
+__arrowMetaAggFieldBounds(RecordBatchFieldState *fstate,
+						  Datum *p_min, Datum *p_max)
 {
-	arrowFdwSetupIOContext *con;
-	strom_io_vector *iovec = NULL;
-	int			j, nr_chunks = 0;
-
-	Assert(kds->nr_colmeta >= kds->ncols);
-	con = alloca(offsetof(arrowFdwSetupIOContext,
-						  ioc[3 * kds->nr_colmeta]));
-	con->rb_offset = rb_state->rb_offset;
-	con->f_offset  = ~0UL;	/* invalid offset */
-	con->m_offset  = TYPEALIGN(PAGE_SIZE, KERN_DATA_STORE_HEAD_LENGTH(kds));
-	con->io_index  = -1;
-	for (j=0; j < kds->ncols; j++)
+	if (fstate->part_key)
 	{
-		RecordBatchFieldState *fstate = &rb_state->columns[j];
-		kern_colmeta *cmeta = &kds->colmeta[j];
-		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
-
-		if (referenced && bms_is_member(attidx, referenced))
-			arrowFdwSetupIOvectorField(con, fstate, kds, cmeta);
+		*p_min = *p_max = fstate->part_value;
+		return true;
 	}
-	if (con->io_index >= 0)
+	return (fstate->stat_valid &&
+			__arrowStatDatumToPG(fstate, &fstate->stat_min, p_min) &&
+			__arrowStatDatumToPG(fstate, &fstate->stat_max, p_max));
+}
+
+/*
+ * __arrowMetaAggQualsAllTrue
+ *
+ * It returns true, if all the rows in the RecordBatch satisfy the hints.
+ * It is the opposite of __arrowStatsHintCheckRecordBatch; the operator must
+ * be true on both of min and max, and no NULLs are allowed.
+ */
+static bool
+__arrowMetaAggQualsAllTrue(List *hints, RecordBatchState *rb_state)
+{
+	ListCell   *lc;
+
+	foreach (lc, hints)
 	{
-		/* close the last I/O chunks */
-		strom_io_chunk *ioc = &con->ioc[con->io_index];
+		arrowStatsHint *hint = lfirst(lc);
+		RecordBatchFieldState *fstate;
+		Datum		min, max;
 
-		ioc->nr_pages = (TYPEALIGN(PAGE_SIZE, con->f_offset) / PAGE_SIZE -
-						 ioc->fchunk_id);
-		con->m_offset = ioc->m_offset + PAGE_SIZE * ioc->nr_pages;
-		nr_chunks = con->io_index + 1;
+		if (hint->attidx >= rb_state->ncols)
+			return false;
+		fstate = &rb_state->columns[hint->attidx];
+		switch (hint->kind)
+		{
+			case ARROW_STATS_HINT__IS_NULL:
+				if (fstate->null_count < fstate->nitems)
+					return false;
+				break;
+			case ARROW_STATS_HINT__IS_NOT_NULL:
+				if (fstate->null_count > 0)
+					return false;
+				break;
+			case ARROW_STATS_HINT__OPERATOR:
+				if (hint->arg_isnull ||
+					fstate->null_count > 0 ||
+					!__arrowMetaAggFieldBounds(fstate, &min, &max))
+					return false;
+				if (OidIsValid(hint->min_fn.fn_oid) &&
+					!DatumGetBool(FunctionCall2Coll(&hint->min_fn,
+													hint->collid,
+													max,
+													hint->arg_value)))
+					return false;
+				if (OidIsValid(hint->max_fn.fn_oid) &&
+					!DatumGetBool(FunctionCall2Coll(&hint->max_fn,
+													hint->collid,
+													min,
+													hint->arg_value)))
+					return false;
+				break;
+			default:
+				elog(ERROR, "Bug? unknown ArrowStatsHint kind: %d",
+					 hint->kind);
+		}
 	}
-	kds->length = con->m_offset;
+	return true;
+}
 
-	iovec = palloc0(offsetof(strom_io_vector, ioc[nr_chunks]));
-	iovec->nr_chunks = nr_chunks;
-	if (nr_chunks > 0)
-		memcpy(iovec->ioc, con->ioc, sizeof(strom_io_chunk) * nr_chunks);
-	return iovec;
+static inline void
+__arrowMetaAggAdvance(arrowMetaAggItem *item, Datum datum)
+{
+	if (item->isnull ||
+		DatumGetBool(FunctionCall2Coll(&item->cmp_fn,
+									   item->collid,
+									   datum,
+									   item->value)))
+	{
+		item->value = datum;
+		item->isnull = false;
+	}
 }
 
 /*
- * __dump_kds_and_iovec - just for debug
+ * arrowMetaAggByMetadata - aggregates the RecordBatch by its metadata,
+ * or returns false if it has to be scanned.
  */
-static inline void
-__dump_kds_and_iovec(kern_data_store *kds, strom_io_vector *iovec)
+static bool
+arrowMetaAggByMetadata(arrowMetaAgg *magg, RecordBatchState *rb_state)
 {
-#if 0
-	int		j;
+	RecordBatchFieldState *fstate;
+	Datum		min, max;
+	int			k;
 
-	elog(INFO, "nchunks = %d", iovec->nr_chunks);
-	for (j=0; j < iovec->nr_chunks; j++)
+	if (!magg->quals_proven ||
+		!__arrowMetaAggQualsAllTrue(magg->hints, rb_state))
+		return false;
+	for (k=0; k < magg->naggs; k++)
 	{
-		strom_io_chunk *ioc = &iovec->ioc[j];
+		arrowMetaAggItem *item = &magg->aggs[k];
 
-		elog(INFO, "io[%d] [ m_offset=%lu, f_read=%lu...%lu, nr_pages=%u}",
-			 j,
-			 ioc->m_offset,
-			 ioc->fchunk_id * PAGE_SIZE,
-			 (ioc->fchunk_id + ioc->nr_pages) * PAGE_SIZE,
-			 ioc->nr_pages);
+		if (item->kind == ARROW_META_AGG__COUNT_STAR)
+			continue;
+		if (item->attidx >= rb_state->ncols)
+			return false;
+		fstate = &rb_state->columns[item->attidx];
+		if (item->kind != ARROW_META_AGG__COUNT &&
+			fstate->null_count < fstate->nitems &&
+			!__arrowMetaAggFieldBounds(fstate, &min, &max))
+			return false;
 	}
 
-	elog(INFO, "kds {length=%zu nitems=%u typeid=%u typmod=%u table_oid=%u}",
-		 kds->length, kds->nitems,
-		 kds->tdtypeid, kds->tdtypmod, kds->table_oid);
-	for (j=0; j < kds->nr_colmeta; j++)
+	for (k=0; k < magg->naggs; k++)
 	{
-		kern_colmeta *cmeta = &kds->colmeta[j];
-
-		elog(INFO, "%ccol[%d] nullmap=%lu,%lu values=%lu,%lu extra=%lu,%lu",
-			 j < kds->ncols ? ' ' : '*', j,
-			 __kds_unpack(cmeta->nullmap_offset),
-			 __kds_unpack(cmeta->nullmap_length),
-			 __kds_unpack(cmeta->values_offset),
-			 __kds_unpack(cmeta->values_length),
-			 __kds_unpack(cmeta->extra_offset),
-			 __kds_unpack(cmeta->extra_length));
+		arrowMetaAggItem *item = &magg->aggs[k];
 
+		if (item->kind == ARROW_META_AGG__COUNT_STAR)
+		{
+			item->count += rb_state->rb_nitems;
+			continue;
+		}
+		fstate = &rb_state->columns[item->attidx];
+		if (item->kind == ARROW_META_AGG__COUNT)
+			item->count += fstate->nitems - fstate->null_count;
+		else if (fstate->null_count < fstate->nitems)
+		{
+			__arrowMetaAggFieldBounds(fstate, &min, &max);
+			__arrowMetaAggAdvance(item, (item->kind == ARROW_META_AGG__MIN
+										 ? min : max));
+		}
 	}
-#endif
+	return true;
 }
 
 /*
- * arrowFdwLoadRecordBatch
+ * arrowMetaAggByScan - aggregates the RecordBatch by the rows
  */
-static pgstrom_data_store *
-__arrowFdwLoadRecordBatch(RecordBatchState *rb_state,
-						  Relation relation,
-						  Bitmapset *referenced,
-						  GpuContext *gcontext,
-						  MemoryContext mcontext,
-						  int optimal_gpu)
+static void
+arrowMetaAggByScan(ForeignScanState *node,
+				   arrowMetaAgg *magg,
+				   RecordBatchState *rb_state)
 {
-	TupleDesc			tupdesc = RelationGetDescr(relation);
+	ArrowFdwState  *af_state = node->fdw_state;
+	Relation		relation = node->ss.ss_currentRelation;
+	EState		   *estate = node->ss.ps.state;
+	ExprContext	   *econtext = node->ss.ps.ps_ExprContext;
+	TupleTableSlot *slot = magg->base_slot;
 	pgstrom_data_store *pds;
-	kern_data_store	   *kds;
-	strom_io_vector	   *iovec;
-	size_t				head_sz;
-	int					j, fdesc;
-	CUresult			rc;
+	kern_data_store *kds;
+	MemoryContext	oldcxt;
+	size_t			index;
+	int				j, k;
 
-	/* setup KDS and I/O-vector */
-	head_sz = KDS_calculateHeadSize(tupdesc);
-	kds = alloca(head_sz);
-	init_kernel_data_store(kds, tupdesc, 0, KDS_FORMAT_ARROW, 0);
-	kds->nitems = rb_state->rb_nitems;
-	kds->nrooms = rb_state->rb_nitems;
-	kds->table_oid = RelationGetRelid(relation);
-	Assert(head_sz == KERN_DATA_STORE_HEAD_LENGTH(kds));
-	for (j=0; j < kds->nr_colmeta; j++)
-		kds->colmeta[j].attopts = rb_state->columns[j].attopts;
-	iovec = arrowFdwSetupIOvector(kds, rb_state, referenced);
-	__dump_kds_and_iovec(kds, iovec);
+	pds = __arrowFdwLoadRecordBatch(rb_state,
+									relation,
+									af_state->referenced,
+									NULL,
+									estate->es_query_cxt,
+									-1,
+									NULL,
+									&af_state->dict_list);
+	/* compute min/max statistics lazily, for the further aggregations */
+	if (af_state->stats_attidx)
+		arrowFdwComputeFieldStats(af_state, rb_state, pds);
+	kds = &pds->kds;
+	for (index=0; index < kds->nitems; index++)
+	{
+		ExecStoreAllNullTuple(slot);
+		oldcxt = MemoryContextSwitchTo(magg->memcxt);
+		for (k = bms_next_member(af_state->referenced, -1);
+			 k >= 0;
+			 k = bms_next_member(af_state->referenced, k))
+		{
+			j = k + FirstLowInvalidHeapAttributeNumber - 1;
+			if (j < 0 || j >= kds->ncols)
+				continue;
+			pg_datum_arrow_ref(kds, &kds->colmeta[j], index,
+							   slot->tts_values + j,
+							   slot->tts_isnull + j);
+		}
+		MemoryContextSwitchTo(oldcxt);
 
-	fdesc = FileGetRawDesc(rb_state->fdesc);
-	/*
-	 * If SSD-to-GPU Direct SQL is available on the arrow file, setup a small
-	 * PDS on host-pinned memory, with strom_io_vector.
-	 */
-	if (gcontext &&
-		gcontext->cuda_dindex == optimal_gpu &&
-		iovec->nr_chunks > 0 &&
-		kds->length <= gpuMemAllocIOMapMaxLength())
+		econtext->ecxt_scantuple = slot;
+		if (!magg->quals || ExecQual(magg->quals, econtext))
+		{
+			for (k=0; k < magg->naggs; k++)
+			{
+				arrowMetaAggItem *item = &magg->aggs[k];
+
+				j = item->attidx;
+				switch (item->kind)
+				{
+					case ARROW_META_AGG__COUNT_STAR:
+						item->count++;
+						break;
+					case ARROW_META_AGG__COUNT:
+						if (!slot->tts_isnull[j])
+							item->count++;
+						break;
+					default:
+						if (!slot->tts_isnull[j])
+							__arrowMetaAggAdvance(item, slot->tts_values[j]);
+						break;
+				}
+			}
+		}
+		ResetExprContext(econtext);
+		MemoryContextReset(magg->memcxt);
+	}
+	PDS_release(pds);
+}
+
+/*
+ * arrowFdwIterateMetadataAgg
+ */
+static TupleTableSlot *
+arrowFdwIterateMetadataAgg(ForeignScanState *node)
+{
+	ArrowFdwState  *af_state = node->fdw_state;
+	arrowMetaAgg   *magg = af_state->metaagg;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	TupleDesc		tupdesc = slot->tts_tupleDescriptor;
+	ListCell	   *lc;
+	int				i, k;
+
+	if (magg->done)
+		return NULL;
+	magg->done = true;
+	for (k=0; k < magg->naggs; k++)
 	{
-		size_t	iovec_sz = offsetof(strom_io_vector, ioc[iovec->nr_chunks]);
+		magg->aggs[k].count = 0;
+		magg->aggs[k].value = 0;
+		magg->aggs[k].isnull = true;
+	}
+	/* evaluate the arguments of the hints once per scan */
+	if (magg->quals_proven && !magg->hints_ready)
+	{
+		ExprContext	   *econtext = af_state->econtext;
+		MemoryContext	oldcxt;
 
-		rc = gpuMemAllocHost(gcontext, (void **)&pds,
-							 offsetof(pgstrom_data_store, kds) +
-							 head_sz + iovec_sz);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on gpuMemAllocHost: %s", errorText(rc));
+		oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
+		foreach (lc, magg->hints)
+		{
+			arrowStatsHint *hint = lfirst(lc);
 
-		pds->gcontext = gcontext;
-		pg_atomic_init_u32(&pds->refcnt, 1);
-		pds->nblocks_uncached = 0;
-		pds->filedesc = fdesc;
-		pds->iovec = (strom_io_vector *)((char *)&pds->kds + head_sz);
-		memcpy(&pds->kds, kds, head_sz);
-		memcpy(pds->iovec, iovec, iovec_sz);
+			if (hint->arg)
+				hint->arg_value = ExecEvalExpr(hint->arg, econtext,
+											   &hint->arg_isnull);
+		}
+		MemoryContextSwitchTo(oldcxt);
+		magg->hints_ready = true;
+	}
+
+	for (i=0; i < af_state->num_rbatches; i++)
+	{
+		RecordBatchState *rb_state = af_state->rbatches[i];
+
+		if (arrowFdwSkipRecordBatch(af_state, rb_state))
+			continue;
+		if (arrowMetaAggByMetadata(magg, rb_state))
+			magg->nbatches_meta++;
+		else
+		{
+			arrowMetaAggByScan(node, magg, rb_state);
+			magg->nbatches_scan++;
+		}
 	}
-	else
+
+	ExecClearTuple(slot);
+	for (k=0; k < tupdesc->natts; k++)
 	{
-		/* Elsewhere, load RecordBatch by filesystem */
-		if (gcontext)
+		arrowMetaAggItem *item = &magg->aggs[k];
+
+		if (k >= magg->naggs)
 		{
-			rc = gpuMemAllocManaged(gcontext,
-									(CUdeviceptr *)&pds,
-									offsetof(pgstrom_data_store,
-											 kds) + kds->length,
-									CU_MEM_ATTACH_GLOBAL);
-			if (rc != CUDA_SUCCESS)
-				elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+			/* junk entry of the qualifiers */
+			slot->tts_values[k] = 0;
+			slot->tts_isnull[k] = true;
+		}
+		else if (item->kind == ARROW_META_AGG__COUNT_STAR ||
+				 item->kind == ARROW_META_AGG__COUNT)
+		{
+			slot->tts_values[k] = Int64GetDatum(item->count);
+			slot->tts_isnull[k] = false;
 		}
 		else
 		{
-			pds = MemoryContextAllocHuge(mcontext,
-										 offsetof(pgstrom_data_store,
-												  kds) + kds->length);
+			slot->tts_values[k] = item->value;
+			slot->tts_isnull[k] = item->isnull;
 		}
-		__PDS_fillup_arrow(pds, gcontext, kds, fdesc, iovec);
 	}
-	pfree(iovec);
-	return pds;
-}
-
-static pgstrom_data_store *
-arrowFdwLoadRecordBatch(ArrowFdwState *af_state,
-						Relation relation,
-						EState *estate,
-						GpuContext *gcontext,
-						int optimal_gpu)
-{
-	uint32		rb_index;
-
-	/* fetch next RecordBatch */
-	rb_index = pg_atomic_fetch_add_u32(af_state->rbatch_index, 1);
-	if (rb_index >= af_state->num_rbatches)
-		return NULL;	/* no more RecordBatch to read */
-
-	return __arrowFdwLoadRecordBatch(af_state->rbatches[rb_index],
-									 relation,
-									 af_state->referenced,
-									 gcontext,
-									 estate->es_query_cxt,
-									 optimal_gpu);
-}
-
-/*
- * ExecScanChunkArrowFdw
- */
-pgstrom_data_store *
-ExecScanChunkArrowFdw(GpuTaskState *gts)
-{
-	pgstrom_data_store *pds;
-
-	InstrStartNode(&gts->outer_instrument);
-	pds = arrowFdwLoadRecordBatch(gts->af_state,
-								  gts->css.ss.ss_currentRelation,
-								  gts->css.ss.ps.state,
-								  gts->gcontext,
-								  gts->optimal_gpu);
-	InstrStopNode(&gts->outer_instrument,
-				  !pds ? 0.0 : (double)pds->kds.nitems);
-	return pds;
+	return ExecStoreVirtualTuple(slot);
 }
 
 /*
@@ -1387,8 +6432,17 @@ ArrowIterateForeignScan(ForeignScanState *node)
 	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
 	pgstrom_data_store *pds;
 
+	if (af_state->metaagg)
+		return arrowFdwIterateMetadataAgg(node);
+	if (af_state->merge)
+		return arrowFdwIterateSortedMerge(node);
+
+	/*
+	 * Rows that never satisfy the scan qualifiers are skipped by the
+	 * vectorized evaluation, prior to the tuple materialization.
+	 */
 	while ((pds = af_state->curr_pds) == NULL ||
-		   af_state->curr_index >= pds->kds.nitems)
+		   !ArrowFdwFetchTuple(slot, af_state, pds, &af_state->curr_index))
 	{
 		EState	   *estate = node->ss.ps.state;
 
@@ -1403,10 +6457,7 @@ ArrowIterateForeignScan(ForeignScanState *node)
 		if (!af_state->curr_pds)
 			return NULL;
 	}
-	Assert(pds && af_state->curr_index < pds->kds.nitems);
-	if (KDS_fetch_tuple_arrow(slot, &pds->kds, af_state->curr_index++))
-		return slot;
-	return NULL;
+	return slot;
 }
 
 /*
@@ -1416,11 +6467,26 @@ void
 ExecReScanArrowFdw(ArrowFdwState *af_state)
 {
 	/* rewind the current scan state */
-	pg_atomic_write_u32(af_state->rbatch_index, 0);
+	pg_atomic_write_u32(&af_state->sstate->rbatch_index, 0);
+	af_state->stats_hint_ready = false;
+	af_state->vec_quals_ready = false;
+	af_state->sel_pds = NULL;
+	af_state->ra_head = 0;
+	af_state->ra_nitems = 0;
 	if (af_state->curr_pds)
 		PDS_release(af_state->curr_pds);
 	af_state->curr_pds = NULL;
 	af_state->curr_index = 0;
+	af_state->deform->kds = NULL;
+	af_state->deform->nrows = 0;
+	af_state->deform->pos = 0;
+	if (af_state->merge)
+		arrowSortedMergeReset(af_state->merge);
+	if (af_state->metaagg)
+	{
+		af_state->metaagg->done = false;
+		af_state->metaagg->hints_ready = false;
+	}
 }
 
 static void
@@ -1437,6 +6503,16 @@ ExecEndArrowFdw(ArrowFdwState *af_state)
 {
 	ListCell   *lc;
 
+	if (af_state->curr_pds)
+		PDS_release(af_state->curr_pds);
+	af_state->curr_pds = NULL;
+	if (af_state->merge)
+		arrowSortedMergeReset(af_state->merge);
+	if (af_state->metaagg)
+		ExecDropSingleTupleTableSlot(af_state->metaagg->base_slot);
+	foreach (lc, af_state->mmap_list)
+		ReleaseArrowFdwMmapState((ArrowFdwMmapState *)lfirst(lc));
+	af_state->mmap_list = NIL;
 	foreach (lc, af_state->fdescList)
 		FileClose((File)lfirst_int(lc));
 }
@@ -1480,6 +6556,108 @@ ExplainArrowFdw(ArrowFdwState *af_state, Relation frel, ExplainState *es)
 	}
 	ExplainPropertyText("referenced", buf.data, es);
 
+	/* shows files pruned by the partition keys */
+	if (af_state->nfiles_pruned > 0)
+		ExplainPropertyInteger("Partition pruned files",
+							   NULL, af_state->nfiles_pruned, es);
+
+	/* shows RecordBatches aggregated by the metadata */
+	if (af_state->metaagg)
+	{
+		arrowMetaAgg   *magg = af_state->metaagg;
+
+		ExplainPropertyText("Metadata aggregate",
+							RelationGetRelationName(frel), es);
+		if (es->analyze)
+		{
+			if (es->format == EXPLAIN_FORMAT_TEXT)
+			{
+				resetStringInfo(&buf);
+				appendStringInfo(&buf, "%u by metadata, %u scanned",
+								 magg->nbatches_meta,
+								 magg->nbatches_scan);
+				ExplainPropertyText("RecordBatches", buf.data, es);
+			}
+			else
+			{
+				ExplainPropertyInteger("RecordBatches by metadata",
+									   NULL, magg->nbatches_meta, es);
+				ExplainPropertyInteger("RecordBatches scanned",
+									   NULL, magg->nbatches_scan, es);
+			}
+		}
+	}
+
+	/* shows sort keys of the ordered scan */
+	if (af_state->merge)
+	{
+		arrowSortedMerge *merge = af_state->merge;
+
+		resetStringInfo(&buf);
+		foreach (lc, merge->sort_keys)
+		{
+			arrowSortKey *skey = lfirst(lc);
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, skey->attnum - 1);
+
+			if (buf.len > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfo(&buf, "%s%s",
+							 quote_identifier(NameStr(attr->attname)),
+							 skey->descending ? " DESC" : "");
+		}
+		ExplainPropertyText("Sorted merge", buf.data, es);
+		if (es->analyze && merge->initialized)
+			ExplainPropertyInteger("Sorted runs", NULL, merge->nruns, es);
+	}
+
+	/* shows RecordBatches skipped by min/max statistics */
+	if (es->analyze && (af_state->stats_hint != NIL ||
+						af_state->has_part_qual))
+	{
+		ArrowFdwSharedState *sstate = af_state->sstate;
+		uint32		nskips = pg_atomic_read_u32(&sstate->rbatch_nskips);
+		uint64		skip_sz = pg_atomic_read_u64(&sstate->rbatch_skip_sz);
+
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			resetStringInfo(&buf);
+			appendStringInfo(&buf, "%u of %u RecordBatches (size: %s)",
+							 nskips, af_state->num_rbatches,
+							 format_bytesz(skip_sz));
+			ExplainPropertyText("Stats-Hint skipped", buf.data, es);
+		}
+		else
+		{
+			ExplainPropertyInteger("Stats-Hint skipped RecordBatches",
+								   NULL, nskips, es);
+			ExplainPropertyInteger("Stats-Hint skipped size",
+								   "bytes", skip_sz, es);
+		}
+	}
+
+	/* shows read-ahead depth and stall time to load RecordBatches */
+	if (es->analyze)
+	{
+		ArrowFdwSharedState *sstate = af_state->sstate;
+		double		stall_ms = ((double)pg_atomic_read_u64(&sstate->rbatch_stall_us)
+								/ 1000.0);
+
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			resetStringInfo(&buf);
+			appendStringInfo(&buf, "depth: %d, stall: %.3f ms",
+							 af_state->ra_depth, stall_ms);
+			ExplainPropertyText("Read-ahead", buf.data, es);
+		}
+		else
+		{
+			ExplainPropertyInteger("Read-ahead depth",
+								   NULL, af_state->ra_depth, es);
+			ExplainPropertyFloat("Read-ahead stall",
+								 "ms", stall_ms, 3, es);
+		}
+	}
+
 	/* shows files on behalf of the foreign table */
 	foreach (lc, af_state->fdescList)
 	{
@@ -1581,64 +6759,169 @@ readArrowFile(const char *pathname, ArrowFileInfo *af_info, bool missing_ok)
 				(errcode_for_file_access(),
 				 errmsg("could not open file \"%s\": %m", pathname)));
 	}
-	readArrowFileDesc(FileGetRawDesc(filp), af_info);
+	if (!readParquetFileDesc(FileGetRawDesc(filp), af_info, NULL))
+		readArrowFileDesc(FileGetRawDesc(filp), af_info);
 	FileClose(filp);
 	return true;
 }
 
 /*
  * RecordBatchAcquireSampleRows - random sampling
+ *
+ * Rows to be sampled are chosen prior to the load, then only the row windows
+ * (ARROW_WINDOW_ALIGN_NROWS rows) that contain the samples are loaded, to
+ * avoid reading the entire RecordBatch. If the RecordBatch cannot be split
+ * (e.g, compressed), or the samples are dense, it is loaded at once.
  */
 static int
-RecordBatchAcquireSampleRows(Relation relation,
+__sampleRowIndexComp(const void *__a, const void *__b)
+{
+	uint32		a = *((const uint32 *)__a);
+	uint32		b = *((const uint32 *)__b);
+
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+static int
+__RecordBatchFetchSampleRows(Relation relation,
 							 RecordBatchState *rb_state,
-							 HeapTuple *rows,
-							 int nsamples)
+							 Bitmapset *referenced,
+							 List **p_dict_list,
+							 uint32 *samples, int nsamples,
+							 HeapTuple *rows)
 {
 	TupleDesc		tupdesc = RelationGetDescr(relation);
 	pgstrom_data_store *pds;
-	Bitmapset	   *referenced = NULL;
-	Datum		   *values;
-	bool		   *isnull;
-	int				count;
-	int				i, j, nwords;
+	Datum		   *values = alloca(sizeof(Datum) * tupdesc->natts);
+	bool		   *isnull = alloca(sizeof(bool)  * tupdesc->natts);
+	int				i, j;
 
-	/* ANALYZE needs to fetch all the attributes */
-	nwords = (tupdesc->natts - FirstLowInvalidHeapAttributeNumber +
-			  BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
-	referenced = alloca(offsetof(Bitmapset, words[nwords]));
-	referenced->nwords = nwords;
-	memset(referenced->words, -1, sizeof(bitmapword) * nwords);
-	
 	pds = __arrowFdwLoadRecordBatch(rb_state,
 									relation,
 									referenced,
 									NULL,
 									CurrentMemoryContext,
-									-1);
-	values = alloca(sizeof(Datum) * tupdesc->natts);
-	isnull = alloca(sizeof(bool)  * tupdesc->natts);
-	for (count = 0; count < nsamples; count++)
+									-1,
+									NULL,
+									p_dict_list);
+	for (i=0; i < nsamples; i++)
 	{
-		/* fetch a row randomly */
-		i = (double)pds->kds.nitems * (((double) random()) /
-									   ((double)MAX_RANDOM_VALUE + 1));
-		Assert(i < pds->kds.nitems);
+		size_t		index = samples[i] - rb_state->rb_row_start;
 
+		Assert(index < pds->kds.nitems);
 		for (j=0; j < pds->kds.ncols; j++)
 		{
 			kern_colmeta   *cmeta = &pds->kds.colmeta[j];
-			
+
 			pg_datum_arrow_ref(&pds->kds,
 							   cmeta,
-							   i,
+							   index,
 							   values + j,
 							   isnull + j);
 		}
-		rows[count] = heap_form_tuple(tupdesc, values, isnull);
+		rows[i] = heap_form_tuple(tupdesc, values, isnull);
 	}
 	PDS_release(pds);
 
+	return nsamples;
+}
+
+static int
+RecordBatchAcquireSampleRows(Relation relation,
+							 RecordBatchState *rb_state,
+							 HeapTuple *rows,
+							 int nsamples)
+{
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	Bitmapset	   *referenced = NULL;
+	List		   *dict_list = NIL;
+	uint32		   *samples;
+	size_t			rb_sz = offsetof(RecordBatchState,
+									 columns[rb_state->ncols]);
+	RecordBatchState *window = alloca(rb_sz);
+	int64			nwindows = 0;
+	int64			curr, prev = -1;
+	int				count = 0;
+	int				i, j, nwords;
+
+	/* ANALYZE needs to fetch all the attributes */
+	nwords = (tupdesc->natts - FirstLowInvalidHeapAttributeNumber +
+			  BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
+	referenced = alloca(offsetof(Bitmapset, words[nwords]));
+	referenced->nwords = nwords;
+	memset(referenced->words, -1, sizeof(bitmapword) * nwords);
+
+	/* choose rows to be sampled */
+	samples = palloc(sizeof(uint32) * nsamples);
+	for (i=0; i < nsamples; i++)
+	{
+		samples[i] = (double)rb_state->rb_nitems *
+			(((double) random()) / ((double)MAX_RANDOM_VALUE + 1));
+		Assert(samples[i] < rb_state->rb_nitems);
+	}
+	qsort(samples, nsamples, sizeof(uint32), __sampleRowIndexComp);
+	for (i=0; i < nsamples; i++)
+	{
+		curr = samples[i] / ARROW_WINDOW_ALIGN_NROWS;
+		if (curr != prev)
+			nwindows++;
+		prev = curr;
+	}
+
+	/* load the row windows that contain the samples */
+	if (nwindows * ARROW_WINDOW_ALIGN_NROWS < rb_state->rb_nitems / 2)
+	{
+		for (i=0; i < nsamples; i = j)
+		{
+			int64		row_start = TYPEALIGN_DOWN(ARROW_WINDOW_ALIGN_NROWS,
+												   samples[i]);
+			int			k;
+
+			memcpy(window, rb_state, rb_sz);
+			window->rb_window = true;
+			window->rb_rebase = false;
+			window->rb_row_start = row_start;
+			window->rb_nitems = Min(ARROW_WINDOW_ALIGN_NROWS,
+									rb_state->rb_nitems - row_start);
+			for (k=0; k < window->ncols; k++)
+			{
+				if (!setupRecordBatchFieldWindow(rb_state,
+												 &window->columns[k],
+												 row_start,
+												 window->rb_nitems,
+												 &window->rb_rebase))
+					break;
+			}
+			if (k < window->ncols)
+				break;		/* not possible to split */
+			for (j=i+1; j < nsamples; j++)
+			{
+				if (samples[j] >= row_start + window->rb_nitems)
+					break;
+			}
+			count += __RecordBatchFetchSampleRows(relation,
+												  window,
+												  referenced,
+												  &dict_list,
+												  samples + i, j - i,
+												  rows + i);
+		}
+	}
+	/* elsewhere, load the entire RecordBatch */
+	if (count < nsamples)
+		count += __RecordBatchFetchSampleRows(relation,
+											  rb_state,
+											  referenced,
+											  &dict_list,
+											  samples + count,
+											  nsamples - count,
+											  rows + count);
+	pfree(samples);
+
 	return count;
 }
 
@@ -1664,16 +6947,19 @@ ArrowAcquireSampleRows(Relation relation,
 	int64			count_nrows = 0;
 	int				nsamples_min = nrooms / 100;
 	int				nitems = 0;
+	const char	   *part_dir;
 
 	filesList = __arrowFdwExtractFilesList(ft->options,
 										   NULL,
 										   &writable);
+	part_dir = arrowFdwPartitionDir(ft->options);
 	foreach (lc, filesList)
 	{
 		char	   *fname = strVal(lfirst(lc));
 		File		fdesc;
 		List	   *rb_cached;
 		ListCell   *cell;
+		Const	  **part_consts = NULL;
 
 		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
         if (fdesc < 0)
@@ -1685,7 +6971,11 @@ ArrowAcquireSampleRows(Relation relation,
 		}
 		fdescList = lappend_int(fdescList, fdesc);
 		
+		if (part_dir)
+			part_consts = arrowFdwPartitionConsts(tupdesc, part_dir, fname);
 		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
+		rb_cached = arrowFdwRemapPartitionColumns(rb_cached, tupdesc,
+												  part_consts);
 		foreach (cell, rb_cached)
 		{
 			RecordBatchState *rb_state = lfirst(cell);
@@ -1764,6 +7054,24 @@ ArrowAnalyzeForeignTable(Relation frel,
 	return true;
 }
 
+/*
+ * arrowSchemaSortedBy - 'sorted_by' custom metadata of the schema, if any
+ */
+static const char *
+arrowSchemaSortedBy(ArrowSchema *schema)
+{
+	int		i;
+
+	for (i=0; i < schema->_num_custom_metadata; i++)
+	{
+		ArrowKeyValue *kv = &schema->custom_metadata[i];
+
+		if (kv->_key_len == 9 && strncmp(kv->key, "sorted_by", 9) == 0)
+			return pnstrdup(kv->value, kv->_value_len);
+	}
+	return NULL;
+}
+
 /*
  * ArrowImportForeignSchema
  */
@@ -1773,6 +7081,8 @@ ArrowImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	ArrowSchema	schema;
 	List	   *filesList;
 	ListCell   *lc;
+	const char *part_dir;
+	const char *sorted_by = NULL;
 	int			j;
 	StringInfoData	cmd;
 
@@ -1800,8 +7110,16 @@ ArrowImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	{
 		const char   *fname = strVal(lfirst(lc));
 		ArrowFileInfo af_info;
+		const char   *temp;
 
 		readArrowFile(fname, &af_info, false);
+		/* sort order is valid only if all the files declare the same */
+		temp = arrowSchemaSortedBy(&af_info.footer.schema);
+		if (lc == list_head(filesList))
+			sorted_by = temp;
+		else if (sorted_by && (!temp || strcmp(sorted_by, temp) != 0))
+			sorted_by = NULL;
+
 		if (lc == list_head(filesList))
 		{
 			copyArrowNode(&schema.node, &af_info.footer.schema.node);
@@ -1846,6 +7164,28 @@ ArrowImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 			appendStringInfo(&cmd, "  %s %s",
 							 quote_identifier(field->name), type_name);
 	}
+	/* partition keys in the path of the first file, as text columns */
+	part_dir = arrowFdwPartitionDir(stmt->options);
+	if (part_dir)
+	{
+		const char *fname = strVal(linitial(filesList));
+		const char *pos = fname + strlen(part_dir);
+		const char *tail;
+
+		while ((tail = strchr(pos, '/')) != NULL)
+		{
+			const char *sep = memchr(pos, '=', tail - pos);
+
+			if (sep && sep > pos)
+			{
+				char   *key = pnstrdup(pos, sep - pos);
+
+				appendStringInfo(&cmd, ",\n  %s text",
+								 quote_identifier(key));
+			}
+			pos = tail + 1;
+		}
+	}
 	appendStringInfo(&cmd,
 					 "\n"
 					 ") SERVER %s\n"
@@ -1859,7 +7199,12 @@ ArrowImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		appendStringInfo(&cmd, "%s '%s'",
 						 defel->defname,
 						 strVal(defel->arg));
+		if (strcmp(defel->defname, "sorted_by") == 0)
+			sorted_by = NULL;
 	}
+	/* sort order declared by the custom metadata, if not given */
+	if (sorted_by)
+		appendStringInfo(&cmd, ",\n           sorted_by '%s'", sorted_by);
 	appendStringInfo(&cmd, ")");
 
 	return list_make1(cmd.data);
@@ -1884,17 +7229,20 @@ ArrowEstimateDSMForeignScan(ForeignScanState *node,
 							ParallelContext *pcxt)
 {
 	//elog(INFO, "pid=%u ArrowEstimateDSMForeignScan", getpid());
-	return MAXALIGN(sizeof(pg_atomic_uint32));
+	return MAXALIGN(sizeof(ArrowFdwSharedState));
 }
 
 /*
  * ArrowInitializeDSMForeignScan
  */
 void
-ExecInitDSMArrowFdw(ArrowFdwState *af_state, pg_atomic_uint32 *rbatch_index)
+ExecInitDSMArrowFdw(ArrowFdwState *af_state, ArrowFdwSharedState *sstate)
 {
-	pg_atomic_init_u32(rbatch_index, 0);
-	af_state->rbatch_index = rbatch_index;
+	pg_atomic_init_u32(&sstate->rbatch_index, 0);
+	pg_atomic_init_u32(&sstate->rbatch_nskips, 0);
+	pg_atomic_init_u64(&sstate->rbatch_skip_sz, 0);
+	pg_atomic_init_u64(&sstate->rbatch_stall_us, 0);
+	af_state->sstate = sstate;
 }
 
 static void
@@ -1903,7 +7251,7 @@ ArrowInitializeDSMForeignScan(ForeignScanState *node,
 							  void *coordinate)
 {
 	ExecInitDSMArrowFdw((ArrowFdwState *)node->fdw_state,
-						(pg_atomic_uint32 *) coordinate);
+						(ArrowFdwSharedState *) coordinate);
 }
 
 /*
@@ -1912,7 +7260,12 @@ ArrowInitializeDSMForeignScan(ForeignScanState *node,
 void
 ExecReInitDSMArrowFdw(ArrowFdwState *af_state)
 {
-	pg_atomic_write_u32(af_state->rbatch_index, 0);
+	pg_atomic_write_u32(&af_state->sstate->rbatch_index, 0);
+	af_state->stats_hint_ready = false;
+	af_state->vec_quals_ready = false;
+	af_state->sel_pds = NULL;
+	af_state->ra_head = 0;
+	af_state->ra_nitems = 0;
 }
 
 
@@ -1929,9 +7282,9 @@ ArrowReInitializeDSMForeignScan(ForeignScanState *node,
  */
 void
 ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
-					   pg_atomic_uint32 *rbatch_index)
+					   ArrowFdwSharedState *sstate)
 {
-	af_state->rbatch_index = rbatch_index;
+	af_state->sstate = sstate;
 }
 
 static void
@@ -1940,16 +7293,32 @@ ArrowInitializeWorkerForeignScan(ForeignScanState *node,
 								 void *coordinate)
 {
 	ExecInitWorkerArrowFdw((ArrowFdwState *)node->fdw_state,
-						   (pg_atomic_uint32 *) coordinate);
+						   (ArrowFdwSharedState *) coordinate);
 }
 
 /*
  * ArrowShutdownForeignScan
+ *
+ * DSM shall be released prior to Explain callback, so we have to save the
+ * run-time statistics on the shutdown timing.
  */
 void
 ExecShutdownArrowFdw(ArrowFdwState *af_state)
 {
-	/* nothing to do */
+	ArrowFdwSharedState *sstate = af_state->sstate;
+	ArrowFdwSharedState *local = &af_state->__sstate_local;
+
+	if (sstate == local)
+		return;
+	pg_atomic_write_u32(&local->rbatch_index,
+						pg_atomic_read_u32(&sstate->rbatch_index));
+	pg_atomic_write_u32(&local->rbatch_nskips,
+						pg_atomic_read_u32(&sstate->rbatch_nskips));
+	pg_atomic_write_u64(&local->rbatch_skip_sz,
+						pg_atomic_read_u64(&sstate->rbatch_skip_sz));
+	pg_atomic_write_u64(&local->rbatch_stall_us,
+						pg_atomic_read_u64(&sstate->rbatch_stall_us));
+	af_state->sstate = local;
 }
 
 static void
@@ -1981,11 +7350,88 @@ ArrowPlanForeignModify(PlannerInfo *root,
 	if (!writable)
 		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
 			 get_rel_name(rte->relid));
-	Assert(list_length(filesList) == 1);
 
 	return NIL;
 }
 
+/*
+ * arrowFdwBeginInsert
+ *
+ * common portion of BeginForeignModify and BeginForeignInsert
+ */
+static arrowWriteState *
+arrowFdwBeginInsert(Relation frel)
+{
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
+	const char	   *fname;
+	File			filp;
+	bool			sharded;
+	bool			redo_log_written = false;
+
+	fname = arrowFdwWritableFile(ft->options, &sharded);
+	if (__arrowFdwLookupRedoLog(fname, true))
+		elog(ERROR, "arrow_fdw: file '%s' is already compacted in the current transaction",
+			 fname);
+	/*
+	 * A single backend file is written by only one transaction at a time.
+	 * Shard files are owned by individual backends, so RowExclusiveLock
+	 * already acquired by the executor is sufficient.
+	 */
+	if (!sharded)
+		LockRelation(frel, ShareRowExclusiveLock);
+
+	filp = PathNameOpenFile(fname, O_RDWR | PG_BINARY);
+	if (filp < 0)
+	{
+		if (errno != ENOENT)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", fname)));
+
+		filp = PathNameOpenFile(fname, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+		if (filp < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", fname)));
+		PG_TRY();
+		{
+			createArrowWriteRedoLog(filp, true);
+			redo_log_written = true;
+		}
+		PG_CATCH();
+		{
+			unlink(fname);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+	}
+	return createArrowWriteState(frel, filp, redo_log_written);
+}
+
+/*
+ * arrowFdwEndInsert
+ *
+ * common portion of EndForeignModify and EndForeignInsert
+ */
+static void
+arrowFdwEndInsert(arrowWriteState *aw_state, TupleDesc tupdesc)
+{
+	int		i;
+
+	arrowWriteFlushBatch(aw_state, tupdesc);
+	writeOutArrowRecordBatch(aw_state, true);
+
+	if (aw_state->batch_slots)
+	{
+		for (i=0; i < aw_state->batch_nrooms; i++)
+		{
+			if (aw_state->batch_slots[i])
+				ExecDropSingleTupleTableSlot(aw_state->batch_slots[i]);
+		}
+	}
+	MemoryContextDelete(aw_state->batch_memcxt);
+}
+
 /*
  * ArrowBeginForeignModify
  */
@@ -1996,45 +7442,43 @@ ArrowBeginForeignModify(ModifyTableState *mtstate,
 						int subplan_index,
 						int eflags)
 {
-	Relation		frel = rrinfo->ri_RelationDesc;
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
-	List		   *filesList = arrowFdwExtractFilesList(ft->options);
-	const char	   *fname;
-	File			filp;
-	bool			redo_log_written = false;
-
-	Assert(list_length(filesList) == 1);
-	fname = strVal(linitial(filesList));
+	rrinfo->ri_FdwState = arrowFdwBeginInsert(rrinfo->ri_RelationDesc);
+}
 
-	LockRelation(frel, ShareRowExclusiveLock);
+/*
+ * arrowWriteInsertSlot
+ *
+ * The supplied row is copied to the batch buffer, then appended to the
+ * SQLfield buffers column by column once the buffer gets filled up.
+ */
+static void
+arrowWriteInsertSlot(arrowWriteState *aw_state, TupleDesc tupdesc,
+					 TupleTableSlot *slot)
+{
+	TupleTableSlot *bslot;
+	MemoryContext	oldcxt;
 
-	filp = PathNameOpenFile(fname, O_RDWR | PG_BINARY);
-	if (filp < 0)
+	if (aw_state->batch_nrooms <= 1)
 	{
-		if (errno != ENOENT)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not open file \"%s\": %m", fname)));
+		arrowWriteAppendSlots(aw_state, tupdesc, &slot, 1);
+		return;
+	}
 
-		filp = PathNameOpenFile(fname, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
-		if (filp < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not open file \"%s\": %m", fname)));
-		PG_TRY();
-		{
-			createArrowWriteRedoLog(filp, true);
-			redo_log_written = true;
-		}
-		PG_CATCH();
-		{
-			unlink(fname);
-			PG_RE_THROW();
-		}
-		PG_END_TRY();
+	if (!aw_state->batch_slots)
+		aw_state->batch_slots = MemoryContextAllocZero(aw_state->memcxt,
+									sizeof(TupleTableSlot *) *
+									aw_state->batch_nrooms);
+	bslot = aw_state->batch_slots[aw_state->batch_nslots];
+	if (!bslot)
+	{
+		oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
+		bslot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+		MemoryContextSwitchTo(oldcxt);
+		aw_state->batch_slots[aw_state->batch_nslots] = bslot;
 	}
-	rrinfo->ri_FdwState = createArrowWriteState(frel, filp,
-												redo_log_written);
+	ExecCopySlot(bslot, slot);
+	if (++aw_state->batch_nslots >= aw_state->batch_nrooms)
+		arrowWriteFlushBatch(aw_state, tupdesc);
 }
 
 /*
@@ -2047,56 +7491,50 @@ ArrowExecForeignInsert(EState *estate,
 					   TupleTableSlot *planSlot)
 {
 	Relation		frel = rrinfo->ri_RelationDesc;
-	TupleDesc		tupdesc = RelationGetDescr(frel);
-	arrowWriteState *aw_state = rrinfo->ri_FdwState;
-	SQLtable	   *table = &aw_state->sql_table;
-	MemoryContext	oldcxt;
-	size_t			usage = 0;
-	int				j;
 
-	slot_getallattrs(slot);
-	oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
-	for (j=0; j < tupdesc->natts; j++)
-	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
-		SQLfield   *column = &table->columns[j];
-		Datum		datum = slot->tts_values[j];
-		bool		isnull = slot->tts_isnull[j];
+	arrowWriteInsertSlot(rrinfo->ri_FdwState,
+						 RelationGetDescr(frel), slot);
+	return slot;
+}
 
-		if (isnull)
-		{
-			usage += sql_field_put_value(column, NULL, 0);
-		}
-		else if (attr->attbyval)
-		{
-			Assert(column->sql_type.pgsql.typbyval);
-			usage += sql_field_put_value(column, (char *)&datum, attr->attlen);
-		}
-		else if (attr->attlen == -1)
-		{
-			int		vl_len = VARSIZE_ANY_EXHDR(datum);
-			char   *vl_ptr = VARDATA_ANY(datum);
+#if PG_VERSION_NUM >= 140000
+/*
+ * ArrowGetForeignModifyBatchSize
+ */
+static int
+ArrowGetForeignModifyBatchSize(ResultRelInfo *rrinfo)
+{
+	TriggerDesc	   *trigdesc = rrinfo->ri_TrigDesc;
 
-			Assert(column->sql_type.pgsql.typlen == -1);
-			usage += sql_field_put_value(column, vl_ptr, vl_len);
-		}
-		else
-		{
-			elog(ERROR, "Bug? unsupported type format");
-		}
-	}
-	table->nitems++;
-	MemoryContextSwitchTo(oldcxt);
+	/* RETURNING and row-level triggers need the row one by one */
+	if (rrinfo->ri_projectReturning != NULL ||
+		(trigdesc && (trigdesc->trig_insert_before_row ||
+					  trigdesc->trig_insert_after_row)))
+		return 1;
+	return Max(arrow_fdw_insert_batch_size, 1);
+}
 
-	/*
-	 * If usage exceeds the threshold of record-batch size, make a redo-log
-	 * on demand, and write out the buffer.
-	 */
-	if (usage > table->segment_sz)
-		writeOutArrowRecordBatch(aw_state, false);
+/*
+ * ArrowExecForeignBatchInsert
+ */
+static TupleTableSlot **
+ArrowExecForeignBatchInsert(EState *estate,
+							ResultRelInfo *rrinfo,
+							TupleTableSlot **slots,
+							TupleTableSlot **planSlots,
+							int *numSlots)
+{
+	Relation		frel = rrinfo->ri_RelationDesc;
+	TupleDesc		tupdesc = RelationGetDescr(frel);
+	arrowWriteState *aw_state = rrinfo->ri_FdwState;
 
-	return slot;
+	/* rows must be appended in order */
+	arrowWriteFlushBatch(aw_state, tupdesc);
+	arrowWriteAppendSlots(aw_state, tupdesc, slots, *numSlots);
+
+	return slots;
 }
+#endif
 
 /*
  * ArrowEndForeignModify
@@ -2105,10 +7543,47 @@ static void
 ArrowEndForeignModify(EState *estate,
 					  ResultRelInfo *rrinfo)
 {
-	arrowWriteState *aw_state = rrinfo->ri_FdwState;
+	arrowFdwEndInsert(rrinfo->ri_FdwState,
+					  RelationGetDescr(rrinfo->ri_RelationDesc));
+}
 
-	writeOutArrowRecordBatch(aw_state, true);
+#if PG_VERSION_NUM >= 110000
+/*
+ * ArrowBeginForeignInsert
+ *
+ * It is called on COPY FROM or tuple-routing to the partition leaf, without
+ * the planner callbacks of ForeignModify.
+ */
+static void
+ArrowBeginForeignInsert(ModifyTableState *mtstate,
+						ResultRelInfo *rrinfo)
+{
+	Relation		frel = rrinfo->ri_RelationDesc;
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
+	List		   *filesList	__attribute__((unused));
+	bool			writable;
+
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	if (!writable)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
+			 RelationGetRelationName(frel));
+
+	rrinfo->ri_FdwState = arrowFdwBeginInsert(frel);
+}
+
+/*
+ * ArrowEndForeignInsert
+ */
+static void
+ArrowEndForeignInsert(EState *estate,
+					  ResultRelInfo *rrinfo)
+{
+	arrowFdwEndInsert(rrinfo->ri_FdwState,
+					  RelationGetDescr(rrinfo->ri_RelationDesc));
 }
+#endif
 
 /*
  * ArrowExplainForeignModify
@@ -2611,6 +8086,12 @@ __arrowSchemaCompatibilityCheck(TupleDesc tupdesc,
 			if (attr->atttypid != fstate->atttypid)
 				return false;
 		}
+		else if (RecordBatchFieldIsDictionary(fstate))
+		{
+			/* children are chunks of the dictionary */
+			if (attr->atttypid != fstate->atttypid)
+				return false;
+		}
 		else
 		{
 			Form_pg_type	typ;
@@ -2704,6 +8185,31 @@ pg_varlena_arrow_ref(kern_data_store *kds,
 	return PointerGetDatum(res);
 }
 
+static bool
+pg_dictionary_arrow_ref(kern_data_store *kds,
+						kern_colmeta *cmeta, size_t index,
+						Datum *p_datum)
+{
+	char	   *values = (char *)kds + __kds_unpack(cmeta->values_offset);
+	arrowDictBuffer *dict;
+	struct varlena *res;
+	char	   *addr;
+	cl_uint		len;
+
+	if (cmeta->extra_offset == 0)
+		elog(ERROR, "Bug? dictionary is not loaded");
+	dict = (arrowDictBuffer *)((char *)kds + __kds_unpack(cmeta->extra_offset));
+	if (!__arrowDictBufferRef(dict, __arrowDictIndexRef(cmeta, values, index),
+							  &addr, &len))
+		return false;
+	res = palloc(VARHDRSZ + len);
+	SET_VARSIZE(res, VARHDRSZ + len);
+	memcpy(VARDATA(res), addr, len);
+	*p_datum = PointerGetDatum(res);
+
+	return true;
+}
+
 static Datum
 pg_bpchar_arrow_ref(kern_data_store *kds,
 					kern_colmeta *cmeta, size_t index)
@@ -2778,76 +8284,70 @@ pg_numeric_arrow_ref(kern_data_store *kds,
 	return PointerGetDatum(result);
 }
 
-static Datum
-pg_date_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
+/*
+ * __arrow_XXX_to_pg - unit conversion from the Arrow representation
+ *
+ * NOTE: these routines are also used to convert min/max statistics, so
+ * they must be consistent with the datum references.
+ */
+static inline DateADT
+__arrow_date_to_pg(cl_long ival, ArrowDateUnit unit)
 {
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
 	DateADT		dt;
 
-	switch (cmeta->attopts.date.unit)
+	switch (unit)
 	{
 		case ArrowDateUnit__Day:
-			dt = ((cl_uint *)base)[index];
+			dt = (DateADT) ival;
 			break;
 		case ArrowDateUnit__MilliSecond:
-			dt = ((cl_ulong *)base)[index] / 1000;
+			dt = (cl_ulong) ival / 1000;
 			break;
 		default:
 			elog(ERROR, "Bug? unexpected unit of Date type");
 	}
 	/* convert UNIX epoch to PostgreSQL epoch */
 	dt -= (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE);
-	return DateADTGetDatum(dt);
+	return dt;
 }
 
-static Datum
-pg_time_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
+static inline TimeADT
+__arrow_time_to_pg(cl_long ival, ArrowTimeUnit unit)
 {
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
-	TimeADT		tm;
-
-	switch (cmeta->attopts.time.unit)
+	switch (unit)
 	{
 		case ArrowTimeUnit__Second:
-			tm = ((cl_long)((cl_int *)base)[index]) * 1000000L;
-			break;
+			return ival * 1000000L;
 		case ArrowTimeUnit__MilliSecond:
-			tm = ((cl_long)((cl_int *)base)[index]) * 1000L;
-			break;
+			return ival * 1000L;
 		case ArrowTimeUnit__MicroSecond:
-			tm = ((cl_long *)base)[index];
-			break;
+			return ival;
 		case ArrowTimeUnit__NanoSecond:
-			tm = ((cl_ulong *)base)[index] / 1000L;
-			break;
+			return (cl_ulong) ival / 1000L;
 		default:
 			elog(ERROR, "Bug? unexpected unit of Time type");
 	}
-	return TimeADTGetDatum(tm);
+	return 0;	/* not reachable */
 }
 
-static Datum
-pg_timestamp_arrow_ref(kern_data_store *kds,
-					   kern_colmeta *cmeta, size_t index)
+static inline Timestamp
+__arrow_timestamp_to_pg(cl_long ival, ArrowTimeUnit unit)
 {
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
 	Timestamp	ts;
 
-	switch (cmeta->attopts.timestamp.unit)
+	switch (unit)
 	{
 		case ArrowTimeUnit__Second:
-			ts = ((cl_ulong *)base)[index] * 1000000UL;
+			ts = (cl_ulong) ival * 1000000UL;
 			break;
 		case ArrowTimeUnit__MilliSecond:
-			ts = ((cl_ulong *)base)[index] * 1000UL;
+			ts = (cl_ulong) ival * 1000UL;
 			break;
 		case ArrowTimeUnit__MicroSecond:
-			ts = ((cl_ulong *)base)[index];
+			ts = ival;
 			break;
 		case ArrowTimeUnit__NanoSecond:
-			ts = ((cl_ulong *)base)[index] / 1000UL;
+			ts = (cl_ulong) ival / 1000UL;
 			break;
 		default:
 			elog(ERROR, "Bug? unexpected unit of Timestamp type");
@@ -2855,7 +8355,49 @@ pg_timestamp_arrow_ref(kern_data_store *kds,
 	/* convert UNIX epoch to PostgreSQL epoch */
 	ts -= (POSTGRES_EPOCH_JDATE -
 		   UNIX_EPOCH_JDATE) * USECS_PER_DAY;
-	return TimestampGetDatum(ts);
+	return ts;
+}
+
+static Datum
+pg_date_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	cl_long		ival;
+
+	if (cmeta->attopts.date.unit == ArrowDateUnit__Day)
+		ival = ((cl_int *)base)[index];
+	else
+		ival = ((cl_long *)base)[index];
+	return DateADTGetDatum(__arrow_date_to_pg(ival,
+											  cmeta->attopts.date.unit));
+}
+
+static Datum
+pg_time_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	cl_long		ival;
+
+	if (cmeta->attopts.time.unit == ArrowTimeUnit__Second ||
+		cmeta->attopts.time.unit == ArrowTimeUnit__MilliSecond)
+		ival = ((cl_int *)base)[index];
+	else
+		ival = ((cl_long *)base)[index];
+	return TimeADTGetDatum(__arrow_time_to_pg(ival,
+											  cmeta->attopts.time.unit));
+}
+
+static Datum
+pg_timestamp_arrow_ref(kern_data_store *kds,
+					   kern_colmeta *cmeta, size_t index)
+{
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	cl_long		ival = ((cl_long *)base)[index];
+
+	return TimestampGetDatum(__arrow_timestamp_to_pg(ival,
+									cmeta->attopts.timestamp.unit));
 }
 
 static Datum
@@ -3063,7 +8605,10 @@ pg_datum_arrow_ref(kern_data_store *kds,
 				break;
 			case TEXTOID:
 			case BYTEAOID:
-				datum = pg_varlena_arrow_ref(kds, cmeta, index);
+				if (cmeta->attopts.dictionary.index_width == 0)
+					datum = pg_varlena_arrow_ref(kds, cmeta, index);
+				else if (!pg_dictionary_arrow_ref(kds, cmeta, index, &datum))
+					goto out;
 				break;
 			case BPCHAROID:
 				datum = pg_bpchar_arrow_ref(kds, cmeta, index);
@@ -3094,38 +8639,377 @@ pg_datum_arrow_ref(kern_data_store *kds,
 		}
 		isnull = false;
 	}
-out:
-	*p_datum  = datum;
-	*p_isnull = isnull;
+out:
+	*p_datum  = datum;
+	*p_isnull = isnull;
+}
+
+/*
+ * KDS_fetch_tuple_arrow
+ */
+bool
+KDS_fetch_tuple_arrow(TupleTableSlot *slot,
+					  kern_data_store *kds,
+					  size_t index)
+{
+	Datum  *values = slot->tts_values;
+	bool   *isnull = slot->tts_isnull;
+	int		j;
+
+	if (index >= kds->nitems)
+		return false;
+	ExecStoreAllNullTuple(slot);
+	for (j=0; j < kds->ncols; j++)
+	{
+		kern_colmeta   *cmeta = &kds->colmeta[j];
+
+		pg_datum_arrow_ref(kds, cmeta,
+						   index,
+						   values + j,
+						   isnull + j);
+	}
+	return true;
+}
+
+/*
+ * Column-at-a-time deform of KDS_FORMAT_ARROW
+ */
+#define __ARROW_DEFORM_FIXED(NAME,TYPE,TO_DATUM)						\
+	static void															\
+	__arrow_deform_##NAME(kern_data_store *kds,							\
+						  kern_colmeta *cmeta,							\
+						  const uint32 *rows, int nrows,				\
+						  Datum *values, bool *isnull)					\
+	{																	\
+		TYPE   *base = (TYPE *)((char *)kds +							\
+								__kds_unpack(cmeta->values_offset));	\
+		uint8  *nullmap = NULL;											\
+		int		i;														\
+																		\
+		if (cmeta->nullmap_offset != 0)									\
+			nullmap = (uint8 *)kds + __kds_unpack(cmeta->nullmap_offset); \
+		for (i=0; i < nrows; i++)										\
+		{																\
+			uint32	k = rows[i];										\
+																		\
+			if (nullmap && att_isnull(k, nullmap))						\
+			{															\
+				values[i] = 0;											\
+				isnull[i] = true;										\
+			}															\
+			else														\
+			{															\
+				values[i] = TO_DATUM(base[k]);							\
+				isnull[i] = false;										\
+			}															\
+		}																\
+	}
+
+#define __ARROW_DATE_DAY_TO_DATUM(X)					\
+	DateADTGetDatum((X) - (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE))
+#define __ARROW_TIMESTAMP_USEC_TO_DATUM(X)				\
+	TimestampGetDatum((X) - (POSTGRES_EPOCH_JDATE -		\
+							 UNIX_EPOCH_JDATE) * USECS_PER_DAY)
+
+__ARROW_DEFORM_FIXED(int2, cl_short, Int16GetDatum)
+__ARROW_DEFORM_FIXED(int4, cl_int,   Int32GetDatum)
+__ARROW_DEFORM_FIXED(int8, cl_long,  Int64GetDatum)
+__ARROW_DEFORM_FIXED(date_day, cl_int, __ARROW_DATE_DAY_TO_DATUM)
+__ARROW_DEFORM_FIXED(timestamp_usec, cl_long, __ARROW_TIMESTAMP_USEC_TO_DATUM)
+#undef __ARROW_DEFORM_FIXED
+
+static void
+__arrow_deform_varlena(kern_data_store *kds,
+					   kern_colmeta *cmeta,
+					   const uint32 *rows, int nrows,
+					   Datum *values, bool *isnull)
+{
+	uint8	   *nullmap = NULL;
+	int			i;
+
+	if (cmeta->nullmap_offset != 0)
+		nullmap = (uint8 *)kds + __kds_unpack(cmeta->nullmap_offset);
+	for (i=0; i < nrows; i++)
+	{
+		if (nullmap && att_isnull(rows[i], nullmap))
+		{
+			values[i] = 0;
+			isnull[i] = true;
+		}
+		else
+		{
+			values[i] = pg_varlena_arrow_ref(kds, cmeta, rows[i]);
+			isnull[i] = false;
+		}
+	}
+}
+
+static void
+__arrow_deform_bool(kern_data_store *kds,
+					kern_colmeta *cmeta,
+					const uint32 *rows, int nrows,
+					Datum *values, bool *isnull)
+{
+	uint8	   *nullmap = NULL;
+	int			i;
+
+	if (cmeta->nullmap_offset != 0)
+		nullmap = (uint8 *)kds + __kds_unpack(cmeta->nullmap_offset);
+	for (i=0; i < nrows; i++)
+	{
+		if (nullmap && att_isnull(rows[i], nullmap))
+		{
+			values[i] = 0;
+			isnull[i] = true;
+		}
+		else
+		{
+			values[i] = pg_bool_arrow_ref(kds, cmeta, rows[i]);
+			isnull[i] = false;
+		}
+	}
+}
+
+/* any other types, arrays and composite types */
+static void
+__arrow_deform_generic(kern_data_store *kds,
+					   kern_colmeta *cmeta,
+					   const uint32 *rows, int nrows,
+					   Datum *values, bool *isnull)
+{
+	int			i;
+
+	for (i=0; i < nrows; i++)
+		pg_datum_arrow_ref(kds, cmeta, rows[i], values + i, isnull + i);
+}
+
+static arrowDeformFn
+arrowFdwLookupDeformFn(kern_colmeta *cmeta)
+{
+	if (cmeta->atttypkind != TYPE_KIND__BASE)
+		return __arrow_deform_generic;
+	if (cmeta->values_offset == 0)
+		return NULL;		/* not loaded, always NULL */
+	switch (cmeta->atttypid)
+	{
+		case INT2OID:
+		case FLOAT2OID:
+			return __arrow_deform_int2;
+		case INT4OID:
+		case FLOAT4OID:
+			return __arrow_deform_int4;
+		case INT8OID:
+		case FLOAT8OID:
+			return __arrow_deform_int8;
+		case TEXTOID:
+		case BYTEAOID:
+			if (cmeta->attopts.dictionary.index_width == 0)
+				return __arrow_deform_varlena;
+			break;
+		case BOOLOID:
+			return __arrow_deform_bool;
+		case DATEOID:
+			if (cmeta->attopts.date.unit == ArrowDateUnit__Day)
+				return __arrow_deform_date_day;
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			if (cmeta->attopts.timestamp.unit == ArrowTimeUnit__MicroSecond)
+				return __arrow_deform_timestamp_usec;
+			break;
+		default:
+			break;
+	}
+	return __arrow_deform_generic;
+}
+
+static arrowDeformState *
+arrowFdwCreateDeformState(Bitmapset *referenced)
+{
+	arrowDeformState *dstate;
+	int			ncols_max = bms_num_members(referenced);
+
+	dstate = palloc0(offsetof(arrowDeformState, columns[ncols_max]));
+	dstate->values = palloc(sizeof(Datum) * ARROW_DEFORM_NROWS *
+							Max(ncols_max, 1));
+	dstate->isnull = palloc(sizeof(bool) * ARROW_DEFORM_NROWS *
+							Max(ncols_max, 1));
+	dstate->memcxt = AllocSetContextCreate(CurrentMemoryContext,
+										   "arrow_fdw deform",
+										   ALLOCSET_DEFAULT_SIZES);
+	dstate->ncols_max = ncols_max;
+
+	return dstate;
+}
+
+/*
+ * arrowFdwBindDeformState - binds extractors of the referenced columns
+ */
+static void
+arrowFdwBindDeformState(arrowDeformState *dstate,
+						Bitmapset *referenced,
+						kern_data_store *kds)
+{
+	int			j, k;
+
+	dstate->kds = kds;
+	dstate->ncols = 0;
+	for (k = bms_next_member(referenced, -1);
+		 k >= 0;
+		 k = bms_next_member(referenced, k))
+	{
+		kern_colmeta *cmeta;
+		arrowDeformFn deform_fn;
+
+		j = k + FirstLowInvalidHeapAttributeNumber - 1;
+		if (j < 0 || j >= kds->ncols)
+			continue;
+		cmeta = &kds->colmeta[j];
+		deform_fn = arrowFdwLookupDeformFn(cmeta);
+		if (!deform_fn)
+			continue;
+		Assert(dstate->ncols < dstate->ncols_max);
+		dstate->columns[dstate->ncols].attidx = j;
+		dstate->columns[dstate->ncols].cmeta = cmeta;
+		dstate->columns[dstate->ncols].deform_fn = deform_fn;
+		dstate->ncols++;
+	}
 }
 
 /*
- * KDS_fetch_tuple_arrow
+ * ArrowFdwFetchTuple
+ *
+ * It fetches the next row (>= *p_index) that may satisfy the scan qualifiers
+ * from the PDS. Only the referenced columns are deformed by a vector of rows;
+ * the other columns are NULL. *p_index is moved to the next row of the
+ * vector, so caller must not touch it except for reset to 0 on a new PDS.
  */
 bool
-KDS_fetch_tuple_arrow(TupleTableSlot *slot,
-					  kern_data_store *kds,
-					  size_t index)
+ArrowFdwFetchTuple(TupleTableSlot *slot,
+				   ArrowFdwState *af_state,
+				   pgstrom_data_store *pds,
+				   cl_long *p_index)
 {
-	Datum  *values = slot->tts_values;
-	bool   *isnull = slot->tts_isnull;
-	int		j;
+	arrowDeformState *dstate = af_state->deform;
+	kern_data_store *kds = &pds->kds;
+	Datum	   *values = slot->tts_values;
+	bool	   *isnull = slot->tts_isnull;
+	int			i, k;
 
-	if (index >= kds->nitems)
-		return false;
+	/* vector of other PDS or older position is no longer valid */
+	if (dstate->kds != kds || dstate->next_index != *p_index)
+		dstate->nrows = dstate->pos = 0;
+
+	if (dstate->pos >= dstate->nrows)
+	{
+		MemoryContext oldcxt;
+		cl_long		index = *p_index;
+		int			nrows = 0;
+
+		if (index == 0 || dstate->kds != kds)
+			arrowFdwBindDeformState(dstate, af_state->referenced, kds);
+		while (nrows < ARROW_DEFORM_NROWS)
+		{
+			index = ArrowFdwNextSelectedRow(af_state, pds, index);
+			if (index >= kds->nitems)
+				break;
+			dstate->rows[nrows++] = index++;
+		}
+		dstate->next_index = *p_index = index;
+		dstate->nrows = nrows;
+		dstate->pos = 0;
+		if (nrows == 0)
+			return false;
+
+		MemoryContextReset(dstate->memcxt);
+		oldcxt = MemoryContextSwitchTo(dstate->memcxt);
+		for (k=0; k < dstate->ncols; k++)
+		{
+			arrowDeformColumn *dcol = &dstate->columns[k];
+
+			dcol->deform_fn(kds, dcol->cmeta,
+							dstate->rows, nrows,
+							dstate->values + k * ARROW_DEFORM_NROWS,
+							dstate->isnull + k * ARROW_DEFORM_NROWS);
+		}
+		MemoryContextSwitchTo(oldcxt);
+	}
+	i = dstate->pos++;
 	ExecStoreAllNullTuple(slot);
-	for (j=0; j < kds->ncols; j++)
+	for (k=0; k < dstate->ncols; k++)
 	{
-		kern_colmeta   *cmeta = &kds->colmeta[j];
+		arrowDeformColumn *dcol = &dstate->columns[k];
 
-		pg_datum_arrow_ref(kds, cmeta,
-						   index,
-						   values + j,
-						   isnull + j);
+		values[dcol->attidx] = dstate->values[k * ARROW_DEFORM_NROWS + i];
+		isnull[dcol->attidx] = dstate->isnull[k * ARROW_DEFORM_NROWS + i];
 	}
 	return true;
 }
 
+/*
+ * arrowFdwScanDirectory
+ *
+ * It picks up files in the directory. If @partitioned, it also walks down
+ * the sub-directories (like 'key=value') recursively, but ignores files and
+ * directories whose names begin with '.' or '_', because they are usually
+ * hidden or temporary ones of the writer (e.g, '_SUCCESS').
+ */
+static List *
+arrowFdwScanDirectory(List *filesList,
+					  const char *dir_path,
+					  const char *dir_suffix,
+					  bool partitioned)
+{
+	struct dirent *dentry;
+	DIR	   *dir;
+	char   *temp;
+
+	dir = AllocateDir(dir_path);
+	while ((dentry = ReadDir(dir, dir_path)) != NULL)
+	{
+		if (strcmp(dentry->d_name, ".") == 0 ||
+			strcmp(dentry->d_name, "..") == 0)
+			continue;
+		if (partitioned)
+		{
+			struct stat	stat_buf;
+
+			if (dentry->d_name[0] == '.' ||
+				dentry->d_name[0] == '_')
+				continue;
+			temp = psprintf("%s/%s", dir_path, dentry->d_name);
+			if (stat(temp, &stat_buf) != 0)
+				elog(ERROR, "failed on stat('%s'): %m", temp);
+			if (S_ISDIR(stat_buf.st_mode))
+			{
+				filesList = arrowFdwScanDirectory(filesList, temp,
+												  dir_suffix, true);
+				pfree(temp);
+				continue;
+			}
+			pfree(temp);
+		}
+		if (dir_suffix)
+		{
+			int		dlen = strlen(dentry->d_name);
+			int		slen = strlen(dir_suffix);
+			int		diff;
+
+			if (dlen < 2 + slen)
+				continue;
+			diff = dlen - slen;
+			if (dentry->d_name[diff-1] != '.' ||
+				strcmp(dentry->d_name + diff, dir_suffix) != 0)
+				continue;
+		}
+		temp = psprintf("%s/%s", dir_path, dentry->d_name);
+		filesList = lappend(filesList, makeString(temp));
+	}
+	FreeDir(dir);
+
+	return filesList;
+}
+
 /*
  * arrowFdwExtractFilesList
  */
@@ -3140,6 +9024,9 @@ __arrowFdwExtractFilesList(List *options_list,
 	char	   *dir_suffix = NULL;
 	int			parallel_nworkers = -1;
 	bool		writable = false;	/* default: read-only */
+	bool		partitioned = false;
+	bool		sorted_by = false;
+	bool		compressed = false;
 
 	foreach (lc, options_list)
 	{
@@ -3188,54 +9075,65 @@ __arrowFdwExtractFilesList(List *options_list,
 		{
 			writable = defGetBoolean(defel);
 		}
+		else if (strcmp(defel->defname, "partitioned") == 0)
+		{
+			partitioned = defGetBoolean(defel);
+		}
+		else if (strcmp(defel->defname, "sorted_by") == 0)
+		{
+			/* only syntax checks here; columns are checked on planning */
+			sorted_by = (__arrowFdwParseSortedBy(strVal(defel->arg),
+												 NULL) != NIL);
+		}
+		else if (strcmp(defel->defname, "compression") == 0)
+		{
+			ArrowCompressionType codec;
+
+			compressed = lookupArrowCompressionCodec(strVal(defel->arg),
+													 &codec);
+		}
 		else
 			elog(ERROR, "arrow: unknown option (%s)", defel->defname);
 	}
 	if (dir_suffix && !dir_path)
 		elog(ERROR, "arrow: cannot use 'suffix' option without 'dir'");
+	if (partitioned && !dir_path)
+		elog(ERROR, "arrow: cannot use 'partitioned' option without 'dir'");
+	if (compressed && !writable)
+		elog(ERROR, "arrow: 'compression' option is valid only if 'writable'");
 
 	if (writable)
 	{
 		if (dir_path)
-			elog(ERROR, "arrow: 'dir_path' and 'writable' options are exclusive");
-		if (list_length(filesList) == 0)
-			elog(ERROR, "arrow: 'writable' needs a backend file specified by 'file' option");
-		if (list_length(filesList) > 1)
-			elog(ERROR, "arrow: 'writable' cannot use multiple backend files");
-	}
-
-	if (dir_path)
-	{
-		struct dirent *dentry;
-		DIR	   *dir;
-		char   *temp;
-
-		dir = AllocateDir(dir_path);
-		while ((dentry = ReadDir(dir, dir_path)) != NULL)
 		{
-			if (strcmp(dentry->d_name, ".") == 0 ||
-				strcmp(dentry->d_name, "..") == 0)
-				continue;
-			if (dir_suffix)
-			{
-				int		dlen = strlen(dentry->d_name);
-				int		slen = strlen(dir_suffix);
-				int		diff;
-
-				if (dlen < 2 + slen)
-					continue;
-				diff = dlen - slen;
-				if (dentry->d_name[diff-1] != '.' ||
-					strcmp(dentry->d_name + diff, dir_suffix) != 0)
-					continue;
-			}
-			temp = psprintf("%s/%s", dir_path, dentry->d_name);
-			filesList = lappend(filesList, makeString(temp));
+			/* each writer backend has its own shard file in the directory */
+			if (filesList != NIL)
+				elog(ERROR, "arrow: 'writable' with 'dir' option cannot use 'file' or 'files' options");
+			if (partitioned)
+				elog(ERROR, "arrow: 'partitioned' and 'writable' options are exclusive");
+			if (access(dir_path, R_OK | W_OK | X_OK) != 0)
+				elog(ERROR, "unable to create shard files in '%s': %m",
+					 dir_path);
+			if (!dir_suffix)
+				dir_suffix = ARROW_SHARD_DEFAULT_SUFFIX;
 		}
-		FreeDir(dir);
+		else
+		{
+			if (list_length(filesList) == 0)
+				elog(ERROR, "arrow: 'writable' needs a backend file specified by 'file' option");
+			if (list_length(filesList) > 1)
+				elog(ERROR, "arrow: 'writable' cannot use multiple backend files");
+		}
+		if (sorted_by)
+			elog(ERROR, "arrow: 'sorted_by' and 'writable' options are exclusive");
 	}
 
-	if (filesList == NIL)
+	if (dir_path)
+		filesList = arrowFdwScanDirectory(filesList, dir_path,
+										  dir_suffix, partitioned);
+
+	/* sharded directory may be empty until the first INSERT */
+	if (filesList == NIL && !(writable && dir_path))
 		elog(ERROR, "no files are configured on behalf of the arrow_fdw foreign table");
 	foreach (lc, filesList)
 	{
@@ -3279,6 +9177,416 @@ arrowFdwExtractFilesList(List *options_list)
 	return __arrowFdwExtractFilesList(options_list, NULL, NULL);
 }
 
+/*
+ * arrowFdwSortKeys
+ *
+ * 'sorted_by' option declares the RecordBatches are sorted by the columns,
+ * in the form of 'column [ASC|DESC], ...'. NULLs are placed on the last for
+ * ascending order, and on the head for descending order, like btree index.
+ * It returns a list of arrowSortKey, if @tupdesc is given; elsewhere, it
+ * checks only the syntax and returns a list of the column names.
+ */
+static List *
+__arrowFdwParseSortedBy(const char *sorted_by, TupleDesc tupdesc)
+{
+	char	   *temp = pstrdup(sorted_by);
+	char	   *tok, *pos;
+	char	   *saveptr;
+	List	   *results = NIL;
+	int			j;
+
+	for (tok = strtok_r(temp, ",", &saveptr);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &saveptr))
+	{
+		char	   *attname;
+		char	   *order;
+		bool		descending = false;
+		arrowSortKey *skey;
+		TypeCacheEntry *tcache;
+		Form_pg_attribute attr = NULL;
+
+		attname = strtok_r(tok, " \t\n\r", &pos);
+		if (!attname)
+			elog(ERROR, "arrow: 'sorted_by' option has an empty sort key");
+		order = strtok_r(NULL, " \t\n\r", &pos);
+		if (order)
+		{
+			if (pg_strcasecmp(order, "desc") == 0)
+				descending = true;
+			else if (pg_strcasecmp(order, "asc") != 0)
+				elog(ERROR, "arrow: unknown sort order \"%s\" in 'sorted_by' option",
+					 order);
+			if (strtok_r(NULL, " \t\n\r", &pos) != NULL)
+				elog(ERROR, "arrow: syntax error in 'sorted_by' option: %s",
+					 sorted_by);
+		}
+		if (!tupdesc)
+		{
+			results = lappend(results, makeString(pstrdup(attname)));
+			continue;
+		}
+
+		for (j=0; j < tupdesc->natts; j++)
+		{
+			attr = tupleDescAttr(tupdesc, j);
+			if (!attr->attisdropped &&
+				strcmp(NameStr(attr->attname), attname) == 0)
+				break;
+		}
+		if (j == tupdesc->natts)
+			elog(ERROR, "arrow: 'sorted_by' option references unknown column \"%s\"",
+				 attname);
+		tcache = lookup_type_cache(attr->atttypid,
+								   TYPECACHE_LT_OPR | TYPECACHE_GT_OPR);
+		skey = palloc0(sizeof(arrowSortKey));
+		skey->attnum = attr->attnum;
+		skey->atttypid = attr->atttypid;
+		skey->atttypmod = attr->atttypmod;
+		skey->attcollid = attr->attcollation;
+		skey->sortop = (descending ? tcache->gt_opr : tcache->lt_opr);
+		skey->descending = descending;
+		if (!OidIsValid(skey->sortop))
+			elog(ERROR, "arrow: column \"%s\" in 'sorted_by' option has no ordering operator",
+				 attname);
+		results = lappend(results, skey);
+	}
+	pfree(temp);
+
+	return results;
+}
+
+static List *
+arrowFdwSortKeys(List *options_list, TupleDesc tupdesc)
+{
+	ListCell   *lc;
+
+	foreach (lc, options_list)
+	{
+		DefElem	   *defel = lfirst(lc);
+
+		if (strcmp(defel->defname, "sorted_by") == 0)
+			return __arrowFdwParseSortedBy(strVal(defel->arg), tupdesc);
+	}
+	return NIL;
+}
+
+/*
+ * arrowFdwPartitionDir - returns the 'dir' option, if 'partitioned' is
+ * also configured; elsewhere NULL.
+ */
+static const char *
+arrowFdwPartitionDir(List *options_list)
+{
+	ListCell   *lc;
+	const char *dir_path = NULL;
+	bool		partitioned = false;
+
+	foreach (lc, options_list)
+	{
+		DefElem	   *defel = lfirst(lc);
+
+		if (strcmp(defel->defname, "dir") == 0)
+			dir_path = strVal(defel->arg);
+		else if (strcmp(defel->defname, "partitioned") == 0)
+			partitioned = defGetBoolean(defel);
+	}
+	return (partitioned ? dir_path : NULL);
+}
+
+/*
+ * arrowFdwWritableFile - returns the file to be written by the current
+ * backend. If 'writable' is configured with 'dir', every backend appends
+ * rows to its own shard file in the directory, so concurrent writers never
+ * share a file; *p_sharded is set in this case. Elsewhere, it is the only
+ * backend file given by either of 'file' or 'files' option.
+ */
+static char *
+arrowFdwWritableFile(List *options_list, bool *p_sharded)
+{
+	ListCell   *lc;
+	List	   *filesList;
+	const char *dir_path = NULL;
+	const char *dir_suffix = ARROW_SHARD_DEFAULT_SUFFIX;
+	bool		writable;
+
+	foreach (lc, options_list)
+	{
+		DefElem	   *defel = lfirst(lc);
+
+		if (strcmp(defel->defname, "dir") == 0)
+			dir_path = strVal(defel->arg);
+		else if (strcmp(defel->defname, "suffix") == 0)
+			dir_suffix = strVal(defel->arg);
+	}
+	*p_sharded = (dir_path != NULL);
+	if (dir_path)
+		return psprintf("%s/shard-%d.%s", dir_path, MyProcPid, dir_suffix);
+
+	filesList = __arrowFdwExtractFilesList(options_list, NULL, &writable);
+	if (!writable || list_length(filesList) != 1)
+		elog(ERROR, "arrow_fdw: no file to be written");
+	return pstrdup(strVal(linitial(filesList)));
+}
+
+/*
+ * Routines for partitioned directory
+ *
+ * Path components of the files in the form of 'key=value' (Hive-style) are
+ * values of the partition keys. Partition keys are the trailing columns of
+ * the foreign table that are not in the arrow files, and the names must be
+ * identical to the keys. They are appended to RecordBatchState as virtual
+ * columns without buffers, and their values are synthesized on the load.
+ */
+#define ARROW_HIVE_DEFAULT_PARTITION	"__HIVE_DEFAULT_PARTITION__"
+
+static bool
+__arrowFdwPartitionKeyValue(const char *dir_path, const char *fname,
+							const char *key, char **p_value)
+{
+	size_t		dlen = strlen(dir_path);
+	size_t		klen = strlen(key);
+	const char *pos;
+	const char *tail;
+
+	if (strncmp(fname, dir_path, dlen) != 0)
+		return false;
+	for (pos = fname + dlen; *pos == '/'; pos++);
+	/* the last component is the filename itself */
+	while ((tail = strchr(pos, '/')) != NULL)
+	{
+		if (tail - pos > (ssize_t) klen &&
+			strncmp(pos, key, klen) == 0 &&
+			pos[klen] == '=')
+		{
+			const char *src = pos + klen + 1;
+			char	   *value = palloc(tail - src + 1);
+			char	   *dst = value;
+
+			/* decode %XX escaped characters */
+			while (src < tail)
+			{
+				if (src[0] == '%' && src + 2 < tail &&
+					isxdigit(src[1]) && isxdigit(src[2]))
+				{
+					char	hex[3] = { src[1], src[2], '\0' };
+
+					*dst++ = (char) strtol(hex, NULL, 16);
+					src += 3;
+				}
+				else
+					*dst++ = *src++;
+			}
+			*dst = '\0';
+			if (strcmp(value, ARROW_HIVE_DEFAULT_PARTITION) == 0)
+			{
+				pfree(value);
+				value = NULL;
+			}
+			*p_value = value;
+			return true;
+		}
+		for (pos = tail; *pos == '/'; pos++);
+	}
+	return false;
+}
+
+/*
+ * arrowFdwPartitionConsts
+ *
+ * It returns an array of Const for each column; non-NULL, if the column is
+ * a partition key of the file. NULL shall be returned if no partition keys.
+ */
+static Const **
+arrowFdwPartitionConsts(TupleDesc tupdesc,
+						const char *dir_path,
+						const char *fname)
+{
+	Const	  **part_consts = NULL;
+	int			j;
+
+	for (j = tupdesc->natts - 1; j >= 0; j--)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		char	   *value;
+		Datum		datum = 0;
+		Oid			typinput;
+		Oid			typioparam;
+
+		if (attr->attisdropped)
+			continue;
+		if (!__arrowFdwPartitionKeyValue(dir_path, fname,
+										 NameStr(attr->attname), &value))
+			break;
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+			case DATEOID:
+			case TEXTOID:
+			case VARCHAROID:
+				break;
+			default:
+				elog(ERROR, "arrow_fdw: partition key '%s' has %s type; only int2/int4/int8/float4/float8/date/text/varchar are supported",
+					 NameStr(attr->attname),
+					 format_type_be(attr->atttypid));
+		}
+		if (value)
+		{
+			getTypeInputInfo(attr->atttypid, &typinput, &typioparam);
+			datum = OidInputFunctionCall(typinput, value,
+										 typioparam, attr->atttypmod);
+		}
+		if (!part_consts)
+			part_consts = palloc0(sizeof(Const *) * tupdesc->natts);
+		part_consts[j] = makeConst(attr->atttypid,
+								   attr->atttypmod,
+								   attr->attcollation,
+								   attr->attlen,
+								   datum,
+								   value == NULL,
+								   attr->attbyval);
+	}
+	return part_consts;
+}
+
+/*
+ * arrowFdwRemapPartitionColumns
+ *
+ * It appends virtual columns of the partition keys to the RecordBatchState
+ * of the metadata cache. If the arrow file has unexpected number of columns,
+ * it is left as is; then, schema compatibility checks shall raise an error.
+ */
+static List *
+arrowFdwRemapPartitionColumns(List *rb_cached,
+							  TupleDesc tupdesc,
+							  Const **part_consts)
+{
+	ListCell   *lc;
+	int			j;
+
+	if (!part_consts)
+		return rb_cached;
+	foreach (lc, rb_cached)
+	{
+		RecordBatchState *rb_state = lfirst(lc);
+		RecordBatchState *rb_temp;
+
+		if (rb_state->ncols >= tupdesc->natts)
+			continue;
+		for (j = rb_state->ncols; j < tupdesc->natts; j++)
+		{
+			if (!part_consts[j])
+				break;
+		}
+		if (j < tupdesc->natts)
+			continue;
+		/* children of the arrow columns still point the original one */
+		rb_temp = palloc0(offsetof(RecordBatchState,
+								   columns[tupdesc->natts]));
+		memcpy(rb_temp, rb_state,
+			   offsetof(RecordBatchState, columns[rb_state->ncols]));
+		rb_temp->ncols = tupdesc->natts;
+		for (j = rb_state->ncols; j < tupdesc->natts; j++)
+		{
+			RecordBatchFieldState *fstate = &rb_temp->columns[j];
+			Const	   *con = part_consts[j];
+
+			fstate->atttypid = con->consttype;
+			fstate->atttypmod = con->consttypmod;
+			if (con->consttype == DATEOID)
+				fstate->attopts.date.unit = ArrowDateUnit__Day;
+			fstate->nitems = rb_temp->rb_nitems;
+			fstate->null_count = (con->constisnull ? rb_temp->rb_nitems : 0);
+			fstate->values_unitsz = ARROW_VALUES__NONE;
+			fstate->stat_known = true;
+			fstate->part_key = true;
+			fstate->part_value = con->constvalue;
+		}
+		lfirst(lc) = rb_temp;
+	}
+	return rb_cached;
+}
+
+/*
+ * arrowFdwPartitionQuals
+ *
+ * It replaces references to the partition keys in @quals by the values of
+ * the file, then tries to evaluate them. If any of them is false, the file
+ * can be pruned (*p_refuted = true). Qualifiers that still depend on Params
+ * are returned, to be checked at the execution time.
+ */
+typedef struct
+{
+	int			natts;
+	Const	  **part_consts;
+} arrowPartitionQualContext;
+
+static Node *
+__arrowFdwPartitionQualMutator(Node *node, arrowPartitionQualContext *context)
+{
+	if (!node)
+		return NULL;
+	if (IsA(node, Var))
+	{
+		Var	   *var = (Var *) node;
+
+		if (!IS_SPECIAL_VARNO(var->varno) &&
+			var->varlevelsup == 0 &&
+			var->varattno > 0 &&
+			var->varattno <= context->natts &&
+			context->part_consts[var->varattno - 1] != NULL &&
+			context->part_consts[var->varattno - 1]->consttype == var->vartype)
+			return (Node *) copyObject(context->part_consts[var->varattno - 1]);
+	}
+	return expression_tree_mutator(node, __arrowFdwPartitionQualMutator,
+								   (void *) context);
+}
+
+static List *
+arrowFdwPartitionQuals(List *quals, TupleDesc tupdesc,
+					   Const **part_consts, bool *p_refuted)
+{
+	arrowPartitionQualContext context;
+	List	   *results = NIL;
+	ListCell   *lc;
+
+	*p_refuted = false;
+	if (!part_consts)
+		return NIL;
+	context.natts = tupdesc->natts;
+	context.part_consts = part_consts;
+	foreach (lc, quals)
+	{
+		Node	   *expr = lfirst(lc);
+
+		if (contain_volatile_functions(expr))
+			continue;
+		expr = __arrowFdwPartitionQualMutator(expr, &context);
+		if (contain_var_clause(expr) ||
+			equal(expr, lfirst(lc)))
+			continue;
+		expr = eval_const_expressions(NULL, expr);
+		if (IsA(expr, Const))
+		{
+			Const  *con = (Const *) expr;
+
+			if (con->constisnull || !DatumGetBool(con->constvalue))
+			{
+				*p_refuted = true;
+				list_free(results);
+				return NIL;
+			}
+		}
+		else
+			results = lappend(results, expr);
+	}
+	return results;
+}
+
 
 /*
  * validator of Arrow_Fdw
@@ -3344,6 +9652,7 @@ arrow_fdw_precheck_schema(Relation rel)
 	ForeignTable   *ft = GetForeignTable(RelationGetRelid(rel));
 	List		   *filesList;
 	ListCell	   *lc;
+	const char	   *part_dir;
 	bool			writable;
 	int				j;
 
@@ -3363,12 +9672,14 @@ arrow_fdw_precheck_schema(Relation rel)
 	filesList = __arrowFdwExtractFilesList(ft->options,
 										   NULL,
 										   &writable);
+	part_dir = arrowFdwPartitionDir(ft->options);
 	foreach (lc, filesList)
 	{
 		const char *fname = strVal(lfirst(lc));
 		File		filp;
 		List	   *rb_cached = NIL;
 		ListCell   *cell;
+		Const	  **part_consts = NULL;
 
 		filp = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
 		if (filp < 0)
@@ -3379,7 +9690,11 @@ arrow_fdw_precheck_schema(Relation rel)
 				 fname, RelationGetRelationName(rel));
 		}
 		/* check schema compatibility */
+		if (part_dir)
+			part_consts = arrowFdwPartitionConsts(tupdesc, part_dir, fname);
 		rb_cached = arrowLookupOrBuildMetadataCache(filp);
+		rb_cached = arrowFdwRemapPartitionColumns(rb_cached, tupdesc,
+												  part_consts);
 		foreach (cell, rb_cached)
 		{
 			RecordBatchState *rb_state = lfirst(cell);
@@ -3635,11 +9950,11 @@ __arrowBuildMetadataCache(List *rb_state_list, uint32 hash)
 	{
 		RecordBatchState *rbstate = lfirst(lc);
 
-		if (!mcache)
-			nfields = RecordBatchFieldCount(rbstate);
-		else
-			Assert(nfields == RecordBatchFieldCount(rbstate));
-
+		/*
+		 * NOTE: number of fields may be different for each RecordBatch,
+		 * if dictionary-encoded columns have delta dictionaries.
+		 */
+		nfields = RecordBatchFieldCount(rbstate);
 		sz = offsetof(arrowMetadataCache, fstate[nfields]);
 		mtemp = MemoryContextAllocZero(TopSharedMemoryContext, sz);
 		if (!mtemp)
@@ -3686,6 +10001,41 @@ __arrowBuildMetadataCache(List *rb_state_list, uint32 hash)
 }
 
 
+/*
+ * lookupArrowWriteMVCCFile
+ *
+ * NOTE: It must be called under shared or exclusive lock on lock_slots[]
+ */
+static arrowWriteMVCCFile *
+lookupArrowWriteMVCCFile(MetadataCacheKey *key, bool create)
+{
+	uint32		index = key->hash % ARROW_METADATA_HASH_NSLOTS;
+	dlist_head *mvcc_slot = &arrow_metadata_state->mvcc_slots[index];
+	arrowWriteMVCCFile *mvcc_file;
+	dlist_iter	iter;
+	int			i;
+
+	dlist_foreach(iter, mvcc_slot)
+	{
+		mvcc_file = dlist_container(arrowWriteMVCCFile, chain, iter.cur);
+		if (mvcc_file->key.st_dev == key->st_dev &&
+			mvcc_file->key.st_ino == key->st_ino)
+			return mvcc_file;
+	}
+	if (!create)
+		return NULL;
+
+	mvcc_file = MemoryContextAllocZero(TopSharedMemoryContext,
+									   sizeof(arrowWriteMVCCFile));
+	mvcc_file->key = *key;
+	mvcc_file->nitems = 0;
+	for (i=0; i < ARROW_MVCC_RB_NSLOTS; i++)
+		dlist_init(&mvcc_file->rb_slots[i]);
+	dlist_push_tail(mvcc_slot, &mvcc_file->chain);
+
+	return mvcc_file;
+}
+
 /*
  * checkArrowRecordBatchIsVisible
  *
@@ -3693,17 +10043,20 @@ __arrowBuildMetadataCache(List *rb_state_list, uint32 hash)
  */
 static bool
 checkArrowRecordBatchIsVisible(RecordBatchState *rbstate,
-							   dlist_head *mvcc_slot)
+							   arrowWriteMVCCFile *mvcc_file)
 {
+	dlist_head	   *rb_slot;
 	dlist_iter		iter;
 
-	dlist_foreach(iter, mvcc_slot)
+	/* no in-progress writes on the file */
+	if (!mvcc_file)
+		return true;
+	rb_slot = &mvcc_file->rb_slots[rbstate->rb_index % ARROW_MVCC_RB_NSLOTS];
+	dlist_foreach(iter, rb_slot)
 	{
 		arrowWriteMVCCLog  *mvcc = dlist_container(arrowWriteMVCCLog,
 												   chain, iter.cur);
-		if (mvcc->key.st_dev == rbstate->stat_buf.st_dev &&
-			mvcc->key.st_ino == rbstate->stat_buf.st_ino &&
-			mvcc->record_batch == rbstate->rb_index)
+		if (mvcc->record_batch == rbstate->rb_index)
 		{
 			if (TransactionIdIsCurrentTransactionId(mvcc->xid))
 				return true;
@@ -3714,6 +10067,449 @@ checkArrowRecordBatchIsVisible(RecordBatchState *rbstate,
 	return true;
 }
 
+/*
+ * arrowParseMetadataFromFile
+ *
+ * It reads the footer of the arrow file, then builds RecordBatchState for
+ * each RecordBatch. If Parquet file, it is built for each row group.
+ * If @resume_offset is positive, the file is in IPC streaming format, and
+ * only the RecordBatches behind the position are parsed. Their rb_index
+ * begins from @rb_base.
+ */
+static List *
+arrowParseMetadataFromFile(File fdesc, struct stat *stat_buf,
+						   size_t resume_offset, int rb_base)
+{
+	ArrowFileInfo	af_info;
+	ArrowSchema	   *schema = &af_info.footer.schema;
+	List		   *rb_state_list = NIL;
+	SQLstat		  **field_stats;
+	ParquetFileInfo	pq_info;
+	int				index, j, num_rbatches;
+
+	if (resume_offset == 0 &&
+		readParquetFileDesc(FileGetRawDesc(fdesc), &af_info, &pq_info))
+	{
+		/* a row group of Parquet file is handled like a RecordBatch */
+		for (index = 0; index < pq_info.num_row_groups; index++)
+		{
+			RecordBatchState *rb_state;
+
+			rb_state = makeRecordBatchStateParquet(schema, &pq_info,
+												   index, fdesc);
+			rb_state->fdesc = fdesc;
+			memcpy(&rb_state->stat_buf, stat_buf, sizeof(struct stat));
+			rb_state->rb_index = index;
+			rb_state_list = lappend(rb_state_list, rb_state);
+		}
+		return rb_state_list;
+	}
+	if (resume_offset == 0)
+		readArrowFileDesc(FileGetRawDesc(fdesc), &af_info);
+	else
+		readArrowStreamDesc(FileGetRawDesc(fdesc), &af_info, resume_offset);
+	if (af_info.recordBatches == NULL)
+		elog(DEBUG2, "arrow file '%s' contains no RecordBatch",
+			 FilePathName(fdesc));
+	/* min/max statistics embedded in the custom-metadata, if any */
+	num_rbatches = af_info.footer._num_recordBatches;
+	field_stats = palloc0(sizeof(SQLstat *) * schema->_num_fields);
+	for (j=0; j < schema->_num_fields && !af_info.is_stream; j++)
+	{
+		ArrowField *field = &schema->fields[j];
+
+		/* unsigned integers are not consistent with PG's datum */
+		if (field->type.node.tag == ArrowNodeTag__Int &&
+			!field->type.Int.is_signed)
+			continue;
+		field_stats[j] = readArrowFieldStat(field, num_rbatches);
+	}
+
+	for (index = 0; index < num_rbatches; index++)
+	{
+		RecordBatchState *rb_state;
+
+		rb_state = makeRecordBatchState(&af_info, index, fdesc);
+		rb_state->fdesc = fdesc;
+		memcpy(&rb_state->stat_buf, stat_buf, sizeof(struct stat));
+		rb_state->rb_index = rb_base + index;
+		for (j=0; j < rb_state->ncols; j++)
+		{
+			RecordBatchFieldState *fstate = &rb_state->columns[j];
+			SQLstat	   *stat;
+
+			if (!field_stats[j])
+				continue;
+			stat = &field_stats[j][index];
+			fstate->stat_known = true;
+			fstate->stat_valid = stat->is_valid;
+			fstate->stat_min = stat->min;
+			fstate->stat_max = stat->max;
+		}
+		rb_state_list = lappend(rb_state_list, rb_state);
+	}
+	return rb_state_list;
+}
+
+/*
+ * arrowStreamResumeOffset
+ *
+ * A file in IPC streaming format is usually written continuously by the
+ * collectors, with no footer. If the file just grows after the metadata
+ * cache was built, it returns the position next to the last RecordBatch
+ * in the cache; so, only the messages appended later need to be parsed.
+ * Elsewhere, it returns 0, and the entire file shall be parsed again.
+ */
+static size_t
+arrowStreamResumeOffset(arrowMetadataCache *mcache, File fdesc,
+						struct stat *stat_buf)
+{
+	char		signature[6];
+	size_t		tail;
+	dlist_iter	iter;
+	int			j;
+
+	if (stat_buf->st_size < mcache->stat_buf.st_size)
+		return 0;
+	if (pread(FileGetRawDesc(fdesc), signature, 6, 0) != 6 ||
+		memcmp(signature, "ARROW1", 6) == 0 ||
+		memcmp(signature, PARQUET_SIGNATURE, PARQUET_SIGNATURE_SZ) == 0)
+		return 0;
+	/* DictionaryBatch (incl. delta) may appear at any place of the stream */
+	for (j=0; j < mcache->ncols; j++)
+	{
+		if (RecordBatchFieldIsDictionary(&mcache->fstate[j]))
+			return 0;
+	}
+	tail = mcache->rb_offset + mcache->rb_length;
+	dlist_foreach(iter, &mcache->siblings)
+	{
+		arrowMetadataCache *__mcache
+			= dlist_container(arrowMetadataCache, chain, iter.cur);
+		tail = Max(tail, __mcache->rb_offset + __mcache->rb_length);
+	}
+	if (tail > stat_buf->st_size)
+		return 0;
+	return tail;
+}
+
+/*
+ * arrowMetadataCacheFilePath
+ */
+static void
+arrowMetadataCacheFilePath(char *path, struct stat *stat_buf)
+{
+	snprintf(path, MAXPGPATH, "%s/%016lx-%016lx.meta",
+			 ARROW_METADATA_CACHE_DIR,
+			 (uint64)stat_buf->st_dev,
+			 (uint64)stat_buf->st_ino);
+}
+
+/*
+ * arrowRemoveMetadataCacheFile
+ *
+ * It removes the persistent metadata cache of the arrow file, prior to
+ * the replacement or removal of the file. Once the inode is released,
+ * nobody can find out the cache file any more.
+ */
+static void
+arrowRemoveMetadataCacheFile(struct stat *stat_buf)
+{
+	char		path[MAXPGPATH];
+
+	arrowMetadataCacheFilePath(path, stat_buf);
+	if (unlink(path) != 0 && errno != ENOENT)
+		elog(LOG, "arrow_fdw: failed on unlink('%s'): %m", path);
+}
+
+static void
+arrowRemoveMetadataCacheFileByPath(const char *pathname)
+{
+	struct stat	stat_buf;
+
+	if (stat(pathname, &stat_buf) == 0)
+		arrowRemoveMetadataCacheFile(&stat_buf);
+}
+
+/*
+ * arrowPruneMetadataCacheFiles
+ *
+ * It removes the persistent metadata cache files whose arrow file is
+ * already removed or replaced, and the temporary files left by crash.
+ * It runs on the postmaster startup, so no backend uses the files yet.
+ */
+static void
+arrowPruneMetadataCacheFiles(void)
+{
+	DIR		   *dir;
+	struct dirent *dentry;
+	char		path[MAXPGPATH];
+	int			nremoved = 0;
+
+	dir = AllocateDir(ARROW_METADATA_CACHE_DIR);
+	if (!dir)
+	{
+		if (errno != ENOENT)
+			elog(LOG, "arrow_fdw: failed on opendir('%s'): %m",
+				 ARROW_METADATA_CACHE_DIR);
+		return;
+	}
+	while ((dentry = ReadDirExtended(dir, ARROW_METADATA_CACHE_DIR,
+									 LOG)) != NULL)
+	{
+		arrowMetadataFileHead head;
+		struct stat	stat_buf;
+		size_t		len = strlen(dentry->d_name);
+		bool		is_valid = false;
+		int			fd;
+
+		if (strcmp(dentry->d_name, ".") == 0 ||
+			strcmp(dentry->d_name, "..") == 0)
+			continue;
+		snprintf(path, MAXPGPATH, "%s/%s",
+				 ARROW_METADATA_CACHE_DIR, dentry->d_name);
+		if (len > 5 && strcmp(dentry->d_name + len - 5, ".meta") == 0 &&
+			(fd = open(path, O_RDONLY | PG_BINARY)) >= 0)
+		{
+			if (__readFile(fd, &head, sizeof(head)) == sizeof(head) &&
+				head.magic == ARROW_METADATA_CACHE_MAGIC &&
+				head.version == ARROW_METADATA_CACHE_VERSION &&
+				head.pathname[MAXPGPATH-1] == '\0' &&
+				stat(head.pathname, &stat_buf) == 0 &&
+				head.st_dev == (uint64)stat_buf.st_dev &&
+				head.st_ino == (uint64)stat_buf.st_ino &&
+				head.st_size == (int64)stat_buf.st_size &&
+				head.st_mtime_sec == (int64)stat_buf.st_mtim.tv_sec &&
+				head.st_mtime_nsec == (int64)stat_buf.st_mtim.tv_nsec)
+				is_valid = true;
+			close(fd);
+		}
+		if (!is_valid)
+		{
+			if (unlink(path) != 0)
+				elog(LOG, "arrow_fdw: failed on unlink('%s'): %m", path);
+			else
+				nremoved++;
+		}
+	}
+	FreeDir(dir);
+	if (nremoved > 0)
+		elog(LOG, "arrow_fdw: %d stale metadata cache files are removed",
+			 nremoved);
+}
+
+/*
+ * arrowLoadMetadataCacheFile
+ *
+ * It tries to load RecordBatchState of the arrow file from the persistent
+ * metadata cache. It returns false if no valid cache file exists.
+ */
+static bool
+arrowLoadMetadataCacheFile(File fdesc, struct stat *stat_buf,
+						   List **p_rb_state_list)
+{
+	char		path[MAXPGPATH];
+	struct stat	cache_stat;
+	arrowMetadataFileHead *head;
+	List	   *rb_state_list = NIL;
+	char	   *buffer;
+	char	   *pos, *tail;
+	int			fd, i, j;
+
+	if (!arrow_metadata_cache_persistent)
+		return false;
+
+	arrowMetadataCacheFilePath(path, stat_buf);
+	fd = open(path, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+		goto miss;
+	if (fstat(fd, &cache_stat) != 0 ||
+		cache_stat.st_size < sizeof(arrowMetadataFileHead))
+	{
+		close(fd);
+		goto miss;
+	}
+	buffer = palloc(cache_stat.st_size);
+	if (__readFile(fd, buffer, cache_stat.st_size) != cache_stat.st_size)
+	{
+		close(fd);
+		pfree(buffer);
+		goto miss;
+	}
+	close(fd);
+
+	/* is the cache file still valid? */
+	head = (arrowMetadataFileHead *) buffer;
+	if (head->magic != ARROW_METADATA_CACHE_MAGIC ||
+		head->version != ARROW_METADATA_CACHE_VERSION ||
+		head->fstate_sz != sizeof(RecordBatchFieldState) ||
+		head->st_dev != (uint64)stat_buf->st_dev ||
+		head->st_ino != (uint64)stat_buf->st_ino ||
+		head->st_size != (int64)stat_buf->st_size ||
+		head->st_mtime_sec != (int64)stat_buf->st_mtim.tv_sec ||
+		head->st_mtime_nsec != (int64)stat_buf->st_mtim.tv_nsec)
+	{
+		elog(DEBUG2, "arrow_fdw: persistent metadata cache for '%s' is stale",
+			 FilePathName(fdesc));
+		pfree(buffer);
+		goto miss;
+	}
+
+	pos = buffer + sizeof(arrowMetadataFileHead);
+	tail = buffer + cache_stat.st_size;
+	for (i=0; i < head->nrbatches; i++)
+	{
+		arrowMetadataFileItem *item = (arrowMetadataFileItem *) pos;
+		RecordBatchState *rb_state;
+
+		if (pos + sizeof(arrowMetadataFileItem) > tail ||
+			item->nfields < item->ncols ||
+			pos + sizeof(arrowMetadataFileItem) +
+			sizeof(RecordBatchFieldState) * item->nfields > tail)
+			goto corrupted;
+		pos += sizeof(arrowMetadataFileItem);
+
+		rb_state = palloc0(offsetof(RecordBatchState,
+									columns[item->nfields]));
+		rb_state->fdesc = fdesc;
+		memcpy(&rb_state->stat_buf, stat_buf, sizeof(struct stat));
+		rb_state->rb_index  = item->rb_index;
+		rb_state->rb_offset = item->rb_offset;
+		rb_state->rb_length = item->rb_length;
+		rb_state->rb_nitems = item->rb_nitems;
+		rb_state->ncols     = item->ncols;
+		memcpy(rb_state->columns, pos,
+			   sizeof(RecordBatchFieldState) * item->nfields);
+		pos += sizeof(RecordBatchFieldState) * item->nfields;
+		/* restore the @children pointers */
+		for (j=0; j < item->nfields; j++)
+		{
+			RecordBatchFieldState *fstate = &rb_state->columns[j];
+			uintptr_t	k = (uintptr_t) fstate->children;
+
+			if (fstate->num_children == 0)
+				fstate->children = NULL;
+			else if (k < item->ncols ||
+					 k + fstate->num_children > item->nfields)
+				goto corrupted;
+			else
+				fstate->children = rb_state->columns + k;
+		}
+		rb_state_list = lappend(rb_state_list, rb_state);
+	}
+	pfree(buffer);
+	pg_atomic_fetch_add_u64(&arrow_metadata_state->stat_disk_hits, 1);
+	*p_rb_state_list = rb_state_list;
+	return true;
+
+corrupted:
+	elog(LOG, "arrow_fdw: persistent metadata cache '%s' is corrupted", path);
+	list_free_deep(rb_state_list);
+	pfree(buffer);
+miss:
+	pg_atomic_fetch_add_u64(&arrow_metadata_state->stat_disk_misses, 1);
+	return false;
+}
+
+/*
+ * arrowWriteMetadataCacheFile
+ *
+ * It writes out RecordBatchState of the arrow file to the persistent
+ * metadata cache. Any errors are not fatal, because it is just a cache.
+ */
+static void
+arrowWriteMetadataCacheFile(File fdesc, struct stat *stat_buf,
+							List *rb_state_list)
+{
+	char		path[MAXPGPATH];
+	char		temp[MAXPGPATH];
+	arrowMetadataFileHead head;
+	StringInfoData buf;
+	ListCell   *lc;
+	int			fd, j;
+
+	if (!arrow_metadata_cache_persistent)
+		return;
+
+	memset(&head, 0, sizeof(arrowMetadataFileHead));
+	head.magic     = ARROW_METADATA_CACHE_MAGIC;
+	head.version   = ARROW_METADATA_CACHE_VERSION;
+	head.fstate_sz = sizeof(RecordBatchFieldState);
+	head.nrbatches = list_length(rb_state_list);
+	head.st_dev    = (uint64)stat_buf->st_dev;
+	head.st_ino    = (uint64)stat_buf->st_ino;
+	head.st_size   = (int64)stat_buf->st_size;
+	head.st_mtime_sec  = (int64)stat_buf->st_mtim.tv_sec;
+	head.st_mtime_nsec = (int64)stat_buf->st_mtim.tv_nsec;
+	strlcpy(head.pathname, FilePathName(fdesc), MAXPGPATH);
+
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf, (char *)&head, sizeof(head));
+	foreach (lc, rb_state_list)
+	{
+		RecordBatchState *rb_state = lfirst(lc);
+		arrowMetadataFileItem item;
+		RecordBatchFieldState *fstate;
+		int			nfields = RecordBatchFieldCount(rb_state);
+
+		memset(&item, 0, sizeof(arrowMetadataFileItem));
+		item.rb_index  = rb_state->rb_index;
+		item.ncols     = rb_state->ncols;
+		item.nfields   = nfields;
+		item.rb_offset = rb_state->rb_offset;
+		item.rb_length = rb_state->rb_length;
+		item.rb_nitems = rb_state->rb_nitems;
+		appendBinaryStringInfo(&buf, (char *)&item, sizeof(item));
+
+		/* flatten the nested fields, then save @children as index */
+		fstate = palloc(sizeof(RecordBatchFieldState) * nfields);
+		copyMetadataFieldCache(fstate, fstate + nfields,
+							   rb_state->ncols,
+							   rb_state->columns);
+		for (j=0; j < nfields; j++)
+		{
+			if (fstate[j].num_children > 0)
+				fstate[j].children = (RecordBatchFieldState *)
+					(uintptr_t)(fstate[j].children - fstate);
+		}
+		appendBinaryStringInfo(&buf, (char *)fstate,
+							   sizeof(RecordBatchFieldState) * nfields);
+		pfree(fstate);
+	}
+
+	/* write out to the temporary file, then rename */
+	arrowMetadataCacheFilePath(path, stat_buf);
+	snprintf(temp, MAXPGPATH, "%s.%d.tmp", path, MyProcPid);
+	fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY, 0600);
+	if (fd < 0 && errno == ENOENT)
+	{
+		mkdir(ARROW_METADATA_CACHE_DIR, S_IRWXU);
+		fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY, 0600);
+	}
+	if (fd < 0)
+	{
+		elog(LOG, "arrow_fdw: failed on open('%s'): %m", temp);
+		goto out;
+	}
+	if (__writeFile(fd, buf.data, buf.len) != buf.len)
+	{
+		elog(LOG, "arrow_fdw: failed on write('%s'): %m", temp);
+		close(fd);
+		unlink(temp);
+		goto out;
+	}
+	close(fd);
+	if (rename(temp, path) != 0)
+	{
+		elog(LOG, "arrow_fdw: failed on rename('%s','%s'): %m", temp, path);
+		unlink(temp);
+		goto out;
+	}
+	pg_atomic_fetch_add_u64(&arrow_metadata_state->stat_disk_writes, 1);
+out:
+	pfree(buf.data);
+}
+
 /*
  * arrowLookupOrBuildMetadataCache
  */
@@ -3725,13 +10521,22 @@ arrowLookupOrBuildMetadataCache(File fdesc)
 	uint32		index;
 	LWLock	   *lock;
 	dlist_head *hash_slot;
-	dlist_head *mvcc_slot;
+	arrowWriteMVCCFile *mvcc_file;
 	dlist_iter	iter1, iter2;
+	dlist_mutable_iter miter;
 	bool		has_exclusive = false;
+	bool		has_entry = false;
 	List	   *results = NIL;
+	List	   *rb_state_any = NIL;
+	List	   *rb_state_head = NIL;	/* cached part of the stream */
+	size_t		resume_offset = 0;
+	ListCell   *lc;
 
 	if (fstat(FileGetRawDesc(fdesc), &stat_buf) != 0)
 		elog(ERROR, "failed on fstat('%s'): %m", FilePathName(fdesc));
+	/* a shard file just created by concurrent writer has nothing yet */
+	if (stat_buf.st_size == 0)
+		return NIL;
 
 	memset(&key, 0, sizeof(key));
 	key.st_dev	= stat_buf.st_dev;
@@ -3741,10 +10546,10 @@ arrowLookupOrBuildMetadataCache(File fdesc)
 	index = key.hash % ARROW_METADATA_HASH_NSLOTS;
 	lock = &arrow_metadata_state->lock_slots[index];
 	hash_slot = &arrow_metadata_state->hash_slots[index];
-	mvcc_slot = &arrow_metadata_state->mvcc_slots[index];
 
 	LWLockAcquire(lock, LW_SHARED);
 retry:
+	mvcc_file = lookupArrowWriteMVCCFile(&key, false);
 	dlist_foreach(iter1, hash_slot)
 	{
 		arrowMetadataCache *mcache
@@ -3780,6 +10585,30 @@ retry:
 				for (tail=buf4+strlen(buf4)-1; isspace(*tail); *tail--='\0');
 				elog(DEBUG2, "arrow_fdw: metadata cache for '%s' (m:%s, c:%s) is older than the latest file (m:%s, c:%s), so invalidated",
 					 FilePathName(fdesc), buf1, buf2, buf3, buf4);
+				/* stream just grown? then, parse only the tail */
+				resume_offset = arrowStreamResumeOffset(mcache, fdesc,
+														&stat_buf);
+				if (resume_offset > 0)
+				{
+					rbstate = makeRecordBatchStateFromCache(mcache, fdesc);
+					rb_state_head = list_make1(rbstate);
+					dlist_foreach (iter2, &mcache->siblings)
+					{
+						arrowMetadataCache *__mcache
+							= dlist_container(arrowMetadataCache,
+											  chain, iter2.cur);
+						rbstate = makeRecordBatchStateFromCache(__mcache,
+																fdesc);
+						rb_state_head = lappend(rb_state_head, rbstate);
+					}
+					foreach (lc, rb_state_head)
+					{
+						rbstate = lfirst(lc);
+						memcpy(&rbstate->stat_buf, &stat_buf,
+							   sizeof(struct stat));
+					}
+				}
+				arrowRemoveMetadataCacheFile(&mcache->stat_buf);
 				arrowInvalidateMetadataCache(mcache, true);
 				break;
 			}
@@ -3787,14 +10616,14 @@ retry:
 			 * Ok, arrow file metadata cache found and still valid
 			 */
 			rbstate = makeRecordBatchStateFromCache(mcache, fdesc);
-			if (checkArrowRecordBatchIsVisible(rbstate, mvcc_slot))
+			if (checkArrowRecordBatchIsVisible(rbstate, mvcc_file))
 				results = list_make1(rbstate);
 			dlist_foreach (iter2, &mcache->siblings)
 			{
 				arrowMetadataCache *__mcache
 					= dlist_container(arrowMetadataCache, chain, iter2.cur);
 				rbstate = makeRecordBatchStateFromCache(__mcache, fdesc);
-				if (checkArrowRecordBatchIsVisible(rbstate, mvcc_slot))
+				if (checkArrowRecordBatchIsVisible(rbstate, mvcc_file))
 					results = lappend(results, rbstate);
 			}
 			SpinLockAcquire(&arrow_metadata_state->lru_lock);
@@ -3802,55 +10631,69 @@ retry:
 							&mcache->lru_chain);
 			SpinLockRelease(&arrow_metadata_state->lru_lock);
 			LWLockRelease(lock);
+			pg_atomic_fetch_add_u64(&arrow_metadata_state->stat_shmem_hits, 1);
 
 			return results;
 		}
 	}
 
 	/*
-	 * Hmm... no valid metadata cache was not found, so build a new entry
-	 * under the exclusive lock on the arrow file.
+	 * Hmm... no valid metadata cache was not found, so build a new entry.
+	 * Parsing the file is not cheap; Parquet file may need to decode the
+	 * column chunks, so it runs without the lock, to avoid blocking the
+	 * concurrent backends that look up other files in the same slot.
 	 */
-	if (!has_exclusive)
+	LWLockRelease(lock);
+	pg_atomic_fetch_add_u64(&arrow_metadata_state->stat_shmem_misses, 1);
+	if (resume_offset > 0)
 	{
-		LWLockRelease(lock);
-		LWLockAcquire(lock, LW_EXCLUSIVE);
-		has_exclusive = true;
-		goto retry;
+		List   *rb_state_tail
+			= arrowParseMetadataFromFile(fdesc, &stat_buf,
+										 resume_offset,
+										 list_length(rb_state_head));
+		elog(DEBUG2, "arrow_fdw: stream '%s' has %d new RecordBatches behind offset %zu",
+			 FilePathName(fdesc), list_length(rb_state_tail),
+			 resume_offset);
+		rb_state_any = list_concat(rb_state_head, rb_state_tail);
+		arrowWriteMetadataCacheFile(fdesc, &stat_buf, rb_state_any);
 	}
-	else
+	else if (!arrowLoadMetadataCacheFile(fdesc, &stat_buf, &rb_state_any))
 	{
-		ArrowFileInfo	af_info;
-		arrowMetadataCache *mcache;
-		List		   *rb_state_any = NIL;
+		rb_state_any = arrowParseMetadataFromFile(fdesc, &stat_buf, 0, 0);
+		arrowWriteMetadataCacheFile(fdesc, &stat_buf, rb_state_any);
+	}
 
-		readArrowFileDesc(FileGetRawDesc(fdesc), &af_info);
-		if (af_info.dictionaries != NULL)
-			elog(ERROR, "DictionaryBatch is not supported");
-		Assert(af_info.footer._num_dictionaries == 0);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	mvcc_file = lookupArrowWriteMVCCFile(&key, false);
+	foreach (lc, rb_state_any)
+	{
+		RecordBatchState *rb_state = lfirst(lc);
 
-		if (af_info.recordBatches == NULL)
-			elog(DEBUG2, "arrow file '%s' contains no RecordBatch",
-				 FilePathName(fdesc));
-		for (index = 0; index < af_info.footer._num_recordBatches; index++)
+		if (checkArrowRecordBatchIsVisible(rb_state, mvcc_file))
+			results = lappend(results, rb_state);
+	}
+	/* concurrent backend may build the entry during the parse */
+	dlist_foreach_modify(miter, hash_slot)
+	{
+		arrowMetadataCache *mcache
+			= dlist_container(arrowMetadataCache, chain, miter.cur);
+		if (mcache->stat_buf.st_dev == stat_buf.st_dev &&
+			mcache->stat_buf.st_ino == stat_buf.st_ino)
 		{
-			RecordBatchState *rb_state;
-			ArrowBlock       *block
-				= &af_info.footer.recordBatches[index];
-			ArrowRecordBatch *rbatch
-				= &af_info.recordBatches[index].body.recordBatch;
-
-			rb_state = makeRecordBatchState(&af_info.footer.schema,
-											block, rbatch);
-			rb_state->fdesc = fdesc;
-			memcpy(&rb_state->stat_buf, &stat_buf, sizeof(struct stat));
-			rb_state->rb_index = index;
-
-			if (checkArrowRecordBatchIsVisible(rb_state, mvcc_slot))
-				results = lappend(results, rb_state);
-			rb_state_any = lappend(rb_state_any, rb_state);
+			if (timespec_comp(&mcache->stat_buf.st_mtim,
+							  &stat_buf.st_mtim) < 0 ||
+				timespec_comp(&mcache->stat_buf.st_ctim,
+							  &stat_buf.st_ctim) < 0)
+				arrowInvalidateMetadataCache(mcache, true);
+			else
+				has_entry = true;
 		}
-		/* try to build a metadata cache for further references */
+	}
+	/* try to build a metadata cache for further references */
+	if (!has_entry)
+	{
+		arrowMetadataCache *mcache;
+
 		mcache = __arrowBuildMetadataCache(rb_state_any, key.hash);
 		if (mcache)
 		{
@@ -3871,6 +10714,77 @@ retry:
 	return results;
 }
 
+/*
+ * arrowUpdateMetadataCacheFieldStat
+ *
+ * It saves min/max statistics computed on the fly to the metadata cache,
+ * for further scans on the same arrow file.
+ */
+static void
+arrowUpdateMetadataCacheFieldStat(RecordBatchState *rb_state, int attidx)
+{
+	RecordBatchFieldState *fstate = &rb_state->columns[attidx];
+	MetadataCacheKey key;
+	uint32		index;
+	LWLock	   *lock;
+	dlist_head *hash_slot;
+	dlist_iter	iter1, iter2;
+
+	memset(&key, 0, sizeof(key));
+	key.st_dev	= rb_state->stat_buf.st_dev;
+	key.st_ino	= rb_state->stat_buf.st_ino;
+	key.hash = hash_any((unsigned char *)&key,
+						offsetof(MetadataCacheKey, hash));
+	index = key.hash % ARROW_METADATA_HASH_NSLOTS;
+	lock = &arrow_metadata_state->lock_slots[index];
+	hash_slot = &arrow_metadata_state->hash_slots[index];
+
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	dlist_foreach(iter1, hash_slot)
+	{
+		arrowMetadataCache *mcache
+			= dlist_container(arrowMetadataCache, chain, iter1.cur);
+		arrowMetadataCache *mtarget = NULL;
+
+		if (mcache->stat_buf.st_dev != rb_state->stat_buf.st_dev ||
+			mcache->stat_buf.st_ino != rb_state->stat_buf.st_ino)
+			continue;
+		/* metadata cache was already rebuilt? */
+		if (timespec_comp(&mcache->stat_buf.st_mtim,
+						  &rb_state->stat_buf.st_mtim) != 0 ||
+			timespec_comp(&mcache->stat_buf.st_ctim,
+						  &rb_state->stat_buf.st_ctim) != 0)
+			break;
+		if (mcache->rb_index == rb_state->rb_index)
+			mtarget = mcache;
+		else
+		{
+			dlist_foreach(iter2, &mcache->siblings)
+			{
+				arrowMetadataCache *__mcache
+					= dlist_container(arrowMetadataCache, chain, iter2.cur);
+				if (__mcache->rb_index == rb_state->rb_index)
+				{
+					mtarget = __mcache;
+					break;
+				}
+			}
+		}
+		/* top-level fields are located at the head of fstate[] */
+		if (mtarget && attidx < mtarget->ncols)
+		{
+			RecordBatchFieldState *__fstate = &mtarget->fstate[attidx];
+
+			__fstate->stat_known = fstate->stat_known;
+			__fstate->stat_valid = fstate->stat_valid;
+			__fstate->stat_min   = fstate->stat_min;
+			__fstate->stat_max   = fstate->stat_max;
+		}
+		break;
+	}
+	LWLockRelease(lock);
+}
+
 /*
  * setupArrowSQLbufferSchema
  */
@@ -3961,6 +10875,8 @@ setupArrowSQLbufferSchema(SQLtable *table, TupleDesc tupdesc)
 								   NameStr(attr->attname),
 								   attr->atttypid,
 								   attr->atttypmod);
+		/* embeds min/max statistics, if supported */
+		enableArrowFieldStat(&table->columns[j]);
 	}
 	table->segment_sz = (size_t)arrow_record_batch_size_kb << 10;
 }
@@ -3984,9 +10900,15 @@ setupArrowSQLbufferBatches(SQLtable *table)
 						offsetof(MetadataCacheKey, hash));
 	index = key.hash % ARROW_METADATA_HASH_NSLOTS;
 
+	if (fileIsParquet(table->fdesc))
+		elog(ERROR, "arrow_fdw: unable to write '%s' in Parquet format",
+			 table->filename);
 	LWLockAcquire(&arrow_metadata_state->lock_slots[index], LW_SHARED);
 	readArrowFileDesc(table->fdesc, &af_info);
 	LWLockRelease(&arrow_metadata_state->lock_slots[index]);
+	if (af_info.is_stream)
+		elog(ERROR, "arrow_fdw: unable to write '%s' in IPC streaming format",
+			 table->filename);
 
 	/* restore DictionaryBatches already in the file */
 	nitems = af_info.footer._num_dictionaries;
@@ -4029,6 +10951,8 @@ setupArrowSQLbufferBatches(SQLtable *table)
 	}
 	else
 		table->recordBatches = NULL;
+	/* restore min/max statistics of the RecordBatches */
+	restoreArrowFieldStats(table, &af_info);
 
 	if (lseek(table->fdesc, pos, SEEK_SET) < 0)
 		elog(ERROR, "failed on lseek('%s',%lu): %m",
@@ -4046,6 +10970,7 @@ createArrowWriteState(Relation frel, File file, bool redo_log_written)
 	SQLtable	   *table;
 	struct stat		stat_buf;
 	MetadataCacheKey key;
+	ListCell	   *lc;
 
 	if (fstat(FileGetRawDesc(file), &stat_buf) != 0)
 		elog(ERROR, "failed on fstat('%s'): %m", FilePathName(file));
@@ -4061,9 +10986,21 @@ createArrowWriteState(Relation frel, File file, bool redo_log_written)
 	aw_state->key = key;
 	aw_state->hash = key.hash;
 	aw_state->redo_log_written = redo_log_written;
+	aw_state->batch_memcxt = AllocSetContextCreate(CurrentMemoryContext,
+												   "arrow_fdw bulk insert",
+												   ALLOCSET_DEFAULT_SIZES);
+	aw_state->batch_nrooms = arrow_fdw_insert_batch_size;
 	table = &aw_state->sql_table;
 	table->filename = FilePathName(file);
 	table->fdesc = FileGetRawDesc(file);
+	foreach (lc, GetForeignTable(RelationGetRelid(frel))->options)
+	{
+		DefElem	   *defel = lfirst(lc);
+
+		if (strcmp(defel->defname, "compression") == 0)
+			table->compressed = lookupArrowCompressionCodec(strVal(defel->arg),
+															&table->codec);
+	}
 	setupArrowSQLbufferSchema(table, tupdesc);
 	if (!redo_log_written)
 		setupArrowSQLbufferBatches(table);
@@ -4187,13 +11124,28 @@ writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
 	ssize_t		nbytes;
 	arrowWriteMVCCLog *mvcc = NULL;
 
-	if (table->nitems > 0)
+	/* compacted file is not visible to others until rename on commit */
+	if (table->nitems > 0 && !aw_state->is_compaction)
 	{
 		mvcc = MemoryContextAllocZero(TopSharedMemoryContext,
 									  sizeof(arrowWriteMVCCLog));
 		mvcc->key = aw_state->key;
 		mvcc->xid = GetCurrentTransactionId();
 		mvcc->cid = GetCurrentCommandId(true);
+		/* tracked by the backend for the cleanup on end of transaction */
+		PG_TRY();
+		{
+			MemoryContext oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+
+			arrow_write_mvcc_list = lappend(arrow_write_mvcc_list, mvcc);
+			MemoryContextSwitchTo(oldcxt);
+		}
+		PG_CATCH();
+		{
+			pfree(mvcc);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
 	}
 
 	PG_TRY();
@@ -4219,11 +11171,19 @@ writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
 					 table->filename);
 			writeArrowSchema(table);
 		}
-		if (table->nitems > 0)
+		if (table->nitems > 0 && !mvcc)
+			writeArrowRecordBatch(table);
+		else if (table->nitems > 0)
 		{
+			arrowWriteMVCCFile *mvcc_file
+				= lookupArrowWriteMVCCFile(&aw_state->key, true);
+
 			mvcc->record_batch = writeArrowRecordBatch(table);
-			dlist_push_tail(&arrow_metadata_state->mvcc_slots[index],
+			mvcc->mvcc_file = mvcc_file;
+			dlist_push_tail(&mvcc_file->rb_slots[mvcc->record_batch %
+												 ARROW_MVCC_RB_NSLOTS],
 							&mvcc->chain);
+			mvcc_file->nitems++;
 			elog(DEBUG2,
 				 "arrow-write: '%s' (st_dev=%u, st_ino=%u), xid=%u, cid=%u, record_batch=%u",
 				 FilePathName(aw_state->file),
@@ -4237,43 +11197,255 @@ writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
 	PG_CATCH();
 	{
 		if (mvcc)
+		{
+			arrow_write_mvcc_list = list_delete_ptr(arrow_write_mvcc_list,
+													mvcc);
 			pfree(mvcc);
+		}
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
 }
 
+/*
+ * __arrowWritePutDatum - append a datum to the column in row-by-row
+ */
+static void
+__arrowWritePutDatum(SQLfield *column, Form_pg_attribute attr,
+					 Datum datum, bool isnull, MemoryContext batch_memcxt)
+{
+	if (isnull)
+	{
+		sql_field_put_value(column, NULL, 0);
+	}
+	else if (attr->attbyval)
+	{
+		Assert(column->sql_type.pgsql.typbyval);
+		sql_field_put_value(column, (char *)&datum, attr->attlen);
+	}
+	else if (attr->attlen == -1)
+	{
+		struct varlena *vl;
+		MemoryContext	oldcxt;
+
+		Assert(column->sql_type.pgsql.typlen == -1);
+		oldcxt = MemoryContextSwitchTo(batch_memcxt);
+		vl = pg_detoast_datum_packed((struct varlena *)DatumGetPointer(datum));
+		MemoryContextSwitchTo(oldcxt);
+		sql_field_put_value(column, VARDATA_ANY(vl), VARSIZE_ANY_EXHDR(vl));
+	}
+	else
+	{
+		elog(ERROR, "Bug? unsupported type format");
+	}
+}
+
+/*
+ * __arrowWriteAppendInline - append fixed-length values of the batch
+ *
+ * It is only used when the Arrow representation is identical to the
+ * PostgreSQL's by-value datum, so no per-row conversion is needed.
+ */
+static void
+__arrowWriteAppendInline(SQLfield *column, int width,
+						 TupleTableSlot **slots, int nslots, int j)
+{
+	size_t		row_index = column->nitems;
+	char	   *dest;
+	int			i;
+
+	sql_buffer_expand(&column->values,
+					  column->values.usage + (size_t)width * nslots);
+	sql_buffer_expand(&column->nullmap,
+					  BITMAPLEN(row_index + nslots));
+	dest = column->values.data + column->values.usage;
+	for (i=0; i < nslots; i++, dest += width)
+	{
+		TupleTableSlot *slot = slots[i];
+
+		if (slot->tts_isnull[j])
+		{
+			column->nullcount++;
+			sql_buffer_clrbit(&column->nullmap, row_index + i);
+			memset(dest, 0, width);
+		}
+		else
+		{
+			sql_buffer_setbit(&column->nullmap, row_index + i);
+			store_att_byval(dest, slot->tts_values[j], width);
+		}
+	}
+	column->values.usage += (size_t)width * nslots;
+	column->nitems += nslots;
+	column->__curr_usage__ = ARROWALIGN(column->values.usage);
+	if (column->nullcount > 0)
+		column->__curr_usage__ += ARROWALIGN(column->nullmap.usage);
+}
+
+/*
+ * __arrowWriteAppendVarlena - append Utf8/Binary values of the batch
+ */
+static void
+__arrowWriteAppendVarlena(SQLfield *column, MemoryContext batch_memcxt,
+						  TupleTableSlot **slots, int nslots, int j)
+{
+	size_t		row_index = column->nitems;
+	uint32	   *offsets;
+	int			i;
+
+	if (row_index == 0)
+		sql_buffer_append_zero(&column->values, sizeof(uint32));
+	sql_buffer_expand(&column->values,
+					  column->values.usage + sizeof(uint32) * nslots);
+	sql_buffer_expand(&column->nullmap,
+					  BITMAPLEN(row_index + nslots));
+	offsets = (uint32 *)(column->values.data + column->values.usage);
+	for (i=0; i < nslots; i++)
+	{
+		TupleTableSlot *slot = slots[i];
+
+		if (slot->tts_isnull[j])
+		{
+			column->nullcount++;
+			sql_buffer_clrbit(&column->nullmap, row_index + i);
+		}
+		else
+		{
+			struct varlena *vl;
+			MemoryContext	oldcxt;
+
+			oldcxt = MemoryContextSwitchTo(batch_memcxt);
+			vl = pg_detoast_datum_packed((struct varlena *)
+										 DatumGetPointer(slot->tts_values[j]));
+			MemoryContextSwitchTo(oldcxt);
+			sql_buffer_setbit(&column->nullmap, row_index + i);
+			sql_buffer_append(&column->extra,
+							  VARDATA_ANY(vl), VARSIZE_ANY_EXHDR(vl));
+		}
+		offsets[i] = column->extra.usage;
+	}
+	column->values.usage += sizeof(uint32) * nslots;
+	column->nitems += nslots;
+	column->__curr_usage__ = (ARROWALIGN(column->values.usage) +
+							  ARROWALIGN(column->extra.usage));
+	if (column->nullcount > 0)
+		column->__curr_usage__ += ARROWALIGN(column->nullmap.usage);
+}
+
+/*
+ * arrowWriteAppendSlots
+ *
+ * It appends the rows on the slots to the SQLfield buffers column by
+ * column, then writes out a RecordBatch if buffer usage exceeds the
+ * threshold.
+ */
+static void
+arrowWriteAppendSlots(arrowWriteState *aw_state, TupleDesc tupdesc,
+					  TupleTableSlot **slots, int nslots)
+{
+	SQLtable	   *table = &aw_state->sql_table;
+	MemoryContext	oldcxt;
+	size_t			usage = 0;
+	int				i, j;
+
+	if (nslots <= 0)
+		return;
+	for (i=0; i < nslots; i++)
+		slot_getallattrs(slots[i]);
+
+	oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		SQLfield   *column = &table->columns[j];
+		ArrowType  *t = &column->arrow_type;
+
+		if (attr->attbyval &&
+			((t->node.tag == ArrowNodeTag__Int &&
+			  t->Int.is_signed &&
+			  t->Int.bitWidth == 8 * attr->attlen) ||
+			 (t->node.tag == ArrowNodeTag__FloatingPoint &&
+			  ((t->FloatingPoint.precision == ArrowPrecision__Single &&
+				attr->attlen == sizeof(float4)) ||
+			   (t->FloatingPoint.precision == ArrowPrecision__Double &&
+				attr->attlen == sizeof(float8))))))
+		{
+			__arrowWriteAppendInline(column, attr->attlen, slots, nslots, j);
+		}
+		else if (attr->attlen == -1 &&
+				 (t->node.tag == ArrowNodeTag__Utf8 ||
+				  t->node.tag == ArrowNodeTag__Binary))
+		{
+			__arrowWriteAppendVarlena(column, aw_state->batch_memcxt,
+									  slots, nslots, j);
+		}
+		else
+		{
+			for (i=0; i < nslots; i++)
+			{
+				TupleTableSlot *slot = slots[i];
+
+				__arrowWritePutDatum(column, attr,
+									 slot->tts_values[j],
+									 slot->tts_isnull[j],
+									 aw_state->batch_memcxt);
+				if ((i & 1023) == 1023)
+					MemoryContextReset(aw_state->batch_memcxt);
+			}
+		}
+		usage += column->__curr_usage__;
+	}
+	table->nitems += nslots;
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextReset(aw_state->batch_memcxt);
+
+	/*
+	 * If usage exceeds the threshold of record-batch size, make a redo-log
+	 * on demand, and write out the buffer.
+	 */
+	if (usage > table->segment_sz)
+		writeOutArrowRecordBatch(aw_state, false);
+}
+
+/*
+ * arrowWriteFlushBatch - append the rows buffered on the batch_slots[]
+ */
+static void
+arrowWriteFlushBatch(arrowWriteState *aw_state, TupleDesc tupdesc)
+{
+	int		i;
+
+	if (aw_state->batch_nslots == 0)
+		return;
+	arrowWriteAppendSlots(aw_state, tupdesc,
+						  aw_state->batch_slots,
+						  aw_state->batch_nslots);
+	for (i=0; i < aw_state->batch_nslots; i++)
+		ExecClearTuple(aw_state->batch_slots[i]);
+	aw_state->batch_nslots = 0;
+}
+
 /*
  * TRUNCATE support
  */
 static void
-__arrowExecTruncateRelation(Relation frel)
+__arrowExecTruncateFile(TupleDesc tupdesc, const char *path_name,
+						bool sharded)
 {
-	TupleDesc	tupdesc = RelationGetDescr(frel);
-	Oid			frel_oid = RelationGetRelid(frel);
-	ForeignTable *ft = GetForeignTable(frel_oid);
 	arrowWriteRedoLog *redo;
 	struct stat	stat_buf;
 	MetadataCacheKey key;
-	List	   *filesList;
 	SQLtable   *table;
-	const char *path_name;
 	const char *dir_name;
 	const char *file_name;
 	size_t		main_sz;
 	int			fdesc = -1;
 	int			nbytes;
 	char		backup_path[MAXPGPATH];
-	bool		writable;
 
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	if (!writable)
-		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
-			 RelationGetRelationName(frel));
-	Assert(list_length(filesList) == 1);
-	path_name = strVal(linitial(filesList));
+	if (__arrowFdwLookupRedoLog(path_name, true))
+		elog(ERROR, "arrow_fdw: file '%s' is already compacted in the current transaction",
+			 path_name);
 	if (stat(path_name, &stat_buf) != 0)
 		elog(ERROR, "failed on stat('%s'): %m", path_name);
 	memset(&key, 0, sizeof(key));
@@ -4296,79 +11468,345 @@ __arrowExecTruncateRelation(Relation frel)
 	strcpy(redo->pathname, path_name);
 	redo->is_truncate = true;
 
-	PG_TRY();
+	PG_TRY();
+	{
+		/*
+		 * move the current arrow file to the backup
+		 */
+		dir_name = dirname(pstrdup(path_name));
+		file_name = basename(pstrdup(path_name));
+		for (;;)
+		{
+			redo->suffix = random();
+			snprintf(backup_path, sizeof(backup_path),
+					 "%s/%s.%u.backup",
+					 dir_name, file_name, redo->suffix);
+			if (stat(backup_path, &stat_buf) != 0)
+			{
+				if (errno == ENOENT)
+					break;
+				elog(ERROR, "failed on stat('%s'): %m", backup_path);
+			}
+		}
+		if (rename(path_name, backup_path) != 0)
+			elog(ERROR, "failed on rename('%s','%s'): %m",
+				 path_name, backup_path);
+
+		/*
+		 * create an empty arrow file, unless it is a shard file that shall
+		 * be re-created on the next INSERT
+		 */
+		if (!sharded)
+		{
+			PG_TRY();
+			{
+				fdesc = open(path_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+				if (fdesc < 0)
+					elog(ERROR, "failed on open('%s'): %m", path_name);
+				table->filename = path_name;
+				table->fdesc = fdesc;
+				nbytes = __writeFile(fdesc, "ARROW1\0\0", 8);
+				if (nbytes != 8)
+					elog(ERROR, "failed on __writeFile('%s'): %m", path_name);
+				writeArrowSchema(table);
+				writeArrowFooter(table);
+			}
+			PG_CATCH();
+			{
+				if (fdesc >= 0)
+					close(fdesc);
+				if (rename(backup_path, path_name) != 0)
+					elog(WARNING, "failed on rename('%s', '%s'): %m",
+						 backup_path, path_name);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+			close(fdesc);
+		}
+	}
+	PG_CATCH();
+	{
+		pfree(redo);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	/* save the REDO log entry */
+	dlist_push_head(&arrow_write_redo_list, &redo->chain);
+}
+
+static void
+__arrowExecTruncateRelation(Relation frel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(frel);
+	ForeignTable *ft = GetForeignTable(RelationGetRelid(frel));
+	List	   *filesList;
+	ListCell   *lc;
+	bool		writable;
+	bool		sharded;
+
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	if (!writable)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
+			 RelationGetRelationName(frel));
+	(void) arrowFdwWritableFile(ft->options, &sharded);
+	Assert(sharded || list_length(filesList) == 1);
+	/* all the shard files are removed on commit */
+	foreach (lc, filesList)
+		__arrowExecTruncateFile(tupdesc, strVal(lfirst(lc)), sharded);
+}
+
+/*
+ * pgstrom_arrow_fdw_truncate
+ */
+Datum
+pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS)
+{
+	Oid			frel_oid = PG_GETARG_OID(0);
+	Relation	frel;
+	FdwRoutine *routine;
+
+	frel = table_open(frel_oid, AccessExclusiveLock);
+	if (frel->rd_rel->relkind != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not arrow_fdw foreign table",
+						RelationGetRelationName(frel))));
+	routine = GetFdwRoutineForRelation(frel, false);
+	if (memcmp(routine, &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not arrow_fdw foreign table",
+						RelationGetRelationName(frel))));
+	__arrowExecTruncateRelation(frel);
+
+	table_close(frel, NoLock);
+
+	PG_RETURN_VOID();
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_truncate);
+
+/*
+ * __arrowFdwLookupRedoLog - returns the REDO log entry on the file by the
+ * current transaction, if any.
+ */
+static arrowWriteRedoLog *
+__arrowFdwLookupRedoLog(const char *pathname, bool compaction_only)
+{
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &arrow_write_redo_list)
+	{
+		arrowWriteRedoLog *redo = dlist_container(arrowWriteRedoLog,
+												  chain, iter.cur);
+		if (compaction_only && !redo->is_compaction)
+			continue;
+		if (strcmp(redo->pathname, pathname) == 0)
+			return redo;
+	}
+	return NULL;
+}
+
+/*
+ * Compaction support
+ *
+ * Every INSERT on the writable arrow_fdw appends at least one RecordBatch,
+ * so trickle inserts make many tiny RecordBatches. Compaction rewrites the
+ * committed rows of the file into a new file ('<file>.<suffix>.compact')
+ * with RecordBatches of arrow_fdw.record_batch_size, then replaces the
+ * original file by rename(2) on commit, or removes it on abort, according
+ * to the REDO log. Until the commit, readers continue to read the original
+ * file, and the caller must hold ShareRowExclusiveLock to block writers.
+ */
+static int
+__arrowExecCompactionFile(Relation frel, const char *path_name,
+						  int min_batches)
+{
+	TupleDesc	tupdesc = RelationGetDescr(frel);
+	arrowWriteRedoLog *redo;
+	arrowWriteState *aw_state;
+	MemoryContext memcxt;
+	MemoryContext oldcxt;
+	TupleTableSlot *slot;
+	Bitmapset  *referenced;
+	List	   *rb_cached;
+	List	   *dict_list = NIL;
+	ListCell   *lc;
+	File		filp;
+	File		cfilp;
+	size_t		threshold = ((size_t)arrow_record_batch_size_kb << 10) / 2;
+	size_t		main_sz;
+	int			nbatches = 0;
+	int			nsmalls = 0;
+	int			i, j, nwords;
+	struct stat	stat_buf;
+	char		compact_path[MAXPGPATH];
+
+	if (__arrowFdwLookupRedoLog(path_name, false))
+		elog(ERROR, "arrow_fdw: file '%s' is modified in the current transaction",
+			 path_name);
+	filp = PathNameOpenFile(path_name, O_RDONLY | PG_BINARY);
+	if (filp < 0)
+	{
+		if (errno == ENOENT)
+			return 0;
+		elog(ERROR, "failed to open '%s' on behalf of '%s': %m",
+			 path_name, RelationGetRelationName(frel));
+	}
+	rb_cached = arrowLookupOrBuildMetadataCache(filp);
+	foreach (lc, rb_cached)
+	{
+		RecordBatchState *rb_state = lfirst(lc);
+
+		if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
+			elog(ERROR, "arrow file '%s' on behalf of the foreign table '%s' has incompatible schema definition",
+				 path_name, RelationGetRelationName(frel));
+		if (rb_state->rb_length < threshold)
+			nsmalls++;
+		nbatches++;
+	}
+	if (nsmalls < Max(min_batches, 2))
+	{
+		FileClose(filp);
+		return 0;
+	}
+	if (fstat(FileGetRawDesc(filp), &stat_buf) != 0)
+		elog(ERROR, "failed on fstat('%s'): %m", path_name);
+
+	/* create a new file for the compacted RecordBatches */
+	for (;;)
+	{
+		uint32	suffix = random();
+
+		snprintf(compact_path, sizeof(compact_path),
+				 "%s.%u.compact", path_name, suffix);
+		cfilp = PathNameOpenFile(compact_path,
+								 O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+		if (cfilp >= 0)
+		{
+			main_sz = MAXALIGN(offsetof(arrowWriteRedoLog, footer_backup));
+			redo = MemoryContextAllocZero(CacheMemoryContext,
+										  main_sz + strlen(path_name) + 1);
+			redo->key.st_dev = stat_buf.st_dev;
+			redo->key.st_ino = stat_buf.st_ino;
+			redo->key.hash = hash_any((unsigned char *)&redo->key,
+									  offsetof(MetadataCacheKey, hash));
+			redo->xid = GetCurrentTransactionId();
+			redo->cid = GetCurrentCommandId(true);
+			redo->pathname = (char *)redo + main_sz;
+			strcpy(redo->pathname, path_name);
+			redo->is_compaction = true;
+			redo->suffix = suffix;
+			/* the compacted file shall be removed on abort */
+			dlist_push_head(&arrow_write_redo_list, &redo->chain);
+			break;
+		}
+		if (errno != EEXIST)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", compact_path)));
+	}
+
+	/* ANALYZE-like load of all the attributes */
+	nwords = (tupdesc->natts - FirstLowInvalidHeapAttributeNumber +
+			  BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
+	referenced = palloc(offsetof(Bitmapset, words[nwords]));
+	referenced->nwords = nwords;
+	memset(referenced->words, -1, sizeof(bitmapword) * nwords);
+
+	aw_state = createArrowWriteState(frel, cfilp, true);
+	aw_state->is_compaction = true;
+	slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	memcxt = AllocSetContextCreate(CurrentMemoryContext,
+								   "arrow_fdw compaction",
+								   ALLOCSET_DEFAULT_SIZES);
+	foreach (lc, rb_cached)
 	{
-		/*
-		 * move the current arrow file to the backup
-		 */
-		dir_name = dirname(pstrdup(path_name));
-		file_name = basename(pstrdup(path_name));
-		for (;;)
+		RecordBatchState *rb_state = lfirst(lc);
+		pgstrom_data_store *pds;
+
+		oldcxt = MemoryContextSwitchTo(memcxt);
+		pds = __arrowFdwLoadRecordBatch(rb_state,
+										frel,
+										referenced,
+										NULL,
+										memcxt,
+										-1,
+										NULL,
+										&dict_list);
+		MemoryContextSwitchTo(oldcxt);
+		for (i=0; i < pds->kds.nitems; i++)
 		{
-			redo->suffix = random();
-			snprintf(backup_path, sizeof(backup_path),
-					 "%s/%s.%u.backup",
-					 dir_name, file_name, redo->suffix);
-			if (stat(backup_path, &stat_buf) != 0)
+			ExecClearTuple(slot);
+			oldcxt = MemoryContextSwitchTo(memcxt);
+			for (j=0; j < pds->kds.ncols; j++)
 			{
-				if (errno == ENOENT)
-					break;
-				elog(ERROR, "failed on stat('%s'): %m", backup_path);
+				pg_datum_arrow_ref(&pds->kds,
+								   &pds->kds.colmeta[j],
+								   i,
+								   slot->tts_values + j,
+								   slot->tts_isnull + j);
 			}
+			MemoryContextSwitchTo(oldcxt);
+			ExecStoreVirtualTuple(slot);
+			arrowWriteInsertSlot(aw_state, tupdesc, slot);
 		}
-		if (rename(path_name, backup_path) != 0)
-			elog(ERROR, "failed on rename('%s','%s'): %m",
-				 path_name, backup_path);
-
-		/*
-		 * create an empty arrow file
-		 */
-		PG_TRY();
-		{
-			fdesc = open(path_name, O_RDWR | O_CREAT | O_EXCL, 0600);
-			if (fdesc < 0)
-				elog(ERROR, "failed on open('%s'): %m", path_name);
-			table->filename = path_name;
-			table->fdesc = fdesc;
-			nbytes = __writeFile(fdesc, "ARROW1\0\0", 8);
-			if (nbytes != 8)
-				elog(ERROR, "failed on __writeFile('%s'): %m", path_name);
-			writeArrowSchema(table);
-			writeArrowFooter(table);
-		}
-		PG_CATCH();
-		{
-			if (fdesc >= 0)
-				close(fdesc);
-			if (rename(backup_path, path_name) != 0)
-				elog(WARNING, "failed on rename('%s', '%s'): %m",
-					 backup_path, path_name);
-			PG_RE_THROW();
-		}
-		PG_END_TRY();
-		close(fdesc);
-	}
-	PG_CATCH();
-	{
-		pfree(redo);
-		PG_RE_THROW();
+		/* buffered rows are copied, so the source can be released */
+		ExecClearTuple(slot);
+		PDS_release(pds);
+		MemoryContextReset(memcxt);
+		dict_list = NIL;
 	}
-	PG_END_TRY();
-	/* save the REDO log entry */
-	dlist_push_head(&arrow_write_redo_list, &redo->chain);
+	arrowFdwEndInsert(aw_state, tupdesc);
+	ExecDropSingleTupleTableSlot(slot);
+	MemoryContextDelete(memcxt);
+	FileClose(cfilp);
+	FileClose(filp);
+
+	elog(DEBUG1, "arrow_fdw: compaction of '%s' (%d -> %d RecordBatches)",
+		 path_name, nbatches, aw_state->sql_table.numRecordBatches);
+
+	return Max(nbatches - aw_state->sql_table.numRecordBatches, 0);
 }
 
 /*
- * pgstrom_arrow_fdw_truncate
+ * __arrowExecCompactionRelation - returns number of RecordBatches reduced
+ */
+static int
+__arrowExecCompactionRelation(Relation frel, int min_batches)
+{
+	ForeignTable *ft = GetForeignTable(RelationGetRelid(frel));
+	List	   *filesList;
+	ListCell   *lc;
+	bool		writable;
+	int			nreduced = 0;
+
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	if (!writable)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
+			 RelationGetRelationName(frel));
+	foreach (lc, filesList)
+		nreduced += __arrowExecCompactionFile(frel, strVal(lfirst(lc)),
+											  min_batches);
+	return nreduced;
+}
+
+/*
+ * pgstrom_arrow_fdw_compaction
  */
 Datum
-pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS)
+pgstrom_arrow_fdw_compaction(PG_FUNCTION_ARGS)
 {
 	Oid			frel_oid = PG_GETARG_OID(0);
 	Relation	frel;
 	FdwRoutine *routine;
+	int			nreduced;
 
-	frel = table_open(frel_oid, AccessExclusiveLock);
+	/* blocks concurrent writers, but not readers */
+	frel = table_open(frel_oid, ShareRowExclusiveLock);
 	if (frel->rd_rel->relkind != RELKIND_FOREIGN_TABLE)
 		ereport(ERROR,
 				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
@@ -4380,13 +11818,156 @@ pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS)
 				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
 				 errmsg("\"%s\" is not arrow_fdw foreign table",
 						RelationGetRelationName(frel))));
-	__arrowExecTruncateRelation(frel);
+	nreduced = __arrowExecCompactionRelation(frel, 2);
 
 	table_close(frel, NoLock);
 
-	PG_RETURN_VOID();
+	PG_RETURN_INT32(nreduced);
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_compaction);
+
+/*
+ * Background worker for compaction
+ */
+static void
+arrowFdwCompactionSigTerm(SIGNAL_ARGS)
+{
+	int		saved_errno = errno;
+
+	arrow_compaction_got_sigterm = true;
+	SetLatch(MyLatch);
+
+	errno = saved_errno;
+}
+
+static void
+arrowFdwCompactionSigHup(SIGNAL_ARGS)
+{
+	int		saved_errno = errno;
+
+	arrow_compaction_got_sighup = true;
+	SetLatch(MyLatch);
+
+	errno = saved_errno;
+}
+
+/*
+ * __arrowFdwCompactionCandidates - writable arrow_fdw foreign tables
+ */
+static List *
+__arrowFdwCompactionCandidates(void)
+{
+	Relation	rel;
+	SysScanDesc	sscan;
+	HeapTuple	tuple;
+	List	   *results = NIL;
+
+	rel = table_open(ForeignTableRelationId, AccessShareLock);
+	sscan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+	while (HeapTupleIsValid(tuple = systable_getnext(sscan)))
+	{
+		Form_pg_foreign_table ftable = (Form_pg_foreign_table) GETSTRUCT(tuple);
+		ForeignTable   *ft = GetForeignTable(ftable->ftrelid);
+		FdwRoutine	   *routine = GetFdwRoutineByServerId(ft->serverid);
+		ListCell	   *lc;
+
+		if (memcmp(routine, &pgstrom_arrow_fdw_routine,
+				   sizeof(FdwRoutine)) != 0)
+			continue;
+		foreach (lc, ft->options)
+		{
+			DefElem	   *defel = lfirst(lc);
+
+			if (strcmp(defel->defname, "writable") == 0 &&
+				defGetBoolean(defel))
+			{
+				results = lappend_oid(results, ftable->ftrelid);
+				break;
+			}
+		}
+	}
+	systable_endscan(sscan);
+	table_close(rel, AccessShareLock);
+
+	return results;
+}
+
+/*
+ * arrowFdwCompactionMain - main loop of the compaction worker
+ */
+void
+arrowFdwCompactionMain(Datum arg)
+{
+	pqsignal(SIGTERM, arrowFdwCompactionSigTerm);
+	pqsignal(SIGHUP, arrowFdwCompactionSigHup);
+	BackgroundWorkerUnblockSignals();
+#if PG_VERSION_NUM < 110000
+	BackgroundWorkerInitializeConnection(arrow_fdw_compaction_database, NULL);
+#else
+	BackgroundWorkerInitializeConnection(arrow_fdw_compaction_database, NULL, 0);
+#endif
+	while (!arrow_compaction_got_sigterm)
+	{
+		List	   *relids;
+		ListCell   *lc;
+		int			ev;
+
+		ev = WaitLatch(MyLatch,
+					   WL_LATCH_SET |
+					   WL_TIMEOUT |
+					   WL_POSTMASTER_DEATH,
+					   (long)arrow_fdw_compaction_naptime * 1000L,
+					   PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		if (ev & WL_POSTMASTER_DEATH)
+			elog(FATAL, "unexpected Postmaster dead");
+		CHECK_FOR_INTERRUPTS();
+		if (arrow_compaction_got_sighup)
+		{
+			arrow_compaction_got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+		if (arrow_compaction_got_sigterm)
+			break;
+
+		SetCurrentStatementStartTimestamp();
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		relids = __arrowFdwCompactionCandidates();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		/* one transaction per table */
+		foreach (lc, relids)
+		{
+			Oid			frel_oid = lfirst_oid(lc);
+			Relation	frel;
+			int			nreduced;
+
+			SetCurrentStatementStartTimestamp();
+			StartTransactionCommand();
+			PushActiveSnapshot(GetTransactionSnapshot());
+			/* never waits for the running writers */
+			if (ConditionalLockRelationOid(frel_oid, ShareRowExclusiveLock))
+			{
+				if (SearchSysCacheExists1(RELOID, ObjectIdGetDatum(frel_oid)))
+				{
+					frel = table_open(frel_oid, NoLock);
+					nreduced = __arrowExecCompactionRelation(frel,
+										arrow_fdw_compaction_min_batches);
+					if (nreduced > 0)
+						elog(LOG, "arrow_fdw: compaction of \"%s\" reduced %d RecordBatches",
+							 RelationGetRelationName(frel), nreduced);
+					table_close(frel, NoLock);
+				}
+			}
+			PopActiveSnapshot();
+			CommitTransactionCommand();
+		}
+		list_free(relids);
+	}
+	proc_exit(0);
 }
-PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_truncate);
 
 static void
 __applyArrowTruncateRedoLog(arrowWriteRedoLog *redo, bool is_commit)
@@ -4398,6 +11979,7 @@ __applyArrowTruncateRedoLog(arrowWriteRedoLog *redo, bool is_commit)
 	if (is_commit)
 	{
 		elog(DEBUG2, "arrow-redo: unlink [%s]", backup);
+		arrowRemoveMetadataCacheFileByPath(backup);
 		if (unlink(backup) != 0)
 			ereport(WARNING,
 					(errcode_for_file_access(),
@@ -4418,6 +12000,40 @@ __applyArrowTruncateRedoLog(arrowWriteRedoLog *redo, bool is_commit)
 	}
 }
 
+static void
+__applyArrowCompactionRedoLog(arrowWriteRedoLog *redo, bool is_commit)
+{
+	char		compact[MAXPGPATH];
+
+	snprintf(compact, MAXPGPATH, "%s.%u.compact",
+			 redo->pathname, redo->suffix);
+	if (is_commit)
+	{
+		/*
+		 * Replace the arrow file by the compacted one atomically; readers
+		 * which already opened the older one continue to read it.
+		 */
+		elog(DEBUG2, "arrow-redo: rename [%s]->[%s]", compact, redo->pathname);
+		arrowRemoveMetadataCacheFileByPath(redo->pathname);
+		if (rename(compact, redo->pathname) != 0)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("could not replace \"%s\" by the compacted file: %m",
+							redo->pathname),
+					 errhint("remove the \"%s\" manually", compact)));
+	}
+	else
+	{
+		elog(DEBUG2, "arrow-redo: unlink [%s]", compact);
+		if (unlink(compact) != 0 && errno != ENOENT)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("could not remove compacted file \"%s\": %m",
+							compact),
+					 errhint("remove the \"%s\" manually", compact)));
+	}
+}
+
 static void
 __applyArrowInsertRedoLog(arrowWriteRedoLog *redo, bool is_commit)
 {
@@ -4430,6 +12046,7 @@ __applyArrowInsertRedoLog(arrowWriteRedoLog *redo, bool is_commit)
 	if (redo->footer_offset == 0 &&
 		redo->footer_length == 0)
 	{
+		arrowRemoveMetadataCacheFileByPath(redo->pathname);
 		if (unlink(redo->pathname) != 0)
 			ereport(WARNING,
 					(errcode_for_file_access(),
@@ -4475,76 +12092,132 @@ __applyArrowInsertRedoLog(arrowWriteRedoLog *redo, bool is_commit)
 	elog(DEBUG2, "arrow_fdw: REDO log applied (xid=%u, cid=%u, file=[%s], offset=%zu, length=%zu)", redo->xid, redo->cid, redo->pathname, redo->footer_offset, redo->footer_length);
 }
 
+/*
+ * __cleanupArrowWriteMVCCLog
+ *
+ * It releases the MVCC log entries written by the current transaction on
+ * the files that belong to the lock_slots[index]. Caller must hold exclusive
+ * lock on the lock_slots[index], thus, on the mvcc_slots[index] also.
+ */
 static void
-__cleanupArrowWriteMVCCLog(TransactionId curr_xid, dlist_head *mvcc_slot)
+__cleanupArrowWriteMVCCLog(TransactionId curr_xid, uint32 index)
 {
-	dlist_mutable_iter iter;
+	List	   *survived = NIL;
+	ListCell   *lc;
+	MemoryContext oldcxt;
 
-	dlist_foreach_modify(iter, mvcc_slot)
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	foreach (lc, arrow_write_mvcc_list)
 	{
-		arrowWriteMVCCLog *mvcc = dlist_container(arrowWriteMVCCLog,
-												  chain, iter.cur);
-		if (mvcc->xid == curr_xid)
+		arrowWriteMVCCLog  *mvcc = lfirst(lc);
+		arrowWriteMVCCFile *mvcc_file = mvcc->mvcc_file;
+
+		if (mvcc->xid != curr_xid ||
+			mvcc->key.hash % ARROW_METADATA_HASH_NSLOTS != index)
+		{
+			survived = lappend(survived, mvcc);
+			continue;
+		}
+		if (mvcc_file)
 		{
 			dlist_delete(&mvcc->chain);
-			elog(DEBUG2, "arrow: release mvcc-log (st_dev=%u, st_ino=%u), xid=%u, cid=%u, record_batch=%u",
-				 (uint32)mvcc->key.st_dev, (uint32)mvcc->key.st_ino,
-				 (uint32)mvcc->xid, (uint32)mvcc->cid, mvcc->record_batch);
-			pfree(mvcc);
+			Assert(mvcc_file->nitems > 0);
+			if (--mvcc_file->nitems == 0)
+			{
+				dlist_delete(&mvcc_file->chain);
+				pfree(mvcc_file);
+			}
 		}
+		elog(DEBUG2, "arrow: release mvcc-log (st_dev=%u, st_ino=%u), xid=%u, cid=%u, record_batch=%u",
+			 (uint32)mvcc->key.st_dev, (uint32)mvcc->key.st_ino,
+			 (uint32)mvcc->xid, (uint32)mvcc->cid, mvcc->record_batch);
+		pfree(mvcc);
 	}
+	list_free(arrow_write_mvcc_list);
+	arrow_write_mvcc_list = survived;
+	MemoryContextSwitchTo(oldcxt);
 }
 
 /*
  * __arrowFdwXactCallback
+ *
+ * It releases the MVCC log entries and applies the REDO log entries of the
+ * current transaction for each lock_slots[], one by one. Only one lock is
+ * held at a time, so it never waits for the lock of another slot while it
+ * holds one; concurrent transactions may touch the slots in any order.
  */
 static void
 __arrowFdwXactCallback(TransactionId curr_xid, bool is_commit)
 {
 	arrowWriteRedoLog  *redo;
+	dlist_iter			iter1;
 	dlist_mutable_iter	iter;
+	ListCell		   *lc;
 	CommandId			curr_cid = InvalidCommandId;
-	uint32				index;
-	bool				locked[ARROW_METADATA_HASH_NSLOTS];
-	LWLock			   *locks[ARROW_METADATA_HASH_NSLOTS];
-	uint32				lcount = 0;
+	uint32				index = 0;
 
 	if (curr_xid == InvalidTransactionId ||
-		dlist_is_empty(&arrow_write_redo_list))
+		(dlist_is_empty(&arrow_write_redo_list) &&
+		 arrow_write_mvcc_list == NIL))
 		return;
 
-	memset(locked, 0, sizeof(locked));
-	dlist_foreach_modify(iter, &arrow_write_redo_list)
+	for (;;)
 	{
-		redo = dlist_container(arrowWriteRedoLog, chain, iter.cur);
-		if (redo->xid != curr_xid)
-			continue;
-		if (curr_cid != InvalidCommandId &&
-			curr_cid < redo->cid)
-			elog(WARNING, "Bug? Order of REDO log is not be correct. ABORT transaction might generate wrong image restored.");
+		LWLock	   *lock;
+		bool		found = false;
 
-		index = redo->key.hash % ARROW_METADATA_HASH_NSLOTS;
-		if (!locked[index])
+		/* pick up the next slot to be processed */
+		dlist_foreach(iter1, &arrow_write_redo_list)
+		{
+			redo = dlist_container(arrowWriteRedoLog, chain, iter1.cur);
+			if (redo->xid == curr_xid)
+			{
+				index = redo->key.hash % ARROW_METADATA_HASH_NSLOTS;
+				found = true;
+				break;
+			}
+		}
+		if (!found)
 		{
-			LWLock	   *lock = &arrow_metadata_state->lock_slots[index];
-			dlist_head *slot = &arrow_metadata_state->mvcc_slots[index];
+			foreach (lc, arrow_write_mvcc_list)
+			{
+				arrowWriteMVCCLog *mvcc = lfirst(lc);
 
-			LWLockAcquire(lock, LW_EXCLUSIVE);
-			__cleanupArrowWriteMVCCLog(curr_xid, slot);
-			locked[index] = true;
-			locks[lcount++] = lock;
+				if (mvcc->xid == curr_xid)
+				{
+					index = mvcc->key.hash % ARROW_METADATA_HASH_NSLOTS;
+					found = true;
+					break;
+				}
+			}
 		}
-		if (redo->is_truncate)
-			__applyArrowTruncateRedoLog(redo, is_commit);
-		else
-			__applyArrowInsertRedoLog(redo, is_commit);
+		if (!found)
+			break;
 
-		dlist_delete(&redo->chain);
-		pfree(redo);
-	}
+		lock = &arrow_metadata_state->lock_slots[index];
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		__cleanupArrowWriteMVCCLog(curr_xid, index);
+		dlist_foreach_modify(iter, &arrow_write_redo_list)
+		{
+			redo = dlist_container(arrowWriteRedoLog, chain, iter.cur);
+			if (redo->xid != curr_xid ||
+				redo->key.hash % ARROW_METADATA_HASH_NSLOTS != index)
+				continue;
+			if (curr_cid != InvalidCommandId &&
+				curr_cid < redo->cid)
+				elog(WARNING, "Bug? Order of REDO log is not be correct. ABORT transaction might generate wrong image restored.");
+			if (redo->is_truncate)
+				__applyArrowTruncateRedoLog(redo, is_commit);
+			else if (redo->is_compaction)
+				__applyArrowCompactionRedoLog(redo, is_commit);
+			else
+				__applyArrowInsertRedoLog(redo, is_commit);
 
-	for (index=0; index < lcount; index++)
-		LWLockRelease(locks[index]);
+			dlist_delete(&redo->chain);
+			pfree(redo);
+		}
+		LWLockRelease(lock);
+	}
 }
 
 /*
@@ -4812,22 +12485,49 @@ BuildArrowGpuBufferCupy(Relation frel,
 				size_t		doffset;
 				size_t		length;
 				size_t		padding = 0;
+				char	   *hbuf;
+				char	   *temp = NULL;
 
 				Assert(attnum > 0 && attnum <= rb_state->ncols);
 				column = &rb_state->columns[attnum-1];
 				hoffset += column->values_offset;
-				
+				hbuf = mmap_ptr + hoffset;
+				if (column->parquet.is_parquet)
+				{
+					ParquetDecodedChunk	pq;
+
+					/* Parquet column chunk must be decoded on the host */
+					parquetDecodeColumnChunk(rb_state->fdesc, &column->parquet,
+											 hoffset,
+											 column->values_zlength,
+											 column->nitems, &pq);
+					if (pq.nullmap)
+						pfree(pq.nullmap);
+					temp = pq.values;
+					hbuf = temp;
+				}
+				else if (column->values_zlength > 0)
+				{
+					/* compressed buffer must be expanded on the host */
+					temp = palloc(column->values_length);
+					__arrowFdwDecompressChunk(rb_state->fdesc, column->codec,
+											  hoffset,
+											  column->values_zlength,
+											  temp, column->values_length);
+					hbuf = temp;
+				}
+
 				doffset = unitsz * (row_index + j * gpubuf->nrooms);
 				length = unitsz * Min(rb_state->rb_nitems, column->nitems);
 				if (length > column->values_length)
 					length = column->values_length;
 				if (length < unitsz * rb_state->rb_nitems)
 					padding = unitsz * rb_state->rb_nitems - length;
-				rc = cuMemcpyHtoD(gmem_ptr + doffset,
-								  mmap_ptr + hoffset,
-								  length);
+				rc = cuMemcpyHtoD(gmem_ptr + doffset, hbuf, length);
 				if (rc != CUDA_SUCCESS)
 					elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+				if (temp)
+					pfree(temp);
 				if (padding > 0)
 				{
 					rc = cuMemsetD8(gmem_ptr + doffset + length, 0, padding);
@@ -4893,6 +12593,9 @@ lookupOrBuildArrowGpuBufferCupy(Relation frel, List *attNums,
 	ArrowGpuBuffer *gpubuf, *_key;
 	text		   *result = NULL;
 
+	if (arrowFdwPartitionDir(ft->options) != NULL)
+		elog(ERROR, "arrow_fdw: export of partitioned directory ('%s') is not supported",
+			 RelationGetRelationName(frel));
 	/*
 	 * Estimation of the data size
 	 */
@@ -5356,6 +13059,45 @@ pgstrom_arrow_fdw_put_gpu_buffer(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_put_gpu_buffer);
 
+/*
+ * pgstrom_arrow_fdw_metadata_stats
+ *
+ * It returns hit/miss counters of the metadata cache.
+ */
+Datum
+pgstrom_arrow_fdw_metadata_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[6];
+	bool		isnull[6];
+
+	tupdesc = CreateTemplateTupleDesc(6);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "shmem_hits",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "shmem_misses",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "disk_hits",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "disk_misses",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "disk_writes",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 6, "shmem_consumed",
+					   INT8OID, -1, 0);
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int64GetDatum(pg_atomic_read_u64(&arrow_metadata_state->stat_shmem_hits));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&arrow_metadata_state->stat_shmem_misses));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&arrow_metadata_state->stat_disk_hits));
+	values[3] = Int64GetDatum(pg_atomic_read_u64(&arrow_metadata_state->stat_disk_misses));
+	values[4] = Int64GetDatum(pg_atomic_read_u64(&arrow_metadata_state->stat_disk_writes));
+	values[5] = Int64GetDatum(pg_atomic_read_u64(&arrow_metadata_state->consumed));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, isnull)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_metadata_stats);
+
 /*
  * pgstrom_startup_arrow_fdw
  */
@@ -5377,6 +13119,11 @@ pgstrom_startup_arrow_fdw(void)
 		SpinLockInit(&arrow_metadata_state->lru_lock);
 		dlist_init(&arrow_metadata_state->lru_list);
 		pg_atomic_init_u64(&arrow_metadata_state->consumed, 0UL);
+		pg_atomic_init_u64(&arrow_metadata_state->stat_shmem_hits, 0UL);
+		pg_atomic_init_u64(&arrow_metadata_state->stat_shmem_misses, 0UL);
+		pg_atomic_init_u64(&arrow_metadata_state->stat_disk_hits, 0UL);
+		pg_atomic_init_u64(&arrow_metadata_state->stat_disk_misses, 0UL);
+		pg_atomic_init_u64(&arrow_metadata_state->stat_disk_writes, 0UL);
 		for (i=0; i < ARROW_METADATA_HASH_NSLOTS; i++)
 		{
 			LWLockInitialize(&arrow_metadata_state->lock_slots[i], -1);
@@ -5389,6 +13136,7 @@ pgstrom_startup_arrow_fdw(void)
 			LWLockInitialize(&arrow_metadata_state->gpubuf_locks[i], -1);
 			dlist_init(&arrow_metadata_state->gpubuf_slots[i]);
 		}
+		arrowPruneMetadataCacheFiles();
 	}
 }
 
@@ -5406,6 +13154,7 @@ pgstrom_init_arrow_fdw(void)
 	r->GetForeignRelSize			= ArrowGetForeignRelSize;
 	r->GetForeignPaths				= ArrowGetForeignPaths;
 	r->GetForeignPlan				= ArrowGetForeignPlan;
+	r->GetForeignUpperPaths			= ArrowGetForeignUpperPaths;
 	r->BeginForeignScan				= ArrowBeginForeignScan;
 	r->IterateForeignScan			= ArrowIterateForeignScan;
 	r->ReScanForeignScan			= ArrowReScanForeignScan;
@@ -5429,6 +13178,14 @@ pgstrom_init_arrow_fdw(void)
 	r->ExecForeignInsert			= ArrowExecForeignInsert;
 	r->EndForeignModify				= ArrowEndForeignModify;
 	r->ExplainForeignModify			= ArrowExplainForeignModify;
+#if PG_VERSION_NUM >= 110000
+	r->BeginForeignInsert			= ArrowBeginForeignInsert;
+	r->EndForeignInsert				= ArrowEndForeignInsert;
+#endif
+#if PG_VERSION_NUM >= 140000
+	r->GetForeignModifyBatchSize	= ArrowGetForeignModifyBatchSize;
+	r->ExecForeignBatchInsert		= ArrowExecForeignBatchInsert;
+#endif
 
 	/*
 	 * Turn on/off arrow_fdw
@@ -5451,12 +13208,21 @@ pgstrom_init_arrow_fdw(void)
 							&arrow_metadata_cache_size_kb,
 							131072,		/* 128MB */
 							32768,		/* 32MB */
-							INT_MAX,
+							MAX_KILOBYTES,
 							PGC_POSTMASTER,
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
 	arrow_metadata_cache_size = (size_t)arrow_metadata_cache_size_kb << 10;
 
+	DefineCustomBoolVariable("arrow_fdw.metadata_cache_persistent",
+							 "Enables to save metadata cache of arrow files on the disk",
+							 NULL,
+							 &arrow_metadata_cache_persistent,
+							 true,
+							 PGC_SIGHUP,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/*
 	 * Debug option to hint number of rows
 	 */
@@ -5483,6 +13249,134 @@ pgstrom_init_arrow_fdw(void)
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
 
+	/*
+	 * Turn on/off mmap(2) based RecordBatch load on CPU scan
+	 *
+	 * It is off by the default, because arrow files are usually put by
+	 * external tools; if the file is truncated while it is mapped, any
+	 * access to the lost pages raises SIGBUS, then the postmaster resets
+	 * all the backends.
+	 */
+	DefineCustomBoolVariable("arrow_fdw.enable_mmap",
+							 "Enables to map arrow files for CPU scan, instead of buffer read",
+							 "Backend crashes by SIGBUS if the file is truncated during the scan",
+							 &arrow_fdw_enable_mmap,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Number of RecordBatches to read-ahead on CPU scan
+	 */
+	DefineCustomIntVariable("arrow_fdw.readahead_depth",
+							"number of RecordBatches to read-ahead on CPU scan",
+							NULL,
+							&arrow_fdw_readahead_depth,
+							2,
+							0,
+							64,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	/*
+	 * Unit size to split a large RecordBatch on parallel scan
+	 */
+	DefineCustomIntVariable("arrow_fdw.split_unit_size",
+							"unit size to split a large RecordBatch on parallel scan",
+							NULL,
+							&arrow_fdw_split_unit_size_kb,
+							256 * 1024,		/* default: 256MB */
+							0,				/* 0 = never split */
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("arrow_fdw.sorted_merge_limit",
+							"maximum number of sorted runs merged by ordered scan",
+							NULL,
+							&arrow_fdw_sorted_merge_limit,
+							256,
+							0,				/* 0 = never ordered scan */
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("arrow_fdw.enable_metadata_agg",
+							 "Enables count/min/max aggregation by the metadata of RecordBatches",
+							 NULL,
+							 &arrow_fdw_enable_metadata_agg,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Number of rows to be appended to the buffer at once on INSERT
+	 */
+	DefineCustomIntVariable("arrow_fdw.insert_batch_size",
+							"Number of rows to be appended column by column on INSERT or COPY FROM",
+							NULL,
+							&arrow_fdw_insert_batch_size,
+							1024,
+							1,
+							65536,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	/*
+	 * Background compaction of small RecordBatches
+	 */
+	DefineCustomStringVariable("arrow_fdw.compaction_database",
+							   "Database where the compaction worker runs on",
+							   "The compaction worker is not launched if empty",
+							   &arrow_fdw_compaction_database,
+							   NULL,
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	DefineCustomIntVariable("arrow_fdw.compaction_naptime",
+							"Interval of the compaction worker",
+							NULL,
+							&arrow_fdw_compaction_naptime,
+							60,
+							1,
+							INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_S,
+							NULL, NULL, NULL);
+	DefineCustomIntVariable("arrow_fdw.compaction_min_batches",
+							"Minimum number of small RecordBatches in a file to be compacted by the worker",
+							NULL,
+							&arrow_fdw_compaction_min_batches,
+							16,
+							2,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	if (arrow_fdw_compaction_database &&
+		arrow_fdw_compaction_database[0] != '\0')
+	{
+		BackgroundWorker worker;
+
+		memset(&worker, 0, sizeof(BackgroundWorker));
+		snprintf(worker.bgw_name, sizeof(worker.bgw_name),
+				 "arrow_fdw compaction worker");
+		worker.bgw_flags = (BGWORKER_SHMEM_ACCESS |
+							BGWORKER_BACKEND_DATABASE_CONNECTION);
+		worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+		worker.bgw_restart_time = 60;
+		snprintf(worker.bgw_library_name, BGW_MAXLEN, "pg_strom");
+		snprintf(worker.bgw_function_name, BGW_MAXLEN, "arrowFdwCompactionMain");
+		worker.bgw_main_arg = 0;
+		RegisterBackgroundWorker(&worker);
+	}
+
 	/* shared memory size */
 	RequestAddinShmemSpace(MAXALIGN(sizeof(arrowMetadataState)));
 	shmem_startup_next = shmem_startup_hook;
@@ -33,6 +33,8 @@ typedef struct SQLbuffer		SQLbuffer;
 typedef struct SQLtable			SQLtable;
 typedef struct SQLfield			SQLfield;
 typedef struct SQLdictionary	SQLdictionary;
+typedef struct SQLstat			SQLstat;
+typedef struct SQLwbuffer		SQLwbuffer;
 typedef union  SQLtype			SQLtype;
 typedef struct SQLtype__pgsql	SQLtype__pgsql;
 typedef struct SQLtype__mysql	SQLtype__mysql;
@@ -67,6 +69,28 @@ union SQLtype
 	SQLtype__mysql	mysql;
 };
 
+/*
+ * SQLstat - min/max statistics of a field for each RecordBatch
+ *
+ * Values are kept in the native representation of the Arrow type; integer
+ * based types (Int, Date, Time and Timestamp) use @i64, and FloatingPoint
+ * uses @f64.
+ */
+typedef union
+{
+	int64		i64;
+	double		f64;
+} SQLstat__datum;
+
+struct SQLstat
+{
+	SQLstat	   *next;
+	int			rb_index;		/* index of the RecordBatch */
+	bool		is_valid;		/* false, if all NULLs or unknown */
+	SQLstat__datum min;
+	SQLstat__datum max;
+};
+
 struct SQLfield
 {
 	char	   *field_name;		/* name of the column, element or sub-field */
@@ -87,6 +111,9 @@ struct SQLfield
 	SQLbuffer	values;			/* main storage of values */
 	SQLbuffer	extra;			/* extra buffer for varlena */
 	size_t		__curr_usage__;	/* current buffer usage */
+	/* min/max statistics for each RecordBatch (optional) */
+	bool		stat_enabled;
+	SQLstat	   *stat_list;		/* SQLstat list in order of rb_index */
 	/* custom metadata(optional) */
 	ArrowKeyValue *customMetadata;
 	int			numCustomMetadata;
@@ -97,10 +124,27 @@ sql_field_put_value(SQLfield *column, const char *addr, int sz)
 	return (column->__curr_usage__ = column->put_value(column, addr, sz));
 }
 
+/*
+ * SQLwbuffer - write-combining buffer of the output file
+ *
+ * If SQLtable has @wbuffer, all the writes are accumulated on the buffer,
+ * then written out by pwrite(2) with @length bytes at once, on the file
+ * offset aligned to @align. It allows to open the file with O_DIRECT.
+ */
+struct SQLwbuffer
+{
+	char	   *data;			/* buffer aligned to @align */
+	size_t		usage;
+	size_t		length;			/* flushed when filled up */
+	size_t		align;			/* alignment of file offset and length */
+	off_t		f_pos;			/* file offset of the @data */
+};
+
 struct SQLtable
 {
 	const char *filename;		/* output filename */
 	int			fdesc;			/* output file descriptor */
+	SQLwbuffer *wbuffer;		/* write-combining buffer, if any */
 	ArrowBlock *recordBatches;	/* recordBatches written in the past */
 	int			numRecordBatches;
 	ArrowBlock *dictionaries;	/* dictionaryBatches written in the past */
@@ -111,6 +155,9 @@ struct SQLtable
 	int			numCustomMetadata;
 	SQLdictionary *sql_dict_list; /* list of SQLdictionary */
 	size_t		segment_sz;		/* threshold of the memory usage */
+	bool		compressed;		/* writes compressed RecordBatches */
+	ArrowCompressionType codec;	/* compression codec, if @compressed */
+	SQLbuffer	zbuffer;		/* working buffer of the compressed body */
 	size_t		nitems;			/* number of items */
 	int			nfields;		/* number of attributes */
 	SQLfield columns[FLEXIBLE_ARRAY_MEMBER];
@@ -132,7 +179,8 @@ struct SQLdictionary
 	int64		dict_id;
 	SQLbuffer	values;
 	SQLbuffer	extra;
-	int			nloaded;	/* # of items loaded from existing file */
+	int			nloaded;	/* # of items already in the file */
+	bool		is_written;	/* true, if DictionaryBatch is in the file */
 	int			nitems;
 	int			nslots;		/* width of hash slot */
 	hashItem   *hslots[FLEXIBLE_ARRAY_MEMBER];
@@ -141,9 +189,29 @@ struct SQLdictionary
 /* arrow_write.c */
 extern ssize_t	writeArrowSchema(SQLtable *table);
 extern void		writeArrowDictionaryBatches(SQLtable *table);
+extern void		resetArrowDictionaryBatches(SQLtable *table);
 extern int		writeArrowRecordBatch(SQLtable *table);
 extern ssize_t	writeArrowFooter(SQLtable *table);
+extern void		sql_table_attach_wbuffer(SQLtable *table,
+										 size_t length, size_t align);
+extern void		sql_table_detach_wbuffer(SQLtable *table);
+extern void		sql_table_clear(SQLtable *table);
+extern size_t	sql_field_append_row(SQLfield *dest, SQLfield *source,
+									 size_t index);
+extern size_t	sql_table_append_row(SQLtable *dest, SQLtable *source,
+									 size_t index);
 extern size_t	estimateArrowBufferLength(SQLfield *column, size_t nitems);
+extern bool		enableArrowFieldStat(SQLfield *column);
+extern void		setupArrowFieldDictionary(SQLfield *column,
+										  SQLdictionary *dict);
+extern bool		enableArrowFieldDictionary(SQLtable *table,
+										   SQLfield *column,
+										   int max_cardinality);
+extern SQLstat *readArrowFieldStat(ArrowField *field, int num_rbatches);
+extern void		restoreArrowFieldStats(SQLtable *table,
+									   ArrowFileInfo *af_info);
+extern bool		lookupArrowCompressionCodec(const char *name,
+											ArrowCompressionType *p_codec);
 
 /* arrow_nodes.c */
 extern void		__initArrowNode(ArrowNode *node, ArrowNodeTag tag);
@@ -152,6 +220,8 @@ extern void		__initArrowNode(ArrowNode *node, ArrowNodeTag tag);
 extern char	   *dumpArrowNode(ArrowNode *node);
 extern void		copyArrowNode(ArrowNode *dest, const ArrowNode *src);
 extern void		readArrowFileDesc(int fdesc, ArrowFileInfo *af_info);
+extern void		readArrowStreamDesc(int fdesc, ArrowFileInfo *af_info,
+									size_t resume_offset);
 extern char	   *arrowTypeName(ArrowField *field);
 
 /* arrow_pgsql.c */
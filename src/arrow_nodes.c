@@ -350,6 +350,18 @@ __dumpArrowSchema(SQLbuffer *buf, ArrowNode *node)
 	sql_buffer_printf(buf, "]}");
 }
 
+static void
+__dumpArrowBodyCompression(SQLbuffer *buf, ArrowNode *node)
+{
+	ArrowBodyCompression *c = (ArrowBodyCompression *)node;
+
+	sql_buffer_printf(
+		buf, "{BodyCompression: codec=%s, method=%s}",
+		c->codec == ArrowCompressionType__LZ4_FRAME ? "LZ4_FRAME" :
+		c->codec == ArrowCompressionType__ZSTD ? "ZSTD" : "???",
+		c->method == ArrowBodyCompressionMethod__BUFFER ? "BUFFER" : "???");
+}
+
 static void
 __dumpArrowRecordBatch(SQLbuffer *buf, ArrowNode *node)
 {
@@ -370,7 +382,13 @@ __dumpArrowRecordBatch(SQLbuffer *buf, ArrowNode *node)
 			sql_buffer_printf(buf, ", ");
 		__dumpArrowNode(buf, (ArrowNode *)&r->buffers[i]);
 	}
-	sql_buffer_printf(buf,"]}");
+	sql_buffer_printf(buf,"]");
+	if (r->compression)
+	{
+		sql_buffer_printf(buf, ", compression=");
+		__dumpArrowNode(buf, (ArrowNode *)r->compression);
+	}
+	sql_buffer_printf(buf,"}");
 }
 
 static void
@@ -396,7 +414,8 @@ __dumpArrowMessage(SQLbuffer *buf, ArrowNode *node)
 		m->version == ArrowMetadataVersion__V1 ? "V1" :
 		m->version == ArrowMetadataVersion__V2 ? "V2" :
 		m->version == ArrowMetadataVersion__V3 ? "V3" :
-		m->version == ArrowMetadataVersion__V4 ? "V4" : "???");
+		m->version == ArrowMetadataVersion__V4 ? "V4" :
+		m->version == ArrowMetadataVersion__V5 ? "V5" : "???");
 	__dumpArrowNode(buf, (ArrowNode *)&m->body);
 	sql_buffer_printf(buf, ", bodyLength=%lu}", m->bodyLength);
 }
@@ -422,7 +441,8 @@ __dumpArrowFooter(SQLbuffer *buf, ArrowNode *node)
 		f->version == ArrowMetadataVersion__V1 ? "V1" :
 		f->version == ArrowMetadataVersion__V2 ? "V2" :
 		f->version == ArrowMetadataVersion__V3 ? "V3" :
-		f->version == ArrowMetadataVersion__V4 ? "V4" : "???");
+		f->version == ArrowMetadataVersion__V4 ? "V4" :
+		f->version == ArrowMetadataVersion__V5 ? "V5" : "???");
 	__dumpArrowNode(buf, (ArrowNode *)&f->schema);
 	sql_buffer_printf(buf, ", dictionaries=[");
 	for (i=0; i < f->_num_dictionaries; i++)
@@ -688,6 +708,15 @@ __copyArrowSchema(ArrowSchema *dest, const ArrowSchema *src)
 	COPY_VECTOR(custom_metadata, ArrowKeyValue);
 }
 
+static void
+__copyArrowBodyCompression(ArrowBodyCompression *dest,
+						   const ArrowBodyCompression *src)
+{
+	__copyArrowNode(&dest->node, &src->node);
+	COPY_SCALAR(codec);
+	COPY_SCALAR(method);
+}
+
 static void
 __copyArrowRecordBatch(ArrowRecordBatch *dest, const ArrowRecordBatch *src)
 {
@@ -695,6 +724,13 @@ __copyArrowRecordBatch(ArrowRecordBatch *dest, const ArrowRecordBatch *src)
 	COPY_SCALAR(length);
 	COPY_VECTOR(nodes, ArrowFieldNode);
 	COPY_VECTOR(buffers, ArrowBuffer);
+	if (!src->compression)
+		dest->compression = NULL;
+	else
+	{
+		dest->compression = palloc0(sizeof(ArrowBodyCompression));
+		__copyArrowBodyCompression(dest->compression, src->compression);
+	}
 }
 
 static void
@@ -717,11 +753,11 @@ __copyArrowMessage(ArrowMessage *dest, const ArrowMessage *src)
 		case ArrowNodeTag__Schema:
 			__copyArrowSchema(&dest->body.schema, &src->body.schema);
 			break;
-		case ArrowNodeTag__RecordBatch:
+		case ArrowNodeTag__DictionaryBatch:
 			__copyArrowDictionaryBatch(&dest->body.dictionaryBatch,
 									   &src->body.dictionaryBatch);
 			break;
-		case ArrowNodeTag__DictionaryBatch:
+		case ArrowNodeTag__RecordBatch:
 			__copyArrowRecordBatch(&dest->body.recordBatch,
 								   &src->body.recordBatch);
 			break;
@@ -942,6 +978,7 @@ __initArrowNode(ArrowNode *node, ArrowNodeTag tag)
 		CASE_ARROW_NODE(FieldNode);
 		CASE_ARROW_NODE(Buffer);
 		CASE_ARROW_NODE(Schema);
+		CASE_ARROW_NODE(BodyCompression);
 		CASE_ARROW_NODE(RecordBatch);
 		CASE_ARROW_NODE(DictionaryBatch);
 		CASE_ARROW_NODE(Message);
@@ -1499,6 +1536,22 @@ readArrowBuffer(ArrowBuffer *node, const char *pos)
 
 }
 
+static void
+readArrowBodyCompression(ArrowBodyCompression *compression, const char *pos)
+{
+	FBTable		t = fetchFBTable((int32 *)pos);
+
+	memset(compression, 0, sizeof(ArrowBodyCompression));
+	INIT_ARROW_NODE(compression, BodyCompression);
+	compression->codec	= fetchChar(&t, 0);
+	compression->method	= fetchChar(&t, 1);
+	if (compression->codec != ArrowCompressionType__LZ4_FRAME &&
+		compression->codec != ArrowCompressionType__ZSTD)
+		Elog("unknown compression codec: %d", compression->codec);
+	if (compression->method != ArrowBodyCompressionMethod__BUFFER)
+		Elog("unknown body compression method: %d", compression->method);
+}
+
 static void
 readArrowRecordBatch(ArrowRecordBatch *rbatch, const char *pos)
 {
@@ -1528,6 +1581,16 @@ readArrowRecordBatch(ArrowRecordBatch *rbatch, const char *pos)
 			next += readArrowBuffer(&rbatch->buffers[i], next);
 	}
 	rbatch->_num_buffers = nitems;
+
+	/* compression: BodyCompression (optional) */
+	next = fetchOffset(&t, 3);
+	if (!next)
+		rbatch->compression = NULL;
+	else
+	{
+		rbatch->compression = palloc0(sizeof(ArrowBodyCompression));
+		readArrowBodyCompression(rbatch->compression, next);
+	}
 }
 
 static void
@@ -1558,7 +1621,8 @@ readArrowMessage(ArrowMessage *message, const char *pos)
 	next				= fetchOffset(&t, 2);
 	message->bodyLength	= fetchLong(&t, 3);
 
-	if (message->version != ArrowMetadataVersion__V4)
+	if (message->version != ArrowMetadataVersion__V4 &&
+		message->version != ArrowMetadataVersion__V5)
 		Elog("metadata version %d is not supported", message->version);
 
 	switch (mtype)
@@ -1680,6 +1744,24 @@ readArrowFileDesc(int fdesc, ArrowFileInfo *af_info)
 		Elog("failed on mmap: %m");
 	mmap_tail = mmap_head + file_sz - ARROW_FILE_TAIL_SIGNATURE_SZ;
 
+	/*
+	 * no head signature, but begins with the continuation marker, so it
+	 * may be IPC streaming format (readArrowStreamDesc also checks the
+	 * first message is Schema)
+	 */
+	if (file_sz >= 2 * sizeof(int32) &&
+		memcmp(mmap_head,
+			   ARROW_FILE_HEAD_SIGNATURE,
+			   ARROW_FILE_HEAD_SIGNATURE_SZ) != 0 &&
+		*((uint32 *)mmap_head) == 0xffffffffU)
+	{
+		__munmap(mmap_head, mmap_sz);
+		readArrowStreamDesc(fdesc, af_info, 0);
+		return;
+	}
+	if (file_sz < ARROW_FILE_HEAD_SIGNATURE_SZ + ARROW_FILE_TAIL_SIGNATURE_SZ)
+		Elog("Signature mismatch on Apache Arrow file");
+
 	/* check signature */
 	if (memcmp(mmap_head,
 			   ARROW_FILE_HEAD_SIGNATURE,
@@ -1757,3 +1839,169 @@ readArrowFileDesc(int fdesc, ArrowFileInfo *af_info)
 	}
 	__munmap(mmap_head, mmap_sz);
 }
+
+/*
+ * __appendArrowStreamBlock - add a message walked on the IPC stream
+ */
+static void
+__appendArrowStreamBlock(ArrowBlock **p_blocks, ArrowMessage **p_messages,
+						 int *p_nitems, int *p_nrooms,
+						 int64 offset, int32 metaDataLength,
+						 ArrowMessage *message)
+{
+	ArrowBlock *block;
+	int			nitems = *p_nitems;
+
+	if (nitems >= *p_nrooms)
+	{
+		int		nrooms = 2 * *p_nrooms + 20;
+
+		if (*p_blocks == NULL)
+		{
+			*p_blocks = palloc0(sizeof(ArrowBlock) * nrooms);
+			*p_messages = palloc0(sizeof(ArrowMessage) * nrooms);
+		}
+		else
+		{
+			*p_blocks = repalloc(*p_blocks, sizeof(ArrowBlock) * nrooms);
+			*p_messages = repalloc(*p_messages, sizeof(ArrowMessage) * nrooms);
+		}
+		*p_nrooms = nrooms;
+	}
+	block = &(*p_blocks)[nitems];
+	memset(block, 0, sizeof(ArrowBlock));
+	INIT_ARROW_NODE(block, Block);
+	block->offset = offset;
+	block->metaDataLength = metaDataLength;
+	block->bodyLength = message->bodyLength;
+	memcpy(&(*p_messages)[nitems], message, sizeof(ArrowMessage));
+	*p_nitems = nitems + 1;
+}
+
+/*
+ * readArrowStreamDesc - read the supplied apache arrow file in the IPC
+ * streaming format
+ *
+ * The streaming format has no footer, so it walks on the message headers
+ * from the head, then builds af_info->footer according to the Schema message
+ * and the positions of DictionaryBatch/RecordBatch messages.
+ * If @resume_offset is positive, the walk jumps to the position next to the
+ * Schema message, then af_info contains only the messages behind it. It is
+ * used to parse only the tail of the file grown by the writer.
+ * A message partially written at the tail is not returned. af_info->stream_tail
+ * points the head of the message (or end-of-stream marker) not read yet.
+ */
+void
+readArrowStreamDesc(int fdesc, ArrowFileInfo *af_info, size_t resume_offset)
+{
+	ArrowFooter	   *footer = &af_info->footer;
+	size_t			file_sz;
+	size_t			mmap_sz;
+	char		   *mmap_head;
+	size_t			offset = 0;
+	int				dict_nrooms = 0;
+	int				rb_nrooms = 0;
+
+	memset(af_info, 0, sizeof(ArrowFileInfo));
+	if (fstat(fdesc, &af_info->stat_buf) != 0)
+		Elog("failed on fstat: %m");
+	file_sz = af_info->stat_buf.st_size;
+	if (file_sz == 0)
+		Elog("Empty file is not Apache Arrow");
+	mmap_sz = TYPEALIGN(sysconf(_SC_PAGESIZE), file_sz);
+	mmap_head = __mmap(NULL, mmap_sz, PROT_READ, MAP_SHARED, fdesc, 0);
+	if (mmap_head == MAP_FAILED)
+		Elog("failed on mmap: %m");
+	af_info->is_stream = true;
+	INIT_ARROW_NODE(footer, Footer);
+
+	while (offset + sizeof(int32) <= file_sz)
+	{
+		int32	   *ival = (int32 *)(mmap_head + offset);
+		int32		metaLength;
+		int32		headLength = 2 * sizeof(int32);
+		int32		rootOffset;
+		const char *pos;
+		ArrowMessage message;
+
+		/*
+		 * Every message must begin with the continuation marker; the older
+		 * format prior to Arrow v0.15 is not supported for streams, because
+		 * we cannot tell it from random binary files.
+		 */
+		if (*((uint32 *)ival) != 0xffffffffU)
+		{
+			if (offset == 0)
+				Elog("Signature mismatch on Apache Arrow file");
+			Elog("Corrupted message header at offset %zu", offset);
+		}
+		if (offset + headLength > file_sz)
+			break;
+		metaLength = ival[1];
+		/* end-of-stream marker */
+		if (metaLength == 0)
+			break;
+		if (metaLength < (int32)sizeof(int32))
+			Elog("Corrupted message header at offset %zu", offset);
+		/* message partially written yet */
+		if (offset + headLength + metaLength > file_sz)
+			break;
+		/* the flatbuffer root table must be inside of the metadata */
+		pos = (const char *)ival + headLength;
+		rootOffset = *((int32 *)pos);
+		if (rootOffset < (int32)sizeof(int32) ||
+			rootOffset > metaLength - (int32)sizeof(int32))
+			Elog("Corrupted message header at offset %zu", offset);
+		readArrowMessage(&message, pos + rootOffset);
+		if (message.bodyLength < 0)
+			Elog("Corrupted message body at offset %zu", offset);
+		if (offset + headLength + metaLength + message.bodyLength > file_sz)
+			break;
+
+		switch (message.body.node.tag)
+		{
+			case ArrowNodeTag__Schema:
+				if (offset != 0)
+					Elog("Schema message appeared at offset %zu", offset);
+				footer->version = message.version;
+				memcpy(&footer->schema, &message.body.schema,
+					   sizeof(ArrowSchema));
+				break;
+			case ArrowNodeTag__DictionaryBatch:
+				if (offset == 0)
+					Elog("IPC stream must begin with Schema message");
+				__appendArrowStreamBlock(&footer->dictionaries,
+										 &af_info->dictionaries,
+										 &footer->_num_dictionaries,
+										 &dict_nrooms,
+										 offset, headLength + metaLength,
+										 &message);
+				break;
+			case ArrowNodeTag__RecordBatch:
+				if (offset == 0)
+					Elog("IPC stream must begin with Schema message");
+				__appendArrowStreamBlock(&footer->recordBatches,
+										 &af_info->recordBatches,
+										 &footer->_num_recordBatches,
+										 &rb_nrooms,
+										 offset, headLength + metaLength,
+										 &message);
+				break;
+			default:
+				Elog("unexpected message type at offset %zu", offset);
+		}
+		offset += headLength + metaLength + message.bodyLength;
+		/* skip the messages already read */
+		if (footer->schema.node.tag == ArrowNodeTag__Schema &&
+			offset < resume_offset)
+		{
+			if (resume_offset > file_sz)
+				Elog("resume offset %zu is out of the file", resume_offset);
+			offset = resume_offset;
+		}
+	}
+	if (footer->schema.node.tag != ArrowNodeTag__Schema)
+		Elog("Signature mismatch on Apache Arrow file");
+	af_info->stream_tail = offset;
+	__munmap(mmap_head, mmap_sz);
+}
@@ -0,0 +1,2011 @@
+/*
+ * arrow_parquet.c
+ *
+ * Routines to read Apache Parquet files on behalf of arrow_fdw; metadata
+ * of the row groups is mapped to the Apache Arrow schema, and column chunks
+ * are decoded to the buffers of the Apache Arrow layout.
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+#include "arrow_defs.h"
+#include "arrow_ipc.h"
+#include "parquet_defs.h"
+
+/*
+ * Thrift Compact Protocol
+ *
+ * FileMetaData and PageHeader of Parquet are serialized by the Thrift compact
+ * protocol. We have only a minimum reader of the structures below.
+ */
+#define THRIFT_TYPE__STOP			0
+#define THRIFT_TYPE__BOOLEAN_TRUE	1
+#define THRIFT_TYPE__BOOLEAN_FALSE	2
+#define THRIFT_TYPE__BYTE			3
+#define THRIFT_TYPE__I16			4
+#define THRIFT_TYPE__I32			5
+#define THRIFT_TYPE__I64			6
+#define THRIFT_TYPE__DOUBLE			7
+#define THRIFT_TYPE__BINARY			8
+#define THRIFT_TYPE__LIST			9
+#define THRIFT_TYPE__SET			10
+#define THRIFT_TYPE__MAP			11
+#define THRIFT_TYPE__STRUCT			12
+
+typedef struct
+{
+	const unsigned char *pos;
+	const unsigned char *end;
+} ThriftCursor;
+
+static uint64
+__thriftReadVarint(ThriftCursor *t)
+{
+	uint64		value = 0;
+	int			shift = 0;
+
+	for (;;)
+	{
+		unsigned char	c;
+
+		if (t->pos >= t->end || shift >= 64)
+			elog(ERROR, "parquet: corrupted thrift varint");
+		c = *t->pos++;
+		value |= ((uint64)(c & 0x7f)) << shift;
+		if ((c & 0x80) == 0)
+			break;
+		shift += 7;
+	}
+	return value;
+}
+
+static int64
+__thriftReadZigZag(ThriftCursor *t)
+{
+	uint64		value = __thriftReadVarint(t);
+
+	return (int64)(value >> 1) ^ -((int64)(value & 1));
+}
+
+#define __thriftReadI32(t)		((int32)__thriftReadZigZag(t))
+#define __thriftReadI64(t)		((int64)__thriftReadZigZag(t))
+
+static bool
+__thriftReadBool(ThriftCursor *t, int ftype)
+{
+	/* boolean of struct field is embedded in the field header */
+	if (ftype == THRIFT_TYPE__BOOLEAN_TRUE)
+		return true;
+	if (ftype == THRIFT_TYPE__BOOLEAN_FALSE)
+		return false;
+	elog(ERROR, "parquet: thrift field is not boolean");
+}
+
+static const char *
+__thriftReadBinary(ThriftCursor *t, int32 *p_length)
+{
+	uint64		length = __thriftReadVarint(t);
+	const char *result = (const char *)t->pos;
+
+	if (length > t->end - t->pos)
+		elog(ERROR, "parquet: corrupted thrift binary");
+	t->pos += length;
+	*p_length = length;
+	return result;
+}
+
+static char *
+__thriftReadString(ThriftCursor *t)
+{
+	const char *addr;
+	int32		length;
+
+	addr = __thriftReadBinary(t, &length);
+	return pnstrdup(addr, length);
+}
+
+static int32
+__thriftReadListHeader(ThriftCursor *t, int *p_elem_type)
+{
+	unsigned char	c;
+	int32			nitems;
+
+	if (t->pos >= t->end)
+		elog(ERROR, "parquet: corrupted thrift list");
+	c = *t->pos++;
+	*p_elem_type = (c & 0x0f);
+	nitems = (c >> 4);
+	if (nitems == 15)
+		nitems = __thriftReadVarint(t);
+	if (nitems < 0)
+		elog(ERROR, "parquet: corrupted thrift list");
+	return nitems;
+}
+
+/*
+ * __thriftNextField - fetch the next field header of the struct, or return
+ * false on the end of struct.
+ */
+static bool
+__thriftNextField(ThriftCursor *t, int16 *p_field_id, int *p_field_type)
+{
+	unsigned char	c;
+	int				delta;
+
+	if (t->pos >= t->end)
+		elog(ERROR, "parquet: corrupted thrift struct");
+	c = *t->pos++;
+	if (c == THRIFT_TYPE__STOP)
+		return false;
+	delta = (c >> 4);
+	if (delta != 0)
+		*p_field_id += delta;
+	else
+		*p_field_id = (int16)__thriftReadZigZag(t);
+	*p_field_type = (c & 0x0f);
+	return true;
+}
+
+static void
+__thriftSkip(ThriftCursor *t, int type)
+{
+	int		elem_type;
+	int32	i, nitems;
+
+	switch (type)
+	{
+		case THRIFT_TYPE__BOOLEAN_TRUE:
+		case THRIFT_TYPE__BOOLEAN_FALSE:
+			break;
+		case THRIFT_TYPE__BYTE:
+			if (t->pos >= t->end)
+				elog(ERROR, "parquet: corrupted thrift byte");
+			t->pos++;
+			break;
+		case THRIFT_TYPE__I16:
+		case THRIFT_TYPE__I32:
+		case THRIFT_TYPE__I64:
+			(void) __thriftReadVarint(t);
+			break;
+		case THRIFT_TYPE__DOUBLE:
+			if (t->end - t->pos < sizeof(double))
+				elog(ERROR, "parquet: corrupted thrift double");
+			t->pos += sizeof(double);
+			break;
+		case THRIFT_TYPE__BINARY:
+			(void) __thriftReadBinary(t, &nitems);
+			break;
+		case THRIFT_TYPE__LIST:
+		case THRIFT_TYPE__SET:
+			nitems = __thriftReadListHeader(t, &elem_type);
+			for (i=0; i < nitems; i++)
+			{
+				/* boolean in the list is a byte */
+				if (elem_type == THRIFT_TYPE__BOOLEAN_TRUE ||
+					elem_type == THRIFT_TYPE__BOOLEAN_FALSE)
+					__thriftSkip(t, THRIFT_TYPE__BYTE);
+				else
+					__thriftSkip(t, elem_type);
+			}
+			break;
+		case THRIFT_TYPE__MAP:
+			nitems = __thriftReadVarint(t);
+			if (nitems > 0)
+			{
+				int		key_type, val_type;
+
+				if (t->pos >= t->end)
+					elog(ERROR, "parquet: corrupted thrift map");
+				key_type = (*t->pos >> 4);
+				val_type = (*t->pos & 0x0f);
+				t->pos++;
+				for (i=0; i < nitems; i++)
+				{
+					__thriftSkip(t, key_type);
+					__thriftSkip(t, val_type);
+				}
+			}
+			break;
+		case THRIFT_TYPE__STRUCT:
+			{
+				int16	fid = 0;
+				int		ftype;
+
+				while (__thriftNextField(t, &fid, &ftype))
+					__thriftSkip(t, ftype);
+			}
+			break;
+		default:
+			elog(ERROR, "parquet: unknown thrift type %d", type);
+	}
+}
+
+/*
+ * Parquet metadata structures
+ */
+typedef struct
+{
+	int32		type;			/* ParquetType, or -1 if group */
+	int32		type_length;
+	int32		repetition_type;
+	char	   *name;
+	int32		num_children;
+	int32		converted_type;	/* -1, if none */
+	int32		scale;
+	int32		precision;
+	/* LogicalType */
+	int32		logical_type;	/* -1, if none */
+	int32		logical_scale;
+	int32		logical_precision;
+	int32		logical_unit;	/* 1:MILLIS, 2:MICROS, 3:NANOS */
+	bool		logical_utc;
+	int32		logical_bitwidth;
+	bool		logical_signed;
+} ParquetSchemaElement;
+
+typedef struct
+{
+	const char *min;
+	int32		min_len;
+	const char *max;
+	int32		max_len;
+	bool		is_legacy;		/* min/max, not min_value/max_value */
+	int64		null_count;		/* -1, if unknown */
+} ParquetStatistics;
+
+typedef struct
+{
+	int32		type;
+	int32		codec;
+	int64		num_values;
+	int64		total_compressed_size;
+	int64		data_page_offset;
+	int64		dictionary_page_offset;	/* -1, if none */
+	int64		unencoded_bytes;		/* -1, if unknown */
+	bool		has_file_path;
+	ParquetStatistics stat;
+} ParquetColumnMetaData;
+
+typedef struct
+{
+	int32		type;			/* ParquetPageType */
+	int32		uncompressed_page_size;
+	int32		compressed_page_size;
+	int32		num_values;
+	int32		encoding;
+	int32		def_level_encoding;
+	/* only DATA_PAGE_V2 */
+	int32		num_nulls;
+	int32		def_levels_byte_length;
+	int32		rep_levels_byte_length;
+	bool		is_compressed;
+} ParquetPageHeader;
+
+static void
+__parquetReadStatistics(ThriftCursor *t, ParquetStatistics *stat)
+{
+	int16		fid = 0;
+	int			ftype;
+	const char *legacy_min = NULL;
+	const char *legacy_max = NULL;
+	int32		legacy_min_len = 0;
+	int32		legacy_max_len = 0;
+
+	memset(stat, 0, sizeof(ParquetStatistics));
+	stat->null_count = -1;
+	while (__thriftNextField(t, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:		/* max (deprecated) */
+				legacy_max = __thriftReadBinary(t, &legacy_max_len);
+				break;
+			case 2:		/* min (deprecated) */
+				legacy_min = __thriftReadBinary(t, &legacy_min_len);
+				break;
+			case 3:		/* null_count */
+				stat->null_count = __thriftReadI64(t);
+				break;
+			case 5:		/* max_value */
+				stat->max = __thriftReadBinary(t, &stat->max_len);
+				break;
+			case 6:		/* min_value */
+				stat->min = __thriftReadBinary(t, &stat->min_len);
+				break;
+			default:
+				__thriftSkip(t, ftype);
+				break;
+		}
+	}
+	if (!stat->min && !stat->max && legacy_min && legacy_max)
+	{
+		stat->min = legacy_min;
+		stat->min_len = legacy_min_len;
+		stat->max = legacy_max;
+		stat->max_len = legacy_max_len;
+		stat->is_legacy = true;
+	}
+}
+
+static void
+__parquetReadLogicalType(ThriftCursor *t, ParquetSchemaElement *elem)
+{
+	int16		fid = 0;
+	int			ftype;
+
+	while (__thriftNextField(t, &fid, &ftype))
+	{
+		int16	sub_fid = 0;
+		int		sub_ftype;
+
+		if (ftype != THRIFT_TYPE__STRUCT)
+		{
+			__thriftSkip(t, ftype);
+			continue;
+		}
+		elem->logical_type = fid;
+		while (__thriftNextField(t, &sub_fid, &sub_ftype))
+		{
+			switch (fid)
+			{
+				case ParquetLogicalType__DECIMAL:
+					if (sub_fid == 1)
+						elem->logical_scale = __thriftReadI32(t);
+					else if (sub_fid == 2)
+						elem->logical_precision = __thriftReadI32(t);
+					else
+						__thriftSkip(t, sub_ftype);
+					break;
+				case ParquetLogicalType__TIME:
+				case ParquetLogicalType__TIMESTAMP:
+					if (sub_fid == 1)
+						elem->logical_utc = __thriftReadBool(t, sub_ftype);
+					else if (sub_fid == 2 && sub_ftype == THRIFT_TYPE__STRUCT)
+					{
+						int16	unit_fid = 0;
+						int		unit_ftype;
+
+						/* TimeUnit union */
+						while (__thriftNextField(t, &unit_fid, &unit_ftype))
+						{
+							elem->logical_unit = unit_fid;
+							__thriftSkip(t, unit_ftype);
+						}
+					}
+					else
+						__thriftSkip(t, sub_ftype);
+					break;
+				case ParquetLogicalType__INTEGER:
+					if (sub_fid == 1 && sub_ftype == THRIFT_TYPE__BYTE)
+					{
+						if (t->pos >= t->end)
+							elog(ERROR, "parquet: corrupted thrift byte");
+						elem->logical_bitwidth = (int8)(*t->pos++);
+					}
+					else if (sub_fid == 2)
+						elem->logical_signed = __thriftReadBool(t, sub_ftype);
+					else
+						__thriftSkip(t, sub_ftype);
+					break;
+				default:
+					__thriftSkip(t, sub_ftype);
+					break;
+			}
+		}
+	}
+}
+
+static void
+__parquetReadSchemaElement(ThriftCursor *t, ParquetSchemaElement *elem)
+{
+	int16		fid = 0;
+	int			ftype;
+
+	memset(elem, 0, sizeof(ParquetSchemaElement));
+	elem->type = -1;
+	elem->converted_type = -1;
+	elem->logical_type = -1;
+	while (__thriftNextField(t, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				elem->type = __thriftReadI32(t);
+				break;
+			case 2:
+				elem->type_length = __thriftReadI32(t);
+				break;
+			case 3:
+				elem->repetition_type = __thriftReadI32(t);
+				break;
+			case 4:
+				elem->name = __thriftReadString(t);
+				break;
+			case 5:
+				elem->num_children = __thriftReadI32(t);
+				break;
+			case 6:
+				elem->converted_type = __thriftReadI32(t);
+				break;
+			case 7:
+				elem->scale = __thriftReadI32(t);
+				break;
+			case 8:
+				elem->precision = __thriftReadI32(t);
+				break;
+			case 10:
+				__parquetReadLogicalType(t, elem);
+				break;
+			default:
+				__thriftSkip(t, ftype);
+				break;
+		}
+	}
+}
+
+static void
+__parquetReadColumnMetaData(ThriftCursor *t, ParquetColumnMetaData *cmeta)
+{
+	int16		fid = 0;
+	int			ftype;
+
+	while (__thriftNextField(t, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				cmeta->type = __thriftReadI32(t);
+				break;
+			case 4:
+				cmeta->codec = __thriftReadI32(t);
+				break;
+			case 5:
+				cmeta->num_values = __thriftReadI64(t);
+				break;
+			case 7:
+				cmeta->total_compressed_size = __thriftReadI64(t);
+				break;
+			case 9:
+				cmeta->data_page_offset = __thriftReadI64(t);
+				break;
+			case 11:
+				cmeta->dictionary_page_offset = __thriftReadI64(t);
+				break;
+			case 12:
+				__parquetReadStatistics(t, &cmeta->stat);
+				break;
+			case 16:	/* SizeStatistics */
+				{
+					int16	sub_fid = 0;
+					int		sub_ftype;
+
+					while (__thriftNextField(t, &sub_fid, &sub_ftype))
+					{
+						if (sub_fid == 1)
+							cmeta->unencoded_bytes = __thriftReadI64(t);
+						else
+							__thriftSkip(t, sub_ftype);
+					}
+				}
+				break;
+			default:
+				__thriftSkip(t, ftype);
+				break;
+		}
+	}
+}
+
+static void
+__parquetReadColumnChunk(ThriftCursor *t, ParquetColumnMetaData *cmeta)
+{
+	int16		fid = 0;
+	int			ftype;
+	bool		has_meta_data = false;
+
+	memset(cmeta, 0, sizeof(ParquetColumnMetaData));
+	cmeta->dictionary_page_offset = -1;
+	cmeta->unencoded_bytes = -1;
+	cmeta->stat.null_count = -1;
+	while (__thriftNextField(t, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:		/* file_path */
+				__thriftSkip(t, ftype);
+				cmeta->has_file_path = true;
+				break;
+			case 3:		/* meta_data */
+				__parquetReadColumnMetaData(t, cmeta);
+				has_meta_data = true;
+				break;
+			default:
+				__thriftSkip(t, ftype);
+				break;
+		}
+	}
+	if (!has_meta_data)
+		elog(ERROR, "parquet: column chunk has no metadata");
+}
+
+static void
+__parquetReadPageHeader(ThriftCursor *t, ParquetPageHeader *phead)
+{
+	int16		fid = 0;
+	int			ftype;
+
+	memset(phead, 0, sizeof(ParquetPageHeader));
+	phead->type = -1;
+	phead->is_compressed = true;
+	while (__thriftNextField(t, &fid, &ftype))
+	{
+		int16	sub_fid = 0;
+		int		sub_ftype;
+
+		switch (fid)
+		{
+			case 1:
+				phead->type = __thriftReadI32(t);
+				break;
+			case 2:
+				phead->uncompressed_page_size = __thriftReadI32(t);
+				break;
+			case 3:
+				phead->compressed_page_size = __thriftReadI32(t);
+				break;
+			case 5:		/* DataPageHeader */
+				while (__thriftNextField(t, &sub_fid, &sub_ftype))
+				{
+					if (sub_fid == 1)
+						phead->num_values = __thriftReadI32(t);
+					else if (sub_fid == 2)
+						phead->encoding = __thriftReadI32(t);
+					else if (sub_fid == 3)
+						phead->def_level_encoding = __thriftReadI32(t);
+					else
+						__thriftSkip(t, sub_ftype);
+				}
+				break;
+			case 7:		/* DictionaryPageHeader */
+				while (__thriftNextField(t, &sub_fid, &sub_ftype))
+				{
+					if (sub_fid == 1)
+						phead->num_values = __thriftReadI32(t);
+					else if (sub_fid == 2)
+						phead->encoding = __thriftReadI32(t);
+					else
+						__thriftSkip(t, sub_ftype);
+				}
+				break;
+			case 8:		/* DataPageHeaderV2 */
+				while (__thriftNextField(t, &sub_fid, &sub_ftype))
+				{
+					if (sub_fid == 1)
+						phead->num_values = __thriftReadI32(t);
+					else if (sub_fid == 2)
+						phead->num_nulls = __thriftReadI32(t);
+					else if (sub_fid == 4)
+						phead->encoding = __thriftReadI32(t);
+					else if (sub_fid == 5)
+						phead->def_levels_byte_length = __thriftReadI32(t);
+					else if (sub_fid == 6)
+						phead->rep_levels_byte_length = __thriftReadI32(t);
+					else if (sub_fid == 7)
+						phead->is_compressed = __thriftReadBool(t, sub_ftype);
+					else
+						__thriftSkip(t, sub_ftype);
+				}
+				break;
+			default:
+				__thriftSkip(t, ftype);
+				break;
+		}
+	}
+	if (phead->compressed_page_size < 0 ||
+		phead->uncompressed_page_size < 0 ||
+		phead->num_values < 0)
+		elog(ERROR, "parquet: corrupted page header");
+}
+
+/*
+ * fileIsParquet
+ */
+bool
+fileIsParquet(int fdesc)
+{
+	char		signature[PARQUET_SIGNATURE_SZ];
+
+	if (pread(fdesc, signature, PARQUET_SIGNATURE_SZ, 0) != PARQUET_SIGNATURE_SZ)
+		return false;
+	return (memcmp(signature, PARQUET_SIGNATURE, PARQUET_SIGNATURE_SZ) == 0);
+}
+
+/*
+ * __parquetReadChunk - read a part of the parquet file
+ */
+static void
+__parquetReadChunk(int fdesc, off_t f_pos, size_t length, void *dest)
+{
+	ssize_t		sz;
+
+	while (length > 0)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		sz = pread(fdesc, dest, length, f_pos);
+		if (sz > 0)
+		{
+			dest = (char *)dest + sz;
+			f_pos += sz;
+			length -= sz;
+		}
+		else if (sz == 0)
+			elog(ERROR, "unable to read parquet file any more");
+		else if (errno != EINTR)
+			elog(ERROR, "failed on pread: %m");
+	}
+}
+
+/*
+ * __parquetSetupArrowField
+ *
+ * It maps the (flat) column of Parquet to the Apache Arrow type, and
+ * determines how to decode the values.
+ */
+static void
+__parquetSetupArrowField(ArrowField *field,
+						 ParquetColumnDesc *desc,
+						 ParquetSchemaElement *elem)
+{
+	ArrowType  *type = &field->type;
+	int			ctype = elem->converted_type;
+	int			ltype = elem->logical_type;
+
+	initArrowNode(field, Field);
+	field->name = elem->name;
+	field->_name_len = (elem->name ? strlen(elem->name) : 0);
+	field->nullable = (elem->repetition_type != ParquetRepetitionType__REQUIRED);
+
+	memset(desc, 0, sizeof(ParquetColumnDesc));
+	desc->is_parquet = true;
+	desc->physical_type = elem->type;
+	desc->max_def_level = (field->nullable ? 1 : 0);
+	desc->type_length = elem->type_length;
+	desc->conv = PARQUET_CONV__NONE;
+
+	/* legacy ConvertedType, if no LogicalType */
+	if (ltype < 0 && ctype >= 0)
+	{
+		switch (ctype)
+		{
+			case ParquetConvertedType__UTF8:
+				ltype = ParquetLogicalType__STRING;
+				break;
+			case ParquetConvertedType__ENUM:
+				ltype = ParquetLogicalType__ENUM;
+				break;
+			case ParquetConvertedType__JSON:
+				ltype = ParquetLogicalType__JSON;
+				break;
+			case ParquetConvertedType__DECIMAL:
+				ltype = ParquetLogicalType__DECIMAL;
+				elem->logical_scale = elem->scale;
+				elem->logical_precision = elem->precision;
+				break;
+			case ParquetConvertedType__DATE:
+				ltype = ParquetLogicalType__DATE;
+				break;
+			case ParquetConvertedType__TIME_MILLIS:
+			case ParquetConvertedType__TIME_MICROS:
+				ltype = ParquetLogicalType__TIME;
+				elem->logical_unit = (ctype == ParquetConvertedType__TIME_MILLIS ? 1 : 2);
+				break;
+			case ParquetConvertedType__TIMESTAMP_MILLIS:
+			case ParquetConvertedType__TIMESTAMP_MICROS:
+				ltype = ParquetLogicalType__TIMESTAMP;
+				elem->logical_unit = (ctype == ParquetConvertedType__TIMESTAMP_MILLIS ? 1 : 2);
+				elem->logical_utc = true;
+				break;
+			case ParquetConvertedType__UINT_8:
+			case ParquetConvertedType__UINT_16:
+			case ParquetConvertedType__UINT_32:
+			case ParquetConvertedType__UINT_64:
+			case ParquetConvertedType__INT_8:
+			case ParquetConvertedType__INT_16:
+			case ParquetConvertedType__INT_32:
+			case ParquetConvertedType__INT_64:
+				ltype = ParquetLogicalType__INTEGER;
+				elem->logical_signed = (ctype >= ParquetConvertedType__INT_8);
+				switch (ctype)
+				{
+					case ParquetConvertedType__UINT_8:
+					case ParquetConvertedType__INT_8:
+						elem->logical_bitwidth = 8;
+						break;
+					case ParquetConvertedType__UINT_16:
+					case ParquetConvertedType__INT_16:
+						elem->logical_bitwidth = 16;
+						break;
+					case ParquetConvertedType__UINT_32:
+					case ParquetConvertedType__INT_32:
+						elem->logical_bitwidth = 32;
+						break;
+					default:
+						elem->logical_bitwidth = 64;
+						break;
+				}
+				break;
+			default:
+				elog(ERROR, "parquet: column '%s' has unsupported converted type (%d)",
+					 elem->name, ctype);
+		}
+	}
+
+	switch (elem->type)
+	{
+		case ParquetType__BOOLEAN:
+			initArrowNode(type, Bool);
+			desc->unitsz = PARQUET_UNITSZ__BITMAP;
+			return;
+
+		case ParquetType__INT32:
+		case ParquetType__INT64:
+			if (ltype == ParquetLogicalType__DATE &&
+				elem->type == ParquetType__INT32)
+			{
+				initArrowNode(type, Date);
+				type->Date.unit = ArrowDateUnit__Day;
+				desc->unitsz = sizeof(int32);
+			}
+			else if (ltype == ParquetLogicalType__TIME)
+			{
+				initArrowNode(type, Time);
+				switch (elem->logical_unit)
+				{
+					case 1:
+						type->Time.unit = ArrowTimeUnit__MilliSecond;
+						break;
+					case 2:
+						type->Time.unit = ArrowTimeUnit__MicroSecond;
+						break;
+					default:
+						type->Time.unit = ArrowTimeUnit__NanoSecond;
+						break;
+				}
+				type->Time.bitWidth = (elem->type == ParquetType__INT32 ? 32 : 64);
+				desc->unitsz = type->Time.bitWidth / BITS_PER_BYTE;
+			}
+			else if (ltype == ParquetLogicalType__TIMESTAMP &&
+					 elem->type == ParquetType__INT64)
+			{
+				initArrowNode(type, Timestamp);
+				switch (elem->logical_unit)
+				{
+					case 1:
+						type->Timestamp.unit = ArrowTimeUnit__MilliSecond;
+						break;
+					case 2:
+						type->Timestamp.unit = ArrowTimeUnit__MicroSecond;
+						break;
+					default:
+						type->Timestamp.unit = ArrowTimeUnit__NanoSecond;
+						break;
+				}
+				if (elem->logical_utc)
+				{
+					type->Timestamp.timezone = pstrdup("UTC");
+					type->Timestamp._timezone_len = 3;
+				}
+				desc->unitsz = sizeof(int64);
+			}
+			else if (ltype == ParquetLogicalType__DECIMAL)
+			{
+				initArrowNode(type, Decimal);
+				type->Decimal.precision = elem->logical_precision;
+				type->Decimal.scale = elem->logical_scale;
+				desc->unitsz = sizeof(int128);
+				desc->conv = PARQUET_CONV__DECIMAL;
+			}
+			else if (ltype == ParquetLogicalType__INTEGER &&
+					 elem->logical_bitwidth < 64)
+			{
+				int		width = elem->logical_bitwidth;
+
+				/* Int8 is not supported, and unsigned needs one more bit */
+				if (!elem->logical_signed)
+					width *= 2;
+				initArrowNode(type, Int);
+				type->Int.bitWidth = Max(width, 16);
+				type->Int.is_signed = true;
+				desc->unitsz = type->Int.bitWidth / BITS_PER_BYTE;
+				desc->conv = (elem->logical_signed
+							  ? PARQUET_CONV__INT
+							  : PARQUET_CONV__UINT);
+			}
+			else if (ltype == ParquetLogicalType__INTEGER &&
+					 !elem->logical_signed)
+			{
+				elog(ERROR, "parquet: column '%s' of UINT64 is not supported",
+					 elem->name);
+			}
+			else if (ltype < 0 || ltype == ParquetLogicalType__INTEGER)
+			{
+				initArrowNode(type, Int);
+				type->Int.bitWidth = (elem->type == ParquetType__INT32 ? 32 : 64);
+				type->Int.is_signed = true;
+				desc->unitsz = type->Int.bitWidth / BITS_PER_BYTE;
+			}
+			else
+				elog(ERROR, "parquet: column '%s' has unsupported logical type (%d)",
+					 elem->name, ltype);
+			return;
+
+		case ParquetType__INT96:
+			/* legacy timestamp; nanoseconds of the day + julian day */
+			initArrowNode(type, Timestamp);
+			type->Timestamp.unit = ArrowTimeUnit__NanoSecond;
+			desc->unitsz = sizeof(int64);
+			desc->conv = PARQUET_CONV__INT96;
+			return;
+
+		case ParquetType__FLOAT:
+			initArrowNode(type, FloatingPoint);
+			type->FloatingPoint.precision = ArrowPrecision__Single;
+			desc->unitsz = sizeof(float);
+			return;
+
+		case ParquetType__DOUBLE:
+			initArrowNode(type, FloatingPoint);
+			type->FloatingPoint.precision = ArrowPrecision__Double;
+			desc->unitsz = sizeof(double);
+			return;
+
+		case ParquetType__BYTE_ARRAY:
+			if (ltype == ParquetLogicalType__STRING ||
+				ltype == ParquetLogicalType__ENUM ||
+				ltype == ParquetLogicalType__JSON)
+				initArrowNode(type, Utf8);
+			else if (ltype < 0 || ltype == ParquetLogicalType__BSON)
+				initArrowNode(type, Binary);
+			else
+				elog(ERROR, "parquet: column '%s' has unsupported logical type (%d)",
+					 elem->name, ltype);
+			desc->unitsz = PARQUET_UNITSZ__VARLENA;
+			return;
+
+		case ParquetType__FIXED_LEN_BYTE_ARRAY:
+			if (elem->type_length <= 0)
+				elog(ERROR, "parquet: column '%s' has wrong type length",
+					 elem->name);
+			if (ltype == ParquetLogicalType__DECIMAL)
+			{
+				if (elem->type_length > sizeof(int128))
+					elog(ERROR, "parquet: column '%s' has too large decimal",
+						 elem->name);
+				initArrowNode(type, Decimal);
+				type->Decimal.precision = elem->logical_precision;
+				type->Decimal.scale = elem->logical_scale;
+				desc->unitsz = sizeof(int128);
+				desc->conv = PARQUET_CONV__DECIMAL;
+			}
+			else
+			{
+				/* fixed-length binary is mapped to Binary */
+				initArrowNode(type, Binary);
+				desc->unitsz = PARQUET_UNITSZ__VARLENA;
+			}
+			return;
+
+		default:
+			elog(ERROR, "parquet: column '%s' has unknown physical type (%d)",
+				 elem->name, elem->type);
+	}
+}
+
+/*
+ * __parquetSetupChunkStat - min/max statistics of the column chunk, if the
+ * values can be compared in the native representation of the Arrow type.
+ */
+static void
+__parquetSetupChunkStat(ParquetColumnChunk *chunk,
+						ParquetColumnMetaData *cmeta,
+						ArrowField *field)
+{
+	ParquetStatistics *stat = &cmeta->stat;
+	int			tag = field->type.node.tag;
+
+	chunk->null_count = stat->null_count;
+	chunk->stat_valid = false;
+	if (chunk->desc.conv != PARQUET_CONV__NONE &&
+		chunk->desc.conv != PARQUET_CONV__INT)
+		return;
+	if (tag != ArrowNodeTag__Int &&
+		tag != ArrowNodeTag__FloatingPoint &&
+		tag != ArrowNodeTag__Date &&
+		tag != ArrowNodeTag__Time &&
+		tag != ArrowNodeTag__Timestamp)
+		return;
+	if (!stat->min || !stat->max)
+		return;
+	switch (cmeta->type)
+	{
+		case ParquetType__INT32:
+			if (stat->min_len != sizeof(int32) ||
+				stat->max_len != sizeof(int32))
+				return;
+			chunk->stat_min.i64 = *((int32 *)stat->min);
+			chunk->stat_max.i64 = *((int32 *)stat->max);
+			break;
+		case ParquetType__INT64:
+			if (stat->min_len != sizeof(int64) ||
+				stat->max_len != sizeof(int64))
+				return;
+			chunk->stat_min.i64 = *((int64 *)stat->min);
+			chunk->stat_max.i64 = *((int64 *)stat->max);
+			break;
+		case ParquetType__FLOAT:
+			if (stat->min_len != sizeof(float) ||
+				stat->max_len != sizeof(float))
+				return;
+			chunk->stat_min.f64 = *((float *)stat->min);
+			chunk->stat_max.f64 = *((float *)stat->max);
+			if (isnan(chunk->stat_min.f64) || isnan(chunk->stat_max.f64))
+				return;
+			break;
+		case ParquetType__DOUBLE:
+			if (stat->min_len != sizeof(double) ||
+				stat->max_len != sizeof(double))
+				return;
+			chunk->stat_min.f64 = *((double *)stat->min);
+			chunk->stat_max.f64 = *((double *)stat->max);
+			if (isnan(chunk->stat_min.f64) || isnan(chunk->stat_max.f64))
+				return;
+			break;
+		default:
+			return;
+	}
+	chunk->stat_valid = true;
+}
+
+/*
+ * readParquetFileDesc
+ *
+ * It reads FileMetaData of the Parquet file, then builds the Apache Arrow
+ * schema on af_info->footer.schema, and the column chunks of the row groups
+ * on @pq_info, if given. It returns false, if not a Parquet file.
+ * Only flat schema is supported right now.
+ */
+bool
+readParquetFileDesc(int fdesc, ArrowFileInfo *af_info,
+					ParquetFileInfo *pq_info)
+{
+	char		tail[sizeof(int32) + PARQUET_SIGNATURE_SZ];
+	char	   *buffer;
+	int32		meta_len;
+	size_t		file_sz;
+	ThriftCursor t;
+	int16		fid = 0;
+	int			ftype;
+	int			elem_type;
+	int32		i, j, nitems;
+	ParquetSchemaElement *elems = NULL;
+	int32		num_elems = 0;
+	ArrowSchema *schema = &af_info->footer.schema;
+	ParquetColumnDesc *descs = NULL;
+	List	   *row_groups = NIL;
+	ListCell   *lc;
+
+	memset(af_info, 0, sizeof(ArrowFileInfo));
+	if (pq_info)
+		memset(pq_info, 0, sizeof(ParquetFileInfo));
+	if (!fileIsParquet(fdesc))
+		return false;
+	if (fstat(fdesc, &af_info->stat_buf) != 0)
+		elog(ERROR, "failed on fstat: %m");
+	file_sz = af_info->stat_buf.st_size;
+	if (file_sz < 2 * PARQUET_SIGNATURE_SZ + sizeof(int32))
+		elog(ERROR, "parquet: file is too small");
+	__parquetReadChunk(fdesc, file_sz - sizeof(tail), sizeof(tail), tail);
+	if (memcmp(tail + sizeof(int32), PARQUET_SIGNATURE,
+			   PARQUET_SIGNATURE_SZ) != 0)
+		elog(ERROR, "Signature mismatch on Apache Parquet file");
+	memcpy(&meta_len, tail, sizeof(int32));
+	if (meta_len <= 0 ||
+		meta_len > file_sz - 2 * PARQUET_SIGNATURE_SZ - sizeof(int32))
+		elog(ERROR, "parquet: corrupted length of FileMetaData");
+	buffer = palloc(meta_len);
+	__parquetReadChunk(fdesc, file_sz - sizeof(tail) - meta_len,
+					   meta_len, buffer);
+
+	/* FileMetaData */
+	t.pos = (const unsigned char *)buffer;
+	t.end = (const unsigned char *)buffer + meta_len;
+	while (__thriftNextField(&t, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 2:		/* schema: list<SchemaElement> */
+				num_elems = __thriftReadListHeader(&t, &elem_type);
+				elems = palloc0(sizeof(ParquetSchemaElement) * Max(num_elems, 1));
+				for (i=0; i < num_elems; i++)
+					__parquetReadSchemaElement(&t, &elems[i]);
+				break;
+			case 4:		/* row_groups: list<RowGroup> */
+				nitems = __thriftReadListHeader(&t, &elem_type);
+				for (i=0; i < nitems; i++)
+				{
+					int16	rg_fid = 0;
+					int		rg_ftype;
+					int64	num_rows = -1;
+					List   *columns = NIL;
+
+					while (__thriftNextField(&t, &rg_fid, &rg_ftype))
+					{
+						if (rg_fid == 1)
+						{
+							int32	k, ncols;
+
+							ncols = __thriftReadListHeader(&t, &elem_type);
+							for (k=0; k < ncols; k++)
+							{
+								ParquetColumnMetaData *cmeta
+									= palloc(sizeof(ParquetColumnMetaData));
+								__parquetReadColumnChunk(&t, cmeta);
+								columns = lappend(columns, cmeta);
+							}
+						}
+						else if (rg_fid == 3)
+							num_rows = __thriftReadI64(&t);
+						else
+							__thriftSkip(&t, rg_ftype);
+					}
+					if (num_rows < 0)
+						elog(ERROR, "parquet: row group has no num_rows");
+					row_groups = lappend(row_groups,
+										 list_make2(makeInteger(num_rows),
+													columns));
+				}
+				break;
+			default:
+				__thriftSkip(&t, ftype);
+				break;
+		}
+	}
+	if (num_elems < 1)
+		elog(ERROR, "parquet: FileMetaData has no schema");
+
+	/* schema; the first element is the root */
+	initArrowNode(&af_info->footer, Footer);
+	af_info->footer.version = ArrowMetadataVersion__V4;
+	initArrowNode(schema, Schema);
+	schema->endianness = ArrowEndianness__Little;
+	schema->_num_fields = num_elems - 1;
+	schema->fields = palloc0(sizeof(ArrowField) * Max(num_elems - 1, 1));
+	descs = palloc0(sizeof(ParquetColumnDesc) * Max(num_elems - 1, 1));
+	if (elems[0].num_children != num_elems - 1)
+		elog(ERROR, "parquet: nested schema is not supported");
+	for (j=1; j < num_elems; j++)
+	{
+		ParquetSchemaElement *elem = &elems[j];
+
+		if (elem->num_children > 0 || elem->type < 0 ||
+			elem->repetition_type == ParquetRepetitionType__REPEATED)
+			elog(ERROR, "parquet: nested schema is not supported (column '%s')",
+				 elem->name);
+		__parquetSetupArrowField(&schema->fields[j-1], &descs[j-1], elem);
+	}
+	if (!pq_info)
+		return true;
+
+	/* row groups */
+	pq_info->num_row_groups = list_length(row_groups);
+	pq_info->num_columns = schema->_num_fields;
+	pq_info->row_group_nrows = palloc0(sizeof(int64) *
+									   Max(pq_info->num_row_groups, 1));
+	pq_info->chunks = palloc0(sizeof(ParquetColumnChunk) *
+							  Max(pq_info->num_row_groups *
+								  pq_info->num_columns, 1));
+	i = 0;
+	foreach (lc, row_groups)
+	{
+		List	   *rg = lfirst(lc);
+		int64		num_rows = intVal(linitial(rg));
+		List	   *columns = lsecond(rg);
+		ListCell   *cell;
+
+		if (list_length(columns) != pq_info->num_columns)
+			elog(ERROR, "parquet: row group has %d columns, but %d expected",
+				 list_length(columns), pq_info->num_columns);
+		pq_info->row_group_nrows[i] = num_rows;
+		j = 0;
+		foreach (cell, columns)
+		{
+			ParquetColumnMetaData *cmeta = lfirst(cell);
+			ParquetColumnChunk *chunk
+				= &pq_info->chunks[i * pq_info->num_columns + j];
+			off_t		offset = cmeta->data_page_offset;
+
+			if (cmeta->has_file_path)
+				elog(ERROR, "parquet: column chunk in the external file is not supported");
+			if (cmeta->type != descs[j].physical_type)
+				elog(ERROR, "parquet: column chunk type mismatch");
+			if (cmeta->num_values != num_rows)
+				elog(ERROR, "parquet: column chunk has %ld values, but %ld rows",
+					 (long)cmeta->num_values, (long)num_rows);
+			/* some writers put 0 on dictionary_page_offset */
+			if (cmeta->dictionary_page_offset > 0 &&
+				cmeta->dictionary_page_offset < offset)
+				offset = cmeta->dictionary_page_offset;
+			if (offset < PARQUET_SIGNATURE_SZ ||
+				cmeta->total_compressed_size <= 0 ||
+				offset + cmeta->total_compressed_size > file_sz)
+				elog(ERROR, "parquet: column chunk is out of the file");
+
+			memcpy(&chunk->desc, &descs[j], sizeof(ParquetColumnDesc));
+			chunk->desc.codec = cmeta->codec;
+			chunk->chunk_offset = offset;
+			chunk->chunk_length = cmeta->total_compressed_size;
+			chunk->num_values = cmeta->num_values;
+			chunk->unencoded_bytes = cmeta->unencoded_bytes;
+			__parquetSetupChunkStat(chunk, cmeta, &schema->fields[j]);
+			j++;
+		}
+		i++;
+	}
+	pfree(buffer);
+
+	return true;
+}
+
+/*
+ * Routines to decode the column chunk
+ */
+typedef struct
+{
+	int64		nitems;		/* number of physical values */
+	int			width;		/* width of fixed-length values */
+	char	   *fixed;		/* fixed-length values */
+	const char **ptrs;		/* variable-length values */
+	int32	   *lens;
+} ParquetValues;
+
+typedef struct
+{
+	const ParquetColumnDesc *desc;
+	int64		nitems;		/* number of rows */
+	int64		row;		/* current row */
+	int64		null_count;
+	uint8	   *nullmap;
+	char	   *values;
+	char	   *extra;
+	size_t		extra_usage;
+	size_t		extra_nrooms;
+	ParquetValues dict;		/* valid, if dictionary page */
+	bool		has_dict;
+} ParquetDecodeState;
+
+static int
+__parquetPhysicalWidth(const ParquetColumnDesc *desc)
+{
+	switch (desc->physical_type)
+	{
+		case ParquetType__BOOLEAN:
+			return 1;		/* unpacked to bytes */
+		case ParquetType__INT32:
+		case ParquetType__FLOAT:
+			return 4;
+		case ParquetType__INT64:
+		case ParquetType__DOUBLE:
+			return 8;
+		case ParquetType__INT96:
+			return 12;
+		case ParquetType__FIXED_LEN_BYTE_ARRAY:
+			return desc->type_length;
+		default:
+			return 0;		/* BYTE_ARRAY */
+	}
+}
+
+static uint64
+__readULEB128(const unsigned char **p_pos, const unsigned char *end)
+{
+	const unsigned char *pos = *p_pos;
+	uint64		value = 0;
+	int			shift = 0;
+
+	for (;;)
+	{
+		if (pos >= end || shift >= 64)
+			elog(ERROR, "parquet: corrupted ULEB128 value");
+		value |= ((uint64)(*pos & 0x7f)) << shift;
+		if ((*pos++ & 0x80) == 0)
+			break;
+		shift += 7;
+	}
+	*p_pos = pos;
+	return value;
+}
+
+/*
+ * __extractBits - fetch @bit_width bits at @bit_pos (LSB first)
+ */
+static inline uint64
+__extractBits(const unsigned char *base, uint64 bit_pos, int bit_width)
+{
+	uint64		value = 0;
+	int			nbits = 0;
+
+	while (nbits < bit_width)
+	{
+		uint64	byte = base[bit_pos >> 3];
+		int		shift = (bit_pos & 7);
+		int		take = Min(8 - shift, bit_width - nbits);
+
+		value |= ((byte >> shift) & ((1UL << take) - 1)) << nbits;
+		nbits += take;
+		bit_pos += take;
+	}
+	return value;
+}
+
+/*
+ * __decodeRleBitPackedHybrid - RLE/bit-packed hybrid encoding, used for
+ * definition levels, dictionary indexes and boolean values.
+ */
+static const unsigned char *
+__decodeRleBitPackedHybrid(const unsigned char *pos,
+						   const unsigned char *end,
+						   int bit_width, uint32 *dest, int64 count)
+{
+	int		bytes_width = (bit_width + 7) / 8;
+	int64	i = 0;
+
+	if (bit_width < 0 || bit_width > 32)
+		elog(ERROR, "parquet: wrong bit width (%d) of RLE/bit-packed", bit_width);
+	while (i < count)
+	{
+		uint64	header = __readULEB128(&pos, end);
+
+		if ((header & 1) != 0)
+		{
+			/* bit-packed run */
+			uint64	ngroups = (header >> 1);
+			uint64	nvalues = 8 * ngroups;
+			uint64	k;
+
+			if (ngroups * bit_width > end - pos)
+				elog(ERROR, "parquet: bit-packed run is out of the page");
+			for (k=0; k < nvalues && i < count; k++)
+				dest[i++] = __extractBits(pos, k * bit_width, bit_width);
+			pos += ngroups * bit_width;
+		}
+		else
+		{
+			/* RLE run */
+			uint64	nvalues = (header >> 1);
+			uint32	value = 0;
+			int		b;
+
+			if (bytes_width > end - pos)
+				elog(ERROR, "parquet: RLE run is out of the page");
+			for (b=0; b < bytes_width; b++)
+				value |= ((uint32)pos[b]) << (8 * b);
+			pos += bytes_width;
+			if (nvalues == 0)
+				elog(ERROR, "parquet: empty RLE run");
+			while (nvalues-- > 0 && i < count)
+				dest[i++] = value;
+		}
+	}
+	return pos;
+}
+
+/*
+ * __decodeDeltaBinaryPacked - DELTA_BINARY_PACKED encoding
+ */
+static const unsigned char *
+__decodeDeltaBinaryPacked(const unsigned char *pos,
+						  const unsigned char *end,
+						  int64 **p_values, int64 *p_nvalues)
+{
+	uint64		block_size = __readULEB128(&pos, end);
+	uint64		num_miniblocks = __readULEB128(&pos, end);
+	uint64		total = __readULEB128(&pos, end);
+	uint64		zigzag = __readULEB128(&pos, end);
+	uint64		values_per_miniblock;
+	int64	   *values;
+	int64		last;
+	uint64		i;
+
+	if (num_miniblocks == 0 || block_size % num_miniblocks != 0)
+		elog(ERROR, "parquet: corrupted DELTA_BINARY_PACKED header");
+	values_per_miniblock = block_size / num_miniblocks;
+	if (values_per_miniblock % 8 != 0)
+		elog(ERROR, "parquet: corrupted DELTA_BINARY_PACKED header");
+	values = palloc(sizeof(int64) * Max(total, 1));
+	last = (int64)(zigzag >> 1) ^ -((int64)(zigzag & 1));
+	if (total > 0)
+		values[0] = last;
+	i = 1;
+	while (i < total)
+	{
+		uint64		temp = __readULEB128(&pos, end);
+		int64		min_delta = (int64)(temp >> 1) ^ -((int64)(temp & 1));
+		const unsigned char *bit_widths = pos;
+		uint64		m, k;
+
+		if (num_miniblocks > end - pos)
+			elog(ERROR, "parquet: DELTA_BINARY_PACKED is out of the page");
+		pos += num_miniblocks;
+		for (m=0; m < num_miniblocks && i < total; m++)
+		{
+			int		bit_width = bit_widths[m];
+			size_t	nbytes = values_per_miniblock * bit_width / 8;
+
+			if (bit_width > 64 || nbytes > end - pos)
+				elog(ERROR, "parquet: DELTA_BINARY_PACKED is out of the page");
+			for (k=0; k < values_per_miniblock && i < total; k++)
+			{
+				uint64	delta = __extractBits(pos, k * bit_width, bit_width);
+
+				last = (int64)((uint64)last + (uint64)min_delta + delta);
+				values[i++] = last;
+			}
+			pos += nbytes;
+		}
+	}
+	*p_values = values;
+	*p_nvalues = total;
+	return pos;
+}
+
+/*
+ * __decodePlainValues - PLAIN encoding
+ */
+static const unsigned char *
+__decodePlainValues(const ParquetColumnDesc *desc,
+					const unsigned char *pos,
+					const unsigned char *end,
+					int64 nvalues, ParquetValues *pvals)
+{
+	int64		i;
+
+	pvals->nitems = nvalues;
+	pvals->width = __parquetPhysicalWidth(desc);
+	if (desc->physical_type == ParquetType__BOOLEAN)
+	{
+		if ((nvalues + 7) / 8 > end - pos)
+			elog(ERROR, "parquet: PLAIN values are out of the page");
+		pvals->fixed = palloc(Max(nvalues, 1));
+		for (i=0; i < nvalues; i++)
+			pvals->fixed[i] = ((pos[i>>3] & (1 << (i & 7))) != 0);
+		pos += (nvalues + 7) / 8;
+	}
+	else if (desc->physical_type == ParquetType__BYTE_ARRAY)
+	{
+		pvals->ptrs = palloc(sizeof(const char *) * Max(nvalues, 1));
+		pvals->lens = palloc(sizeof(int32) * Max(nvalues, 1));
+		for (i=0; i < nvalues; i++)
+		{
+			int32	len;
+
+			if (sizeof(int32) > end - pos)
+				elog(ERROR, "parquet: PLAIN values are out of the page");
+			memcpy(&len, pos, sizeof(int32));
+			pos += sizeof(int32);
+			if (len < 0 || len > end - pos)
+				elog(ERROR, "parquet: PLAIN values are out of the page");
+			pvals->ptrs[i] = (const char *)pos;
+			pvals->lens[i] = len;
+			pos += len;
+		}
+	}
+	else
+	{
+		size_t	nbytes = pvals->width * nvalues;
+
+		if (nbytes > end - pos)
+			elog(ERROR, "parquet: PLAIN values are out of the page");
+		pvals->fixed = (char *)pos;
+		pos += nbytes;
+	}
+	return pos;
+}
+
+/*
+ * __decodePageValues - decode @nvalues non-null values of the data page
+ */
+static void
+__decodePageValues(ParquetDecodeState *ds, int encoding,
+				   const unsigned char *pos,
+				   const unsigned char *end,
+				   int64 nvalues, ParquetValues *pvals)
+{
+	const ParquetColumnDesc *desc = ds->desc;
+	int64		i;
+
+	memset(pvals, 0, sizeof(ParquetValues));
+	pvals->nitems = nvalues;
+	pvals->width = __parquetPhysicalWidth(desc);
+	switch (encoding)
+	{
+		case ParquetEncoding__PLAIN:
+			__decodePlainValues(desc, pos, end, nvalues, pvals);
+			break;
+
+		case ParquetEncoding__PLAIN_DICTIONARY:
+		case ParquetEncoding__RLE_DICTIONARY:
+			{
+				uint32	   *index;
+				int			bit_width;
+
+				if (!ds->has_dict)
+					elog(ERROR, "parquet: dictionary page is missing");
+				if (pos >= end && nvalues > 0)
+					elog(ERROR, "parquet: dictionary indexes are out of the page");
+				bit_width = (nvalues > 0 ? *pos++ : 0);
+				index = palloc(sizeof(uint32) * Max(nvalues, 1));
+				__decodeRleBitPackedHybrid(pos, end, bit_width,
+										   index, nvalues);
+				if (pvals->width > 0)
+					pvals->fixed = palloc(pvals->width * Max(nvalues, 1));
+				else
+				{
+					pvals->ptrs = palloc(sizeof(const char *) * Max(nvalues, 1));
+					pvals->lens = palloc(sizeof(int32) * Max(nvalues, 1));
+				}
+				for (i=0; i < nvalues; i++)
+				{
+					if (index[i] >= ds->dict.nitems)
+						elog(ERROR, "parquet: dictionary index out of range");
+					if (pvals->width > 0)
+						memcpy(pvals->fixed + pvals->width * i,
+							   ds->dict.fixed + pvals->width * index[i],
+							   pvals->width);
+					else
+					{
+						pvals->ptrs[i] = ds->dict.ptrs[index[i]];
+						pvals->lens[i] = ds->dict.lens[index[i]];
+					}
+				}
+				pfree(index);
+			}
+			break;
+
+		case ParquetEncoding__RLE:
+			{
+				uint32	   *values;
+				int32		len;
+
+				/* RLE value encoding is only valid for BOOLEAN */
+				if (desc->physical_type != ParquetType__BOOLEAN)
+					elog(ERROR, "parquet: RLE encoding on non-boolean");
+				if (sizeof(int32) > end - pos)
+					elog(ERROR, "parquet: RLE values are out of the page");
+				memcpy(&len, pos, sizeof(int32));
+				pos += sizeof(int32);
+				if (len < 0 || len > end - pos)
+					elog(ERROR, "parquet: RLE values are out of the page");
+				values = palloc(sizeof(uint32) * Max(nvalues, 1));
+				__decodeRleBitPackedHybrid(pos, pos + len, 1,
+										   values, nvalues);
+				pvals->fixed = palloc(Max(nvalues, 1));
+				for (i=0; i < nvalues; i++)
+					pvals->fixed[i] = (values[i] != 0);
+				pfree(values);
+			}
+			break;
+
+		case ParquetEncoding__DELTA_BINARY_PACKED:
+			{
+				int64	   *values;
+				int64		count;
+
+				if (desc->physical_type != ParquetType__INT32 &&
+					desc->physical_type != ParquetType__INT64)
+					elog(ERROR, "parquet: DELTA_BINARY_PACKED on non-integer");
+				__decodeDeltaBinaryPacked(pos, end, &values, &count);
+				if (count < nvalues)
+					elog(ERROR, "parquet: DELTA_BINARY_PACKED has less values than expected");
+				pvals->fixed = palloc(pvals->width * Max(nvalues, 1));
+				for (i=0; i < nvalues; i++)
+				{
+					if (pvals->width == sizeof(int32))
+						((int32 *)pvals->fixed)[i] = (int32)values[i];
+					else
+						((int64 *)pvals->fixed)[i] = values[i];
+				}
+				pfree(values);
+			}
+			break;
+
+		case ParquetEncoding__DELTA_LENGTH_BYTE_ARRAY:
+			{
+				int64	   *lengths;
+				int64		count;
+
+				if (desc->physical_type != ParquetType__BYTE_ARRAY)
+					elog(ERROR, "parquet: DELTA_LENGTH_BYTE_ARRAY on non-binary");
+				pos = __decodeDeltaBinaryPacked(pos, end, &lengths, &count);
+				if (count < nvalues)
+					elog(ERROR, "parquet: DELTA_LENGTH_BYTE_ARRAY has less values than expected");
+				pvals->ptrs = palloc(sizeof(const char *) * Max(nvalues, 1));
+				pvals->lens = palloc(sizeof(int32) * Max(nvalues, 1));
+				for (i=0; i < nvalues; i++)
+				{
+					if (lengths[i] < 0 || lengths[i] > end - pos)
+						elog(ERROR, "parquet: DELTA_LENGTH_BYTE_ARRAY is out of the page");
+					pvals->ptrs[i] = (const char *)pos;
+					pvals->lens[i] = lengths[i];
+					pos += lengths[i];
+				}
+				pfree(lengths);
+			}
+			break;
+
+		case ParquetEncoding__DELTA_BYTE_ARRAY:
+			{
+				int64	   *prefixes;
+				int64	   *suffixes;
+				int64		count1, count2;
+				size_t		total = 0;
+				char	   *buf;
+				const char *prev = NULL;
+				int32		prev_len = 0;
+
+				if (desc->physical_type != ParquetType__BYTE_ARRAY &&
+					desc->physical_type != ParquetType__FIXED_LEN_BYTE_ARRAY)
+					elog(ERROR, "parquet: DELTA_BYTE_ARRAY on non-binary");
+				pos = __decodeDeltaBinaryPacked(pos, end, &prefixes, &count1);
+				pos = __decodeDeltaBinaryPacked(pos, end, &suffixes, &count2);
+				if (count1 < nvalues || count2 < nvalues)
+					elog(ERROR, "parquet: DELTA_BYTE_ARRAY has less values than expected");
+				for (i=0; i < nvalues; i++)
+				{
+					if (prefixes[i] < 0 || suffixes[i] < 0)
+						elog(ERROR, "parquet: corrupted DELTA_BYTE_ARRAY");
+					total += prefixes[i] + suffixes[i];
+				}
+				buf = palloc(Max(total, 1));
+				pvals->ptrs = palloc(sizeof(const char *) * Max(nvalues, 1));
+				pvals->lens = palloc(sizeof(int32) * Max(nvalues, 1));
+				for (i=0; i < nvalues; i++)
+				{
+					if (prefixes[i] > prev_len ||
+						suffixes[i] > end - pos)
+						elog(ERROR, "parquet: DELTA_BYTE_ARRAY is out of the page");
+					memcpy(buf, prev, prefixes[i]);
+					memcpy(buf + prefixes[i], pos, suffixes[i]);
+					pos += suffixes[i];
+					pvals->ptrs[i] = buf;
+					pvals->lens[i] = prefixes[i] + suffixes[i];
+					prev = buf;
+					prev_len = pvals->lens[i];
+					buf += pvals->lens[i];
+				}
+				pfree(prefixes);
+				pfree(suffixes);
+				/* FIXED_LEN_BYTE_ARRAY is consumed as fixed-length values */
+				if (pvals->width > 0)
+				{
+					pvals->fixed = palloc(pvals->width * Max(nvalues, 1));
+					for (i=0; i < nvalues; i++)
+					{
+						if (pvals->lens[i] != pvals->width)
+							elog(ERROR, "parquet: corrupted DELTA_BYTE_ARRAY");
+						memcpy(pvals->fixed + pvals->width * i,
+							   pvals->ptrs[i], pvals->width);
+					}
+				}
+			}
+			break;
+
+		case ParquetEncoding__BYTE_STREAM_SPLIT:
+			{
+				int		width = pvals->width;
+				int		b;
+
+				if (width <= 0 ||
+					desc->physical_type == ParquetType__BOOLEAN)
+					elog(ERROR, "parquet: BYTE_STREAM_SPLIT on unsupported type");
+				if (width * nvalues > end - pos)
+					elog(ERROR, "parquet: BYTE_STREAM_SPLIT is out of the page");
+				pvals->fixed = palloc(width * Max(nvalues, 1));
+				for (i=0; i < nvalues; i++)
+				{
+					for (b=0; b < width; b++)
+						pvals->fixed[width * i + b] = pos[b * nvalues + i];
+				}
+			}
+			break;
+
+		default:
+			elog(ERROR, "parquet: encoding %d is not supported", encoding);
+	}
+}
+
+/*
+ * __parquetPutValue - put a value onto the buffers of Arrow layout
+ */
+static void
+__parquetPutValue(ParquetDecodeState *ds, ParquetValues *pvals, int64 k)
+{
+	const ParquetColumnDesc *desc = ds->desc;
+	int64		row = ds->row;
+
+	if (ds->nullmap)
+		ds->nullmap[row >> 3] |= (1 << (row & 7));
+
+	if (desc->unitsz == PARQUET_UNITSZ__BITMAP)
+	{
+		if (pvals->fixed[k])
+			((uint8 *)ds->values)[row >> 3] |= (1 << (row & 7));
+	}
+	else if (desc->unitsz == PARQUET_UNITSZ__VARLENA)
+	{
+		const char *addr;
+		size_t		len;
+		uint32	   *offsets = (uint32 *)ds->values;
+
+		if (pvals->width > 0)
+		{
+			addr = pvals->fixed + pvals->width * k;
+			len  = pvals->width;
+		}
+		else
+		{
+			addr = pvals->ptrs[k];
+			len  = pvals->lens[k];
+		}
+		if (ds->extra_usage + len >= UINT_MAX)
+			elog(ERROR, "parquet: column chunk is too large");
+		if (ds->extra_usage + len > ds->extra_nrooms)
+		{
+			ds->extra_nrooms = Max(2 * ds->extra_nrooms,
+								   ds->extra_usage + len + BLCKSZ);
+			ds->extra = repalloc_huge(ds->extra, ds->extra_nrooms);
+		}
+		memcpy(ds->extra + ds->extra_usage, addr, len);
+		ds->extra_usage += len;
+		offsets[row + 1] = ds->extra_usage;
+	}
+	else
+	{
+		char	   *dest = ds->values + desc->unitsz * row;
+		const char *src = pvals->fixed + pvals->width * k;
+		int64		ival;
+
+		switch (desc->conv)
+		{
+			case PARQUET_CONV__NONE:
+				memcpy(dest, src, desc->unitsz);
+				break;
+			case PARQUET_CONV__INT:
+			case PARQUET_CONV__UINT:
+				if (pvals->width == sizeof(int32))
+				{
+					if (desc->conv == PARQUET_CONV__INT)
+						ival = *((int32 *)src);
+					else
+						ival = *((uint32 *)src);
+				}
+				else
+					ival = *((int64 *)src);
+				if (desc->unitsz == sizeof(int16))
+					*((int16 *)dest) = (int16)ival;
+				else if (desc->unitsz == sizeof(int32))
+					*((int32 *)dest) = (int32)ival;
+				else
+					*((int64 *)dest) = ival;
+				break;
+			case PARQUET_CONV__INT96:
+				{
+					int64	nanos;
+					int32	julian_day;
+
+					memcpy(&nanos, src, sizeof(int64));
+					memcpy(&julian_day, src + sizeof(int64), sizeof(int32));
+					/* 2440588 is the julian day of 1970-01-01 */
+					*((int64 *)dest) = ((int64)(julian_day - 2440588) *
+										86400L * 1000000000L + nanos);
+				}
+				break;
+			case PARQUET_CONV__DECIMAL:
+				{
+					int128	value = 0;
+					int		b;
+
+					if (desc->physical_type == ParquetType__INT32)
+						value = *((int32 *)src);
+					else if (desc->physical_type == ParquetType__INT64)
+						value = *((int64 *)src);
+					else
+					{
+						/* big-endian two's complement */
+						if (pvals->width > 0 && (src[0] & 0x80) != 0)
+							value = -1;
+						for (b=0; b < pvals->width; b++)
+							value = (value << 8) | (uint8)src[b];
+					}
+					memcpy(dest, &value, sizeof(int128));
+				}
+				break;
+			default:
+				elog(ERROR, "parquet: unknown conversion %d", desc->conv);
+		}
+	}
+	ds->row++;
+}
+
+static void
+__parquetPutNull(ParquetDecodeState *ds)
+{
+	if (!ds->nullmap)
+		elog(ERROR, "parquet: null value on REQUIRED column");
+	if (ds->desc->unitsz == PARQUET_UNITSZ__VARLENA)
+	{
+		uint32	   *offsets = (uint32 *)ds->values;
+
+		offsets[ds->row + 1] = offsets[ds->row];
+	}
+	ds->null_count++;
+	ds->row++;
+}
+
+/*
+ * __parquetDecompressPage
+ */
+static const unsigned char *
+__parquetDecompressPage(const ParquetColumnDesc *desc,
+						const unsigned char *src, size_t src_len,
+						size_t raw_len)
+{
+	char	   *dest;
+	size_t		sz;
+
+	if (desc->codec == ParquetCompressionCodec__UNCOMPRESSED)
+	{
+		if (src_len != raw_len)
+			elog(ERROR, "parquet: uncompressed page length mismatch");
+		return src;
+	}
+	dest = palloc(Max(raw_len, 1));
+	switch (desc->codec)
+	{
+#ifdef HAVE_LIBSNAPPY
+		case ParquetCompressionCodec__SNAPPY:
+			sz = raw_len;
+			if (snappy_uncompress((const char *)src, src_len,
+								  dest, &sz) != SNAPPY_OK)
+				elog(ERROR, "parquet: failed on snappy_uncompress");
+			break;
+#endif
+#ifdef HAVE_LIBZSTD
+		case ParquetCompressionCodec__ZSTD:
+			sz = ZSTD_decompress(dest, raw_len, src, src_len);
+			if (ZSTD_isError(sz))
+				elog(ERROR, "parquet: failed on ZSTD_decompress: %s",
+					 ZSTD_getErrorName(sz));
+			break;
+#endif
+		default:
+			elog(ERROR, "parquet: compression codec %d is not supported in this build",
+				 desc->codec);
+	}
+	if (sz != raw_len)
+		elog(ERROR, "parquet: decompressed page length mismatch (%zu of %zu)",
+			 sz, raw_len);
+	return (const unsigned char *)dest;
+}
+
+/*
+ * __parquetDecodeDataPage
+ */
+static void
+__parquetDecodeDataPage(ParquetDecodeState *ds,
+						ParquetPageHeader *phead,
+						const unsigned char *page)
+{
+	const ParquetColumnDesc *desc = ds->desc;
+	const unsigned char *pos;
+	const unsigned char *end;
+	uint32	   *def_levels = NULL;
+	int64		nvalues = phead->num_values;
+	int64		nnulls = 0;
+	int64		i, k;
+	ParquetValues pvals;
+
+	if (ds->row + nvalues > ds->nitems)
+		elog(ERROR, "parquet: column chunk has more values than expected");
+	if (phead->type == ParquetPageType__DATA_PAGE)
+	{
+		pos = __parquetDecompressPage(desc, page,
+									  phead->compressed_page_size,
+									  phead->uncompressed_page_size);
+		end = pos + phead->uncompressed_page_size;
+		/* no repetition levels on the flat schema */
+		if (desc->max_def_level > 0)
+		{
+			int32	len;
+
+			if (phead->def_level_encoding != ParquetEncoding__RLE)
+				elog(ERROR, "parquet: encoding %d of definition levels is not supported",
+					 phead->def_level_encoding);
+			if (sizeof(int32) > end - pos)
+				elog(ERROR, "parquet: definition levels are out of the page");
+			memcpy(&len, pos, sizeof(int32));
+			pos += sizeof(int32);
+			if (len < 0 || len > end - pos)
+				elog(ERROR, "parquet: definition levels are out of the page");
+			def_levels = palloc(sizeof(uint32) * Max(nvalues, 1));
+			__decodeRleBitPackedHybrid(pos, pos + len, 1,
+									   def_levels, nvalues);
+			pos += len;
+		}
+	}
+	else
+	{
+		int32	levels_len = (phead->rep_levels_byte_length +
+							  phead->def_levels_byte_length);
+
+		if (levels_len < 0 || levels_len > phead->compressed_page_size ||
+			levels_len > phead->uncompressed_page_size)
+			elog(ERROR, "parquet: corrupted DATA_PAGE_V2 header");
+		if (desc->max_def_level > 0)
+		{
+			const unsigned char *lpos = page + phead->rep_levels_byte_length;
+
+			def_levels = palloc(sizeof(uint32) * Max(nvalues, 1));
+			__decodeRleBitPackedHybrid(lpos,
+									   lpos + phead->def_levels_byte_length,
+									   1, def_levels, nvalues);
+		}
+		if (phead->is_compressed)
+			pos = __parquetDecompressPage(desc, page + levels_len,
+										  phead->compressed_page_size - levels_len,
+										  phead->uncompressed_page_size - levels_len);
+		else
+			pos = page + levels_len;
+		end = pos + (phead->uncompressed_page_size - levels_len);
+	}
+	if (def_levels)
+	{
+		for (i=0; i < nvalues; i++)
+		{
+			if (def_levels[i] == 0)
+				nnulls++;
+		}
+	}
+	__decodePageValues(ds, phead->encoding, pos, end,
+					   nvalues - nnulls, &pvals);
+	for (i=0, k=0; i < nvalues; i++)
+	{
+		if (def_levels && def_levels[i] == 0)
+			__parquetPutNull(ds);
+		else
+			__parquetPutValue(ds, &pvals, k++);
+	}
+}
+
+/*
+ * parquetDecodeColumnChunk
+ *
+ * It reads the pages of the column chunk, then decodes them to the buffers
+ * of the Apache Arrow layout on @result.
+ */
+void
+parquetDecodeColumnChunk(File fdesc,
+						 const ParquetColumnDesc *desc,
+						 off_t chunk_offset,
+						 size_t chunk_length,
+						 int64 nitems,
+						 ParquetDecodedChunk *result)
+{
+	ParquetDecodeState ds;
+	unsigned char *chunk;
+	size_t		pos = 0;
+	size_t		nullmap_length = MAXALIGN(BITMAPLEN(nitems));
+	size_t		values_length;
+
+	Assert(desc->is_parquet);
+	memset(&ds, 0, sizeof(ParquetDecodeState));
+	ds.desc = desc;
+	ds.nitems = nitems;
+	if (desc->max_def_level > 0)
+		ds.nullmap = palloc0(nullmap_length);
+	if (desc->unitsz == PARQUET_UNITSZ__BITMAP)
+		values_length = MAXALIGN(BITMAPLEN(nitems));
+	else if (desc->unitsz == PARQUET_UNITSZ__VARLENA)
+	{
+		values_length = MAXALIGN(sizeof(uint32) * (nitems + 1));
+		ds.extra_nrooms = Max(chunk_length, BLCKSZ);
+		ds.extra = palloc_huge(ds.extra_nrooms);
+	}
+	else
+		values_length = MAXALIGN(desc->unitsz * nitems);
+	ds.values = palloc_huge(values_length);
+	memset(ds.values, 0, values_length);
+
+	chunk = palloc_huge(chunk_length);
+	__parquetReadChunk(FileGetRawDesc(fdesc), chunk_offset,
+					   chunk_length, chunk);
+	while (ds.row < nitems && pos < chunk_length)
+	{
+		ParquetPageHeader phead;
+		ThriftCursor t;
+		const unsigned char *page;
+
+		t.pos = chunk + pos;
+		t.end = chunk + chunk_length;
+		__parquetReadPageHeader(&t, &phead);
+		page = t.pos;
+		if (phead.compressed_page_size > t.end - t.pos)
+			elog(ERROR, "parquet: page is out of the column chunk");
+		pos = (page - chunk) + phead.compressed_page_size;
+
+		switch (phead.type)
+		{
+			case ParquetPageType__DICTIONARY_PAGE:
+				{
+					const unsigned char *dpos;
+
+					if (phead.encoding != ParquetEncoding__PLAIN &&
+						phead.encoding != ParquetEncoding__PLAIN_DICTIONARY)
+						elog(ERROR, "parquet: encoding %d of dictionary page is not supported",
+							 phead.encoding);
+					dpos = __parquetDecompressPage(desc, page,
+												   phead.compressed_page_size,
+												   phead.uncompressed_page_size);
+					memset(&ds.dict, 0, sizeof(ParquetValues));
+					__decodePlainValues(desc, dpos,
+										dpos + phead.uncompressed_page_size,
+										phead.num_values, &ds.dict);
+					ds.has_dict = true;
+				}
+				break;
+			case ParquetPageType__DATA_PAGE:
+			case ParquetPageType__DATA_PAGE_V2:
+				__parquetDecodeDataPage(&ds, &phead, page);
+				break;
+			default:
+				/* INDEX_PAGE and others are not needed */
+				break;
+		}
+	}
+	if (ds.row != nitems)
+		elog(ERROR, "parquet: column chunk has %ld values, but %ld expected",
+			 (long)ds.row, (long)nitems);
+	pfree(chunk);
+
+	memset(result, 0, sizeof(ParquetDecodedChunk));
+	result->nitems = nitems;
+	result->null_count = ds.null_count;
+	if (ds.null_count > 0)
+	{
+		result->nullmap = ds.nullmap;
+		result->nullmap_length = nullmap_length;
+	}
+	else if (ds.nullmap)
+		pfree(ds.nullmap);
+	result->values = ds.values;
+	result->values_length = values_length;
+	if (ds.extra)
+	{
+		size_t	extra_length = MAXALIGN(ds.extra_usage);
+
+		if (extra_length > ds.extra_nrooms)
+			ds.extra = repalloc_huge(ds.extra, extra_length);
+		memset(ds.extra + ds.extra_usage, 0, extra_length - ds.extra_usage);
+		result->extra = ds.extra;
+		result->extra_length = extra_length;
+	}
+}
@@ -8,6 +8,14 @@
  */
 #include "postgres.h"
 #include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#ifdef HAVE_LIBLZ4
+#include <lz4frame.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
 #include "arrow_ipc.h"
 
 typedef struct
@@ -668,10 +676,22 @@ createArrowSchema(ArrowSchema *node)
 	return makeBufferFlatten(buf);
 }
 
+static FBTableBuf *
+createArrowBodyCompression(ArrowBodyCompression *node)
+{
+	FBTableBuf *buf = allocFBTableBuf(2);
+
+	assert(ArrowNodeIs(node, BodyCompression));
+	addBufferChar(buf, 0, node->codec);
+	addBufferChar(buf, 1, node->method);
+
+	return makeBufferFlatten(buf);
+}
+
 static FBTableBuf *
 createArrowRecordBatch(ArrowRecordBatch *node)
 {
-	FBTableBuf *buf = allocFBTableBuf(3);
+	FBTableBuf *buf = allocFBTableBuf(4);
 
 	assert(ArrowNodeIs(node, RecordBatch));
 	addBufferLong(buf, 0, node->length);
@@ -681,6 +701,8 @@ createArrowRecordBatch(ArrowRecordBatch *node)
 	addBufferArrowBufferVector(buf, 2,
 							   node->_num_buffers,
 							   node->buffers);
+	if (node->compression)
+		addBufferOffset(buf, 3, createArrowBodyCompression(node->compression));
 	return makeBufferFlatten(buf);
 }
 
@@ -790,6 +812,187 @@ createArrowFooter(ArrowFooter *node)
  * Routines for File I/O
  * ---------------------------------------------------------------- */
 
+/*
+ * sql_table_write - writes out the image to the output file, or to the
+ * write-combining buffer if attached
+ */
+static void
+__sql_table_pwrite(int fdesc, const char *addr, size_t length, off_t f_pos)
+{
+	ssize_t		nbytes;
+
+	while (length > 0)
+	{
+		nbytes = pwrite(fdesc, addr, length, f_pos);
+		if (nbytes < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Elog("failed on pwrite(2): %m");
+		}
+		addr += nbytes;
+		length -= nbytes;
+		f_pos += nbytes;
+	}
+}
+
+static void
+sql_table_write(SQLtable *table, const void *addr, size_t length)
+{
+	SQLwbuffer *wbuf = table->wbuffer;
+	const char *pos = addr;
+	ssize_t		nbytes;
+
+	if (!wbuf)
+	{
+		while (length > 0)
+		{
+			nbytes = write(table->fdesc, pos, length);
+			if (nbytes < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				Elog("failed on write(2): %m");
+			}
+			pos += nbytes;
+			length -= nbytes;
+		}
+		return;
+	}
+
+	while (length > 0)
+	{
+		nbytes = Min(length, wbuf->length - wbuf->usage);
+		memcpy(wbuf->data + wbuf->usage, pos, nbytes);
+		wbuf->usage += nbytes;
+		pos += nbytes;
+		length -= nbytes;
+		if (wbuf->usage == wbuf->length)
+		{
+			__sql_table_pwrite(table->fdesc, wbuf->data,
+							   wbuf->usage, wbuf->f_pos);
+			wbuf->f_pos += wbuf->usage;
+			wbuf->usage = 0;
+		}
+	}
+}
+
+static void
+sql_table_write_buffer(SQLtable *table, SQLbuffer *buf)
+{
+	static const char zero[64];
+	size_t		gap = ARROWALIGN(buf->usage) - buf->usage;
+
+	sql_table_write(table, buf->data, buf->usage);
+	if (gap > 0)
+		sql_table_write(table, zero, gap);
+}
+
+/*
+ * sql_table_position - current file position, including the portion on
+ * the write-combining buffer
+ */
+static off_t
+sql_table_position(SQLtable *table)
+{
+	off_t		f_pos;
+
+	if (table->wbuffer)
+		return table->wbuffer->f_pos + table->wbuffer->usage;
+	f_pos = lseek(table->fdesc, 0, SEEK_CUR);
+	if (f_pos < 0)
+		Elog("unable to get current position of the file: %m");
+	return f_pos;
+}
+
+/*
+ * sql_table_attach_wbuffer
+ *
+ * It attaches a write-combining buffer of @length bytes on the table.
+ * The unaligned portion in front of the current file position is read
+ * back onto the buffer, so the caller can set O_DIRECT on the file
+ * descriptor once the buffer is attached.
+ */
+void
+sql_table_attach_wbuffer(SQLtable *table, size_t length, size_t align)
+{
+	SQLwbuffer *wbuf;
+	off_t		f_pos;
+	char	   *pos;
+	size_t		remain;
+	ssize_t		nbytes;
+
+	if (table->wbuffer)
+		Elog("Bug? write-combining buffer is already attached");
+	if (align == 0 || (align & (align - 1)) != 0)
+		Elog("alignment of write-combining buffer must be power of 2");
+	length = TYPEALIGN(align, length);
+	f_pos = sql_table_position(table);
+
+	wbuf = malloc(sizeof(SQLwbuffer));
+	if (!wbuf)
+		Elog("out of memory");
+	if (posix_memalign((void **)&wbuf->data, align, length) != 0)
+		Elog("out of memory");
+	wbuf->length = length;
+	wbuf->align = align;
+	wbuf->f_pos = f_pos & ~((off_t)align - 1);
+	wbuf->usage = f_pos - wbuf->f_pos;
+
+	/* read back the unaligned portion */
+	pos = wbuf->data;
+	remain = wbuf->usage;
+	f_pos = wbuf->f_pos;
+	while (remain > 0)
+	{
+		nbytes = pread(table->fdesc, pos, remain, f_pos);
+		if (nbytes < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Elog("failed on pread(2): %m");
+		}
+		else if (nbytes == 0)
+			Elog("pread: unexpected EOF");
+		pos += nbytes;
+		remain -= nbytes;
+		f_pos += nbytes;
+	}
+	table->wbuffer = wbuf;
+}
+
+/*
+ * sql_table_detach_wbuffer
+ *
+ * It flushes the write-combining buffer, then detaches it. The last block
+ * is written with zero padding up to the alignment, then the file is
+ * truncated to the exact length.
+ */
+void
+sql_table_detach_wbuffer(SQLtable *table)
+{
+	SQLwbuffer *wbuf = table->wbuffer;
+	off_t		f_pos;
+	size_t		length;
+
+	if (!wbuf)
+		return;
+	f_pos = wbuf->f_pos + wbuf->usage;
+	if (wbuf->usage > 0)
+	{
+		length = TYPEALIGN(wbuf->align, wbuf->usage);
+		memset(wbuf->data + wbuf->usage, 0, length - wbuf->usage);
+		__sql_table_pwrite(table->fdesc, wbuf->data, length, wbuf->f_pos);
+		if (ftruncate(table->fdesc, f_pos) != 0)
+			Elog("failed on ftruncate(2): %m");
+	}
+	if (lseek(table->fdesc, f_pos, SEEK_SET) < 0)
+		Elog("failed on lseek(2): %m");
+	free(wbuf->data);
+	free(wbuf);
+	table->wbuffer = NULL;
+}
+
 /*
  * writeFlatBufferMessage
  */
@@ -802,14 +1005,13 @@ typedef struct
 } FBMessageFileImage;
 
 static ssize_t
-writeFlatBufferMessage(int fdesc, ArrowMessage *message)
+writeFlatBufferMessage(SQLtable *table, ArrowMessage *message)
 {
 	FBTableBuf *payload = createArrowMessage(message);
 	FBMessageFileImage *image;
 	ssize_t		offset;
 	ssize_t		gap;
 	ssize_t		length;
-	ssize_t		nbytes;
 
 	assert(payload->length > 0);
 	offset = TYPEALIGN(payload->maxalign, payload->vtable.vlen);
@@ -823,18 +1025,8 @@ writeFlatBufferMessage(int fdesc, ArrowMessage *message)
 	image->rootOffset = sizeof(int32) + offset;
 	memcpy(image->data + gap, &payload->vtable, payload->length);
 
-	offset = 0;
-	while (offset < length)
-	{
-		nbytes = write(fdesc, (char *)image + offset, length - offset);
-		if (nbytes < 0)
-		{
-			if (errno == EINTR)
-				continue;
-			Elog("failed on write: %m");
-		}
-		offset += nbytes;
-	}
+	sql_table_write(table, image, length);
+
 	return length;
 }
 
@@ -854,7 +1046,7 @@ typedef struct
 } FBFooterTailImage;
 
 static ssize_t
-writeFlatBufferFooter(int fdesc, ArrowFooter *footer)
+writeFlatBufferFooter(SQLtable *table, ArrowFooter *footer)
 {
 	FBTableBuf *payload = createArrowFooter(footer);
 	FBFooterFileImage *image;
@@ -865,9 +1057,7 @@ writeFlatBufferFooter(int fdesc, ArrowFooter *footer)
 	uint64		eos = 0xffffffffUL;
 
 	/* put EOS and ensure 64bit alignment */
-	nbytes = write(fdesc, &eos, sizeof(uint64));
-	if (nbytes != sizeof(uint64))
-		Elog("failed on write: %m");
+	sql_table_write(table, &eos, sizeof(uint64));
 
 	assert(payload->length > 0);
     offset = INTALIGN(payload->vtable.vlen) - payload->vtable.vlen;
@@ -885,8 +1075,8 @@ writeFlatBufferFooter(int fdesc, ArrowFooter *footer)
 	tail = (FBFooterTailImage *)(image->data + nbytes);
 	tail->metaOffset = nbytes + sizeof(int32);
 	strcpy(tail->signature, "ARROW1");
-	if (write(fdesc, image, length) != length)
-		Elog("failed on write: %m");
+	sql_table_write(table, image, length);
+
 	return length;
 }
 
@@ -961,7 +1151,7 @@ writeArrowSchema(SQLtable *table)
 	schema->custom_metadata = table->customMetadata;
 	schema->_num_custom_metadata = table->numCustomMetadata;
 	/* serialization */
-	return writeFlatBufferMessage(table->fdesc, &message);
+	return writeFlatBufferMessage(table, &message);
 }
 
 
@@ -969,7 +1159,7 @@ writeArrowSchema(SQLtable *table)
  * writeArrowDictionaryBatches
  */
 static ArrowBlock
-__writeArrowDictionaryBatch(int fdesc, SQLdictionary *dict)
+__writeArrowDictionaryBatch(SQLtable *table, SQLdictionary *dict)
 {
 	ArrowMessage	message;
 	ArrowDictionaryBatch *dbatch;
@@ -987,7 +1177,7 @@ __writeArrowDictionaryBatch(int fdesc, SQLdictionary *dict)
 	dbatch = &message.body.dictionaryBatch;
 	initArrowNode(dbatch, DictionaryBatch);
 	dbatch->id = dict->dict_id;
-	dbatch->isDelta = (dict->nloaded > 0);
+	dbatch->isDelta = dict->is_written;
 
 	/* ArrowFieldNode of RecordBatch */
 	initArrowNode(&fnodes[0], FieldNode);
@@ -1024,12 +1214,10 @@ __writeArrowDictionaryBatch(int fdesc, SQLdictionary *dict)
     message.version = ArrowMetadataVersion__V4;
 	message.bodyLength = bodyLength;
 
-	currPos = lseek(fdesc, 0, SEEK_CUR);
-	if (currPos < 0)
-		Elog("unable to get current position of the file");
-	metaLength = writeFlatBufferMessage(fdesc, &message);
-	sql_buffer_write(fdesc, &dict->values);
-	sql_buffer_write(fdesc, &dict->extra);
+	currPos = sql_table_position(table);
+	metaLength = writeFlatBufferMessage(table, &message);
+	sql_table_write_buffer(table, &dict->values);
+	sql_table_write_buffer(table, &dict->extra);
 
 	/* setup Block of Footer */
 	initArrowNode(&block, Block);
@@ -1049,7 +1237,7 @@ writeArrowDictionaryBatches(SQLtable *table)
 
 	for (dict = table->sql_dict_list; dict; dict = dict->next)
 	{
-		if (dict->nloaded > 0 && dict->nloaded == dict->nitems)
+		if (dict->is_written && dict->nloaded == dict->nitems)
 			continue;		/* nothing to be written */
 
 		if (!table->dictionaries)
@@ -1057,12 +1245,61 @@ writeArrowDictionaryBatches(SQLtable *table)
 		else
 			table->dictionaries = repalloc(table->dictionaries,
 										   sizeof(ArrowBlock) * (index+1));
-		block = __writeArrowDictionaryBatch(table->fdesc, dict);
+		block = __writeArrowDictionaryBatch(table, dict);
 		table->dictionaries[index++] = block;
+
+		/* items added later shall be written as a delta */
+		dict->nloaded = dict->nitems;
+		dict->is_written = true;
+		sql_buffer_clear(&dict->values);
+		sql_buffer_clear(&dict->extra);
 	}
 	table->numDictionaries = index;
 }
 
+/*
+ * resetArrowDictionaryBatches
+ *
+ * It rebuilds the whole image of the dictionaries, to be written as base
+ * DictionaryBatches on the next writeArrowDictionaryBatches(); for a new
+ * output file.
+ */
+void
+resetArrowDictionaryBatches(SQLtable *table)
+{
+	SQLdictionary  *dict;
+	hashItem	   *hitem;
+	hashItem	  **items;
+	int				i;
+
+	for (dict = table->sql_dict_list; dict; dict = dict->next)
+	{
+		items = palloc0(sizeof(hashItem *) * (dict->nitems + 1));
+		for (i=0; i < dict->nslots; i++)
+		{
+			for (hitem = dict->hslots[i]; hitem; hitem = hitem->next)
+			{
+				assert(hitem->index < dict->nitems);
+				items[hitem->index] = hitem;
+			}
+		}
+		sql_buffer_clear(&dict->values);
+		sql_buffer_clear(&dict->extra);
+		sql_buffer_append_zero(&dict->values, sizeof(uint32));
+		for (i=0; i < dict->nitems; i++)
+		{
+			hitem = items[i];
+			sql_buffer_append(&dict->extra, hitem->label, hitem->label_sz);
+			sql_buffer_append(&dict->values,
+							  &dict->extra.usage, sizeof(uint32));
+		}
+		dict->nloaded = 0;
+		dict->is_written = false;
+	}
+	table->dictionaries = NULL;
+	table->numDictionaries = 0;
+}
+
 /*
  * setupArrowFieldNode
  */
@@ -1292,15 +1529,15 @@ estimateArrowBufferLength(SQLfield *column, size_t nitems)
 }
 
 static void
-writeArrowBuffer(int fdesc, SQLfield *column)
+writeArrowBuffer(SQLtable *table, SQLfield *column)
 {
 	if (column->enumdict)
 	{
 		/* Enum data types */
 		assert(column->arrow_type.node.tag == ArrowNodeTag__Utf8);
 		if (column->nullcount > 0)
-			sql_buffer_write(fdesc, &column->nullmap);
-		sql_buffer_write(fdesc, &column->values);
+			sql_table_write_buffer(table, &column->nullmap);
+		sql_table_write_buffer(table, &column->values);
 	}
 	else if (column->element)
 	{
@@ -1308,9 +1545,9 @@ writeArrowBuffer(int fdesc, SQLfield *column)
 		assert(column->arrow_type.node.tag == ArrowNodeTag__List ||
 			   column->arrow_type.node.tag == ArrowNodeTag__LargeList);
 		if (column->nullcount > 0)
-			sql_buffer_write(fdesc, &column->nullmap);
-		sql_buffer_write(fdesc, &column->values);
-		writeArrowBuffer(fdesc, column->element);
+			sql_table_write_buffer(table, &column->nullmap);
+		sql_table_write_buffer(table, &column->values);
+		writeArrowBuffer(table, column->element);
 	}
 	else if (column->subfields)
 	{
@@ -1319,9 +1556,9 @@ writeArrowBuffer(int fdesc, SQLfield *column)
 		/* Composite data types */
 		assert(column->arrow_type.node.tag == ArrowNodeTag__Struct);
 		if (column->nullcount > 0)
-			sql_buffer_write(fdesc, &column->nullmap);
+			sql_table_write_buffer(table, &column->nullmap);
 		for (j=0; j < column->nfields; j++)
-			writeArrowBuffer(fdesc, &column->subfields[j]);
+			writeArrowBuffer(table, &column->subfields[j]);
 	}
 	else
 	{
@@ -1338,8 +1575,8 @@ writeArrowBuffer(int fdesc, SQLfield *column)
 			case ArrowNodeTag__Interval:
 			case ArrowNodeTag__FixedSizeBinary:
 				if (column->nullcount > 0)
-					sql_buffer_write(fdesc, &column->nullmap);
-				sql_buffer_write(fdesc, &column->values);
+					sql_table_write_buffer(table, &column->nullmap);
+				sql_table_write_buffer(table, &column->values);
 				break;
 
 			/* variable length type */
@@ -1348,9 +1585,176 @@ writeArrowBuffer(int fdesc, SQLfield *column)
 			case ArrowNodeTag__LargeUtf8:
 			case ArrowNodeTag__LargeBinary:
 				if (column->nullcount > 0)
-					sql_buffer_write(fdesc, &column->nullmap);
-				sql_buffer_write(fdesc, &column->values);
-				sql_buffer_write(fdesc, &column->extra);
+					sql_table_write_buffer(table, &column->nullmap);
+				sql_table_write_buffer(table, &column->values);
+				sql_table_write_buffer(table, &column->extra);
+				break;
+
+			default:
+				Elog("Bug? Arrow Type %s is not supported right now",
+					 column->arrow_typename);
+				break;
+		}
+	}
+}
+
+/*
+ * Routines for compressed RecordBatch (BodyCompression)
+ *
+ * Each non-empty buffer is written as a 64bit length of the uncompressed
+ * image, followed by the compressed image. If compression does not make
+ * the buffer smaller, -1 is written as the length, then the raw image.
+ * The compressed body is built on the @zbuffer of SQLtable.
+ */
+bool
+lookupArrowCompressionCodec(const char *name, ArrowCompressionType *p_codec)
+{
+	if (strcasecmp(name, "none") == 0)
+		return false;
+#ifdef HAVE_LIBLZ4
+	if (strcasecmp(name, "lz4") == 0 ||
+		strcasecmp(name, "lz4_frame") == 0)
+	{
+		*p_codec = ArrowCompressionType__LZ4_FRAME;
+		return true;
+	}
+#endif
+#ifdef HAVE_LIBZSTD
+	if (strcasecmp(name, "zstd") == 0)
+	{
+		*p_codec = ArrowCompressionType__ZSTD;
+		return true;
+	}
+#endif
+	Elog("compression codec '%s' is not supported", name);
+	return false;	/* not reachable */
+}
+
+static void
+__compress_arrow_buffer(SQLtable *table, ArrowBuffer *bnode, SQLbuffer *buf)
+{
+	SQLbuffer  *zbuf = &table->zbuffer;
+	size_t		offset = zbuf->usage;
+	size_t		bound	__attribute__((unused));
+	size_t		zlen;
+	int64		rawlen;
+	char	   *dest;
+
+	initArrowNode(bnode, Buffer);
+	bnode->offset = offset;
+	bnode->length = 0;
+	if (!buf || buf->usage == 0)
+		return;		/* empty buffer has no length prefix */
+
+	switch (table->codec)
+	{
+#ifdef HAVE_LIBLZ4
+		case ArrowCompressionType__LZ4_FRAME:
+			bound = LZ4F_compressFrameBound(buf->usage, NULL);
+			sql_buffer_expand(zbuf, offset + sizeof(int64) + bound);
+			dest = zbuf->data + offset + sizeof(int64);
+			zlen = LZ4F_compressFrame(dest, bound,
+									  buf->data, buf->usage, NULL);
+			if (LZ4F_isError(zlen))
+				Elog("failed on LZ4F_compressFrame: %s",
+					 LZ4F_getErrorName(zlen));
+			break;
+#endif
+#ifdef HAVE_LIBZSTD
+		case ArrowCompressionType__ZSTD:
+			bound = ZSTD_compressBound(buf->usage);
+			sql_buffer_expand(zbuf, offset + sizeof(int64) + bound);
+			dest = zbuf->data + offset + sizeof(int64);
+			zlen = ZSTD_compress(dest, bound,
+								 buf->data, buf->usage, 1);
+			if (ZSTD_isError(zlen))
+				Elog("failed on ZSTD_compress: %s",
+					 ZSTD_getErrorName(zlen));
+			break;
+#endif
+		default:
+			Elog("Bug? unsupported compression codec: %d", table->codec);
+			return;
+	}
+	if (zlen < buf->usage)
+		rawlen = buf->usage;
+	else
+	{
+		/* bound is never less than the raw image */
+		memcpy(dest, buf->data, buf->usage);
+		zlen = buf->usage;
+		rawlen = -1;
+	}
+	memcpy(zbuf->data + offset, &rawlen, sizeof(int64));
+	bnode->length = sizeof(int64) + zlen;
+	zbuf->usage = offset + bnode->length;
+	sql_buffer_append_zero(zbuf, ARROWALIGN(zbuf->usage) - zbuf->usage);
+}
+
+static int
+setupArrowBufferCompressed(ArrowBuffer *bnode, SQLfield *column,
+						   SQLtable *table)
+{
+	SQLbuffer  *nullmap = (column->nullcount > 0 ? &column->nullmap : NULL);
+	int			j, retval = -1;
+
+	if (column->enumdict)
+	{
+		/* Enum data types */
+		assert(column->arrow_type.node.tag == ArrowNodeTag__Utf8);
+		__compress_arrow_buffer(table, bnode, nullmap);
+		__compress_arrow_buffer(table, bnode+1, &column->values);
+		retval = 2;
+	}
+	else if (column->element)
+	{
+		/* Array data types */
+		assert(column->arrow_type.node.tag == ArrowNodeTag__List ||
+			   column->arrow_type.node.tag == ArrowNodeTag__LargeList);
+		__compress_arrow_buffer(table, bnode, nullmap);
+		__compress_arrow_buffer(table, bnode+1, &column->values);
+		retval = 2 + setupArrowBufferCompressed(bnode+2, column->element,
+												table);
+	}
+	else if (column->subfields)
+	{
+		/* Composite data types */
+		assert(column->arrow_type.node.tag == ArrowNodeTag__Struct);
+		__compress_arrow_buffer(table, bnode, nullmap);
+		retval = 1;
+		for (j=0; j < column->nfields; j++)
+			retval += setupArrowBufferCompressed(bnode + retval,
+												 &column->subfields[j],
+												 table);
+	}
+	else
+	{
+		switch (column->arrow_type.node.tag)
+		{
+			/* inline type */
+			case ArrowNodeTag__Int:
+			case ArrowNodeTag__FloatingPoint:
+			case ArrowNodeTag__Bool:
+			case ArrowNodeTag__Decimal:
+			case ArrowNodeTag__Date:
+			case ArrowNodeTag__Time:
+			case ArrowNodeTag__Timestamp:
+			case ArrowNodeTag__Interval:
+			case ArrowNodeTag__FixedSizeBinary:
+				__compress_arrow_buffer(table, bnode, nullmap);
+				__compress_arrow_buffer(table, bnode+1, &column->values);
+				retval = 2;
+				break;
+
+			/* variable length type */
+			case ArrowNodeTag__Utf8:
+			case ArrowNodeTag__Binary:
+			case ArrowNodeTag__LargeUtf8:
+			case ArrowNodeTag__LargeBinary:
+				__compress_arrow_buffer(table, bnode, nullmap);
+				__compress_arrow_buffer(table, bnode+1, &column->values);
+				__compress_arrow_buffer(table, bnode+2, &column->extra);
+				retval = 3;
 				break;
 
 			default:
@@ -1359,6 +1763,7 @@ writeArrowBuffer(int fdesc, SQLfield *column)
 				break;
 		}
 	}
+	return retval;
 }
 
 static void
@@ -1382,11 +1787,728 @@ sql_field_clear(SQLfield *column)
 	}
 }
 
+void
+sql_table_clear(SQLtable *table)
+{
+	int		j;
+
+	for (j=0; j < table->nfields; j++)
+		sql_field_clear(&table->columns[j]);
+	table->nitems = 0;
+}
+
+/*
+ * sql_table_append_row - copies a row of the source table to the tail of
+ * the destination table. Both tables must have identical field definitions.
+ * sql_field_append_row does the same for a field; the caller must also
+ * increment nitems of the destination table.
+ */
+static void		sql_field_append_rows(SQLfield *dest, SQLfield *source,
+									  size_t head, size_t nrows);
+
+static void
+__sql_field_append_offsets(SQLfield *dest, SQLfield *source,
+						   size_t head, size_t nrows, bool is_large)
+{
+	SQLbuffer  *values = &dest->values;
+	size_t		i;
+
+	if (values->usage == 0)
+		sql_buffer_append_zero(values, is_large ? sizeof(int64)
+											   : sizeof(int32));
+	for (i=head; i < head + nrows; i++)
+	{
+		int64		curr, next;
+
+		if (is_large)
+		{
+			curr = ((int64 *)source->values.data)[i];
+			next = ((int64 *)source->values.data)[i+1];
+		}
+		else
+		{
+			curr = ((int32 *)source->values.data)[i];
+			next = ((int32 *)source->values.data)[i+1];
+		}
+
+		if (source->element)
+		{
+			/* List; offsets to the element rows */
+			sql_field_append_rows(dest->element, source->element,
+								  curr, next - curr);
+			next = dest->element->nitems;
+		}
+		else
+		{
+			/* Utf8 or Binary; offsets to the extra buffer */
+			sql_buffer_append(&dest->extra,
+							  source->extra.data + curr, next - curr);
+			next = dest->extra.usage;
+		}
+
+		if (is_large)
+			sql_buffer_append(values, &next, sizeof(int64));
+		else
+		{
+			int32	__next = next;
+
+			sql_buffer_append(values, &__next, sizeof(int32));
+		}
+	}
+}
+
+static void
+sql_field_append_rows(SQLfield *dest, SQLfield *source,
+					  size_t head, size_t nrows)
+{
+	uint8	   *nullmap = (uint8 *)source->nullmap.data;
+	uint8	   *bitmap = (uint8 *)source->values.data;
+	size_t		base = dest->nitems;
+	size_t		i, j;
+
+	assert(head + nrows <= source->nitems);
+	for (i=head; i < head + nrows; i++)
+	{
+		size_t		row_index = dest->nitems++;
+
+		if (source->nullcount > 0 && (nullmap[i>>3] & (1<<(i&7))) == 0)
+		{
+			dest->nullcount++;
+			sql_buffer_clrbit(&dest->nullmap, row_index);
+		}
+		else
+			sql_buffer_setbit(&dest->nullmap, row_index);
+	}
+
+	if (source->subfields)
+	{
+		/* Composite data types */
+		for (j=0; j < source->nfields; j++)
+			sql_field_append_rows(&dest->subfields[j],
+								  &source->subfields[j], head, nrows);
+	}
+	else if (source->element)
+	{
+		/* Array data types */
+		__sql_field_append_offsets(dest, source, head, nrows,
+								   source->arrow_type.node.tag ==
+								   ArrowNodeTag__LargeList);
+	}
+	else if (source->enumdict)
+	{
+		/* Enum data types; dictionary indexes (int32) */
+		sql_buffer_append(&dest->values,
+						  source->values.data + sizeof(int32) * head,
+						  sizeof(int32) * nrows);
+	}
+	else
+	{
+		switch (source->arrow_type.node.tag)
+		{
+			case ArrowNodeTag__Bool:
+				for (i=head, j=base; i < head + nrows; i++, j++)
+				{
+					if ((bitmap[i>>3] & (1<<(i&7))) != 0)
+						sql_buffer_setbit(&dest->values, j);
+					else
+						sql_buffer_clrbit(&dest->values, j);
+				}
+				break;
+
+			/* inline type; values are fixed-length, also for nulls */
+			case ArrowNodeTag__Int:
+			case ArrowNodeTag__FloatingPoint:
+			case ArrowNodeTag__Decimal:
+			case ArrowNodeTag__Date:
+			case ArrowNodeTag__Time:
+			case ArrowNodeTag__Timestamp:
+			case ArrowNodeTag__Interval:
+			case ArrowNodeTag__FixedSizeBinary:
+				{
+					size_t	unitsz = source->values.usage / source->nitems;
+
+					assert(source->values.usage == unitsz * source->nitems);
+					sql_buffer_append(&dest->values,
+									  source->values.data + unitsz * head,
+									  unitsz * nrows);
+				}
+				break;
+
+			/* variable length type */
+			case ArrowNodeTag__Utf8:
+			case ArrowNodeTag__Binary:
+				__sql_field_append_offsets(dest, source, head, nrows, false);
+				break;
+			case ArrowNodeTag__LargeUtf8:
+			case ArrowNodeTag__LargeBinary:
+				__sql_field_append_offsets(dest, source, head, nrows, true);
+				break;
+
+			default:
+				Elog("Bug? Arrow Type %s is not supported right now",
+					 source->arrow_typename);
+				break;
+		}
+	}
+}
+
+static size_t
+sql_field_update_usage(SQLfield *column)
+{
+	size_t		usage = 0;
+	int			j;
+
+	if (column->nullcount > 0)
+		usage += ARROWALIGN(column->nullmap.usage);
+	usage += ARROWALIGN(column->values.usage);
+	usage += ARROWALIGN(column->extra.usage);
+	if (column->element)
+		usage += sql_field_update_usage(column->element);
+	for (j=0; j < column->nfields; j++)
+		usage += sql_field_update_usage(&column->subfields[j]);
+
+	return (column->__curr_usage__ = usage);
+}
+
+size_t
+sql_field_append_row(SQLfield *dest, SQLfield *source, size_t index)
+{
+	sql_field_append_rows(dest, source, index, 1);
+	return sql_field_update_usage(dest);
+}
+
+size_t
+sql_table_append_row(SQLtable *dest, SQLtable *source, size_t index)
+{
+	size_t		usage = 0;
+	int			j;
+
+	assert(dest->nfields == source->nfields && index < source->nitems);
+	dest->nitems++;
+	for (j=0; j < dest->nfields; j++)
+		usage += sql_field_append_row(&dest->columns[j],
+									  &source->columns[j], index);
+	return usage;
+}
+
+/*
+ * Routines for min/max statistics of RecordBatch
+ *
+ * If @stat_enabled, min/max values of the field are collected for each
+ * RecordBatch, then written out as custom-metadata of the Field in the
+ * Footer, as comma separated lists in order of RecordBatches; "NULL" means
+ * the RecordBatch has no valid statistics (e.g, all-null).
+ */
+#define ARROW_FIELD_STAT_MIN_VALUES		"min_values"
+#define ARROW_FIELD_STAT_MAX_VALUES		"max_values"
+
+static bool
+__arrowTypeStatIsSupported(ArrowType *t)
+{
+	switch (t->node.tag)
+	{
+		case ArrowNodeTag__Int:
+			/* Uint64 is not representable by int64 */
+			return (t->Int.is_signed || t->Int.bitWidth < 64);
+		case ArrowNodeTag__FloatingPoint:
+			return (t->FloatingPoint.precision == ArrowPrecision__Single ||
+					t->FloatingPoint.precision == ArrowPrecision__Double);
+		case ArrowNodeTag__Date:
+		case ArrowNodeTag__Time:
+		case ArrowNodeTag__Timestamp:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+bool
+enableArrowFieldStat(SQLfield *column)
+{
+	if (column->enumdict ||
+		column->element ||
+		column->subfields ||
+		!__arrowTypeStatIsSupported(&column->arrow_type))
+		return false;
+	column->stat_enabled = true;
+	return true;
+}
+
+#define __UPDATE_FIELD_STAT_INT(TYPE)							\
+	do {														\
+		TYPE   *values = (TYPE *)column->values.data;			\
+																\
+		for (i=0; i < column->nitems; i++)						\
+		{														\
+			int64	ival;										\
+																\
+			if (nullmap && (nullmap[i>>3] & (1<<(i&7))) == 0)	\
+				continue;										\
+			ival = values[i];									\
+			if (!stat->is_valid)								\
+			{													\
+				stat->min.i64 = stat->max.i64 = ival;			\
+				stat->is_valid = true;							\
+			}													\
+			else if (ival < stat->min.i64)						\
+				stat->min.i64 = ival;							\
+			else if (ival > stat->max.i64)						\
+				stat->max.i64 = ival;							\
+		}														\
+	} while(0)
+
+#define __UPDATE_FIELD_STAT_FLOAT(TYPE)							\
+	do {														\
+		TYPE   *values = (TYPE *)column->values.data;			\
+																\
+		for (i=0; i < column->nitems; i++)						\
+		{														\
+			double	fval;										\
+																\
+			if (nullmap && (nullmap[i>>3] & (1<<(i&7))) == 0)	\
+				continue;										\
+			fval = values[i];									\
+			if (isnan(fval))									\
+			{													\
+				/* NaN has no reasonable ordering here */		\
+				stat->is_valid = false;							\
+				break;											\
+			}													\
+			if (!stat->is_valid)								\
+			{													\
+				stat->min.f64 = stat->max.f64 = fval;			\
+				stat->is_valid = true;							\
+			}													\
+			else if (fval < stat->min.f64)						\
+				stat->min.f64 = fval;							\
+			else if (fval > stat->max.f64)						\
+				stat->max.f64 = fval;							\
+		}														\
+	} while(0)
+
+static void
+__updateArrowFieldStat(SQLfield *column, int rb_index)
+{
+	ArrowType  *t = &column->arrow_type;
+	SQLstat	   *stat = palloc0(sizeof(SQLstat));
+	SQLstat	  **tail;
+	uint8	   *nullmap = NULL;
+	size_t		i;
+
+	stat->rb_index = rb_index;
+	if (column->nullcount > 0)
+		nullmap = (uint8 *)column->nullmap.data;
+	switch (t->node.tag)
+	{
+		case ArrowNodeTag__Int:
+			switch (t->Int.bitWidth)
+			{
+				case 8:
+					if (t->Int.is_signed)
+						__UPDATE_FIELD_STAT_INT(int8);
+					else
+						__UPDATE_FIELD_STAT_INT(uint8);
+					break;
+				case 16:
+					if (t->Int.is_signed)
+						__UPDATE_FIELD_STAT_INT(int16);
+					else
+						__UPDATE_FIELD_STAT_INT(uint16);
+					break;
+				case 32:
+					if (t->Int.is_signed)
+						__UPDATE_FIELD_STAT_INT(int32);
+					else
+						__UPDATE_FIELD_STAT_INT(uint32);
+					break;
+				case 64:
+					__UPDATE_FIELD_STAT_INT(int64);
+					break;
+				default:
+					break;
+			}
+			break;
+		case ArrowNodeTag__FloatingPoint:
+			if (t->FloatingPoint.precision == ArrowPrecision__Single)
+				__UPDATE_FIELD_STAT_FLOAT(float);
+			else if (t->FloatingPoint.precision == ArrowPrecision__Double)
+				__UPDATE_FIELD_STAT_FLOAT(double);
+			break;
+		case ArrowNodeTag__Date:
+			if (t->Date.unit == ArrowDateUnit__Day)
+				__UPDATE_FIELD_STAT_INT(int32);
+			else
+				__UPDATE_FIELD_STAT_INT(int64);
+			break;
+		case ArrowNodeTag__Time:
+			if (t->Time.unit == ArrowTimeUnit__Second ||
+				t->Time.unit == ArrowTimeUnit__MilliSecond)
+				__UPDATE_FIELD_STAT_INT(int32);
+			else
+				__UPDATE_FIELD_STAT_INT(int64);
+			break;
+		case ArrowNodeTag__Timestamp:
+			__UPDATE_FIELD_STAT_INT(int64);
+			break;
+		default:
+			break;
+	}
+	/* append to the tail */
+	for (tail = &column->stat_list; *tail; tail = &(*tail)->next);
+	*tail = stat;
+}
+#undef __UPDATE_FIELD_STAT_INT
+#undef __UPDATE_FIELD_STAT_FLOAT
+
+static void
+setupArrowFieldStat(ArrowField *field, SQLfield *column, int num_rbatches)
+{
+	SQLbuffer	min_buf;
+	SQLbuffer	max_buf;
+	SQLstat	   *stat;
+	ArrowKeyValue *kv;
+	bool		is_float;
+	char		temp[80];
+	int			index = 0;
+
+	if (!column->stat_enabled || num_rbatches == 0)
+		return;
+	is_float = (column->arrow_type.node.tag == ArrowNodeTag__FloatingPoint);
+
+	sql_buffer_init(&min_buf);
+	sql_buffer_init(&max_buf);
+	for (stat = column->stat_list; stat; stat = stat->next, index++)
+	{
+		if (stat->rb_index != index)
+			Elog("Bug? min/max statistics of '%s' lost RecordBatch[%d]",
+				 column->field_name, index);
+		if (index > 0)
+		{
+			sql_buffer_append(&min_buf, ",", 1);
+			sql_buffer_append(&max_buf, ",", 1);
+		}
+		if (!stat->is_valid)
+		{
+			sql_buffer_append(&min_buf, "NULL", 4);
+			sql_buffer_append(&max_buf, "NULL", 4);
+			continue;
+		}
+		if (is_float)
+			snprintf(temp, sizeof(temp), "%.17g", stat->min.f64);
+		else
+			snprintf(temp, sizeof(temp), "%ld", stat->min.i64);
+		sql_buffer_append(&min_buf, temp, strlen(temp));
+		if (is_float)
+			snprintf(temp, sizeof(temp), "%.17g", stat->max.f64);
+		else
+			snprintf(temp, sizeof(temp), "%ld", stat->max.i64);
+		sql_buffer_append(&max_buf, temp, strlen(temp));
+	}
+	if (index != num_rbatches)
+		Elog("Bug? min/max statistics of '%s' has %d items, but %d RecordBatches",
+			 column->field_name, index, num_rbatches);
+
+	kv = palloc0(sizeof(ArrowKeyValue) * (field->_num_custom_metadata + 2));
+	if (field->_num_custom_metadata > 0)
+		memcpy(kv, field->custom_metadata,
+			   sizeof(ArrowKeyValue) * field->_num_custom_metadata);
+	field->custom_metadata = kv;
+	kv += field->_num_custom_metadata;
+	field->_num_custom_metadata += 2;
+
+	initArrowNode(&kv[0], KeyValue);
+	kv[0].key = ARROW_FIELD_STAT_MIN_VALUES;
+	kv[0]._key_len = strlen(ARROW_FIELD_STAT_MIN_VALUES);
+	kv[0].value = min_buf.data;
+	kv[0]._value_len = min_buf.usage;
+
+	initArrowNode(&kv[1], KeyValue);
+	kv[1].key = ARROW_FIELD_STAT_MAX_VALUES;
+	kv[1]._key_len = strlen(ARROW_FIELD_STAT_MAX_VALUES);
+	kv[1].value = max_buf.data;
+	kv[1]._value_len = max_buf.usage;
+}
+
+static char *
+__fetchArrowFieldStatToken(char **p_pos)
+{
+	char	   *tok = *p_pos;
+	char	   *pos;
+
+	if (!tok)
+		return NULL;
+	pos = strchr(tok, ',');
+	if (!pos)
+		*p_pos = NULL;
+	else
+	{
+		*pos++ = '\0';
+		*p_pos = pos;
+	}
+	while (isspace(*tok))
+		tok++;
+	pos = tok + strlen(tok) - 1;
+	while (pos >= tok && isspace(*pos))
+		*pos-- = '\0';
+	return tok;
+}
+
+static bool
+__parseArrowFieldStatToken(const char *tok, bool is_float,
+						   SQLstat__datum *datum)
+{
+	char	   *end;
+
+	errno = 0;
+	if (is_float)
+		datum->f64 = strtod(tok, &end);
+	else
+		datum->i64 = strtol(tok, &end, 10);
+	return (errno == 0 && end != tok && *end == '\0');
+}
+
+/*
+ * readArrowFieldStat
+ *
+ * It returns an array of SQLstat for each RecordBatch, if the field has
+ * valid min/max statistics. Elsewhere, NULL shall be returned.
+ */
+SQLstat *
+readArrowFieldStat(ArrowField *field, int num_rbatches)
+{
+	SQLstat	   *results;
+	char	   *min_pos = NULL;
+	char	   *max_pos = NULL;
+	bool		is_float;
+	int			i;
+
+	if (num_rbatches == 0 || !__arrowTypeStatIsSupported(&field->type))
+		return NULL;
+	for (i=0; i < field->_num_custom_metadata; i++)
+	{
+		ArrowKeyValue  *kv = &field->custom_metadata[i];
+		char		   *value;
+
+		value = palloc(kv->_value_len + 1);
+		memcpy(value, kv->value, kv->_value_len);
+		value[kv->_value_len] = '\0';
+		if (kv->_key_len == strlen(ARROW_FIELD_STAT_MIN_VALUES) &&
+			strncmp(kv->key, ARROW_FIELD_STAT_MIN_VALUES, kv->_key_len) == 0)
+			min_pos = value;
+		else if (kv->_key_len == strlen(ARROW_FIELD_STAT_MAX_VALUES) &&
+				 strncmp(kv->key, ARROW_FIELD_STAT_MAX_VALUES, kv->_key_len) == 0)
+			max_pos = value;
+	}
+	if (!min_pos || !max_pos)
+		return NULL;
+	is_float = (field->type.node.tag == ArrowNodeTag__FloatingPoint);
+
+	results = palloc0(sizeof(SQLstat) * num_rbatches);
+	for (i=0; i < num_rbatches; i++)
+	{
+		SQLstat	   *stat = &results[i];
+		char	   *min_tok = __fetchArrowFieldStatToken(&min_pos);
+		char	   *max_tok = __fetchArrowFieldStatToken(&max_pos);
+
+		if (!min_tok || !max_tok)
+			return NULL;	/* number of items mismatch */
+		stat->next = (i+1 < num_rbatches ? &results[i+1] : NULL);
+		stat->rb_index = i;
+		if (strcmp(min_tok, "NULL") == 0 || strcmp(max_tok, "NULL") == 0)
+			stat->is_valid = false;
+		else if (__parseArrowFieldStatToken(min_tok, is_float, &stat->min) &&
+				 __parseArrowFieldStatToken(max_tok, is_float, &stat->max))
+			stat->is_valid = true;
+		else
+			return NULL;	/* corrupted statistics */
+	}
+	if (min_pos || max_pos)
+		return NULL;		/* number of items mismatch */
+	return results;
+}
+
+/*
+ * restoreArrowFieldStats
+ *
+ * It restores min/max statistics of the RecordBatches already written,
+ * on the append mode. If the existing file has no statistics, we cannot
+ * write out statistics consistently, so @stat_enabled shall be disabled.
+ */
+void
+restoreArrowFieldStats(SQLtable *table, ArrowFileInfo *af_info)
+{
+	ArrowSchema *schema = &af_info->footer.schema;
+	int			num_rbatches = af_info->footer._num_recordBatches;
+	int			j;
+
+	for (j=0; j < table->nfields; j++)
+	{
+		SQLfield   *column = &table->columns[j];
+
+		column->stat_list = NULL;
+		if (!column->stat_enabled || num_rbatches == 0)
+			continue;
+		if (j < schema->_num_fields)
+			column->stat_list = readArrowFieldStat(&schema->fields[j],
+												   num_rbatches);
+		if (!column->stat_list)
+			column->stat_enabled = false;
+	}
+}
+
+/*
+ * Routines for dictionary encoding of Utf8 fields
+ *
+ * enableArrowFieldDictionary() converts the Utf8 values already on the
+ * buffer into indexes of a new dictionary, if number of the distinct values
+ * is less than or equal to @max_cardinality. Values that appear later are
+ * added to the dictionary, then written out as delta DictionaryBatches by
+ * writeArrowDictionaryBatches().
+ */
+static uint32
+__putArrowDictionaryItem(SQLdictionary *dict, const char *addr, int sz)
+{
+	hashItem   *hitem;
+	uint32		hash, hindex;
+
+	hash = hash_any((const unsigned char *)addr, sz);
+	hindex = hash % dict->nslots;
+	for (hitem = dict->hslots[hindex]; hitem != NULL; hitem = hitem->next)
+	{
+		if (hitem->hash == hash &&
+			hitem->label_sz == sz &&
+			memcmp(hitem->label, addr, sz) == 0)
+			return hitem->index;
+	}
+	hitem = palloc(offsetof(hashItem, label[sz+1]));
+	hitem->hash = hash;
+	hitem->index = dict->nitems++;
+	hitem->label_sz = sz;
+	memcpy(hitem->label, addr, sz);
+	hitem->label[sz] = '\0';
+	hitem->next = dict->hslots[hindex];
+	dict->hslots[hindex] = hitem;
+
+	sql_buffer_append(&dict->extra, addr, sz);
+	if (dict->values.usage == 0)
+		sql_buffer_append_zero(&dict->values, sizeof(uint32));
+	sql_buffer_append(&dict->values, &dict->extra.usage, sizeof(uint32));
+
+	return hitem->index;
+}
+
+static size_t
+put_dictionary_text_value(SQLfield *column, const char *addr, int sz)
+{
+	size_t		row_index = column->nitems++;
+	uint32		index = 0;
+	size_t		usage;
+
+	if (!addr)
+	{
+		column->nullcount++;
+		sql_buffer_clrbit(&column->nullmap, row_index);
+	}
+	else
+	{
+		index = __putArrowDictionaryItem(column->enumdict, addr, sz);
+		sql_buffer_setbit(&column->nullmap, row_index);
+	}
+	sql_buffer_append(&column->values, &index, sizeof(uint32));
+
+	usage = ARROWALIGN(column->values.usage);
+	if (column->nullcount > 0)
+		usage += ARROWALIGN(column->nullmap.usage);
+	return usage;
+}
+
+void
+setupArrowFieldDictionary(SQLfield *column, SQLdictionary *dict)
+{
+	assert(column->arrow_type.node.tag == ArrowNodeTag__Utf8);
+	column->enumdict = dict;
+	column->arrow_typename = "Utf8 (dictionary)";
+	column->put_value = put_dictionary_text_value;
+}
+
+bool
+enableArrowFieldDictionary(SQLtable *table, SQLfield *column,
+						   int max_cardinality)
+{
+	SQLdictionary *dict;
+	uint32	   *values = (uint32 *)column->values.data;
+	uint8	   *nullmap = NULL;
+	int64		dict_id = 0;
+	int			nslots = Max(max_cardinality, 1024);
+	size_t		i;
+
+	if (column->enumdict ||
+		column->element ||
+		column->subfields ||
+		column->arrow_type.node.tag != ArrowNodeTag__Utf8 ||
+		max_cardinality <= 0)
+		return false;
+	if (column->nullcount > 0)
+		nullmap = (uint8 *)column->nullmap.data;
+
+	/* dictionary-id next to the existing ones */
+	for (dict = table->sql_dict_list; dict != NULL; dict = dict->next)
+		dict_id = Max(dict_id, dict->dict_id + 1);
+	dict = palloc0(offsetof(SQLdictionary, hslots[nslots]));
+	dict->dict_id = dict_id;
+	sql_buffer_init(&dict->values);
+	sql_buffer_init(&dict->extra);
+	dict->nslots = nslots;
+
+	/*
+	 * checks the cardinality; the dictionary is just abandoned if too
+	 * many distinct values, but it has at most @max_cardinality items.
+	 */
+	for (i=0; i < column->nitems; i++)
+	{
+		if (nullmap && (nullmap[i>>3] & (1<<(i&7))) == 0)
+			continue;
+		__putArrowDictionaryItem(dict, column->extra.data + values[i],
+								 values[i+1] - values[i]);
+		if (dict->nitems > max_cardinality)
+			return false;
+	}
+
+	/*
+	 * replaces the offsets by the dictionary indexes; values[i+1] is not
+	 * overwritten until i-th item is processed.
+	 */
+	for (i=0; i < column->nitems; i++)
+	{
+		uint32		index = 0;
+
+		if (!nullmap || (nullmap[i>>3] & (1<<(i&7))) != 0)
+			index = __putArrowDictionaryItem(dict,
+											 column->extra.data + values[i],
+											 values[i+1] - values[i]);
+		values[i] = index;
+	}
+	column->values.usage = sizeof(uint32) * column->nitems;
+	sql_buffer_clear(&column->extra);
+
+	dict->next = table->sql_dict_list;
+	table->sql_dict_list = dict;
+	setupArrowFieldDictionary(column, dict);
+	table->numBuffers--;	/* no extra buffer */
+
+	column->__curr_usage__ = ARROWALIGN(column->values.usage);
+	if (column->nullcount > 0)
+		column->__curr_usage__ += ARROWALIGN(column->nullmap.usage);
+	return true;
+}
+
 int
 writeArrowRecordBatch(SQLtable *table)
 {
 	ArrowMessage	message;
 	ArrowRecordBatch *rbatch;
+	ArrowBodyCompression compression;
 	ArrowFieldNode *nodes;
 	ArrowBuffer	   *buffers;
 	ArrowBlock	   *block;
@@ -1398,16 +2520,13 @@ writeArrowRecordBatch(SQLtable *table)
 
 	assert(table->nitems > 0);
 	/* adjust current file position */
-	currPos = lseek(table->fdesc, 0, SEEK_CUR);
-	if (currPos < 0)
-		Elog("unable to get current position of the file");
+	currPos = sql_table_position(table);
 	if (currPos != LONGALIGN(currPos))
 	{
 		uint64  zero = 0;
 		size_t  gap = LONGALIGN(currPos) - currPos;
 
-		if (write(table->fdesc, &zero, gap) != gap)
-			Elog("unable to fill up alignment gap: %m");
+		sql_table_write(table, &zero, gap);
 	}
 
 	/* fill up [nodes] vector */
@@ -1421,16 +2540,31 @@ writeArrowRecordBatch(SQLtable *table)
 
 	/* fill up [buffers] vector */
 	buffers = alloca(sizeof(ArrowBuffer) * table->numBuffers);
-	for (i=0, j=0; i < table->nfields; i++)
+	if (!table->compressed)
+	{
+		for (i=0, j=0; i < table->nfields; i++)
+		{
+			j += setupArrowBuffer(&buffers[j], &table->columns[i],
+								  &bodyLength);
+		}
+	}
+	else
 	{
-		j += setupArrowBuffer(&buffers[j], &table->columns[i],
-							  &bodyLength);
+		sql_buffer_clear(&table->zbuffer);
+		for (i=0, j=0; i < table->nfields; i++)
+		{
+			j += setupArrowBufferCompressed(&buffers[j], &table->columns[i],
+											table);
+		}
+		bodyLength = table->zbuffer.usage;
 	}
 	assert(j == table->numBuffers);
 
 	/* setup Message of Schema */
 	initArrowNode(&message, Message);
-	message.version = ArrowMetadataVersion__V4;
+	message.version = (table->compressed
+					   ? ArrowMetadataVersion__V5
+					   : ArrowMetadataVersion__V4);
 	message.bodyLength = bodyLength;
 
 	rbatch = &message.body.recordBatch;
@@ -1440,10 +2574,31 @@ writeArrowRecordBatch(SQLtable *table)
 	rbatch->_num_nodes = table->numFieldNodes;
 	rbatch->buffers = buffers;
 	rbatch->_num_buffers = table->numBuffers;
+	if (table->compressed)
+	{
+		initArrowNode(&compression, BodyCompression);
+		compression.codec = table->codec;
+		compression.method = ArrowBodyCompressionMethod__BUFFER;
+		rbatch->compression = &compression;
+	}
 	/* serialization */
-	metaLength = writeFlatBufferMessage(table->fdesc, &message);
+	metaLength = writeFlatBufferMessage(table, &message);
+	if (!table->compressed)
+	{
+		for (j=0; j < table->nfields; j++)
+			writeArrowBuffer(table, &table->columns[j]);
+	}
+	else
+		sql_table_write_buffer(table, &table->zbuffer);
+
+	/* update min/max statistics, if enabled */
 	for (j=0; j < table->nfields; j++)
-		writeArrowBuffer(table->fdesc, &table->columns[j]);
+	{
+		SQLfield   *column = &table->columns[j];
+
+		if (column->stat_enabled)
+			__updateArrowFieldStat(column, table->numRecordBatches);
+	}
 
 	/* save the offset/length at ArrowBlock */
 	index = table->numRecordBatches++;
@@ -1459,9 +2614,7 @@ writeArrowRecordBatch(SQLtable *table)
 	block->bodyLength = bodyLength;
 
 	/* make the local buffer empty again */
-	for (j=0; j < table->nfields; j++)
-		sql_field_clear(&table->columns[j]);
-	table->nitems = 0;
+	sql_table_clear(table);
 
 	return index;
 }
@@ -1487,7 +2640,11 @@ writeArrowFooter(SQLtable *table)
 	schema->fields = alloca(sizeof(ArrowField) * table->nfields);
 	schema->_num_fields = table->nfields;
 	for (i=0; i < table->nfields; i++)
+	{
 		setupArrowField(&schema->fields[i], &table->columns[i]);
+		setupArrowFieldStat(&schema->fields[i], &table->columns[i],
+							table->numRecordBatches);
+	}
 	schema->custom_metadata = table->customMetadata;
 	schema->_num_custom_metadata = table->numCustomMetadata;
 
@@ -1500,5 +2657,5 @@ writeArrowFooter(SQLtable *table)
 	footer._num_recordBatches = table->numRecordBatches;
 
 	/* serialization */
-	return writeFlatBufferFooter(table->fdesc, &footer);
+	return writeFlatBufferFooter(table, &footer);
 }
@@ -228,6 +228,10 @@ PDS_fetch_tuple(TupleTableSlot *slot,
 			return KDS_fetch_tuple_column(slot, &pds->kds,
 										  gts->curr_index++);
 		case KDS_FORMAT_ARROW:
+			/* only referenced columns, and skip rows by the outer quals */
+			if (gts->af_state)
+				return ArrowFdwFetchTuple(slot, gts->af_state, pds,
+										  &gts->curr_index);
 			return KDS_fetch_tuple_arrow(slot, &pds->kds,
 										 gts->curr_index++);
 		default:
@@ -331,7 +335,10 @@ PDS_release(pgstrom_data_store *pds)
 		if (!pds->gcontext)
 		{
 			Assert(pds->kds.format == KDS_FORMAT_ARROW);
-			pfree(pds);
+			if (pds->mmap_state)
+				ReleaseArrowFdwMmapState(pds->mmap_state);
+			else
+				pfree(pds);
 		}
 #if 0
 		else if ((pds->kds.format == KDS_FORMAT_BLOCK) ||
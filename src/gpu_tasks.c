@@ -217,6 +217,7 @@ void
 pgstromInitGpuTaskState(GpuTaskState *gts,
 						GpuContext *gcontext,
 						GpuTaskKind task_kind,
+						List *outer_quals,
 						List *outer_refs_list,
 						List *used_params,
 						cl_int optimal_gpu,
@@ -263,7 +264,9 @@ pgstromInitGpuTaskState(GpuTaskState *gts,
 		}
 		/* setup ArrowFdwState, if foreign-table */
 		if (RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE)
-			gts->af_state = ExecInitArrowFdw(relation, outer_refs);
+			gts->af_state = ExecInitArrowFdw(&gts->css.ss,
+											 outer_quals,
+											 outer_refs);
 	}
 	gts->outer_refs = outer_refs;
 	gts->scan_done = false;
@@ -654,7 +657,7 @@ pgstromInitDSMGpuTaskState(GpuTaskState *gts,
 	if (gts->af_state)
 	{
 		Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE);
-		ExecInitDSMArrowFdw(gts->af_state, &gtss->af_rbatch_index);
+		ExecInitDSMArrowFdw(gts->af_state, &gtss->af_sstate);
 	}
 	else if (relation)
 	{
@@ -684,7 +687,7 @@ pgstromInitWorkerGpuTaskState(GpuTaskState *gts, void *coordinate)
 	if (gts->af_state)
 	{
 		Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE);
-		ExecInitWorkerArrowFdw(gts->af_state, &gtss->af_rbatch_index);
+		ExecInitWorkerArrowFdw(gts->af_state, &gtss->af_sstate);
 	}
 	else if (relation)
 	{
@@ -718,6 +721,17 @@ pgstromReInitializeDSMGpuTaskState(GpuTaskState *gts)
 		table_parallelscan_reinitialize(relation, &gtss->phscan);
 }
 
+/*
+ * pgstromShutdownDSMGpuTaskState
+ */
+void
+pgstromShutdownDSMGpuTaskState(GpuTaskState *gts)
+{
+	/* save the run-time statistics of Arrow_Fdw prior to DSM release */
+	if (gts->af_state)
+		ExecShutdownArrowFdw(gts->af_state);
+}
+
 /*
  * pgstromInitGpuTask
  */
@@ -2721,6 +2721,7 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	pgstromInitGpuTaskState(&gjs->gts,
 							gjs->gts.gcontext,
 							GpuTaskKind_GpuJoin,
+							gj_info->outer_quals,
 							gj_info->outer_refs,
 							gj_info->used_params,
 							gj_info->optimal_gpu,
@@ -3515,6 +3516,7 @@ ExecShutdownGpuJoin(CustomScanState *node)
 	 * GpuJoin, it should not be called under the background worker
 	 * context, however, ExecShutdown walks down the node.
 	 */
+	pgstromShutdownDSMGpuTaskState(&gjs->gts);
 	if (!gj_sstate_old)
 		return;
 
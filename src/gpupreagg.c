@@ -4101,6 +4101,7 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 	pgstromInitGpuTaskState(&gpas->gts,
 							gpas->gts.gcontext,
 							GpuTaskKind_GpuPreAgg,
+							gpa_info->outer_quals,
 							gpa_info->outer_refs,
 							gpa_info->used_params,
 							gpa_info->optimal_gpu,
@@ -4393,6 +4394,7 @@ ExecShutdownGpuPreAgg(CustomScanState *node)
 	 * another GpuJoin, it should not be called under the background
 	 * worker context, however, ExecShutdown walks down the node.
 	 */
+	pgstromShutdownDSMGpuTaskState(&gpas->gts);
 	if (!gpa_rtstat_old)
 		return;
 	/* parallel worker put runtime-stat on ExecEnd handler */
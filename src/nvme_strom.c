@@ -724,6 +724,7 @@ typedef struct
 {
 	Oid		tablespace_oid;
 	int		nvme_optimal_gpu;
+	int		nvme_distance;
 } vfs_nvme_status;
 
 static HTAB	   *vfs_nvme_htable = NULL;
@@ -741,16 +742,23 @@ vfs_nvme_cache_callback(Datum arg, int cacheid, uint32 hashvalue)
 
 /*
  * GetOptimalGpuForFile
+ *
+ * It returns the optimal GPU for the file, and the largest distance between
+ * the GPU and the underlying NVME devices on @p_distance, if any.
  */
 int
-GetOptimalGpuForFile(File fdesc)
+GetOptimalGpuForFile(File fdesc, int *p_distance)
 {
 	StromCmd__CheckFile *uarg
 		= alloca(offsetof(StromCmd__CheckFile, rawdisks[100]));
 	int		nrooms = 100;
 	int		optimal_gpu = -1;
+	int		distance = -1;
 	int		i, curr_gpu;
 
+	if (p_distance)
+		*p_distance = -1;
+
 retry:
 	memset(uarg, 0, offsetof(StromCmd__CheckFile, rawdisks[nrooms]));
 	uarg->fdesc = FileGetRawDesc(fdesc);
@@ -795,18 +803,23 @@ retry:
 			optimal_gpu = curr_gpu;
 		else if (optimal_gpu != curr_gpu)
 			return -1;
+		distance = Max(distance, nvme->nvme_distances[curr_gpu]);
 	}
+	if (p_distance)
+		*p_distance = distance;
 	return optimal_gpu;
 }
 
 static cl_int
-GetOptimalGpuForTablespace(Oid tablespace_oid)
+GetOptimalGpuForTablespace(Oid tablespace_oid, int *p_distance)
 {
 	vfs_nvme_status *entry;
 	char   *pathname;
 	File	fdesc;
 	bool	found;
 
+	if (p_distance)
+		*p_distance = -1;
 	if (!nvme_strom_enabled)
 		return -1;		/* nvme_strom is not configured or disabled */
 
@@ -834,6 +847,7 @@ GetOptimalGpuForTablespace(Oid tablespace_oid)
 		/* check whether the tablespace is supported */
 		entry->tablespace_oid = tablespace_oid;
 		entry->nvme_optimal_gpu = -1;
+		entry->nvme_distance = -1;
 
 		pathname = GetDatabasePath(MyDatabaseId, tablespace_oid);
 		fdesc = PathNameOpenFile(pathname, O_RDONLY | O_DIRECTORY);
@@ -845,10 +859,13 @@ GetOptimalGpuForTablespace(Oid tablespace_oid)
 		}
 		else
 		{
-			entry->nvme_optimal_gpu = GetOptimalGpuForFile(fdesc);
+			entry->nvme_optimal_gpu =
+				GetOptimalGpuForFile(fdesc, &entry->nvme_distance);
 			FileClose(fdesc);
 		}
 	}
+	if (p_distance)
+		*p_distance = entry->nvme_distance;
 	return entry->nvme_optimal_gpu;
 }
 
@@ -863,7 +880,7 @@ GetOptimalGpuForRelation(PlannerInfo *root, RelOptInfo *rel)
 	if (baseRelIsArrowFdw(rel))
 		return GetOptimalGpuForArrowFdw(root, rel);
 
-	cuda_dindex = GetOptimalGpuForTablespace(rel->reltablespace);
+	cuda_dindex = GetOptimalGpuForTablespace(rel->reltablespace, NULL);
 	if (cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
 		return -1;
 
@@ -882,6 +899,26 @@ GetOptimalGpuForRelation(PlannerInfo *root, RelOptInfo *rel)
 	return -1;
 }
 
+/*
+ * GetNvmeDistanceForRelation
+ *
+ * It returns the distance between the optimal GPU and NVME devices where
+ * the relation is stored, or -1 if unknown.
+ */
+cl_int
+GetNvmeDistanceForRelation(PlannerInfo *root, RelOptInfo *rel)
+{
+	cl_int		distance;
+
+	if (baseRelIsArrowFdw(rel))
+		return GetNvmeDistanceForArrowFdw(root, rel);
+	if (GetOptimalGpuForRelation(root, rel) < 0)
+		return -1;
+	GetOptimalGpuForTablespace(rel->reltablespace, &distance);
+
+	return distance;
+}
+
 bool
 RelationCanUseNvmeStrom(Relation relation)
 {
@@ -890,7 +927,7 @@ RelationCanUseNvmeStrom(Relation relation)
 	/* SSD2GPU on temp relation is not supported */
 	if (RelationUsesLocalBuffers(relation))
 		return false;
-	cuda_dindex = GetOptimalGpuForTablespace(tablespace_oid);
+	cuda_dindex = GetOptimalGpuForTablespace(tablespace_oid, NULL);
 	return (cuda_dindex >= 0 &&
 			cuda_dindex <  numDevAttrs);
 }
@@ -0,0 +1,209 @@
+/*
+ * parquet_defs.h
+ *
+ * definitions for apache parquet format
+ */
+#ifndef _PARQUET_DEFS_H_
+#define _PARQUET_DEFS_H_
+
+#define PARQUET_SIGNATURE			"PAR1"
+#define PARQUET_SIGNATURE_SZ		(sizeof(PARQUET_SIGNATURE) - 1)
+
+/*
+ * Type : physical type of the column
+ */
+typedef enum
+{
+	ParquetType__BOOLEAN				= 0,
+	ParquetType__INT32					= 1,
+	ParquetType__INT64					= 2,
+	ParquetType__INT96					= 3,
+	ParquetType__FLOAT					= 4,
+	ParquetType__DOUBLE					= 5,
+	ParquetType__BYTE_ARRAY				= 6,
+	ParquetType__FIXED_LEN_BYTE_ARRAY	= 7,
+} ParquetType;
+
+/*
+ * ConvertedType : legacy logical type annotation
+ */
+typedef enum
+{
+	ParquetConvertedType__UTF8				= 0,
+	ParquetConvertedType__MAP				= 1,
+	ParquetConvertedType__MAP_KEY_VALUE		= 2,
+	ParquetConvertedType__LIST				= 3,
+	ParquetConvertedType__ENUM				= 4,
+	ParquetConvertedType__DECIMAL			= 5,
+	ParquetConvertedType__DATE				= 6,
+	ParquetConvertedType__TIME_MILLIS		= 7,
+	ParquetConvertedType__TIME_MICROS		= 8,
+	ParquetConvertedType__TIMESTAMP_MILLIS	= 9,
+	ParquetConvertedType__TIMESTAMP_MICROS	= 10,
+	ParquetConvertedType__UINT_8			= 11,
+	ParquetConvertedType__UINT_16			= 12,
+	ParquetConvertedType__UINT_32			= 13,
+	ParquetConvertedType__UINT_64			= 14,
+	ParquetConvertedType__INT_8				= 15,
+	ParquetConvertedType__INT_16			= 16,
+	ParquetConvertedType__INT_32			= 17,
+	ParquetConvertedType__INT_64			= 18,
+	ParquetConvertedType__JSON				= 19,
+	ParquetConvertedType__BSON				= 20,
+	ParquetConvertedType__INTERVAL			= 21,
+} ParquetConvertedType;
+
+/*
+ * LogicalType : field-id of the union
+ */
+typedef enum
+{
+	ParquetLogicalType__STRING		= 1,
+	ParquetLogicalType__MAP			= 2,
+	ParquetLogicalType__LIST		= 3,
+	ParquetLogicalType__ENUM		= 4,
+	ParquetLogicalType__DECIMAL		= 5,
+	ParquetLogicalType__DATE		= 6,
+	ParquetLogicalType__TIME		= 7,
+	ParquetLogicalType__TIMESTAMP	= 8,
+	ParquetLogicalType__INTEGER		= 10,
+	ParquetLogicalType__UNKNOWN		= 11,
+	ParquetLogicalType__JSON		= 12,
+	ParquetLogicalType__BSON		= 13,
+	ParquetLogicalType__UUID		= 14,
+} ParquetLogicalType;
+
+/*
+ * FieldRepetitionType
+ */
+typedef enum
+{
+	ParquetRepetitionType__REQUIRED	= 0,
+	ParquetRepetitionType__OPTIONAL	= 1,
+	ParquetRepetitionType__REPEATED	= 2,
+} ParquetRepetitionType;
+
+/*
+ * Encoding
+ */
+typedef enum
+{
+	ParquetEncoding__PLAIN					= 0,
+	ParquetEncoding__PLAIN_DICTIONARY		= 2,
+	ParquetEncoding__RLE					= 3,
+	ParquetEncoding__BIT_PACKED				= 4,
+	ParquetEncoding__DELTA_BINARY_PACKED	= 5,
+	ParquetEncoding__DELTA_LENGTH_BYTE_ARRAY = 6,
+	ParquetEncoding__DELTA_BYTE_ARRAY		= 7,
+	ParquetEncoding__RLE_DICTIONARY			= 8,
+	ParquetEncoding__BYTE_STREAM_SPLIT		= 9,
+} ParquetEncoding;
+
+/*
+ * CompressionCodec
+ */
+typedef enum
+{
+	ParquetCompressionCodec__UNCOMPRESSED	= 0,
+	ParquetCompressionCodec__SNAPPY			= 1,
+	ParquetCompressionCodec__GZIP			= 2,
+	ParquetCompressionCodec__LZO			= 3,
+	ParquetCompressionCodec__BROTLI			= 4,
+	ParquetCompressionCodec__LZ4			= 5,
+	ParquetCompressionCodec__ZSTD			= 6,
+	ParquetCompressionCodec__LZ4_RAW		= 7,
+} ParquetCompressionCodec;
+
+/*
+ * PageType
+ */
+typedef enum
+{
+	ParquetPageType__DATA_PAGE			= 0,
+	ParquetPageType__INDEX_PAGE			= 1,
+	ParquetPageType__DICTIONARY_PAGE	= 2,
+	ParquetPageType__DATA_PAGE_V2		= 3,
+} ParquetPageType;
+
+/*
+ * ParquetColumnDesc - how to decode the column chunk into the buffers of
+ * the Apache Arrow layout
+ */
+#define PARQUET_CONV__NONE		0	/* physical values as is */
+#define PARQUET_CONV__INT		1	/* signed integer to @unitsz width */
+#define PARQUET_CONV__UINT		2	/* unsigned integer to @unitsz width */
+#define PARQUET_CONV__INT96		3	/* INT96 timestamp to nanoseconds */
+#define PARQUET_CONV__DECIMAL	4	/* decimal to 128bit integer */
+
+#define PARQUET_UNITSZ__BITMAP	(-1)	/* Bool */
+#define PARQUET_UNITSZ__VARLENA	0		/* Utf8, Binary */
+
+typedef struct
+{
+	bool		is_parquet;		/* true, if Parquet column chunk */
+	int8		physical_type;	/* ParquetType */
+	int8		codec;			/* ParquetCompressionCodec */
+	int8		max_def_level;	/* 0: REQUIRED, 1: OPTIONAL */
+	int8		conv;			/* one of PARQUET_CONV__* */
+	int32		type_length;	/* width of FIXED_LEN_BYTE_ARRAY */
+	int32		unitsz;			/* width of values once decoded, or
+								 * PARQUET_UNITSZ__* */
+} ParquetColumnDesc;
+
+/*
+ * ParquetColumnChunk - a column chunk in the row group
+ */
+typedef struct
+{
+	ParquetColumnDesc desc;
+	off_t		chunk_offset;	/* head of the pages (dictionary, if any) */
+	size_t		chunk_length;	/* total_compressed_size */
+	int64		num_values;
+	int64		null_count;		/* -1, if unknown */
+	int64		unencoded_bytes; /* -1, if unknown (BYTE_ARRAY only) */
+	bool		stat_valid;		/* min/max statistics are valid */
+	SQLstat__datum stat_min;
+	SQLstat__datum stat_max;
+} ParquetColumnChunk;
+
+/*
+ * ParquetFileInfo - state information of readParquetFileDesc()
+ */
+typedef struct
+{
+	int			num_row_groups;
+	int			num_columns;
+	int64	   *row_group_nrows;	/* [num_row_groups] */
+	ParquetColumnChunk *chunks;		/* [num_row_groups * num_columns] */
+} ParquetFileInfo;
+
+/*
+ * ParquetDecodedChunk - buffers of the Apache Arrow layout, decoded from
+ * a column chunk. Lengths are MAXALIGN'ed, and padding is zero-filled.
+ */
+typedef struct
+{
+	int64		nitems;
+	int64		null_count;
+	uint8	   *nullmap;		/* NULL, if no null values */
+	size_t		nullmap_length;
+	char	   *values;
+	size_t		values_length;
+	char	   *extra;			/* NULL, if fixed-length values */
+	size_t		extra_length;
+} ParquetDecodedChunk;
+
+/*
+ * arrow_parquet.c
+ */
+extern bool		fileIsParquet(int fdesc);
+extern bool		readParquetFileDesc(int fdesc, ArrowFileInfo *af_info,
+									ParquetFileInfo *pq_info);
+extern void		parquetDecodeColumnChunk(File fdesc,
+										 const ParquetColumnDesc *desc,
+										 off_t chunk_offset,
+										 size_t chunk_length,
+										 int64 nitems,
+										 ParquetDecodedChunk *result);
+
+#endif		/* _PARQUET_DEFS_H_ */
@@ -27,6 +27,7 @@
 #include "access/htup_details.h"
 #include "access/reloptions.h"
 #include "access/relscan.h"
+#include "access/stratnum.h"
 #include "access/sysattr.h"
 #include "access/tuptoaster.h"
 #include "access/twophase.h"
@@ -82,6 +83,7 @@
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
 #include "funcapi.h"
+#include "lib/binaryheap.h"
 #include "lib/ilist.h"
 #include "lib/stringinfo.h"
 #include "libpq/be-fsstubs.h"
@@ -148,6 +150,7 @@
 #include "utils/bytea.h"
 #include "utils/cash.h"
 #include "utils/date.h"
+#include "utils/datum.h"
 #if PG_VERSION_NUM >= 120000
 #include "utils/float.h"
 #endif
@@ -170,6 +173,7 @@
 #include "utils/ruleutils.h"
 #include "utils/selfuncs.h"
 #include "utils/snapmgr.h"
+#include "utils/sortsupport.h"
 #include "utils/spccache.h"
 #include "utils/syscache.h"
 #if PG_VERSION_NUM < 120000
@@ -187,6 +191,7 @@
 #include <assert.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <float.h>
 #include <libgen.h>
 #include <limits.h>
@@ -199,6 +204,15 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/vfs.h>
+#ifdef HAVE_LIBLZ4
+#include <lz4frame.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LIBSNAPPY
+#include <snappy-c.h>
+#endif
 
 #include "nvme_strom.h"
 #include "arrow_defs.h"
@@ -302,6 +316,18 @@ typedef struct GpuTask				GpuTask;
 typedef struct GpuTaskState			GpuTaskState;
 typedef struct GpuTaskSharedState	GpuTaskSharedState;
 typedef struct ArrowFdwState		ArrowFdwState;
+typedef struct ArrowFdwMmapState	ArrowFdwMmapState;
+
+/*
+ * ArrowFdwSharedState - shared state of Arrow_Fdw scan (may be on DSM)
+ */
+typedef struct
+{
+	pg_atomic_uint32 rbatch_index;		/* next RecordBatch to be read */
+	pg_atomic_uint32 rbatch_nskips;		/* # of skipped RecordBatches */
+	pg_atomic_uint64 rbatch_skip_sz;	/* total size of skipped ones */
+	pg_atomic_uint64 rbatch_stall_us;	/* total time to wait for loading */
+} ArrowFdwSharedState;
 
 /*
  * GpuTaskState
@@ -390,7 +416,7 @@ struct GpuTaskState
 struct GpuTaskSharedState
 {
 	/* for arrow_fdw file scan  */
-	pg_atomic_uint32 af_rbatch_index;
+	ArrowFdwSharedState af_sstate;
 
 	/* for block-based regular table scan */
 	BlockNumber		pbs_nblocks;	/* # blocks in relation at start of scan */
@@ -595,10 +621,13 @@ typedef struct pgstrom_data_store
 	 * If NULL, KDS is preliminary loaded by CPU and filesystem, and
 	 * PDS is also allocated on managed memory area. So, worker don't
 	 * need to kick DMA operations explicitly.
+	 * @mmap_state is not NULL, if PDS header is located on the read-only
+	 * mapping of the arrow file, and KDS refers the file image directly.
 	 */
 	cl_uint				nblocks_uncached;	/* for KDS_FORMAT_BLOCK */
 	cl_int				filedesc;
 	strom_io_vector	   *iovec;				/* for KDS_FORMAT_ARROW */
+	ArrowFdwMmapState  *mmap_state;			/* for KDS_FORMAT_ARROW */
 
 	/* data chunk in kernel portion */
 	kern_data_store kds	__attribute__ ((aligned (STROMALIGN_LEN)));
@@ -951,6 +980,7 @@ extern kern_parambuf *construct_kern_parambuf(List *used_params,
 extern void pgstromInitGpuTaskState(GpuTaskState *gts,
 									GpuContext *gcontext,
 									GpuTaskKind task_kind,
+									List *outer_quals,
 									List *outer_refs,
 									List *used_params,
 									cl_int optimal_gpu,
@@ -969,6 +999,7 @@ extern void pgstromInitDSMGpuTaskState(GpuTaskState *gts,
 extern void pgstromInitWorkerGpuTaskState(GpuTaskState *gts,
 										  void *coordinate);
 extern void pgstromReInitializeDSMGpuTaskState(GpuTaskState *gts);
+extern void pgstromShutdownDSMGpuTaskState(GpuTaskState *gts);
 
 extern GpuTask *fetch_next_gputask(GpuTaskState *gts);
 
@@ -980,9 +1011,11 @@ extern void pgstrom_init_gputasks(void);
  */
 extern Size	nvme_strom_threshold(void);
 extern int	nvme_strom_ioctl(int cmd, void *arg);
-extern int	GetOptimalGpuForFile(File fdesc);
+extern int	GetOptimalGpuForFile(File fdesc, int *p_distance);
 extern int	GetOptimalGpuForRelation(PlannerInfo *root,
 									 RelOptInfo *rel);
+extern cl_int GetNvmeDistanceForRelation(PlannerInfo *root,
+										 RelOptInfo *rel);
 extern bool ScanPathWillUseNvmeStrom(PlannerInfo *root,
 									 RelOptInfo *baserel);
 extern bool RelationCanUseNvmeStrom(Relation relation);
@@ -1192,6 +1225,11 @@ extern int pgstrom_common_relscan_cost(PlannerInfo *root,
 									   cl_uint *p_nrows_per_block,
 									   Cost *p_startup_cost,
 									   Cost *p_run_cost);
+extern Cost pgstrom_relscan_disk_cost(PlannerInfo *root,
+									  RelOptInfo *scan_rel,
+									  Cost disk_cost,
+									  double parallel_divisor,
+									  bool with_ssd2gpu);
 extern Bitmapset *pgstrom_pullup_outer_refs(PlannerInfo *root,
 											RelOptInfo *base_rel,
 											Bitmapset *referenced);
@@ -1364,21 +1402,34 @@ extern GstoreIpcHandle *__pgstrom_gstore_export_ipchandle(Oid ftable_oid);
 extern bool baseRelIsArrowFdw(RelOptInfo *baserel);
 extern cl_int GetOptimalGpuForArrowFdw(PlannerInfo *root,
 									   RelOptInfo *baserel);
+extern cl_int GetNvmeDistanceForArrowFdw(PlannerInfo *root,
+										 RelOptInfo *baserel);
+extern Cost GetDecompressCostForArrowFdw(PlannerInfo *root,
+										 RelOptInfo *baserel);
 extern bool KDS_fetch_tuple_arrow(TupleTableSlot *slot,
 								  kern_data_store *kds,
 								  size_t row_index);
 
-extern ArrowFdwState *ExecInitArrowFdw(Relation relation,
+extern ArrowFdwState *ExecInitArrowFdw(ScanState *ss,
+									   List *outer_quals,
 									   Bitmapset *outer_refs);
 extern pgstrom_data_store *ExecScanChunkArrowFdw(GpuTaskState *gts);
+extern cl_long ArrowFdwNextSelectedRow(ArrowFdwState *af_state,
+									   pgstrom_data_store *pds,
+									   cl_long row_index);
+extern bool ArrowFdwFetchTuple(TupleTableSlot *slot,
+							   ArrowFdwState *af_state,
+							   pgstrom_data_store *pds,
+							   cl_long *p_index);
 extern void ExecReScanArrowFdw(ArrowFdwState *af_state);
 extern void ExecEndArrowFdw(ArrowFdwState *af_state);
 extern void ExecInitDSMArrowFdw(ArrowFdwState *af_state,
-								pg_atomic_uint32 *rbatch_index);
+								ArrowFdwSharedState *sstate);
 extern void ExecReInitDSMArrowFdw(ArrowFdwState *af_state);
 extern void ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
-								   pg_atomic_uint32 *rbatch_index);
+								   ArrowFdwSharedState *sstate);
 extern void ExecShutdownArrowFdw(ArrowFdwState *af_state);
+extern void ReleaseArrowFdwMmapState(ArrowFdwMmapState *mmap_state);
 extern void ExplainArrowFdw(ArrowFdwState *af_state,
 							Relation frel, ExplainState *es);
 extern void pgstrom_init_arrow_fdw(void);
@@ -1132,6 +1132,12 @@ repalloc(void *old, Size sz)
 	return ptr;
 }
 
+void
+pfree(void *ptr)
+{
+	free(ptr);
+}
+
 /*
  * PG12 or later replaces XXprintf by pg_XXprintf
  */
@@ -8,6 +8,7 @@
  */
 #include "sql2arrow.h"
 #include <limits.h>
+#include <arpa/inet.h>
 #include <libpq-fe.h>
 
 #define CURSOR_NAME		"curr_pg2arrow"
@@ -34,8 +35,20 @@ typedef struct
 	PGresult   *res;
 	uint32		nitems;
 	uint32		index;
+	char	   *snapshot;	/* snapshot to be imported, if any */
+	bool		has_cursor;	/* true, if cursor is declared */
+	/* COPY ... TO STDOUT (FORMAT binary) mode */
+	bool		copy_binary;
+	bool		copy_done;	/* true, if trailer is already read */
+	char	   *copy_buf;	/* bytes received, but not consumed yet */
+	size_t		copy_head;
+	size_t		copy_tail;
+	size_t		copy_size;
 } PGSTATE;
 
+#define PGCOPY_SIGNATURE		"PGCOPY\n\377\r\n\0"
+#define PGCOPY_SIGNATURE_SZ		11
+
 static inline bool
 pg_strtobool(const char *v)
 {
@@ -150,6 +163,135 @@ pgsql_next_result(PGSTATE *pgstate)
 	return res;
 }
 
+/*
+ * pgsql_copy_ensure - ensures @nbytes of the binary COPY stream are
+ * available on the buffer, and returns the address. A field or a tuple
+ * header may be split across CopyData messages, so the messages are
+ * appended on the buffer until sufficient bytes are received.
+ */
+static char *
+pgsql_copy_ensure(PGSTATE *pgstate, size_t nbytes)
+{
+	while (pgstate->copy_tail - pgstate->copy_head < nbytes)
+	{
+		char	   *msg;
+		int			len;
+		size_t		remain = pgstate->copy_tail - pgstate->copy_head;
+
+		len = PQgetCopyData(pgstate->conn, &msg, 0);
+		if (len == -1)
+			Elog("binary COPY stream ended unexpectedly");
+		if (len < 0)
+			Elog("failed on PQgetCopyData: %s",
+				 PQerrorMessage(pgstate->conn));
+		/* move the remaining portion to the head */
+		if (pgstate->copy_head > 0)
+		{
+			memmove(pgstate->copy_buf,
+					pgstate->copy_buf + pgstate->copy_head, remain);
+			pgstate->copy_head = 0;
+			pgstate->copy_tail = remain;
+		}
+		if (remain + len > pgstate->copy_size)
+		{
+			pgstate->copy_size = Max(2 * pgstate->copy_size,
+									 remain + len + (1UL << 20));
+			pgstate->copy_buf = repalloc(pgstate->copy_buf,
+										 pgstate->copy_size);
+		}
+		memcpy(pgstate->copy_buf + pgstate->copy_tail, msg, len);
+		pgstate->copy_tail += len;
+		PQfreemem(msg);
+	}
+	return pgstate->copy_buf + pgstate->copy_head;
+}
+
+static inline int16
+pgsql_copy_peek_int16(PGSTATE *pgstate)
+{
+	uint16		ival;
+
+	memcpy(&ival, pgsql_copy_ensure(pgstate, sizeof(int16)), sizeof(int16));
+	return (int16)ntohs(ival);
+}
+
+static inline int32
+pgsql_copy_read_int32(PGSTATE *pgstate)
+{
+	uint32		ival;
+
+	memcpy(&ival, pgsql_copy_ensure(pgstate, sizeof(int32)), sizeof(int32));
+	pgstate->copy_head += sizeof(int32);
+	return (int32)ntohl(ival);
+}
+
+/*
+ * pgsql_copy_begin - runs the query by COPY TO STDOUT (FORMAT binary),
+ * then reads the header of the stream
+ */
+static void
+pgsql_copy_begin(PGSTATE *pgstate, const char *sqldb_command)
+{
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *query;
+	char	   *pos;
+	int32		flags;
+	int32		ext_len;
+
+	query = palloc(strlen(sqldb_command) + 100);
+	sprintf(query, "COPY (%s) TO STDOUT (FORMAT binary)", sqldb_command);
+	res = PQexec(conn, query);
+	if (PQresultStatus(res) != PGRES_COPY_OUT)
+		Elog("unable to run COPY TO STDOUT: %s", PQresultErrorMessage(res));
+	PQclear(res);
+	pfree(query);
+
+	pgstate->copy_size = (1UL << 20);
+	pgstate->copy_buf = palloc(pgstate->copy_size);
+	pgstate->copy_head = 0;
+	pgstate->copy_tail = 0;
+
+	/* header of the binary COPY stream */
+	pos = pgsql_copy_ensure(pgstate, PGCOPY_SIGNATURE_SZ);
+	if (memcmp(pos, PGCOPY_SIGNATURE, PGCOPY_SIGNATURE_SZ) != 0)
+		Elog("binary COPY stream has wrong signature");
+	pgstate->copy_head += PGCOPY_SIGNATURE_SZ;
+	flags = pgsql_copy_read_int32(pgstate);
+	if ((flags & (1 << 16)) != 0)
+		Elog("binary COPY stream with OIDs is not supported");
+	ext_len = pgsql_copy_read_int32(pgstate);
+	if (ext_len < 0)
+		Elog("binary COPY stream has corrupted header");
+	pgsql_copy_ensure(pgstate, ext_len);
+	pgstate->copy_head += ext_len;
+}
+
+/*
+ * pgsql_copy_end - reads the end of the binary COPY stream
+ */
+static void
+pgsql_copy_end(PGSTATE *pgstate)
+{
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *msg;
+	int			len;
+
+	pgstate->copy_head += sizeof(int16);	/* trailer */
+	pgstate->copy_done = true;
+	while ((len = PQgetCopyData(conn, &msg, 0)) > 0)
+		PQfreemem(msg);
+	if (len != -1)
+		Elog("failed on PQgetCopyData: %s", PQerrorMessage(conn));
+	while ((res = PQgetResult(conn)) != NULL)
+	{
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("failed on COPY TO STDOUT: %s", PQresultErrorMessage(res));
+		PQclear(res);
+	}
+}
+
 /*
  * pgsql_create_dictionary
  */
@@ -190,7 +332,8 @@ pgsql_create_dictionary(PGconn *conn, SQLtable *root,
 	snprintf(query, sizeof(query),
 			 "SELECT enumlabel"
 			 "  FROM pg_catalog.pg_enum"
-			 " WHERE enumtypid = %u", enum_typeid);
+			 " WHERE enumtypid = %u"
+			 " ORDER BY enumsortorder", enum_typeid);
 	res = PQexec(conn, query);
 	if (PQresultStatus(res) != PGRES_TUPLES_OK)
 		Elog("failed on pg_enum system catalog query: %s",
@@ -299,6 +442,22 @@ pgsql_setup_attribute(PGconn *conn,
 		column->enumdict = pgsql_create_dictionary(conn, root, atttypid,
 												   arrow_field);
 	}
+	else if (arrow_field && arrow_field->dictionary)
+	{
+		SQLdictionary *dict;
+		int64		dict_id = arrow_field->dictionary->id;
+
+		/* Utf8 field encoded by --auto-dictionary, on --append */
+		for (dict = root->sql_dict_list; dict != NULL; dict = dict->next)
+		{
+			if (dict->dict_id == dict_id)
+				break;
+		}
+		if (!dict || column->arrow_type.node.tag != ArrowNodeTag__Utf8)
+			Elog("attribute %s is not compatible", attname);
+		setupArrowFieldDictionary(column, dict);
+		*p_numBuffers -= 1;		/* no extra buffer */
+	}
 }
 
 /*
@@ -616,11 +775,49 @@ sqldb_begin_query(void *sqldb_state,
 	char	   *query;
 
 	/* begin read-only transaction */
-	res = PQexec(conn, "BEGIN READ ONLY");
+	if (!pgstate->snapshot)
+		res = PQexec(conn, "BEGIN READ ONLY");
+	else
+		res = PQexec(conn, "BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY");
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		Elog("unable to begin transaction: %s", PQresultErrorMessage(res));
 	PQclear(res);
 
+	/* import the snapshot exported by the other session, if any */
+	if (pgstate->snapshot)
+	{
+		query = palloc(strlen(pgstate->snapshot) + 100);
+		sprintf(query, "SET TRANSACTION SNAPSHOT '%s'", pgstate->snapshot);
+		res = PQexec(conn, query);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("unable to import snapshot: %s", PQresultErrorMessage(res));
+		PQclear(res);
+	}
+
+	if (pgstate->copy_binary)
+	{
+		SQLtable   *table;
+
+		/* only description of the results, without execution */
+		res = PQprepare(conn, "", sqldb_command, 0, NULL);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("unable to prepare the query: %s", PQresultErrorMessage(res));
+		PQclear(res);
+		res = PQdescribePrepared(conn, "");
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("unable to describe the query: %s", PQresultErrorMessage(res));
+		table = pgsql_create_buffer(conn, res, af_info, dictionary_list);
+		PQclear(res);
+
+		pgsql_copy_begin(pgstate, sqldb_command);
+		if (pgsql_copy_peek_int16(pgstate) < 0)
+		{
+			pgsql_copy_end(pgstate);
+			return NULL;
+		}
+		return table;
+	}
+
 	/* declare cursor */
 	query = palloc(strlen(sqldb_command) + 1024);
 	sprintf(query, "DECLARE " CURSOR_NAME " BINARY CURSOR FOR %s",
@@ -629,6 +826,7 @@ sqldb_begin_query(void *sqldb_state,
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		Elog("unable to declare a SQL cursor: %s", PQresultErrorMessage(res));
 	PQclear(res);
+	pgstate->has_cursor = true;
 
 	/* fetch the first result */
 	res = pgsql_next_result(pgstate);
@@ -644,9 +842,47 @@ sqldb_fetch_results(void *sqldb_state, SQLtable *table)
 {
 	PGSTATE	   *pgstate = sqldb_state;
 	PGresult   *res = pgstate->res;
-	int			j, index = pgstate->index++;
+	int			j, index;
 	size_t		usage = 0;
 
+	if (pgstate->copy_binary)
+	{
+		int16		nfields;
+
+		if (pgstate->copy_done)
+			return -1;
+		nfields = pgsql_copy_peek_int16(pgstate);
+		if (nfields < 0)
+		{
+			pgsql_copy_end(pgstate);
+			return -1;		/* end of the scan */
+		}
+		if (nfields != table->nfields)
+			Elog("binary COPY stream has %d fields, but %d expected",
+				 nfields, table->nfields);
+		pgstate->copy_head += sizeof(int16);
+
+		table->nitems++;
+		for (j=0; j < table->nfields; j++)
+		{
+			SQLfield   *column = &table->columns[j];
+			int32		sz = pgsql_copy_read_int32(pgstate);
+			const char *addr = NULL;
+
+			if (sz < 0)
+				sz = 0;		/* NULL */
+			else
+			{
+				addr = pgsql_copy_ensure(pgstate, sz);
+				pgstate->copy_head += sz;
+			}
+			usage += sql_field_put_value(column, addr, sz);
+			assert(table->nitems == column->nitems);
+		}
+		return usage;
+	}
+
+	index = pgstate->index++;
 	if (index >= pgstate->nitems)
 	{
 		res = pgsql_next_result(pgstate);
@@ -689,16 +925,120 @@ sqldb_close_connection(void *sqldb_state)
 
 	if (pgstate->res)
 		PQclear(pgstate->res);
+	if (pgstate->copy_buf)
+		pfree(pgstate->copy_buf);
 	/* close the cursor */
-	res = PQexec(conn, "CLOSE " CURSOR_NAME);
-	if (PQresultStatus(res) != PGRES_COMMAND_OK)
-		Elog("failed on close cursor '%s': %s", CURSOR_NAME,
-			 PQresultErrorMessage(res));
-	PQclear(res);
+	if (pgstate->has_cursor)
+	{
+		res = PQexec(conn, "CLOSE " CURSOR_NAME);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("failed on close cursor '%s': %s", CURSOR_NAME,
+				 PQresultErrorMessage(res));
+		PQclear(res);
+	}
 	/* close the connection */
 	PQfinish(conn);
 }
 
+/*
+ * sqldb_export_snapshot - begin a transaction, then export its snapshot
+ * to be shared with the parallel workers. The transaction must be kept
+ * until all the workers import the snapshot.
+ */
+char *
+sqldb_export_snapshot(void *sqldb_state)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *snapshot;
+
+	res = PQexec(conn, "BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		Elog("unable to begin transaction: %s", PQresultErrorMessage(res));
+	PQclear(res);
+
+	res = PQexec(conn, "SELECT pg_catalog.pg_export_snapshot()");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK ||
+		PQntuples(res) != 1 ||
+		PQgetisnull(res, 0, 0))
+		Elog("unable to export snapshot: %s", PQresultErrorMessage(res));
+	snapshot = pstrdup(PQgetvalue(res, 0, 0));
+	PQclear(res);
+
+	return snapshot;
+}
+
+/*
+ * sqldb_import_snapshot - the session imports the snapshot on the next
+ * sqldb_begin_query
+ */
+void
+sqldb_import_snapshot(void *sqldb_state, const char *snapshot)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+
+	pgstate->snapshot = pstrdup(snapshot);
+}
+
+/*
+ * sqldb_enable_copy_binary - the session fetches the results by
+ * COPY ... TO STDOUT (FORMAT binary), instead of the binary cursor
+ */
+void
+sqldb_enable_copy_binary(void *sqldb_state)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+
+	pgstate->copy_binary = true;
+}
+
+/*
+ * sqldb_relation_nblocks - number of the blocks of the relation
+ */
+int64
+sqldb_relation_nblocks(void *sqldb_state, const char *relname)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *ident;
+	char	   *query;
+	int64		nblocks;
+
+	ident = PQescapeLiteral(conn, relname, strlen(relname));
+	if (!ident)
+		Elog("failed on PQescapeLiteral: %s", PQerrorMessage(conn));
+	query = palloc(strlen(ident) + 200);
+	sprintf(query,
+			"SELECT pg_catalog.pg_relation_size(%s::regclass)"
+			" / pg_catalog.current_setting('block_size')::bigint",
+			ident);
+	PQfreemem(ident);
+	res = PQexec(conn, query);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK ||
+		PQntuples(res) != 1 ||
+		PQgetisnull(res, 0, 0))
+		Elog("failed on getting size of '%s': %s",
+			 relname, PQresultErrorMessage(res));
+	nblocks = atol(PQgetvalue(res, 0, 0));
+	PQclear(res);
+	pfree(query);
+
+	return nblocks;
+}
+
+/*
+ * sqldb_server_version - version number of the server, like 120004
+ */
+int
+sqldb_server_version(void *sqldb_state)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+
+	return PQserverVersion(pgstate->conn);
+}
+
 /*
  * Misc functions
  */
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <strings.h>
+#include <pthread.h>
 
 /* command options */
 static char	   *sqldb_command = NULL;
@@ -28,31 +29,51 @@ static char	   *sqldb_password = NULL;
 static char	   *sqldb_database = NULL;
 static char	   *dump_arrow_filename = NULL;
 static int		shows_progress = 0;
+static int		stat_all_columns = 0;
+static char	   *stat_embedded_columns = NULL;
+static char	   *compression_codec = NULL;
+static char	   *sorted_by_columns = NULL;
 static userConfigOption *sqldb_session_configs = NULL;
+static char	   *sqldb_table_name = NULL;
+static int		num_parallel_workers = 0;
+static char	   *parallel_key_expr = NULL;
+static int		parallel_multi_files = 0;
+static int		copy_binary_mode = 0;
+static int		async_write_mode = 0;
+static int		direct_io_mode = 0;
+static int		auto_dictionary_max = 0;
+static size_t	split_size = 0;
+static int		split_batches = 0;
+static char	   *partition_key_name = NULL;
+static int		hive_partitioning = 0;
+
+/* write-combining buffer for --async-write and --direct-io */
+#define WRITE_COMBINING_BUFSZ	(32UL << 20)
+#define WRITE_COMBINING_ALIGN	4096
+/* default threshold of --auto-dictionary */
+#define AUTO_DICTIONARY_MAX_CARDINALITY		1000
+/* partition value of NULL keys, same as Hive */
+#define HIVE_DEFAULT_PARTITION		"__HIVE_DEFAULT_PARTITION__"
 
 /*
  * loadArrowDictionaryBatches
  */
-static SQLdictionary *
-__loadArrowDictionaryBatchOne(const char *message_head,
+static void
+__loadArrowDictionaryBatchOne(SQLdictionary *dict,
+							  const char *message_head,
 							  ArrowDictionaryBatch *dbatch)
 {
-	SQLdictionary  *dict;
 	ArrowBuffer	   *v_buffer = &dbatch->data.buffers[1];
 	ArrowBuffer	   *e_buffer = &dbatch->data.buffers[2];
 	uint32		   *values = (uint32 *)(message_head + v_buffer->offset);
 	char		   *extra = (char *)(message_head + e_buffer->offset);
 	int				i;
 
-	dict = palloc0(offsetof(SQLdictionary, hslots[1024]));
-	dict->dict_id = dbatch->id;
-	sql_buffer_init(&dict->values);
-	sql_buffer_init(&dict->extra);
-	dict->nloaded = dbatch->data.length;
-	dict->nitems  = dbatch->data.length;
-	dict->nslots = 1024;
+	if (dbatch->data.compression)
+		Elog("compressed DictionaryBatch is not supported for --append");
 
-	for (i=0; i < dict->nloaded; i++)
+	/* delta DictionaryBatch appends items on the dictionary */
+	for (i=0; i < dbatch->data.length; i++)
 	{
 		hashItem   *hitem;
 		uint32		len = values[i+1] - values[i];
@@ -61,7 +82,7 @@ __loadArrowDictionaryBatchOne(const char *message_head,
 
 		hitem = palloc(offsetof(hashItem, label[len+1]));
 		hitem->hash = hash_any((unsigned char *)pos, len);
-		hitem->index = i;
+		hitem->index = dict->nitems++;
 		hitem->label_sz = len;
 		memcpy(hitem->label, pos, len);
 		hitem->label[len] = '\0';
@@ -70,8 +91,7 @@ __loadArrowDictionaryBatchOne(const char *message_head,
 		hitem->next = dict->hslots[hindex];
 		dict->hslots[hindex] = hitem;
 	}
-	assert(dict->nitems == dict->nloaded);
-	return dict;
+	dict->nloaded = dict->nitems;
 }
 
 static SQLdictionary *
@@ -106,9 +126,28 @@ loadArrowDictionaryBatches(int fdesc, ArrowFileInfo *af_info)
 				 dbatch->id);
 		message_head = mmap_head + block->offset;
 		message_body = message_head + block->metaDataLength;
-		dict = __loadArrowDictionaryBatchOne(message_body, dbatch);
-		dict->next = dictionary_list;
-		dictionary_list = dict;
+
+		for (dict = dictionary_list; dict != NULL; dict = dict->next)
+		{
+			if (dict->dict_id == dbatch->id)
+				break;
+		}
+		if (!dict)
+		{
+			dict = palloc0(offsetof(SQLdictionary, hslots[1024]));
+			dict->dict_id = dbatch->id;
+			sql_buffer_init(&dict->values);
+			sql_buffer_init(&dict->extra);
+			dict->is_written = true;
+			dict->nslots = 1024;
+
+			dict->next = dictionary_list;
+			dictionary_list = dict;
+		}
+		else if (!dbatch->isDelta)
+			Elog("DictionaryBatch (dictionary_id=%ld) is replaced",
+				 dbatch->id);
+		__loadArrowDictionaryBatchOne(dict, message_body, dbatch);
 	}
 	munmap(mmap_head, mmap_sz);
 
@@ -140,12 +179,18 @@ fixup_append_file_on_exit(int status, void *p)
 	arrowFileUndoLog *undo = arrow_file_undo_log;
 	ssize_t		count = 0;
 	ssize_t		nbytes;
+	int			flags;
 
 	if (status == 0 || !undo)
 		return;
 	/* avoid infinite recursion */
 	arrow_file_undo_log = NULL;
 
+	/* undo log is not aligned, if --direct-io */
+	flags = fcntl(undo->append_fdesc, F_GETFL);
+	if (flags >= 0 && (flags & O_DIRECT) != 0)
+		fcntl(undo->append_fdesc, F_SETFL, flags & ~O_DIRECT);
+
 	if (lseek(undo->append_fdesc,
 			  undo->footer_offset, SEEK_SET) != undo->footer_offset)
 	{
@@ -230,6 +275,9 @@ setup_append_file(SQLtable *table, ArrowFileInfo *af_info)
 		   af_info->footer.recordBatches,
 		   sizeof(ArrowBlock) * nitems);
 
+	/* restore min/max statistics of the RecordBatches, if any */
+	restoreArrowFieldStats(table, af_info);
+
 	/* move to the file offset in front of the Footer portion */
 	nbytes = sizeof(int32) + 6;		/* strlen("ARROW1") */
 	offset = lseek(table->fdesc, -nbytes, SEEK_END);
@@ -387,7 +435,48 @@ usage(void)
 		  "\n"
 		  "Arrow format options:\n"
 		  "  -s, --segment-size=SIZE size of record batch for each\n"
+		  "      --stat[=COLUMNS] embeds min/max statistics of the columns\n"
+		  "                       for each record batch (all the supported\n"
+		  "                       columns, if COLUMNS are not given)\n"
+		  "      --compress=CODEC compression codec of record batch;\n"
+		  "                       one of 'lz4', 'zstd' or 'none' (default)\n"
+		  "      --sorted-by=KEYS declares the results are sorted by the\n"
+		  "                       keys, like 'COLUMN [ASC|DESC], ...'\n"
+#ifdef __PG2ARROW__
+		  "      --copy           fetches the results using COPY TO STDOUT\n"
+		  "                       (FORMAT binary), instead of the cursor\n"
+#endif
+		  "      --async-write    writes RecordBatches on a background\n"
+		  "                       thread, while fetching the next ones\n"
+		  "      --direct-io      writes the result file with O_DIRECT\n"
+		  "      --auto-dictionary[=MAX] dictionary encoding of the text\n"
+		  "                       columns, if the first record batch has\n"
+		  "                       no more than MAX distinct values\n"
+		  "                       (default: 1000)\n"
+		  "\n"
+		  "Output splitting options:\n"
+		  "      --split-size=SIZE switches to the next file, once the\n"
+		  "                       output file reaches SIZE\n"
+		  "      --split-batches=N switches to the next file, once the\n"
+		  "                       output file has N record batches\n"
+		  "                       (files are FILENAME.0, FILENAME.1,...)\n"
+		  "      --partition-key=COLUMN writes the rows to the file for\n"
+		  "                       each value of the COLUMN, like\n"
+		  "                       FILENAME.<value>\n"
+		  "      --hive           uses Hive-style directory layout with\n"
+		  "                       --partition-key, like\n"
+		  "                       DIR/<COLUMN>=<value>/FILENAME\n"
 		  "\n"
+#ifdef __PG2ARROW__
+		  "Parallel export options:\n"
+		  "      --parallel=N     runs N connections on a shared snapshot\n"
+		  "      --parallel-key=EXPR expression to split the results of -c\n"
+		  "                       (-t is split by ctid block ranges)\n"
+		  "      --parallel-files writes N files, FILENAME.0, FILENAME.1,...\n"
+		  "                       instead of a single file\n"
+		  "\n"
+#endif
+
 		  "Connection options:\n"
 		  "  -h, --host=HOSTNAME  database server host\n"
 		  "  -p, --port=PORT      database server port\n"
@@ -411,6 +500,33 @@ usage(void)
 	exit(1);
 }
 
+/*
+ * parse_size_value - parses SIZE with optional k, m or g suffix.
+ * It returns 0 on invalid values.
+ */
+static size_t
+parse_size_value(const char *value)
+{
+	const char *pos = value;
+
+	while (isdigit(*pos))
+		pos++;
+	if (pos == value)
+		return 0;
+	if (*pos == '\0')
+		return atol(value);
+	if (strcasecmp(pos, "k") == 0 ||
+		strcasecmp(pos, "kb") == 0)
+		return atol(value) * (1UL << 10);
+	if (strcasecmp(pos, "m") == 0 ||
+		strcasecmp(pos, "mb") == 0)
+		return atol(value) * (1UL << 20);
+	if (strcasecmp(pos, "g") == 0 ||
+		strcasecmp(pos, "gb") == 0)
+		return atol(value) * (1UL << 30);
+	return 0;
+}
+
 static void
 parse_options(int argc, char * const argv[])
 {
@@ -434,6 +550,22 @@ parse_options(int argc, char * const argv[])
 		{"dump",         required_argument, NULL, 1001},
 		{"progress",     no_argument,       NULL, 1002},
 		{"set",          required_argument, NULL, 1003},
+		{"stat",         optional_argument, NULL, 1004},
+		{"compress",     required_argument, NULL, 1005},
+		{"sorted-by",    required_argument, NULL, 1006},
+#ifdef __PG2ARROW__
+		{"parallel",     required_argument, NULL, 1007},
+		{"parallel-key", required_argument, NULL, 1008},
+		{"parallel-files", no_argument,     NULL, 1009},
+		{"copy",         no_argument,       NULL, 1010},
+#endif /* __PG2ARROW__ */
+		{"async-write",  no_argument,       NULL, 1011},
+		{"direct-io",    no_argument,       NULL, 1012},
+		{"auto-dictionary", optional_argument, NULL, 1013},
+		{"split-size",   required_argument, NULL, 1014},
+		{"split-batches", required_argument, NULL, 1015},
+		{"partition-key", required_argument, NULL, 1016},
+		{"hive",         no_argument,       NULL, 1017},
 		{"help",         no_argument,       NULL, 9999},
 		{NULL, 0, NULL, 0},
 	};
@@ -441,7 +573,6 @@ parse_options(int argc, char * const argv[])
 	bool		meet_command = false;
 	bool		meet_table = false;
 	int			password_prompt = 0;
-	const char *pos;
 	userConfigOption *last_user_config = NULL;
 
 	while ((c = getopt_long(argc, argv, "d:c:t:o:s:h:P:u:p:",
@@ -472,6 +603,7 @@ parse_options(int argc, char * const argv[])
 				if (!sqldb_command)
 					Elog("out of memory");
 				sprintf(sqldb_command, "SELECT * FROM %s", optarg);
+				sqldb_table_name = optarg;
 				break;
 
 			case 'o':
@@ -493,21 +625,8 @@ parse_options(int argc, char * const argv[])
 			case 's':
 				if (batch_segment_sz != 0)
 					Elog("-s option was supplied twice");
-				pos = optarg;
-				while (isdigit(*pos))
-					pos++;
-				if (*pos == '\0')
-					batch_segment_sz = atol(optarg);
-				else if (strcasecmp(pos, "k") == 0 ||
-						 strcasecmp(pos, "kb") == 0)
-					batch_segment_sz = atol(optarg) * (1UL << 10);
-				else if (strcasecmp(pos, "m") == 0 ||
-						 strcasecmp(pos, "mb") == 0)
-					batch_segment_sz = atol(optarg) * (1UL << 20);
-				else if (strcasecmp(pos, "g") == 0 ||
-						 strcasecmp(pos, "gb") == 0)
-					batch_segment_sz = atol(optarg) * (1UL << 30);
-				else
+				batch_segment_sz = parse_size_value(optarg);
+				if (batch_segment_sz == 0)
 					Elog("segment size is not valid: %s", optarg);
 				break;
 
@@ -583,6 +702,98 @@ parse_options(int argc, char * const argv[])
 				}
 				break;
 
+			case 1004:		/* --stat */
+				if (stat_all_columns || stat_embedded_columns)
+					Elog("--stat option was supplied twice");
+				if (optarg)
+					stat_embedded_columns = optarg;
+				else
+					stat_all_columns = 1;
+				break;
+
+			case 1005:		/* --compress */
+				if (compression_codec)
+					Elog("--compress option was supplied twice");
+				compression_codec = optarg;
+				break;
+
+			case 1006:		/* --sorted-by */
+				if (sorted_by_columns)
+					Elog("--sorted-by option was supplied twice");
+				sorted_by_columns = optarg;
+				break;
+
+#ifdef __PG2ARROW__
+			case 1007:		/* --parallel */
+				if (num_parallel_workers > 0)
+					Elog("--parallel option was supplied twice");
+				num_parallel_workers = atoi(optarg);
+				if (num_parallel_workers < 1)
+					Elog("--parallel must be 1 or larger: %s", optarg);
+				break;
+
+			case 1008:		/* --parallel-key */
+				if (parallel_key_expr)
+					Elog("--parallel-key option was supplied twice");
+				parallel_key_expr = optarg;
+				break;
+
+			case 1009:		/* --parallel-files */
+				parallel_multi_files = 1;
+				break;
+
+			case 1010:		/* --copy */
+				copy_binary_mode = 1;
+				break;
+#endif /* __PG2ARROW__ */
+			case 1011:		/* --async-write */
+				async_write_mode = 1;
+				break;
+
+			case 1012:		/* --direct-io */
+				direct_io_mode = 1;
+				break;
+
+			case 1013:		/* --auto-dictionary */
+				if (auto_dictionary_max > 0)
+					Elog("--auto-dictionary option was supplied twice");
+				if (!optarg)
+					auto_dictionary_max = AUTO_DICTIONARY_MAX_CARDINALITY;
+				else
+				{
+					auto_dictionary_max = atoi(optarg);
+					if (auto_dictionary_max <= 0)
+						Elog("--auto-dictionary must be 1 or larger: %s",
+							 optarg);
+				}
+				break;
+
+			case 1014:		/* --split-size */
+				if (split_size != 0)
+					Elog("--split-size option was supplied twice");
+				split_size = parse_size_value(optarg);
+				if (split_size == 0)
+					Elog("split size is not valid: %s", optarg);
+				break;
+
+			case 1015:		/* --split-batches */
+				if (split_batches != 0)
+					Elog("--split-batches option was supplied twice");
+				split_batches = atoi(optarg);
+				if (split_batches < 1)
+					Elog("--split-batches must be 1 or larger: %s", optarg);
+				break;
+
+			case 1016:		/* --partition-key */
+				if (partition_key_name)
+					Elog("--partition-key option was supplied twice");
+				partition_key_name = optarg;
+				break;
+
+			case 1017:		/* --hive */
+				hive_partitioning = 1;
+				break;
+
 			case 9999:		/* --help */
 			default:
 				usage();
@@ -622,10 +833,1237 @@ parse_options(int argc, char * const argv[])
 	}
 	if (!sqldb_command)
 		Elog("Neither -c nor -t options are supplied");
+	/* --parallel checks */
+	if (num_parallel_workers > 1)
+	{
+		if (append_filename)
+			Elog("--parallel and --append are exclusive");
+		if (sorted_by_columns)
+			Elog("--parallel and --sorted-by are exclusive");
+		if (sqldb_table_name && parallel_key_expr)
+			Elog("--parallel-key is available only with -c");
+		if (!sqldb_table_name && !parallel_key_expr)
+			Elog("--parallel with -c needs --parallel-key");
+		if (parallel_multi_files && !output_filename)
+			Elog("--parallel-files needs -o option");
+		if (async_write_mode || direct_io_mode)
+			Elog("--parallel is exclusive with --async-write and --direct-io");
+		if (auto_dictionary_max > 0)
+			Elog("--parallel and --auto-dictionary are exclusive");
+	}
+	else if (parallel_key_expr || parallel_multi_files)
+		Elog("--parallel-key and --parallel-files need --parallel=N (N > 1)");
+	if (append_filename && auto_dictionary_max > 0)
+		Elog("--append and --auto-dictionary are exclusive");
+	/* output splitting checks */
+	if (split_size > 0 || split_batches > 0 || partition_key_name)
+	{
+		if (!output_filename)
+			Elog("--split-size, --split-batches and --partition-key need -o option");
+		if (num_parallel_workers > 1)
+			Elog("--parallel is exclusive with --split-size, --split-batches and --partition-key");
+		if (async_write_mode || direct_io_mode)
+			Elog("--async-write and --direct-io are exclusive with --split-size, --split-batches and --partition-key");
+		if (partition_key_name && auto_dictionary_max > 0)
+			Elog("--partition-key and --auto-dictionary are exclusive");
+	}
+	if (hive_partitioning && !partition_key_name)
+		Elog("--hive needs --partition-key");
 	if (batch_segment_sz == 0)
 		batch_segment_sz = (1UL << 28);		/* 256MB in default */
 }
 
+/*
+ * setup_field_stats - enables min/max statistics by --stat option
+ */
+static void
+setup_field_stats(SQLtable *table)
+{
+	char	   *temp;
+	char	   *tok, *pos;
+	int			j;
+
+	if (stat_all_columns)
+	{
+		for (j=0; j < table->nfields; j++)
+			enableArrowFieldStat(&table->columns[j]);
+		return;
+	}
+	if (!stat_embedded_columns)
+		return;
+
+	temp = pstrdup(stat_embedded_columns);
+	for (tok = strtok_r(temp, ",", &pos);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &pos))
+	{
+		char   *tail;
+
+		while (isspace(*tok))
+			tok++;
+		tail = tok + strlen(tok) - 1;
+		while (tail >= tok && isspace(*tail))
+			*tail-- = '\0';
+
+		for (j=0; j < table->nfields; j++)
+		{
+			SQLfield   *column = &table->columns[j];
+
+			if (strcmp(column->field_name, tok) != 0)
+				continue;
+			if (!enableArrowFieldStat(column))
+				Elog("--stat: column '%s' does not support min/max statistics",
+					 tok);
+			break;
+		}
+		if (j == table->nfields)
+			Elog("--stat: column '%s' was not found", tok);
+	}
+}
+
+/*
+ * setup_sorted_by - checks the sort keys given by --sorted-by option
+ */
+static void
+setup_sorted_by(SQLtable *table)
+{
+	char	   *temp;
+	char	   *tok, *pos;
+	int			j;
+
+	if (!sorted_by_columns)
+		return;
+	temp = pstrdup(sorted_by_columns);
+	for (tok = strtok_r(temp, ",", &pos);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &pos))
+	{
+		char   *name, *order, *__pos;
+
+		name = strtok_r(tok, " \t\n\r", &__pos);
+		if (!name)
+			Elog("--sorted-by: empty sort key");
+		order = strtok_r(NULL, " \t\n\r", &__pos);
+		if (order && strcasecmp(order, "asc") != 0 &&
+					 strcasecmp(order, "desc") != 0)
+			Elog("--sorted-by: unknown sort order '%s'", order);
+		for (j=0; j < table->nfields; j++)
+		{
+			if (strcmp(table->columns[j].field_name, name) == 0)
+				break;
+		}
+		if (j == table->nfields)
+			Elog("--sorted-by: column '%s' was not found", name);
+	}
+	pfree(temp);
+}
+
+/*
+ * setup_sql_table - applies the options on the SQLtable built from
+ * the results of the query
+ */
+static void
+setup_sql_table(SQLtable *table)
+{
+	ArrowKeyValue  *kv;
+
+	table->segment_sz = batch_segment_sz;
+	/* compression of record batches, if --compress */
+	if (compression_codec)
+		table->compressed = lookupArrowCompressionCodec(compression_codec,
+														&table->codec);
+	/* enables min/max statistics, if --stat */
+	setup_field_stats(table);
+	/* checks the sort keys, if --sorted-by */
+	setup_sorted_by(table);
+
+	/* save the SQL command (and sort keys) as custom metadata */
+	kv = palloc0(sizeof(ArrowKeyValue) * 2);
+	initArrowNode(&kv[0], KeyValue);
+	kv[0].key = "sql_command";
+	kv[0]._key_len = 11;
+	kv[0].value = sqldb_command;
+	kv[0]._value_len = strlen(sqldb_command);
+	table->customMetadata = kv;
+	table->numCustomMetadata = 1;
+	if (sorted_by_columns)
+	{
+		initArrowNode(&kv[1], KeyValue);
+		kv[1].key = "sorted_by";
+		kv[1]._key_len = 9;
+		kv[1].value = sorted_by_columns;
+		kv[1]._value_len = strlen(sorted_by_columns);
+		table->numCustomMetadata = 2;
+	}
+}
+
+/*
+ * setup_auto_dictionary - fetches the first segment of the results, then
+ * enables dictionary encoding of the text columns with low cardinality.
+ * It has to run prior to the schema definition. It returns true, if no
+ * more rows.
+ */
+static bool
+setup_auto_dictionary(void *sqldb_state, SQLtable *table)
+{
+	ssize_t		usage;
+	int			j;
+
+	while ((usage = sqldb_fetch_results(sqldb_state, table)) >= 0)
+	{
+		if (usage > batch_segment_sz)
+			break;
+	}
+	for (j=0; j < table->nfields; j++)
+		enableArrowFieldDictionary(table, &table->columns[j],
+								   auto_dictionary_max);
+	return (usage < 0);
+}
+
+/*
+ * setup_write_combining - attaches the write-combining buffer for
+ * --async-write and --direct-io
+ */
+static void
+setup_write_combining(SQLtable *table)
+{
+	int		flags;
+
+	sql_table_attach_wbuffer(table,
+							 WRITE_COMBINING_BUFSZ,
+							 WRITE_COMBINING_ALIGN);
+	if (direct_io_mode)
+	{
+		flags = fcntl(table->fdesc, F_GETFL);
+		if (flags < 0 || fcntl(table->fdesc, F_SETFL, flags | O_DIRECT) != 0)
+			Elog("unable to set O_DIRECT on '%s': %m", table->filename);
+	}
+}
+
+/*
+ * Asynchronous write (--async-write)
+ *
+ * The main thread fetches the results into one of the two SQLtable buffers,
+ * while the writer thread writes out the other one; so, the throughput
+ * approaches max(fetch, write), not their sum. The state of the output file
+ * (write-combining buffer, list of RecordBatches and min/max statistics)
+ * moves to the SQLtable being written, then back to the original SQLtable
+ * at the end.
+ */
+static pthread_mutex_t async_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  async_write_cond = PTHREAD_COND_INITIALIZER;
+static SQLtable	   *async_write_pending = NULL;
+static SQLtable	   *async_write_state = NULL;	/* owner of the file state */
+static bool			async_write_finished = false;
+
+/*
+ * clone_sql_table - makes an empty SQLtable with the same definition
+ */
+static void
+clone_sql_field(SQLfield *dest, SQLfield *column)
+{
+	int		j;
+
+	memcpy(dest, column, sizeof(SQLfield));
+	dest->nitems = 0;
+	dest->nullcount = 0;
+	sql_buffer_init(&dest->nullmap);
+	sql_buffer_init(&dest->values);
+	sql_buffer_init(&dest->extra);
+	dest->__curr_usage__ = 0;
+	dest->stat_list = NULL;
+	if (column->element)
+	{
+		dest->element = palloc(sizeof(SQLfield));
+		clone_sql_field(dest->element, column->element);
+	}
+	if (column->subfields)
+	{
+		dest->subfields = palloc(sizeof(SQLfield) * column->nfields);
+		for (j=0; j < column->nfields; j++)
+			clone_sql_field(&dest->subfields[j], &column->subfields[j]);
+	}
+}
+
+static SQLtable *
+clone_sql_table(SQLtable *table)
+{
+	size_t		sz = offsetof(SQLtable, columns[table->nfields]);
+	SQLtable   *dest = palloc(sz);
+	int			j;
+
+	memcpy(dest, table, sz);
+	dest->wbuffer = NULL;
+	dest->recordBatches = NULL;
+	dest->numRecordBatches = 0;
+	sql_buffer_init(&dest->zbuffer);
+	dest->nitems = 0;
+	for (j=0; j < table->nfields; j++)
+		clone_sql_field(&dest->columns[j], &table->columns[j]);
+	return dest;
+}
+
+static void
+async_move_state(SQLtable *dest, SQLtable *source)
+{
+	int		j;
+
+	if (dest == source)
+		return;
+	dest->wbuffer = source->wbuffer;
+	dest->recordBatches = source->recordBatches;
+	dest->numRecordBatches = source->numRecordBatches;
+	dest->dictionaries = source->dictionaries;
+	dest->numDictionaries = source->numDictionaries;
+	for (j=0; j < dest->nfields; j++)
+		dest->columns[j].stat_list = source->columns[j].stat_list;
+	source->wbuffer = NULL;
+}
+
+static void *
+async_write_worker(void *__arg)
+{
+	SQLtable   *table;
+	size_t		nitems;
+
+	pthread_mutex_lock(&async_write_lock);
+	for (;;)
+	{
+		while (!async_write_pending && !async_write_finished)
+			pthread_cond_wait(&async_write_cond, &async_write_lock);
+		table = async_write_pending;
+		if (!table)
+			break;
+		pthread_mutex_unlock(&async_write_lock);
+
+		async_move_state(table, async_write_state);
+		nitems = table->nitems;
+		writeArrowRecordBatch(table);
+		shows_record_batch_progress(table, nitems);
+
+		pthread_mutex_lock(&async_write_lock);
+		async_write_state = table;
+		async_write_pending = NULL;
+		pthread_cond_broadcast(&async_write_cond);
+	}
+	pthread_mutex_unlock(&async_write_lock);
+
+	return NULL;
+}
+
+/*
+ * async_write_submit - hands over the filled SQLtable to the writer thread.
+ * It waits for completion of the previous one, so the caller can reuse
+ * the other SQLtable on return.
+ */
+static void
+async_write_submit(SQLtable *table)
+{
+	pthread_mutex_lock(&async_write_lock);
+	while (async_write_pending)
+		pthread_cond_wait(&async_write_cond, &async_write_lock);
+	/*
+	 * The writer thread is idle now, so we write out delta DictionaryBatches
+	 * prior to the RecordBatch, while the dictionaries are not updated.
+	 */
+	writeArrowDictionaryBatches(async_write_state);
+	async_write_pending = table;
+	pthread_cond_broadcast(&async_write_cond);
+	pthread_mutex_unlock(&async_write_lock);
+}
+
+static void
+async_write_main(void *sqldb_state, SQLtable *table, bool end_of_results)
+{
+	SQLtable   *spare = clone_sql_table(table);
+	SQLtable   *curr = table;
+	pthread_t	thread;
+	ssize_t		usage;
+
+	async_write_state = table;
+	if ((errno = pthread_create(&thread, NULL,
+								async_write_worker, NULL)) != 0)
+		Elog("failed on pthread_create: %m");
+
+	while (!end_of_results &&
+		   (usage = sqldb_fetch_results(sqldb_state, curr)) >= 0)
+	{
+		if (usage > batch_segment_sz)
+		{
+			async_write_submit(curr);
+			curr = (curr == table ? spare : table);
+		}
+	}
+	if (curr->nitems > 0)
+		async_write_submit(curr);
+
+	/* terminate the writer thread */
+	pthread_mutex_lock(&async_write_lock);
+	while (async_write_pending)
+		pthread_cond_wait(&async_write_cond, &async_write_lock);
+	async_write_finished = true;
+	pthread_cond_broadcast(&async_write_cond);
+	pthread_mutex_unlock(&async_write_lock);
+
+	if ((errno = pthread_join(thread, NULL)) != 0)
+		Elog("failed on pthread_join: %m");
+	async_move_state(table, async_write_state);
+}
+
+/*
+ * Output splitting (--split-size, --split-batches, --partition-key)
+ *
+ * The results are written to multiple files; each file has its own schema,
+ * DictionaryBatches and footer, so it is a standalone Apache Arrow file.
+ * With --split-size or --split-batches, the output file is switched to the
+ * next one once it reaches the threshold. With --partition-key, every row
+ * is moved from the staging SQLtable to the SQLtable of the partition by
+ * the key value, and each partition has its own series of files. With
+ * --hive, the key column is not written to the files, because readers
+ * take the key value from the directory name.
+ *
+ * There may be thousands of partitions, so a partition file is closed
+ * once a RecordBatch is written, then reopened on the next write. The
+ * buffers of the partition are also released at that time, and the total
+ * size of the buffers is kept under split_memory_limit by writing out
+ * the largest partition, even if it is less than the segment size.
+ */
+typedef struct splitPartition
+{
+	struct splitPartition *next;
+	uint32		hash;
+	char	   *value;			/* NULL, if partition of NULL keys */
+	SQLtable   *table;
+	char	   *filename;		/* current file, if not closed yet */
+	size_t		footprint;		/* allocated size of the buffers */
+	int			seq;			/* sequence number of the next file */
+} splitPartition;
+
+#define SPLIT_PARTITION_NSLOTS		1024
+#define SPLIT_MEMORY_LIMIT_MIN		(1UL << 30)		/* 1GB */
+static splitPartition *split_partition_slots[SPLIT_PARTITION_NSLOTS];
+static int		split_partition_attnum = -1;
+static size_t	split_memory_limit = 0;
+static size_t	split_memory_usage = 0;
+static char	   *split_key_buf = NULL;
+static size_t	split_key_bufsz = 0;
+
+/*
+ * hive_escape_string - escapes the characters not allowed in the path name
+ * of Hive-style partitioning, like %2F
+ */
+static char *
+hive_escape_string(char *dest, const char *src)
+{
+	for (; *src != '\0'; src++)
+	{
+		unsigned char	c = *src;
+
+		if (c < 0x20 || c == 0x7f || strchr("\"#%'*/:=?\\{[]^", c) != NULL)
+			dest += sprintf(dest, "%%%02X", c);
+		else
+			*dest++ = c;
+	}
+	*dest = '\0';
+	return dest;
+}
+
+/*
+ * split_output_filename
+ *
+ * FILENAME.arrow => FILENAME[.<value>][.<seq>].arrow, or
+ * DIR/FILENAME.arrow => DIR/<key>=<value>/FILENAME[.<seq>].arrow with --hive
+ */
+static char *
+split_output_filename(const char *value, int seq)
+{
+	const char *base = strrchr(output_filename, '/');
+	const char *stem = (base ? base + 1 : output_filename);
+	const char *ext = strrchr(stem, '.');
+	char	   *result, *pos;
+	size_t		len = strlen(output_filename) + 100;
+
+	if (!ext || ext == stem)
+		ext = stem + strlen(stem);
+	if (partition_key_name)
+	{
+		if (!value)
+			value = HIVE_DEFAULT_PARTITION;
+		len += 3 * (strlen(partition_key_name) + strlen(value));
+	}
+	result = pos = palloc(len);
+
+	if (hive_partitioning)
+	{
+		pos += sprintf(pos, "%.*s",
+					   (int)(stem - output_filename), output_filename);
+		pos = hive_escape_string(pos, partition_key_name);
+		*pos++ = '=';
+		pos = hive_escape_string(pos, value);
+		if (mkdir(result, 0755) != 0 && errno != EEXIST)
+			Elog("failed on mkdir('%s'): %m", result);
+		pos += sprintf(pos, "/%.*s", (int)(ext - stem), stem);
+	}
+	else
+	{
+		pos += sprintf(pos, "%.*s",
+					   (int)(ext - output_filename), output_filename);
+		if (partition_key_name)
+		{
+			*pos++ = '.';
+			pos = hive_escape_string(pos, value);
+		}
+	}
+	if (split_size > 0 || split_batches > 0)
+		pos += sprintf(pos, ".%d", seq);
+	strcpy(pos, ext);
+
+	return result;
+}
+
+/*
+ * split_open_file - opens the next file of the partition, then writes out
+ * the schema and the whole image of the dictionaries. If the current file
+ * of the partition is not closed yet, it is reopened to append.
+ */
+static void
+split_open_file(splitPartition *sp)
+{
+	SQLtable   *table = sp->table;
+	int			j;
+
+	if (sp->filename)
+	{
+		table->fdesc = open(sp->filename, O_RDWR);
+		if (table->fdesc < 0)
+			Elog("failed on open('%s'): %m", sp->filename);
+		if (lseek(table->fdesc, 0, SEEK_END) < 0)
+			Elog("failed on lseek('%s'): %m", sp->filename);
+		return;
+	}
+	table->recordBatches = NULL;
+	table->numRecordBatches = 0;
+	for (j=0; j < table->nfields; j++)
+		table->columns[j].stat_list = NULL;
+	resetArrowDictionaryBatches(table);
+	sp->filename = split_output_filename(sp->value, sp->seq);
+	setup_output_file(table, sp->filename);
+	writeArrowDictionaryBatches(table);
+}
+
+static void
+split_close_file(splitPartition *sp)
+{
+	SQLtable   *table = sp->table;
+
+	if (table->fdesc < 0)
+		split_open_file(sp);
+	writeArrowFooter(table);
+	close(table->fdesc);
+	table->fdesc = -1;
+	sp->filename = NULL;
+	sp->seq++;
+}
+
+/*
+ * split_release_buffers - releases the buffers of the idle partition
+ */
+static void
+__split_release_buffer(SQLbuffer *buf)
+{
+	if (buf->data)
+		pfree(buf->data);
+	sql_buffer_init(buf);
+}
+
+static void
+__split_release_field(SQLfield *column)
+{
+	int		j;
+
+	__split_release_buffer(&column->nullmap);
+	__split_release_buffer(&column->values);
+	__split_release_buffer(&column->extra);
+	if (column->element)
+		__split_release_field(column->element);
+	for (j=0; j < column->nfields; j++)
+		__split_release_field(&column->subfields[j]);
+}
+
+static void
+split_release_buffers(splitPartition *sp)
+{
+	SQLtable   *table = sp->table;
+	int			j;
+
+	for (j=0; j < table->nfields; j++)
+		__split_release_field(&table->columns[j]);
+	__split_release_buffer(&table->zbuffer);
+	split_memory_usage -= sp->footprint;
+	sp->footprint = 0;
+}
+
+/*
+ * split_update_footprint - updates the allocated size of the buffers of
+ * the partition, and the total of them.
+ */
+static size_t
+__split_field_footprint(SQLfield *column)
+{
+	size_t	sz = (column->nullmap.length +
+				  column->values.length +
+				  column->extra.length);
+	int		j;
+
+	if (column->element)
+		sz += __split_field_footprint(column->element);
+	for (j=0; j < column->nfields; j++)
+		sz += __split_field_footprint(&column->subfields[j]);
+	return sz;
+}
+
+static void
+split_update_footprint(splitPartition *sp)
+{
+	SQLtable   *table = sp->table;
+	size_t		sz = 0;
+	int			j;
+
+	for (j=0; j < table->nfields; j++)
+		sz += __split_field_footprint(&table->columns[j]);
+	split_memory_usage += sz - sp->footprint;
+	sp->footprint = sz;
+}
+
+static void
+split_write_record_batch(splitPartition *sp)
+{
+	SQLtable   *table = sp->table;
+	size_t		nitems = table->nitems;
+	ArrowBlock *block;
+
+	if (table->fdesc < 0)
+		split_open_file(sp);
+	/* delta DictionaryBatches, if any */
+	writeArrowDictionaryBatches(table);
+	writeArrowRecordBatch(table);
+	shows_record_batch_progress(table, nitems);
+
+	/* switch to the next file, if it reached the threshold */
+	block = &table->recordBatches[table->numRecordBatches - 1];
+	if ((split_batches > 0 &&
+		 table->numRecordBatches >= split_batches) ||
+		(split_size > 0 &&
+		 block->offset + block->metaDataLength + block->bodyLength >= split_size))
+		split_close_file(sp);
+	else if (partition_key_name)
+	{
+		/* not to run out of file descriptors by thousands of partitions */
+		close(table->fdesc);
+		table->fdesc = -1;
+	}
+	if (partition_key_name)
+		split_release_buffers(sp);
+}
+
+/*
+ * split_write_largest_partition - writes out the partition that consumes
+ * the largest buffers, to keep the memory consumption under the limit.
+ */
+static void
+split_write_largest_partition(void)
+{
+	splitPartition *sp, *largest = NULL;
+	int			j;
+
+	for (j=0; j < SPLIT_PARTITION_NSLOTS; j++)
+	{
+		for (sp = split_partition_slots[j]; sp; sp = sp->next)
+		{
+			if (sp->table->nitems > 0 &&
+				(!largest || largest->footprint < sp->footprint))
+				largest = sp;
+		}
+	}
+	if (!largest)
+		Elog("Bug? no partition to be written out");
+	split_write_record_batch(largest);
+}
+
+/*
+ * split_partition_value - text form of the partition key of the first row
+ * in the staging SQLtable. It returns NULL for NULL keys.
+ */
+static const char *
+split_partition_value(SQLfield *column)
+{
+	ArrowType  *t = &column->arrow_type;
+	const char *addr = column->values.data;
+	size_t		len = 64;
+
+	if (column->nullcount > 0 &&
+		(((uint8 *)column->nullmap.data)[0] & 1) == 0)
+		return NULL;
+	if (t->node.tag == ArrowNodeTag__Utf8 && !column->enumdict)
+	{
+		len = ((uint32 *)addr)[1] - ((uint32 *)addr)[0] + 1;
+		addr = column->extra.data + ((uint32 *)addr)[0];
+	}
+	else if (column->enumdict)
+	{
+		SQLdictionary *dict = column->enumdict;
+		hashItem   *hitem = NULL;
+		uint32		index = *((uint32 *)addr);
+		int			i;
+
+		for (i=0; !hitem && i < dict->nslots; i++)
+		{
+			for (hitem = dict->hslots[i]; hitem; hitem = hitem->next)
+			{
+				if (hitem->index == index)
+					break;
+			}
+		}
+		if (!hitem)
+			Elog("Bug? enum label of index %u was not found", index);
+		len = hitem->label_sz + 1;
+		addr = hitem->label;
+	}
+	if (split_key_bufsz < len)
+	{
+		split_key_bufsz = len + 64;
+		if (!split_key_buf)
+			split_key_buf = palloc(split_key_bufsz);
+		else
+			split_key_buf = repalloc(split_key_buf, split_key_bufsz);
+	}
+
+	switch (t->node.tag)
+	{
+		case ArrowNodeTag__Int:
+			switch (t->Int.bitWidth)
+			{
+				case 8:
+					if (t->Int.is_signed)
+						sprintf(split_key_buf, "%d", *((int8 *)addr));
+					else
+						sprintf(split_key_buf, "%u", *((uint8 *)addr));
+					break;
+				case 16:
+					if (t->Int.is_signed)
+						sprintf(split_key_buf, "%d", *((int16 *)addr));
+					else
+						sprintf(split_key_buf, "%u", *((uint16 *)addr));
+					break;
+				case 32:
+					if (t->Int.is_signed)
+						sprintf(split_key_buf, "%d", *((int32 *)addr));
+					else
+						sprintf(split_key_buf, "%u", *((uint32 *)addr));
+					break;
+				case 64:
+					if (t->Int.is_signed)
+						sprintf(split_key_buf, "%ld", *((int64 *)addr));
+					else
+						sprintf(split_key_buf, "%lu", *((uint64 *)addr));
+					break;
+				default:
+					Elog("unexpected Int bitWidth: %d", t->Int.bitWidth);
+			}
+			break;
+
+		case ArrowNodeTag__Bool:
+			strcpy(split_key_buf, (*((uint8 *)addr) & 1) ? "true" : "false");
+			break;
+
+		case ArrowNodeTag__Date:
+			{
+				time_t		tval;
+				struct tm	tm;
+
+				if (t->Date.unit == ArrowDateUnit__Day)
+					tval = (time_t)(*((int32 *)addr)) * 86400;
+				else
+				{
+					int64	msec = *((int64 *)addr);
+
+					tval = msec / 1000 - (msec % 1000 < 0 ? 1 : 0);
+				}
+				if (!gmtime_r(&tval, &tm))
+					Elog("failed on gmtime_r: %m");
+				strftime(split_key_buf, split_key_bufsz, "%Y-%m-%d", &tm);
+			}
+			break;
+
+		case ArrowNodeTag__Utf8:
+			memcpy(split_key_buf, addr, len - 1);
+			split_key_buf[len - 1] = '\0';
+			break;
+
+		default:
+			Elog("--partition-key '%s' is not a supported type (%s)",
+				 column->field_name, column->arrow_typename);
+	}
+	return split_key_buf;
+}
+
+static splitPartition *
+split_lookup_partition(SQLtable *table)
+{
+	SQLfield   *column = &table->columns[split_partition_attnum];
+	const char *value = split_partition_value(column);
+	splitPartition *sp;
+	uint32		hash = 0;
+	int			hindex;
+
+	if (value)
+		hash = hash_any((const unsigned char *)value, strlen(value));
+	hindex = hash % SPLIT_PARTITION_NSLOTS;
+	for (sp = split_partition_slots[hindex]; sp; sp = sp->next)
+	{
+		if (sp->hash != hash)
+			continue;
+		if (!value ? !sp->value : (sp->value && strcmp(sp->value, value) == 0))
+			return sp;
+	}
+	/* a new partition */
+	sp = palloc0(sizeof(splitPartition));
+	sp->hash = hash;
+	sp->value = (value ? pstrdup(value) : NULL);
+	sp->table = clone_sql_table(table);
+	sp->table->fdesc = -1;
+	if (hive_partitioning)
+	{
+		SQLtable   *ptable = sp->table;
+		SQLfield   *column = &ptable->columns[split_partition_attnum];
+
+		/* the key column is a flat type; one FieldNode and 2 or 3 Buffers */
+		ptable->numFieldNodes--;
+		if (column->arrow_type.node.tag == ArrowNodeTag__Utf8 &&
+			!column->enumdict)
+			ptable->numBuffers -= 3;
+		else
+			ptable->numBuffers -= 2;
+		memmove(&ptable->columns[split_partition_attnum],
+				&ptable->columns[split_partition_attnum + 1],
+				sizeof(SQLfield) * (ptable->nfields -
+									split_partition_attnum - 1));
+		ptable->nfields--;
+	}
+	sp->next = split_partition_slots[hindex];
+	split_partition_slots[hindex] = sp;
+
+	return sp;
+}
+
+/*
+ * split_hive_drop_dictionary - removes the enum dictionary of the key column
+ * from the staging SQLtable, if no other columns use it; because the key
+ * column is not written to the files with --hive.
+ */
+static bool
+__split_field_uses_dict(SQLfield *column, SQLdictionary *dict)
+{
+	int		j;
+
+	if (column->enumdict == dict)
+		return true;
+	if (column->element &&
+		__split_field_uses_dict(column->element, dict))
+		return true;
+	for (j=0; j < column->nfields; j++)
+	{
+		if (__split_field_uses_dict(&column->subfields[j], dict))
+			return true;
+	}
+	return false;
+}
+
+static void
+split_hive_drop_dictionary(SQLtable *table)
+{
+	SQLdictionary *dict = table->columns[split_partition_attnum].enumdict;
+	SQLdictionary **prev;
+	int			j;
+
+	if (!dict)
+		return;
+	for (j=0; j < table->nfields; j++)
+	{
+		if (j != split_partition_attnum &&
+			__split_field_uses_dict(&table->columns[j], dict))
+			return;
+	}
+	for (prev = &table->sql_dict_list; *prev; prev = &(*prev)->next)
+	{
+		if (*prev == dict)
+		{
+			*prev = dict->next;
+			break;
+		}
+	}
+}
+
+/*
+ * split_append_row - moves the row in the staging SQLtable to the partition
+ */
+static size_t
+split_append_row(splitPartition *sp, SQLtable *table)
+{
+	SQLtable   *ptable = sp->table;
+	size_t		usage = 0;
+	int			i, j;
+
+	if (!hive_partitioning)
+		return sql_table_append_row(ptable, table, 0);
+	ptable->nitems++;
+	for (i=0, j=0; i < table->nfields; i++)
+	{
+		if (i == split_partition_attnum)
+			continue;
+		usage += sql_field_append_row(&ptable->columns[j++],
+									  &table->columns[i], 0);
+	}
+	return usage;
+}
+
+static void
+split_export_main(void *sqldb_state, SQLtable *table, bool end_of_results)
+{
+	splitPartition *sp;
+	ssize_t		usage;
+	int			j;
+
+	table->fdesc = -1;
+	if (!partition_key_name)
+	{
+		sp = palloc0(sizeof(splitPartition));
+		sp->table = table;
+		while (!end_of_results &&
+			   (usage = sqldb_fetch_results(sqldb_state, table)) >= 0)
+		{
+			if (usage > batch_segment_sz)
+				split_write_record_batch(sp);
+		}
+		if (table->nitems > 0)
+			split_write_record_batch(sp);
+		if (sp->filename)
+			split_close_file(sp);
+		return;
+	}
+
+	/* --partition-key; @table is used to stage a row */
+	for (j=0; j < table->nfields; j++)
+	{
+		if (strcmp(table->columns[j].field_name, partition_key_name) == 0)
+		{
+			split_partition_attnum = j;
+			break;
+		}
+	}
+	if (split_partition_attnum < 0)
+		Elog("--partition-key '%s' was not found in the results",
+			 partition_key_name);
+	if (hive_partitioning)
+	{
+		if (table->nfields < 2)
+			Elog("--hive needs any columns other than --partition-key");
+		split_hive_drop_dictionary(table);
+	}
+	split_memory_limit = Max(4 * batch_segment_sz, SPLIT_MEMORY_LIMIT_MIN);
+	while (sqldb_fetch_results(sqldb_state, table) >= 0)
+	{
+		sp = split_lookup_partition(table);
+		if (split_append_row(sp, table) > batch_segment_sz)
+			split_write_record_batch(sp);
+		else
+		{
+			split_update_footprint(sp);
+			while (split_memory_usage > split_memory_limit)
+				split_write_largest_partition();
+		}
+		sql_table_clear(table);
+	}
+	/* write out the remaining rows and the footers */
+	for (j=0; j < SPLIT_PARTITION_NSLOTS; j++)
+	{
+		for (sp = split_partition_slots[j]; sp; sp = sp->next)
+		{
+			if (sp->table->nitems > 0)
+				split_write_record_batch(sp);
+			if (sp->filename)
+				split_close_file(sp);
+		}
+	}
+}
+
+#ifdef __PG2ARROW__
+/*
+ * Parallel export (--parallel=N)
+ *
+ * N worker threads run the portion of the query on their own connection,
+ * with the snapshot exported by the leader connection; so, they see the
+ * same database state. -t is split by ctid block ranges, and -c is split
+ * by the hash value of --parallel-key; rows with NULL key are assigned to
+ * the worker-0, because their hash value is NULL.
+ * The ctid range condition is processed by TID Range Scan on PostgreSQL
+ * v14 or later. Older servers would run a full sequential scan on every
+ * worker, so -t is exported by a single connection in this case.
+ * Each worker converts the results into its own SQLtable. With
+ * --parallel-files, each worker writes its own file. Elsewhere,
+ * RecordBatches of the workers are interleaved in a single file; the write
+ * is serialized by parallel_write_lock, and the list of RecordBatches and
+ * min/max statistics are shared.
+ */
+typedef struct
+{
+	int			worker_id;
+	pthread_t	thread;
+	void	   *sqldb_state;
+	char	   *command;
+	char	   *filename;		/* only if --parallel-files */
+	SQLtable   *table;			/* NULL, if empty results */
+} parallelWorker;
+
+static pthread_mutex_t parallel_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static SQLtable	   *parallel_head_table = NULL;
+static ArrowBlock  *parallel_record_batches = NULL;
+static int			parallel_num_record_batches = 0;
+static SQLstat	  **parallel_stat_lists = NULL;
+
+/*
+ * parallel_switch_state - swaps the shared state of the output file
+ */
+static void
+parallel_switch_state(SQLtable *table, bool attach)
+{
+	int		j;
+
+	if (attach)
+	{
+		table->fdesc = parallel_head_table->fdesc;
+		table->filename = parallel_head_table->filename;
+		table->recordBatches = parallel_record_batches;
+		table->numRecordBatches = parallel_num_record_batches;
+		for (j=0; j < table->nfields; j++)
+			table->columns[j].stat_list = parallel_stat_lists[j];
+	}
+	else
+	{
+		parallel_record_batches = table->recordBatches;
+		parallel_num_record_batches = table->numRecordBatches;
+		for (j=0; j < table->nfields; j++)
+			parallel_stat_lists[j] = table->columns[j].stat_list;
+	}
+}
+
+static void
+parallel_write_record_batch(SQLtable *table)
+{
+	size_t		nitems = table->nitems;
+
+	pthread_mutex_lock(&parallel_write_lock);
+	if (!parallel_head_table)
+	{
+		/* the first worker writes the header portion */
+		setup_output_file(table, output_filename);
+		writeArrowDictionaryBatches(table);
+		parallel_head_table = table;
+		parallel_stat_lists = palloc0(sizeof(SQLstat *) * table->nfields);
+	}
+	else if (parallel_head_table->nfields != table->nfields)
+		Elog("Bug? workers have inconsistent results");
+	parallel_switch_state(table, true);
+	writeArrowRecordBatch(table);
+	shows_record_batch_progress(table, nitems);
+	parallel_switch_state(table, false);
+	pthread_mutex_unlock(&parallel_write_lock);
+}
+
+static void *
+parallel_export_worker(void *__arg)
+{
+	parallelWorker *pw = __arg;
+	SQLtable   *table;
+	ssize_t		usage;
+
+	table = sqldb_begin_query(pw->sqldb_state, pw->command, NULL, NULL);
+	if (!table)
+		return NULL;	/* no rows in this portion */
+	setup_sql_table(table);
+	if (pw->filename)
+	{
+		setup_output_file(table, pw->filename);
+		writeArrowDictionaryBatches(table);
+	}
+	while ((usage = sqldb_fetch_results(pw->sqldb_state, table)) >= 0)
+	{
+		if (usage > batch_segment_sz)
+		{
+			if (pw->filename)
+			{
+				size_t	nitems = table->nitems;
+
+				writeArrowRecordBatch(table);
+				shows_record_batch_progress(table, nitems);
+			}
+			else
+				parallel_write_record_batch(table);
+		}
+	}
+	if (table->nitems > 0)
+	{
+		if (pw->filename)
+		{
+			size_t	nitems = table->nitems;
+
+			writeArrowRecordBatch(table);
+			shows_record_batch_progress(table, nitems);
+		}
+		else
+			parallel_write_record_batch(table);
+	}
+	if (pw->filename)
+	{
+		writeArrowFooter(table);
+		close(table->fdesc);
+	}
+	pw->table = table;
+	return NULL;
+}
+
+/*
+ * parallel_output_filename - FILENAME.arrow => FILENAME.<id>.arrow
+ */
+static char *
+parallel_output_filename(const char *filename, int worker_id)
+{
+	const char *base = strrchr(filename, '/');
+	const char *ext;
+	char	   *result = palloc(strlen(filename) + 40);
+
+	ext = strrchr(base ? base + 1 : filename, '.');
+	if (!ext || ext == (base ? base + 1 : filename))
+		sprintf(result, "%s.%d", filename, worker_id);
+	else
+		sprintf(result, "%.*s.%d%s",
+				(int)(ext - filename), filename, worker_id, ext);
+	return result;
+}
+
+static int
+parallel_export_main(void)
+{
+	void	   *leader_state;
+	char	   *snapshot;
+	int64		nblocks = 0;
+	parallelWorker *workers;
+	SQLtable   *table = NULL;
+	int			k, nworkers = num_parallel_workers;
+
+	leader_state = sqldb_server_connect(sqldb_hostname,
+										sqldb_port_num,
+										sqldb_username,
+										sqldb_password,
+										sqldb_database,
+										sqldb_session_configs);
+	snapshot = sqldb_export_snapshot(leader_state);
+	if (sqldb_table_name)
+	{
+		if (sqldb_server_version(leader_state) < 140000)
+		{
+			fprintf(stderr, "NOTICE: TID range scan needs PostgreSQL v14 or later,"
+					" so -t is exported by a single connection\n");
+			nworkers = 1;
+		}
+		else
+			nblocks = sqldb_relation_nblocks(leader_state, sqldb_table_name);
+	}
+
+	workers = palloc0(sizeof(parallelWorker) * nworkers);
+	for (k=0; k < nworkers; k++)
+	{
+		parallelWorker *pw = &workers[k];
+
+		pw->worker_id = k;
+		pw->sqldb_state = sqldb_server_connect(sqldb_hostname,
+											   sqldb_port_num,
+											   sqldb_username,
+											   sqldb_password,
+											   sqldb_database,
+											   sqldb_session_configs);
+		sqldb_import_snapshot(pw->sqldb_state, snapshot);
+		if (copy_binary_mode)
+			sqldb_enable_copy_binary(pw->sqldb_state);
+		if (sqldb_table_name)
+		{
+			int64	head = (nblocks * k) / nworkers;
+			int64	tail = (nblocks * (k+1)) / nworkers;
+
+			pw->command = palloc(strlen(sqldb_table_name) + 200);
+			if (nworkers == 1)
+				sprintf(pw->command, "SELECT * FROM %s", sqldb_table_name);
+			else if (k == nworkers - 1)
+				sprintf(pw->command,
+						"SELECT * FROM %s WHERE ctid >= '(%ld,0)'::tid",
+						sqldb_table_name, head);
+			else
+				sprintf(pw->command,
+						"SELECT * FROM %s WHERE ctid >= '(%ld,0)'::tid"
+						" AND ctid < '(%ld,0)'::tid",
+						sqldb_table_name, head, tail);
+		}
+		else
+		{
+			pw->command = palloc(strlen(sqldb_command) +
+								 strlen(parallel_key_expr) + 200);
+			sprintf(pw->command,
+					"SELECT * FROM (%s) __pg2arrow_parallel"
+					" WHERE coalesce(pg_catalog.hashtext((%s)::text) & 2147483647, 0) %% %d = %d",
+					sqldb_command, parallel_key_expr, nworkers, k);
+		}
+		if (parallel_multi_files)
+			pw->filename = parallel_output_filename(output_filename, k);
+	}
+
+	for (k=0; k < nworkers; k++)
+	{
+		parallelWorker *pw = &workers[k];
+
+		if ((errno = pthread_create(&pw->thread, NULL,
+									parallel_export_worker, pw)) != 0)
+			Elog("failed on pthread_create: %m");
+	}
+	for (k=0; k < nworkers; k++)
+	{
+		parallelWorker *pw = &workers[k];
+
+		if ((errno = pthread_join(pw->thread, NULL)) != 0)
+			Elog("failed on pthread_join: %m");
+		if (pw->table)
+			table = pw->table;
+		else if (parallel_multi_files)
+			fprintf(stderr, "NOTICE: worker %d had no rows, so '%s' was not built\n",
+					k, pw->filename);
+		sqldb_close_connection(pw->sqldb_state);
+	}
+	/* all the workers have imported the snapshot */
+	sqldb_close_connection(leader_state);
+	if (!table)
+		Elog("Empty results by the query: %s", sqldb_command);
+
+	/* write out footer portion of the single file */
+	if (!parallel_multi_files)
+	{
+		table = parallel_head_table;
+		parallel_switch_state(table, true);
+		writeArrowFooter(table);
+		close(table->fdesc);
+	}
+	return 0;
+}
+#endif	/* __PG2ARROW__ */
+
 /*
  * Entrypoint of mysql2arrow
  */
@@ -635,8 +2073,8 @@ int main(int argc, char * const argv[])
 	ArrowFileInfo	af_info;
 	void		   *sqldb_state;
 	SQLtable	   *table;
-	ArrowKeyValue  *kv;
 	ssize_t			usage;
+	bool			end_of_results = false;
 	SQLdictionary  *sql_dict_list = NULL;
 	
 	parse_options(argc, argv);
@@ -644,6 +2082,11 @@ int main(int argc, char * const argv[])
 	/* special case if --dump=FILENAME */
 	if (dump_arrow_filename)
 		return dumpArrowFile(dump_arrow_filename);
+#ifdef __PG2ARROW__
+	/* special case if --parallel=N */
+	if (num_parallel_workers > 1)
+		return parallel_export_main();
+#endif
 
 	/* open connection */
 	sqldb_state = sqldb_server_connect(sqldb_hostname,
@@ -652,6 +2095,10 @@ int main(int argc, char * const argv[])
 									   sqldb_password,
 									   sqldb_database,
 									   sqldb_session_configs);
+#ifdef __PG2ARROW__
+	if (copy_binary_mode)
+		sqldb_enable_copy_binary(sqldb_state);
+#endif
 	/* read the original arrow file, if --append mode */
 	if (append_filename)
 	{
@@ -659,6 +2106,9 @@ int main(int argc, char * const argv[])
 		if (append_fdesc < 0)
 			Elog("failed on open('%s'): %m", append_filename);
 		readArrowFileDesc(append_fdesc, &af_info);
+		if (af_info.is_stream)
+			Elog("unable to append on '%s' in IPC streaming format",
+				 append_filename);
 		sql_dict_list = loadArrowDictionaryBatches(append_fdesc, &af_info);
 	}
 	/* begin SQL command execution */
@@ -668,18 +2118,18 @@ int main(int argc, char * const argv[])
 							  sql_dict_list);
 	if (!table)
 		Elog("Empty results by the query: %s", sqldb_command);
-	table->segment_sz = batch_segment_sz;
+	setup_sql_table(table);
+	/* dictionary encoding of the text columns, if --auto-dictionary */
+	if (auto_dictionary_max > 0)
+		end_of_results = setup_auto_dictionary(sqldb_state, table);
 
-	/* save the SQL command as custom metadata */
-	kv = palloc0(sizeof(ArrowKeyValue));
-	initArrowNode(kv, KeyValue);
-	kv->key = "sql_command";
-	kv->_key_len = 11;
-	kv->value = sqldb_command;
-	kv->_value_len = strlen(sqldb_command);
-	table->customMetadata = kv;
-	table->numCustomMetadata = 1;
-	
+	/* special case if --split-size, --split-batches or --partition-key */
+	if (split_size > 0 || split_batches > 0 || partition_key_name)
+	{
+		split_export_main(sqldb_state, table, end_of_results);
+		sqldb_close_connection(sqldb_state);
+		return 0;
+	}
 	/* open & setup result file */
 	if (!append_filename)
 		setup_output_file(table, output_filename);
@@ -691,26 +2141,38 @@ int main(int argc, char * const argv[])
 	}
 	/* write out dictionary batch, if any */
 	writeArrowDictionaryBatches(table);
+	if (async_write_mode || direct_io_mode)
+		setup_write_combining(table);
 	/* main loop to fetch and write result */
-	while ((usage = sqldb_fetch_results(sqldb_state, table)) >= 0)
+	if (async_write_mode)
+		async_write_main(sqldb_state, table, end_of_results);
+	else
 	{
-		if (usage > batch_segment_sz)
+		while (!end_of_results &&
+			   (usage = sqldb_fetch_results(sqldb_state, table)) >= 0)
+		{
+			if (usage > batch_segment_sz)
+			{
+				size_t		nitems = table->nitems;
+
+				/* delta DictionaryBatches, if any */
+				writeArrowDictionaryBatches(table);
+				writeArrowRecordBatch(table);
+				shows_record_batch_progress(table, nitems);
+			}
+		}
+		if (table->nitems > 0)
 		{
 			size_t		nitems = table->nitems;
 
+			writeArrowDictionaryBatches(table);
 			writeArrowRecordBatch(table);
 			shows_record_batch_progress(table, nitems);
 		}
 	}
-	if (table->nitems > 0)
-	{
-		size_t		nitems = table->nitems;
-
-		writeArrowRecordBatch(table);
-		shows_record_batch_progress(table, nitems);
-	}
 	/* write out footer portion */
 	writeArrowFooter(table);
+	sql_table_detach_wbuffer(table);
 
 	/* cleanup */
 	sqldb_close_connection(sqldb_state);
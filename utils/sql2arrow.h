@@ -28,6 +28,19 @@ sqldb_fetch_results(void *sqldb_state, SQLtable *table);
 extern void
 sqldb_close_connection(void *sqldb_state);
 
+/* only pg2arrow, for --parallel */
+extern char *
+sqldb_export_snapshot(void *sqldb_state);
+extern void
+sqldb_import_snapshot(void *sqldb_state, const char *snapshot);
+extern int64
+sqldb_relation_nblocks(void *sqldb_state, const char *relname);
+extern int
+sqldb_server_version(void *sqldb_state);
+/* only pg2arrow, for --copy */
+extern void
+sqldb_enable_copy_binary(void *sqldb_state);
+
 /* misc functions */
 extern void	   *palloc(Size sz);
 extern void	   *palloc0(Size sz);